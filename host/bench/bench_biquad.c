@@ -0,0 +1,164 @@
+// Compares the biquad bank with the per-channel dsps_biquad_f32_ansi calls it
+// replaced in the IIR filter: cost per frame, one frame at a time and in blocks,
+// and whether the outputs are identical.
+//
+//   bench_biquad [-n frames] [-b block]
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_dsp.h"
+
+#include "constants.h"
+#include "biquad_bank.h"
+
+// Same filters as the IIR filter defaults at the frame rate.
+static const float frequencies[SENSOR_COUNT] = {2, 2, 2, 2, 2, 10, 10, 10, 10, 10};
+#define QFACTOR 0.5f
+
+static uint32_t rng_state = 2463534242u;
+
+static uint32_t xorshift(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Idle readings with noise, and presses of a few hundred counts lasting up to a second.
+static void fill_input(float *in, int frames)
+{
+    int level[SENSOR_COUNT] = {0};
+    int remaining[SENSOR_COUNT] = {0};
+    for (int n = 0; n < frames; ++n)
+    {
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            if (remaining[i]-- <= 0)
+            {
+                level[i] = xorshift() % 4 ? 0 : 200 + xorshift() % 800;
+                remaining[i] = 10 + xorshift() % 100;
+            }
+            in[n * (SENSOR_COUNT) + i] = (float)(1000 + level[i] + xorshift() % 25);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int frames = 1000000;
+    int block = 32;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 'b':
+            block = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n frames] [-b block]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames < 1 || block < 1)
+    {
+        fprintf(stderr, "usage: %s [-n frames] [-b block]\n", argv[0]);
+        return 1;
+    }
+
+    float coeffs[SENSOR_COUNT][5];
+    biquad_bank bank;
+    biquad_bank_init(&bank);
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        dsps_biquad_gen_bpf_f32(coeffs[i], frequencies[i] / SENSOR_FRAME_RATE_HZ, QFACTOR);
+        biquad_bank_set(&bank, i, coeffs[i]);
+    }
+
+    size_t values = (size_t)frames * (SENSOR_COUNT);
+    float *in = malloc(values * sizeof(float));
+    float *reference = malloc(values * sizeof(float));
+    float *single = malloc(values * sizeof(float));
+    float *blocked = malloc(values * sizeof(float));
+    fill_input(in, frames);
+
+    // What iir_filter_process_filter did: one call per channel per frame.
+    float delay_line[SENSOR_COUNT][2] = {0};
+    int64_t t0 = now_ns();
+    for (int n = 0; n < frames; ++n)
+    {
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            dsps_biquad_f32_ansi(&in[n * (SENSOR_COUNT) + i], &reference[n * (SENSOR_COUNT) + i], 1, coeffs[i], delay_line[i]);
+        }
+    }
+    int64_t reference_ns = now_ns() - t0;
+
+    t0 = now_ns();
+    for (int n = 0; n < frames; ++n)
+    {
+        biquad_bank_process(&bank, &in[n * (SENSOR_COUNT)], &single[n * (SENSOR_COUNT)]);
+    }
+    int64_t single_ns = now_ns() - t0;
+
+    biquad_bank_reset(&bank);
+    t0 = now_ns();
+    for (int n = 0; n < frames; n += block)
+    {
+        int count = frames - n < block ? frames - n : block;
+        biquad_bank_process_block(&bank, &in[n * (SENSOR_COUNT)], &blocked[n * (SENSOR_COUNT)], count);
+    }
+    int64_t blocked_ns = now_ns() - t0;
+
+    printf("%d frames of %d channels\n", frames, SENSOR_COUNT);
+    printf("dsps_biquad_f32_ansi per channel  %6.1f ns/frame\n", (double)reference_ns / frames);
+    printf("biquad_bank_process               %6.1f ns/frame  %.1fx\n", (double)single_ns / frames,
+           (double)reference_ns / single_ns);
+    printf("biquad_bank_process_block (%4d)  %6.1f ns/frame  %.1fx\n", block, (double)blocked_ns / frames,
+           (double)reference_ns / blocked_ns);
+
+    bool ok = true;
+    const float *outputs[] = {single, blocked};
+    const char *names[] = {"per frame", "block"};
+    for (int k = 0; k < 2; ++k)
+    {
+        size_t differing = 0;
+        double max_error = 0;
+        for (size_t j = 0; j < values; ++j)
+        {
+            if (memcmp(&outputs[k][j], &reference[j], sizeof(float)) != 0)
+            {
+                differing++;
+                max_error = fmax(max_error, fabs((double)outputs[k][j] - reference[j]));
+            }
+        }
+        printf("%-9s output: %s", names[k], differing ? "DIFFERS" : "identical to the reference");
+        if (differing)
+        {
+            printf(", %zu values, max error %g", differing, max_error);
+        }
+        printf("\n");
+        ok &= !differing;
+    }
+
+    free(in);
+    free(reference);
+    free(single);
+    free(blocked);
+    return ok ? 0 : 1;
+}
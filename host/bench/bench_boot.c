@@ -0,0 +1,195 @@
+// Boots the firmware twice in virtual time, the way app_main and hid_task do,
+// and reports the time from boot to the first keystroke sent over BLE. The first
+// boot starts with empty NVS: the filter calibrates, typing starts once it has
+// (synthetic_typing's default), and the calibration is saved (filter_store.h).
+// The second boot restores it, with typing from -s ms after boot. The host
+// connects -c ms after boot, as a bonded host reconnects.
+//
+//   bench_boot [-c connect_ms] [-s start_ms] [-v]
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_hidd_prf_api.h"
+
+#include "haptics.h"
+#include "sensors.h"
+#include "encoding.h"
+#include "constants.h"
+#include "state.h"
+#include "bluetooth.h"
+#include "filter.h"
+#include "filter_store.h"
+#include "iir_filter.h"
+
+#include "host_hal.h"
+#include "synthetic_typing.h"
+
+// Give up on a boot that has not typed by then.
+#define BOOT_LIMIT_US 30000000
+
+// One boot, in a process of its own. Returns the exit status.
+static int boot(const char *nvs_path, bool cold, int64_t connect_us, int64_t typing_start_us)
+{
+    host_clock_set_virtual(true);
+    if (!cold && !host_nvs_load(nvs_path))
+    {
+        perror(nvs_path);
+        return 1;
+    }
+    synthetic_typing_t typing;
+    synthetic_typing_default(&typing);
+    if (!cold)
+    {
+        typing.start_us = typing_start_us;
+    }
+    host_adc_set_source(synthetic_typing_adc_source, &typing);
+
+    // app_main.
+    bt_init();
+    sensor_init();
+    default_filter_init(init_iir_filter_default());
+    bool restored = filter_store_restore();
+    initialize_feedback();
+
+    // hid_task, with the writer task's work done inline.
+    if (!restored)
+    {
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+    }
+    envelope_encoder_state encoder_state = {};
+    command_decoder_state command_state = {};
+    keyboard_system_command_t last_command = KEYBOARD_COMMAND_NONE;
+    keyboard_cmd_t last_tx_key = 0;
+    key_mask_t last_tx_mask = 0;
+    bool connected = false;
+    while (esp_timer_get_time() < BOOT_LIMIT_US)
+    {
+        if (!connected && esp_timer_get_time() >= connect_us)
+        {
+            host_bt_connect(0);
+            connected = true;
+        }
+        update_state(last_command);
+        char pins = pressure_sensor_read();
+        encoder_output_t out = envelope_encode(&encoder_state, pins, device_state);
+        convert_to_hid_code(&out, device_state);
+        do_feedback(out.encoder_flags);
+        last_command = decode_command(&command_state, out);
+        if (device_state == (KEYBOARD_STATE_BT_CONNECTED | KEYBOARD_STATE_SENSOR_NORMAL) &&
+            !((out.mask == last_tx_mask) && (out.hid == last_tx_key)))
+        {
+            last_tx_key = out.hid;
+            last_tx_mask = out.mask;
+            bt_send(out.mask, out.hid);
+        }
+        filter_store_flush();
+        if (bt_first_key_us() >= 0 && (!cold || filter_store_get_stats().writes))
+        {
+            break;
+        }
+    }
+
+    filter_store_stats_t stats = filter_store_get_stats();
+    printf("%s boot: ", cold ? "cold" : "warm");
+    if (stats.restored_us >= 0)
+    {
+        printf("filter restored at %lld ms, ", (long long)stats.restored_us / 1000);
+    }
+    else
+    {
+        printf("filter calibrating, ");
+    }
+    printf("typing from %lld ms, host connected at %lld ms, ", (long long)typing.start_us / 1000,
+           (long long)connect_us / 1000);
+    if (bt_first_key_us() >= 0)
+    {
+        printf("first key at %lld ms\n", (long long)bt_first_key_us() / 1000);
+    }
+    else
+    {
+        printf("no key in %d s\n", BOOT_LIMIT_US / 1000000);
+    }
+
+    if (cold)
+    {
+        if (!stats.writes)
+        {
+            printf("filter state was not saved\n");
+            return 1;
+        }
+        if (!host_nvs_save(nvs_path))
+        {
+            perror(nvs_path);
+            return 1;
+        }
+    }
+    return bt_first_key_us() >= 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    int64_t connect_us = 0;
+    int64_t typing_start_us = 0;
+    bool verbose = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:s:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            connect_us = atoll(optarg) * 1000;
+            break;
+        case 's':
+            typing_start_us = atoll(optarg) * 1000;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-c connect_ms] [-s start_ms] [-v]\n", argv[0]);
+            return 1;
+        }
+    }
+    esp_log_level_set("*", verbose ? ESP_LOG_INFO : ESP_LOG_NONE);
+
+    char nvs_path[] = "/tmp/bench_boot_nvsXXXXXX";
+    int fd = mkstemp(nvs_path);
+    if (fd < 0)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    int status = 0;
+    for (int cold = 1; cold >= 0 && status == 0; --cold)
+    {
+        // Every boot starts from fresh firmware statics.
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("fork");
+            status = 1;
+            break;
+        }
+        if (pid == 0)
+        {
+            int code = boot(nvs_path, cold, connect_us, typing_start_us);
+            fflush(stdout);
+            _exit(code);
+        }
+        int wstatus;
+        waitpid(pid, &wstatus, 0);
+        status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 1;
+    }
+    unlink(nvs_path);
+    return status;
+}
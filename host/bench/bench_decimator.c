@@ -0,0 +1,147 @@
+// Measures the CIC decimator for a range of orders and ratios: CPU cost per
+// output frame, noise left on a steady reading, and group delay of a step.
+//
+//   bench_decimator [-n frames]
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "constants.h"
+#include "decimator.h"
+
+// Raw noise on an idle Velostat channel, in ADC counts.
+#define NOISE_STDDEV 12.0
+#define BASELINE 1000
+#define STEP 800
+
+static uint32_t rng_state = 2463534242u;
+
+static double gaussian(void)
+{
+    // Irwin-Hall approximation from four uniforms.
+    double sum = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        rng_state ^= rng_state << 13;
+        rng_state ^= rng_state >> 17;
+        rng_state ^= rng_state << 5;
+        sum += rng_state / 4294967296.0;
+    }
+    return (sum - 2.0) * sqrt(3.0);
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void fill_noisy(uint32_t *scans, int count, int level)
+{
+    for (int s = 0; s < count; ++s)
+    {
+        for (int i = 0; i < ADC_SENSOR_COUNT; ++i)
+        {
+            double value = level + NOISE_STDDEV * gaussian();
+            scans[s * ADC_SENSOR_COUNT + i] = value < 0 ? 0 : value > 4095 ? 4095 : (uint32_t)lround(value);
+        }
+    }
+}
+
+static void run(int order, int ratio, int frames, uint32_t *scans)
+{
+    cic_decimator decimator;
+    if (cic_decimator_init(&decimator, order, ratio) != ESP_OK)
+    {
+        printf("order %d  ratio %3d  register too narrow\n", order, ratio);
+        return;
+    }
+
+    // Steady input: cost and residual noise.
+    int scan_count = frames * ratio;
+    fill_noisy(scans, scan_count, BASELINE);
+    uint32_t out[ADC_SENSOR_COUNT];
+    double sum = 0, sum_squares = 0;
+    int outputs = 0;
+    int64_t t0 = now_ns();
+    for (int s = 0; s < scan_count; ++s)
+    {
+        if (cic_decimator_push(&decimator, &scans[s * ADC_SENSOR_COUNT], out))
+        {
+            sum += out[0];
+            sum_squares += (double)out[0] * out[0];
+            outputs++;
+        }
+    }
+    int64_t elapsed = now_ns() - t0;
+    double mean = sum / outputs;
+    double stddev = sqrt(sum_squares / outputs - mean * mean);
+
+    // Noiseless step off a frame boundary: delay to the 50% crossing, in input scans.
+    cic_decimator_reset(&decimator);
+    int step_at = 5 * ratio * order + 3;
+    double delay = -1;
+    uint32_t previous = BASELINE;
+    for (int s = 0; s < step_at + 4 * ratio * order && delay < 0; ++s)
+    {
+        uint32_t level = s < step_at ? BASELINE : BASELINE + STEP;
+        uint32_t scan[ADC_SENSOR_COUNT];
+        for (int i = 0; i < ADC_SENSOR_COUNT; ++i)
+        {
+            scan[i] = level;
+        }
+        if (cic_decimator_push(&decimator, scan, out))
+        {
+            if (out[0] >= BASELINE + STEP / 2)
+            {
+                // Interpolate between this output and the previous one.
+                double fraction = (BASELINE + STEP / 2.0 - previous) / ((double)out[0] - previous);
+                delay = s - ratio * (1 - fraction) - step_at + 1;
+            }
+            previous = out[0];
+        }
+    }
+
+    printf("order %d  ratio %3d  %7.1f ns/frame  noise %5.2f counts (%4.1f bits gained)  delay %5.1f scans (nominal %5.1f)\n",
+           order, ratio, (double)elapsed / outputs, stddev, log2(NOISE_STDDEV / stddev), delay, order * (ratio - 1) / 2.0);
+}
+
+int main(int argc, char **argv)
+{
+    int frames = 20000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n frames]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames <= 0)
+    {
+        fprintf(stderr, "frame count must be positive\n");
+        return 1;
+    }
+
+    static const int ratios[] = {5, 10, 20};
+    uint32_t *scans = malloc(sizeof(uint32_t) * ADC_SENSOR_COUNT * frames * 20);
+    printf("%d channels, input noise %.1f counts, ADC_DECIMATOR_ORDER %d, ADC_SCANS_PER_FRAME %d\n",
+           ADC_SENSOR_COUNT, NOISE_STDDEV, ADC_DECIMATOR_ORDER, ADC_SCANS_PER_FRAME);
+    for (int order = 1; order <= DECIMATOR_MAX_ORDER; ++order)
+    {
+        for (size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); ++r)
+        {
+            run(order, ratios[r], frames, scans);
+        }
+    }
+    free(scans);
+    return 0;
+}
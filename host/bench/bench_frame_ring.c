@@ -0,0 +1,203 @@
+// Stress test and throughput benchmark for the sampler's SPSC frame ring.
+// A producer thread and a consumer thread, on different CPUs when there are two,
+// pass frames as fast as they can, yielding when the ring is full or empty.
+// Every frame is checked for order and content, and the rate is compared with
+// the FreeRTOS queue stand-in doing the same job.
+//
+//   bench_frame_ring [-n frames]
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "frame_ring.h"
+
+typedef struct
+{
+    int frames;
+    int cpu;
+    frame_ring_t *ring;
+    QueueHandle_t queue;
+    uint64_t full_or_empty;
+    int errors;
+} side_t;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void pin_to_cpu(int cpu)
+{
+    if (cpu < 0)
+    {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Every field depends on the sequence, so a torn or stale copy is caught.
+static void fill_frame(sensor_frame_t *frame, uint32_t sequence)
+{
+    frame->sequence = sequence;
+    frame->timestamp_us = (int64_t)sequence * 10000;
+    for (int i = 0; i < ADC_SENSOR_COUNT; ++i)
+    {
+        frame->adc_raw[i] = sequence * 2654435761u + i;
+    }
+    frame->pressed = sequence & SENSOR_MASK_ALL;
+    frame->pins = (char)sequence;
+}
+
+static int check_frame(const sensor_frame_t *frame, uint32_t sequence)
+{
+    sensor_frame_t expected;
+    fill_frame(&expected, sequence);
+    if (frame->sequence != expected.sequence || frame->timestamp_us != expected.timestamp_us || frame->pins != expected.pins ||
+        frame->pressed != expected.pressed)
+    {
+        return 1;
+    }
+    for (int i = 0; i < ADC_SENSOR_COUNT; ++i)
+    {
+        if (frame->adc_raw[i] != expected.adc_raw[i])
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void *ring_producer(void *arg)
+{
+    side_t *side = arg;
+    pin_to_cpu(side->cpu);
+    sensor_frame_t frame;
+    for (int n = 0; n < side->frames; ++n)
+    {
+        fill_frame(&frame, n);
+        while (!frame_ring_push(side->ring, &frame))
+        {
+            side->full_or_empty++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void *ring_consumer(void *arg)
+{
+    side_t *side = arg;
+    pin_to_cpu(side->cpu);
+    sensor_frame_t frame;
+    for (int n = 0; n < side->frames; ++n)
+    {
+        while (!frame_ring_pop(side->ring, &frame))
+        {
+            side->full_or_empty++;
+            sched_yield();
+        }
+        side->errors += check_frame(&frame, n);
+    }
+    return NULL;
+}
+
+static void *queue_producer(void *arg)
+{
+    side_t *side = arg;
+    pin_to_cpu(side->cpu);
+    sensor_frame_t frame;
+    for (int n = 0; n < side->frames; ++n)
+    {
+        fill_frame(&frame, n);
+        xQueueSend(side->queue, &frame, portMAX_DELAY);
+    }
+    return NULL;
+}
+
+static void *queue_consumer(void *arg)
+{
+    side_t *side = arg;
+    pin_to_cpu(side->cpu);
+    sensor_frame_t frame;
+    for (int n = 0; n < side->frames; ++n)
+    {
+        xQueueReceive(side->queue, &frame, portMAX_DELAY);
+        side->errors += check_frame(&frame, n);
+    }
+    return NULL;
+}
+
+static int run(const char *name, void *(*producer_fn)(void *), void *(*consumer_fn)(void *), side_t *producer, side_t *consumer)
+{
+    pthread_t producer_thread, consumer_thread;
+    int64_t t0 = now_ns();
+    pthread_create(&consumer_thread, NULL, consumer_fn, consumer);
+    pthread_create(&producer_thread, NULL, producer_fn, producer);
+    pthread_join(producer_thread, NULL);
+    pthread_join(consumer_thread, NULL);
+    int64_t elapsed = now_ns() - t0;
+    printf("%-12s %8.2f Mframes/s  %6.1f ns/frame  producer spins %llu  consumer spins %llu  errors %d\n", name,
+           producer->frames / (elapsed / 1e3), (double)elapsed / producer->frames,
+           (unsigned long long)producer->full_or_empty, (unsigned long long)consumer->full_or_empty, consumer->errors);
+    return consumer->errors;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = 5000000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n frames]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames <= 0)
+    {
+        fprintf(stderr, "frame count must be positive\n");
+        return 1;
+    }
+
+    bool two_cpus = sysconf(_SC_NPROCESSORS_ONLN) >= 2;
+    printf("%d frames of %zu bytes, ring of %d, %s\n", frames, sizeof(sensor_frame_t), FRAME_RING_CAPACITY,
+           two_cpus ? "threads pinned to CPUs 0 and 1" : "single CPU");
+
+    static frame_ring_t ring;
+    frame_ring_init(&ring);
+    side_t producer = {.frames = frames, .cpu = two_cpus ? 0 : -1, .ring = &ring};
+    side_t consumer = {.frames = frames, .cpu = two_cpus ? 1 : -1, .ring = &ring};
+    int errors = run("frame_ring", ring_producer, ring_consumer, &producer, &consumer);
+    if (frame_ring_count(&ring) != 0)
+    {
+        printf("ring not empty at the end\n");
+        errors++;
+    }
+
+    QueueHandle_t queue = xQueueCreate(FRAME_RING_CAPACITY, sizeof(sensor_frame_t));
+    side_t queue_producer_side = {.frames = frames, .cpu = producer.cpu, .queue = queue};
+    side_t queue_consumer_side = {.frames = frames, .cpu = consumer.cpu, .queue = queue};
+    errors += run("xQueue", queue_producer, queue_consumer, &queue_producer_side, &queue_consumer_side);
+    vQueueDelete(queue);
+
+    printf("%s\n", errors ? "FAILED" : "ok");
+    return errors != 0;
+}
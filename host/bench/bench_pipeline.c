@@ -0,0 +1,210 @@
+// Runs the hid_task loop (sensors -> filter -> encoder -> haptics -> bt_send) on
+// synthetic typing under virtual time and reports the CPU cost of each stage.
+// -p sets the time from one chord to the next, and -l lets the encoder learn its
+// envelope timing (ENVELOPE_ADAPTIVE_TIMING), to see how fast typing it keeps
+// up with. Below about 210 ms the chords overlap, and -r lets the next one
+// start while the last is releasing (ENVELOPE_ROLLOVER). Chords accepted in the
+// order typed are counted as intact.
+//
+//   bench_pipeline [-n frames] [-p period_ms] [-l] [-r] [-v]
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_hidd_prf_api.h"
+
+#include "haptics.h"
+#include "sensors.h"
+#include "encoding.h"
+#include "constants.h"
+#include "state.h"
+#include "bluetooth.h"
+#include "filter.h"
+#include "iir_filter.h"
+#include "layout.h"
+
+#include "host_hal.h"
+#include "synthetic_typing.h"
+
+enum
+{
+    STAGE_SENSORS,
+    STAGE_ENCODER,
+    STAGE_BT,
+    STAGE_COUNT,
+};
+
+static const char *stage_names[STAGE_COUNT] = {"pressure_sensor_read", "encode+feedback", "bt_send"};
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int compare_int64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void report_stage(const char *name, int64_t *samples, int count)
+{
+    int64_t total = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        total += samples[i];
+    }
+    qsort(samples, count, sizeof(int64_t), compare_int64);
+    printf("%-22s mean %8.1f ns  p50 %7ld ns  p99 %7ld ns  max %8ld ns\n", name,
+           (double)total / count, (long)samples[count / 2], (long)samples[count * 99 / 100], (long)samples[count - 1]);
+}
+
+int main(int argc, char **argv)
+{
+    int frames = 100000;
+    int period_ms = 0;
+    bool adaptive_timing = false;
+    bool rollover = false;
+    bool verbose = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:lrv")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 'p':
+            period_ms = atoi(optarg);
+            break;
+        case 'l':
+            adaptive_timing = true;
+            break;
+        case 'r':
+            rollover = true;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n frames] [-p period_ms] [-l] [-r] [-v]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames <= 0)
+    {
+        fprintf(stderr, "frame count must be positive\n");
+        return 1;
+    }
+
+    esp_log_level_set("*", verbose ? ESP_LOG_INFO : ESP_LOG_NONE);
+    host_clock_set_virtual(true);
+
+    synthetic_typing_t typing;
+    synthetic_typing_default(&typing);
+    if (period_ms > 0)
+    {
+        typing.period_us = period_ms * 1000;
+    }
+    host_adc_set_source(synthetic_typing_adc_source, &typing);
+
+    bt_init();
+    sensor_init();
+    default_filter_init(init_iir_filter_default());
+    initialize_feedback();
+    host_bt_connect(0);
+
+    envelope_encoder_state encoder_state;
+    envelope_encoder_init(&encoder_state, false, false, adaptive_timing, rollover);
+    command_decoder_state command_state = {};
+    keyboard_system_command_t last_command = KEYBOARD_COMMAND_NONE;
+    keyboard_cmd_t last_tx_key = 0;
+    key_mask_t last_tx_mask = 0;
+    int accepted = 0;
+    int intact = 0;
+    int next_chord = 0;
+
+    int64_t *samples[STAGE_COUNT];
+    for (int s = 0; s < STAGE_COUNT; ++s)
+    {
+        samples[s] = calloc(frames, sizeof(int64_t));
+    }
+
+    for (int i = 0; i < frames; ++i)
+    {
+        update_state(last_command);
+
+        int64_t t0 = now_ns();
+        char pins = pressure_sensor_read();
+        int64_t t1 = now_ns();
+        encoder_output_t out = envelope_encode(&encoder_state, pins, device_state);
+        layout_apply();
+        convert_to_hid_code(&out, device_state);
+        do_feedback(out.encoder_flags);
+        last_command = decode_command(&command_state, out);
+        int64_t t2 = now_ns();
+        if (device_state == (KEYBOARD_STATE_BT_CONNECTED | KEYBOARD_STATE_SENSOR_NORMAL) &&
+            !((out.mask == last_tx_mask) && (out.hid == last_tx_key)))
+        {
+            last_tx_key = out.hid;
+            last_tx_mask = out.mask;
+            bt_send(out.mask, out.hid);
+        }
+        int64_t t3 = now_ns();
+
+        if (out.encoder_flags == ENCODER_FLAG_ACCEPTED)
+        {
+            accepted++;
+            // Matched against the next few chords typed, so that a chord lost or
+            // merged does not throw off the rest.
+            for (int k = 0; k < 3; ++k)
+            {
+                if (out.accumulated_bitstring == typing.chords[(next_chord + k) % typing.chord_count])
+                {
+                    intact++;
+                    next_chord += k + 1;
+                    break;
+                }
+            }
+        }
+        samples[STAGE_SENSORS][i] = t1 - t0;
+        samples[STAGE_ENCODER][i] = t2 - t1;
+        samples[STAGE_BT][i] = t3 - t2;
+    }
+
+    int64_t *total = calloc(frames, sizeof(int64_t));
+    for (int i = 0; i < frames; ++i)
+    {
+        total[i] = samples[STAGE_SENSORS][i] + samples[STAGE_ENCODER][i] + samples[STAGE_BT][i];
+    }
+
+    int64_t typed = esp_timer_get_time() > typing.start_us ? (esp_timer_get_time() - typing.start_us) / typing.period_us + 1 : 0;
+    printf("%d frames (%.1f s virtual), %d chords accepted, %llu HID reports\n", frames,
+           esp_timer_get_time() / 1e6, accepted, (unsigned long long)host_bt_report_count());
+    printf("%lld chords typed, %d accepted intact\n", (long long)typed, intact);
+    if (adaptive_timing)
+    {
+        printf("learned grace %u ms, reject after %u ms, from %u chords\n", encoder_state.timing.grace_us / 1000,
+               encoder_state.timing.reject_us / 1000, encoder_state.timing.chords);
+    }
+    if (rollover)
+    {
+        printf("%u chords started while the one before was releasing\n", encoder_state.rollovers);
+    }
+    for (int s = 0; s < STAGE_COUNT; ++s)
+    {
+        report_stage(stage_names[s], samples[s], frames);
+        free(samples[s]);
+    }
+    report_stage("total", total, frames);
+    free(total);
+    return 0;
+}
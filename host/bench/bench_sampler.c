@@ -0,0 +1,118 @@
+// Compares the old vTaskDelay(1)-paced loop with the sampler task in real time,
+// with a consumer that spends load_us per frame and stalls for stall_ms once a
+// second (a slow esp_ble_gatts_send_indicate, say). Reports the achieved frame
+// rate and the sampler's jitter, deadline-miss and queue statistics.
+//
+//   bench_sampler [-d seconds] [-l load_us] [-s stall_ms]
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "constants.h"
+#include "acquisition.h"
+#include "sampler.h"
+
+#include "host_hal.h"
+#include "synthetic_typing.h"
+
+static void busy_wait_us(int64_t duration_us)
+{
+    int64_t end = esp_timer_get_time() + duration_us;
+    while (esp_timer_get_time() < end)
+    {
+    }
+}
+
+static void simulate_processing(int64_t frame_start_us, int64_t *next_stall_us, int load_us, int stall_ms)
+{
+    busy_wait_us(load_us);
+    if (stall_ms && frame_start_us >= *next_stall_us)
+    {
+        struct timespec ts = {.tv_sec = stall_ms / 1000, .tv_nsec = (long)(stall_ms % 1000) * 1000000};
+        nanosleep(&ts, NULL);
+        *next_stall_us += 1000000;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = 3;
+    int load_us = 2000;
+    int stall_ms = 60;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:l:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            seconds = atoi(optarg);
+            break;
+        case 'l':
+            load_us = atoi(optarg);
+            break;
+        case 's':
+            stall_ms = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-d seconds] [-l load_us] [-s stall_ms]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (seconds <= 0 || load_us < 0 || stall_ms < 0)
+    {
+        fprintf(stderr, "arguments must be positive\n");
+        return 1;
+    }
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    synthetic_typing_t typing;
+    synthetic_typing_default(&typing);
+    host_adc_set_source(synthetic_typing_adc_source, &typing);
+
+    // Old pacing: the period is one tick plus whatever the loop body took.
+    int64_t start = esp_timer_get_time();
+    int64_t next_stall = start + 1000000;
+    int loops = 0;
+    while (esp_timer_get_time() - start < (int64_t)seconds * 1000000)
+    {
+        vTaskDelay(1);
+        simulate_processing(esp_timer_get_time(), &next_stall, load_us, stall_ms);
+        loops++;
+    }
+    double elapsed = (esp_timer_get_time() - start) / 1e6;
+    printf("vTaskDelay(1) loop  %6.1f Hz (filter assumes %d Hz)\n", loops / elapsed, SENSOR_FRAME_RATE_HZ);
+
+    acquisition_init();
+    sampler_init(NULL);
+    sampler_start(xTaskGetCurrentTaskHandle());
+    start = esp_timer_get_time();
+    next_stall = start + 1000000;
+    int received = 0;
+    int64_t max_latency = 0;
+    while (esp_timer_get_time() - start < (int64_t)seconds * 1000000)
+    {
+        sensor_frame_t frame;
+        if (!sampler_receive(&frame, pdMS_TO_TICKS(100)))
+        {
+            printf("sampler stopped delivering\n");
+            return 1;
+        }
+        int64_t latency = esp_timer_get_time() - frame.timestamp_us;
+        max_latency = latency > max_latency ? latency : max_latency;
+        simulate_processing(esp_timer_get_time(), &next_stall, load_us, stall_ms);
+        received++;
+    }
+    elapsed = (esp_timer_get_time() - start) / 1e6;
+    sampler_stats_t stats = sampler_get_stats();
+    printf("sampler task        %6.1f Hz sampled, %6.1f Hz consumed\n", stats.frames / elapsed, received / elapsed);
+    printf("  jitter mean %.1f us  max %lld us  deadline misses %lu  ring overflows %lu  max frame age %lld us\n",
+           stats.frames > 1 ? (double)stats.total_jitter_us / (stats.frames - 1) : 0.0, (long long)stats.max_jitter_us,
+           (unsigned long)stats.deadline_misses, (unsigned long)stats.ring_overflows, (long long)max_latency);
+    return 0;
+}
@@ -0,0 +1,268 @@
+// Compares the cost per frame of the binary sensor log with formatting the
+// SENSORLOG and FILTER_LOG text lines it replaces, then decodes what was logged
+// and checks it against the input, including resynchronising after records are
+// dropped because nobody drained the buffer. -o writes the log, interleaved with
+// other console output, as a sample capture for sensor_log_decode.
+//
+//   bench_sensor_log [-n frames] [-o capture.txt]
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_log.h"
+
+#include "constants.h"
+#include "sensor_log.h"
+
+#include "synthetic_typing.h"
+#include "sensor_log_reader.h"
+
+#define FRAME_PERIOD_US (1000000 / SENSOR_FRAME_RATE_HZ)
+// Console speed on the device, with start and stop bits.
+#define CONSOLE_BYTES_PER_SECOND (115200 / 10)
+
+typedef struct
+{
+    sensor_frame_t frame;
+    uint32_t raw[SENSOR_COUNT];
+    float filtered[SENSOR_COUNT];
+    sensor_mask_t pressed;
+    keyboard_state_t state;
+} logged_frame_t;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Raw readings from synthetic typing and a band-passed version of them, roughly
+// what the IIR filter would log.
+static void make_frames(logged_frame_t *frames, int count)
+{
+    synthetic_typing_t typing;
+    synthetic_typing_default(&typing);
+    float last[SENSOR_COUNT] = {0};
+    float smooth[SENSOR_COUNT] = {0};
+    for (int n = 0; n < count; ++n)
+    {
+        logged_frame_t *f = &frames[n];
+        f->frame.sequence = n;
+        f->frame.timestamp_us = (int64_t)n * FRAME_PERIOD_US + 90;
+        f->pressed = 0;
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            int sample = i < ADC_SENSOR_COUNT ? synthetic_typing_sample(&typing, i, f->frame.timestamp_us) : 100 * ((n / 37 + i) % 2);
+            f->raw[i] = sample < 0 ? 0 : sample > 4095 ? 4095 : sample;
+            smooth[i] += 0.2f * (f->raw[i] - smooth[i]);
+            f->filtered[i] = smooth[i] - last[i];
+            last[i] = smooth[i];
+            f->pressed |= (sensor_mask_t)(f->filtered[i] < -20) << i;
+        }
+        f->state = KEYBOARD_STATE_BT_CONNECTED | KEYBOARD_STATE_SENSOR_NORMAL | KEYBOARD_STATE_SENSOR_LOGGING;
+    }
+}
+
+static void log_frame(const logged_frame_t *f)
+{
+    sensor_log_filtered(f->filtered);
+    sensor_log_record(&f->frame, f->raw, f->pressed, f->state);
+}
+
+// The two lines the firmware printed per frame, formatted as ESP_LOGI would.
+static int format_text(char *out, size_t size, const logged_frame_t *f)
+{
+    const uint32_t *r = f->raw;
+    const float *o = f->filtered;
+    int n = snprintf(out, size, "I (%lld) SENSOR: SENSORLOG | %4ld | %4ld | %4ld | %4ld | %4ld | %4ld | %4ld | %4ld | %4ld | %4ld |\r\n",
+                     (long long)f->frame.timestamp_us / 1000, (long)r[0], (long)r[1], (long)r[2], (long)r[3], (long)r[4],
+                     (long)r[5], (long)r[6], (long)r[7], (long)r[8], (long)r[9]);
+    n += snprintf(out + n, size - n, "I (%lld) FILTER: FILTER_LOG | %4f | %4f | %4f | %4f | %4f | %4f | %4f | %4f | %4f | %4f |\r\n",
+                  (long long)f->frame.timestamp_us / 1000, o[0], o[1], o[2], o[3], o[4], o[5], o[6], o[7], o[8], o[9]);
+    return n;
+}
+
+static int check_entry(const sensor_log_entry_t *entry, const logged_frame_t *f)
+{
+    int errors = entry->sequence != f->frame.sequence || entry->timestamp_us != f->frame.timestamp_us ||
+                 entry->state != (uint32_t)f->state || !entry->has_filtered;
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        errors += entry->raw[i] != f->raw[i];
+        errors += fabsf(entry->filtered[i] - f->filtered[i]) > 0.5f / SENSOR_LOG_FILTER_SCALE + 1e-4f;
+    }
+    errors += entry->pressed != f->pressed;
+    if (errors)
+    {
+        printf("frame %lu decoded wrongly\n", (unsigned long)f->frame.sequence);
+    }
+    return errors != 0;
+}
+
+// Decodes a capture, checking each record against the frame it claims to be.
+static int decode(const char *capture, size_t length, const logged_frame_t *frames, int count, sensor_log_reader_t *reader,
+                  uint32_t *first)
+{
+    int errors = 0;
+    const char *line = capture;
+    const char *end = capture + length;
+    while (line < end && errors < 10)
+    {
+        const char *newline = memchr(line, '\n', end - line);
+        size_t n = newline ? (size_t)(newline - line) : (size_t)(end - line);
+        sensor_log_entry_t entry;
+        if (sensor_log_reader_line(reader, line, n, &entry))
+        {
+            *first = reader->records == 1 ? entry.sequence : *first;
+            errors += entry.sequence >= (uint32_t)count || check_entry(&entry, &frames[entry.sequence]);
+        }
+        line += n + 1;
+    }
+    return errors;
+}
+
+// The log as the serial monitor shows it, with a text line after every 64th record.
+static bool write_capture(const char *path, const char *capture, size_t length)
+{
+    FILE *out = fopen(path, "w");
+    if (!out)
+    {
+        return false;
+    }
+    int lines = 0;
+    for (const char *line = capture; line < capture + length;)
+    {
+        const char *newline = memchr(line, '\n', capture + length - line);
+        fwrite(line, 1, newline - line, out);
+        fputs("\r\n", out);
+        if (++lines % 64 == 0)
+        {
+            fprintf(out, "\033[0;32mI (%d) ENCODING: | c |\033[0m\r\n", lines * 10);
+        }
+        line = newline + 1;
+    }
+    return fclose(out) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    int count = 100000;
+    const char *capture_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 'o':
+            capture_path = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n frames] [-o capture.txt]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (count < 1000)
+    {
+        fprintf(stderr, "need at least 1000 frames\n");
+        return 1;
+    }
+    esp_log_level_set("*", ESP_LOG_NONE);
+
+    logged_frame_t *frames = malloc(sizeof(logged_frame_t) * count);
+    make_frames(frames, count);
+
+    // Text: formatting only. On the device the console write follows, and at
+    // 115200 baud it blocks the sampler for the whole line.
+    char text[512];
+    size_t text_bytes = 0;
+    int64_t t0 = now_ns();
+    for (int n = 0; n < count; ++n)
+    {
+        text_bytes += format_text(text, sizeof(text), &frames[n]);
+    }
+    int64_t text_ns = now_ns() - t0;
+
+    // Binary, drained as the writer task would, outside the timed part.
+    size_t capacity = (size_t)count * SENSOR_LOG_MAX_LINE;
+    char *capture = malloc(capacity);
+    size_t captured = 0;
+    int64_t binary_ns = 0;
+    for (int n = 0; n < count; ++n)
+    {
+        t0 = now_ns();
+        log_frame(&frames[n]);
+        binary_ns += now_ns() - t0;
+        captured += sensor_log_read((uint8_t *)capture + captured, capacity - captured);
+    }
+    sensor_log_stats_t stats = sensor_log_get_stats();
+
+    double text_per_frame = (double)text_bytes / count;
+    double binary_per_frame = (double)captured / count;
+    printf("%d frames, %d sensors\n", count, SENSOR_COUNT);
+    printf("text    %7.1f ns/frame  %6.1f bytes/frame  %5.2f ms/frame on the console at 115200 baud, %3.0f%% of the link\n",
+           (double)text_ns / count, text_per_frame, text_per_frame * 1000 / CONSOLE_BYTES_PER_SECOND,
+           100 * text_per_frame * SENSOR_FRAME_RATE_HZ / CONSOLE_BYTES_PER_SECOND);
+    printf("binary  %7.1f ns/frame  %6.1f bytes/frame  %5.2f ms/frame on the console at 115200 baud, %3.0f%% of the link\n",
+           (double)binary_ns / count, binary_per_frame, binary_per_frame * 1000 / CONSOLE_BYTES_PER_SECOND,
+           100 * binary_per_frame * SENSOR_FRAME_RATE_HZ / CONSOLE_BYTES_PER_SECOND);
+    printf("        %lu records, %lu keyframes, %lu dropped, up to %lu bytes buffered\n", (unsigned long)stats.records,
+           (unsigned long)stats.keyframes, (unsigned long)stats.dropped_records, (unsigned long)stats.max_buffered);
+
+    sensor_log_reader_t reader;
+    sensor_log_reader_init(&reader);
+    uint32_t first = 0;
+    int errors = decode(capture, captured, frames, count, &reader, &first);
+    if (reader.records != (uint32_t)count || reader.corrupt || reader.missing || stats.dropped_records)
+    {
+        printf("steady: decoded %lu of %d records, %lu corrupt, %lu missing\n", (unsigned long)reader.records, count,
+               (unsigned long)reader.corrupt, (unsigned long)reader.missing);
+        errors++;
+    }
+
+    if (capture_path && !write_capture(capture_path, capture, captured))
+    {
+        perror(capture_path);
+        errors++;
+    }
+
+    // Stop draining until the buffer overflows, then drain again: the decoder must
+    // pick up at the keyframe that follows the gap, and account for every lost frame.
+    captured = 0;
+    int stalled = SENSOR_LOG_BUFFER_SIZE / 20;
+    uint32_t dropped_before = stats.dropped_records;
+    for (int n = 0; n < count; ++n)
+    {
+        log_frame(&frames[n]);
+        if (n < 1000 - stalled || n >= 1000)
+        {
+            captured += sensor_log_read((uint8_t *)capture + captured, capacity - captured);
+        }
+    }
+    uint32_t dropped = sensor_log_get_stats().dropped_records - dropped_before;
+    // Corrupt one line in the middle as well.
+    char *damaged = memchr(capture + captured / 2, '\n', captured / 2);
+    damaged[10] = damaged[10] == 'A' ? 'B' : 'A';
+    sensor_log_reader_init(&reader);
+    errors += decode(capture, captured, frames, count, &reader, &first);
+    printf("stall   %lu records dropped, decoded %lu, %lu missing, %lu corrupt, %lu skipped before a keyframe\n",
+           (unsigned long)dropped, (unsigned long)reader.records, (unsigned long)reader.missing,
+           (unsigned long)reader.corrupt, (unsigned long)reader.unsynced);
+    if (!dropped || reader.corrupt != 1 || reader.records + reader.missing != (uint32_t)count - first ||
+        reader.records + reader.unsynced + reader.corrupt + dropped != (uint32_t)count)
+    {
+        printf("records unaccounted for\n");
+        errors++;
+    }
+
+    free(capture);
+    free(frames);
+    printf("%s\n", errors ? "FAILED" : "ok");
+    return errors != 0;
+}
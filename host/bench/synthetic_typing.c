@@ -0,0 +1,94 @@
+#include "constants.h"
+#include "synthetic_typing.h"
+
+static const adc_channel_t adc_channels[] = SENSOR_ADC_CHANNELS;
+
+// Every letter of the alpha layout once.
+static const char default_chords[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+                                      14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26};
+
+void synthetic_typing_default(synthetic_typing_t *typing)
+{
+    *typing = (synthetic_typing_t){
+        .chords = default_chords,
+        .chord_count = sizeof(default_chords),
+        .start_us = 5000000,
+        .period_us = 450000,
+        .hold_us = 120000,
+        .stagger_us = 8000,
+        .ramp_us = 30000,
+        .baseline = 150,
+        .amplitude = 900,
+        .noise = 12,
+    };
+}
+
+char synthetic_typing_chord_at(const synthetic_typing_t *typing, int64_t time_us)
+{
+    if (time_us < typing->start_us)
+    {
+        return 0;
+    }
+    int64_t index = (time_us - typing->start_us) / typing->period_us;
+    return typing->chords[index % typing->chord_count];
+}
+
+static int press_level(const synthetic_typing_t *typing, int64_t t)
+{
+    // Trapezoid: ramp up, hold, ramp down.
+    if (t < 0)
+    {
+        return 0;
+    }
+    if (t < typing->ramp_us)
+    {
+        return typing->amplitude * t / typing->ramp_us;
+    }
+    t -= typing->ramp_us;
+    if (t < typing->hold_us)
+    {
+        return typing->amplitude;
+    }
+    t -= typing->hold_us;
+    if (t < typing->ramp_us)
+    {
+        return typing->amplitude * (typing->ramp_us - t) / typing->ramp_us;
+    }
+    return 0;
+}
+
+int synthetic_typing_sample(const synthetic_typing_t *typing, int sensor, int64_t time_us)
+{
+    uint32_t hash = (uint32_t)(time_us / 1000) * 2654435761u ^ (uint32_t)(sensor + 1) * 40503u;
+    int noise = typing->noise ? (int)((hash >> 16) % (2 * typing->noise + 1)) - typing->noise : 0;
+    int value = typing->baseline + noise;
+
+    if (time_us < typing->start_us || sensor >= ENCODING_SENSOR_COUNT)
+    {
+        return value;
+    }
+    // Typed faster than a press lasts, the next chord lands while the last one
+    // is releasing; a finger in both is as far down as the deeper press.
+    int64_t since = time_us - typing->start_us;
+    int64_t press_us = 2 * typing->ramp_us + typing->hold_us + sensor * typing->stagger_us;
+    int level = 0;
+    for (int64_t t = since % typing->period_us; t < press_us && t <= since; t += typing->period_us)
+    {
+        char chord = synthetic_typing_chord_at(typing, time_us - t);
+        int press = chord & (1 << sensor) ? press_level(typing, t - sensor * typing->stagger_us) : 0;
+        level = press > level ? press : level;
+    }
+    return value + level;
+}
+
+int synthetic_typing_adc_source(adc_unit_t unit, adc_channel_t channel, int64_t time_us, void *ctx)
+{
+    for (int i = 0; i < ADC_SENSOR_COUNT; ++i)
+    {
+        if (adc_channels[i] == channel)
+        {
+            return synthetic_typing_sample(ctx, i, time_us);
+        }
+    }
+    return 0;
+}
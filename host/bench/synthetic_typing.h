@@ -0,0 +1,41 @@
+#ifndef SYNTHETIC_TYPING_H__
+#define SYNTHETIC_TYPING_H__
+
+#include <stdint.h>
+#include "hal/adc_types.h"
+
+// Scripted chord presses rendered as raw ADC readings, for driving the firmware
+// through host_adc_set_source without a capture.
+typedef struct
+{
+    // 5-bit chords to type, cycled.
+    const char *chords;
+    int chord_count;
+
+    int64_t start_us;
+    // Time from one chord onset to the next.
+    int64_t period_us;
+    // How long every finger of the chord is held at full pressure.
+    int64_t hold_us;
+    // Extra onset delay per finger, so chords do not land on one sample.
+    int64_t stagger_us;
+    // Rise and fall time of a press.
+    int64_t ramp_us;
+
+    int baseline;
+    int amplitude;
+    int noise;
+} synthetic_typing_t;
+
+void synthetic_typing_default(synthetic_typing_t *typing);
+
+// Raw reading of one sensor (index into SENSOR_ADC_CHANNELS) at a given time.
+int synthetic_typing_sample(const synthetic_typing_t *typing, int sensor, int64_t time_us);
+
+// Chord whose press starts in the period containing time_us, or 0 before the first.
+char synthetic_typing_chord_at(const synthetic_typing_t *typing, int64_t time_us);
+
+// host_adc_source_t adapter; ctx is a synthetic_typing_t.
+int synthetic_typing_adc_source(adc_unit_t unit, adc_channel_t channel, int64_t time_us, void *ctx);
+
+#endif
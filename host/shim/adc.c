@@ -0,0 +1,81 @@
+#include <stdlib.h>
+
+#include "soc/soc_caps.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_timer.h"
+#include "host_hal.h"
+#include "host_internal.h"
+
+struct adc_oneshot_unit_ctx_t
+{
+    adc_unit_t unit_id;
+    adc_oneshot_chan_cfg_t channels[SOC_ADC_MAX_CHANNEL_NUM];
+};
+
+// Idle Velostat readings sit around 100-300 counts with a little noise.
+static int default_source(adc_unit_t unit, adc_channel_t channel, int64_t time_us, void *ctx)
+{
+    uint32_t hash = (uint32_t)(time_us / 1000) * 2654435761u ^ (uint32_t)channel * 40503u;
+    return 150 + (int)(hash >> 28);
+}
+
+static host_adc_source_t adc_source = default_source;
+static void *adc_source_ctx = NULL;
+static uint64_t conversion_count = 0;
+
+void host_adc_set_source(host_adc_source_t source, void *ctx)
+{
+    adc_source = source ? source : default_source;
+    adc_source_ctx = ctx;
+}
+
+uint64_t host_adc_conversion_count(void)
+{
+    return conversion_count;
+}
+
+int host_adc_sample(adc_unit_t unit, adc_channel_t channel, int64_t time_us)
+{
+    conversion_count++;
+    int raw = adc_source(unit, channel, time_us, adc_source_ctx);
+    raw = raw < 0 ? 0 : raw;
+    return raw > 4095 ? 4095 : raw;
+}
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *init_config, adc_oneshot_unit_handle_t *ret_unit)
+{
+    if (!init_config || !ret_unit)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct adc_oneshot_unit_ctx_t *unit = calloc(1, sizeof(struct adc_oneshot_unit_ctx_t));
+    unit->unit_id = init_config->unit_id;
+    *ret_unit = unit;
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t handle, adc_channel_t channel, const adc_oneshot_chan_cfg_t *config)
+{
+    if (!handle || !config || channel >= SOC_ADC_MAX_CHANNEL_NUM)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handle->channels[channel] = *config;
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t handle, adc_channel_t chan, int *out_raw)
+{
+    if (!handle || !out_raw || chan >= SOC_ADC_MAX_CHANNEL_NUM)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_raw = host_adc_sample(handle->unit_id, chan, esp_timer_get_time());
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_del_unit(adc_oneshot_unit_handle_t handle)
+{
+    free(handle);
+    return ESP_OK;
+}
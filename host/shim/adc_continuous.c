@@ -0,0 +1,310 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_adc/adc_continuous.h"
+#include "esp_timer.h"
+#include "host_hal.h"
+#include "host_internal.h"
+
+// Conversions land in a DMA frame of conv_frame_size bytes. Completed frames are
+// copied into the pool (the driver's ring buffer) that adc_continuous_read drains.
+struct adc_continuous_ctx_t
+{
+    pthread_mutex_t lock;
+    pthread_cond_t data_ready;
+
+    adc_continuous_handle_cfg_t handle_config;
+    adc_digi_pattern_config_t pattern[SOC_ADC_PATT_LEN_MAX];
+    uint32_t pattern_num;
+    uint32_t sample_freq_hz;
+    adc_continuous_evt_cbs_t cbs;
+    void *user_data;
+
+    bool running;
+    int64_t start_us;
+    uint64_t conversions;
+
+    uint8_t *dma_frame;
+    uint32_t dma_fill;
+
+    uint8_t *pool;
+    uint32_t pool_head;
+    uint32_t pool_used;
+
+    pthread_t dma_thread;
+    bool dma_thread_running;
+};
+
+static int64_t conversion_time_us(adc_continuous_handle_t handle, uint64_t index)
+{
+    return handle->start_us + (int64_t)(index * 1000000 / handle->sample_freq_hz);
+}
+
+static void pool_push(adc_continuous_handle_t handle, const uint8_t *data, uint32_t size)
+{
+    uint32_t capacity = handle->handle_config.max_store_buf_size;
+    if (handle->pool_used + size > capacity)
+    {
+        if (!handle->handle_config.flags.flush_pool)
+        {
+            if (handle->cbs.on_pool_ovf)
+            {
+                adc_continuous_evt_data_t edata = {.conv_frame_buffer = NULL, .size = 0};
+                handle->cbs.on_pool_ovf(handle, &edata, handle->user_data);
+            }
+            return;
+        }
+        handle->pool_used = 0;
+        if (handle->cbs.on_pool_ovf)
+        {
+            adc_continuous_evt_data_t edata = {.conv_frame_buffer = NULL, .size = 0};
+            handle->cbs.on_pool_ovf(handle, &edata, handle->user_data);
+        }
+    }
+    uint32_t tail = (handle->pool_head + handle->pool_used) % capacity;
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        handle->pool[(tail + i) % capacity] = data[i];
+    }
+    handle->pool_used += size;
+}
+
+// Runs the converter up to time_us, completing DMA frames as they fill. Called with the lock held.
+static void produce_until(adc_continuous_handle_t handle, int64_t time_us)
+{
+    while (conversion_time_us(handle, handle->conversions) <= time_us)
+    {
+        const adc_digi_pattern_config_t *entry = &handle->pattern[handle->conversions % handle->pattern_num];
+        int raw = host_adc_sample(entry->unit, entry->channel, conversion_time_us(handle, handle->conversions));
+
+        adc_digi_output_data_t result = {0};
+        result.type2.data = raw;
+        result.type2.channel = entry->channel;
+        result.type2.unit = entry->unit;
+        memcpy(handle->dma_frame + handle->dma_fill, result.val, SOC_ADC_DIGI_RESULT_BYTES);
+        handle->dma_fill += SOC_ADC_DIGI_RESULT_BYTES;
+        handle->conversions++;
+
+        if (handle->dma_fill == handle->handle_config.conv_frame_size)
+        {
+            adc_continuous_evt_data_t edata = {.conv_frame_buffer = handle->dma_frame, .size = handle->dma_fill};
+            if (handle->cbs.on_conv_done)
+            {
+                handle->cbs.on_conv_done(handle, &edata, handle->user_data);
+            }
+            pool_push(handle, handle->dma_frame, handle->dma_fill);
+            handle->dma_fill = 0;
+        }
+    }
+}
+
+// Time at which the DMA frame being filled completes.
+static int64_t next_frame_done_us(adc_continuous_handle_t handle)
+{
+    uint32_t remaining = (handle->handle_config.conv_frame_size - handle->dma_fill) / SOC_ADC_DIGI_RESULT_BYTES;
+    return conversion_time_us(handle, handle->conversions + remaining - 1);
+}
+
+static void *dma_thread_entry(void *arg)
+{
+    adc_continuous_handle_t handle = arg;
+    pthread_mutex_lock(&handle->lock);
+    while (handle->running)
+    {
+        int64_t wake_us = next_frame_done_us(handle);
+        pthread_mutex_unlock(&handle->lock);
+
+        int64_t delay_us = wake_us - esp_timer_get_time();
+        if (delay_us > 0)
+        {
+            struct timespec ts = {.tv_sec = delay_us / 1000000, .tv_nsec = (delay_us % 1000000) * 1000};
+            nanosleep(&ts, NULL);
+        }
+
+        pthread_mutex_lock(&handle->lock);
+        if (handle->running)
+        {
+            produce_until(handle, esp_timer_get_time());
+            pthread_cond_broadcast(&handle->data_ready);
+        }
+    }
+    pthread_mutex_unlock(&handle->lock);
+    return NULL;
+}
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t *hdl_config, adc_continuous_handle_t *ret_handle)
+{
+    if (!hdl_config || !ret_handle || hdl_config->conv_frame_size == 0 ||
+        hdl_config->conv_frame_size % SOC_ADC_DIGI_DATA_BYTES_PER_CONV != 0 ||
+        hdl_config->max_store_buf_size < hdl_config->conv_frame_size)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct adc_continuous_ctx_t *handle = calloc(1, sizeof(struct adc_continuous_ctx_t));
+    pthread_mutex_init(&handle->lock, NULL);
+    pthread_cond_init(&handle->data_ready, NULL);
+    handle->handle_config = *hdl_config;
+    handle->dma_frame = calloc(1, hdl_config->conv_frame_size);
+    handle->pool = calloc(1, hdl_config->max_store_buf_size);
+    *ret_handle = handle;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t *config)
+{
+    if (!handle || !config || config->pattern_num == 0 || config->pattern_num > SOC_ADC_PATT_LEN_MAX ||
+        config->sample_freq_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW || config->sample_freq_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->running)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memcpy(handle->pattern, config->adc_pattern, config->pattern_num * sizeof(adc_digi_pattern_config_t));
+    handle->pattern_num = config->pattern_num;
+    handle->sample_freq_hz = config->sample_freq_hz;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_register_event_callbacks(adc_continuous_handle_t handle, const adc_continuous_evt_cbs_t *cbs, void *user_data)
+{
+    if (!handle || !cbs)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handle->cbs = *cbs;
+    handle->user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle)
+{
+    if (!handle || handle->pattern_num == 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pthread_mutex_lock(&handle->lock);
+    handle->running = true;
+    handle->start_us = esp_timer_get_time();
+    handle->conversions = 0;
+    handle->dma_fill = 0;
+    handle->pool_used = 0;
+    pthread_mutex_unlock(&handle->lock);
+
+    // Under a virtual clock the reader produces conversions itself, so a run is deterministic.
+    if (!host_clock_is_virtual())
+    {
+        pthread_create(&handle->dma_thread, NULL, dma_thread_entry, handle);
+        handle->dma_thread_running = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t *buf, uint32_t length_max, uint32_t *out_length, uint32_t timeout_ms)
+{
+    if (!handle || !buf || !out_length)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_length = 0;
+    pthread_mutex_lock(&handle->lock);
+    if (!handle->running)
+    {
+        pthread_mutex_unlock(&handle->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (host_clock_is_virtual())
+    {
+        produce_until(handle, esp_timer_get_time());
+        if (handle->pool_used == 0)
+        {
+            // Block in virtual time: jump to the next completed frame, or to the timeout.
+            int64_t wait_us = next_frame_done_us(handle) - esp_timer_get_time();
+            if (timeout_ms != ADC_MAX_DELAY && wait_us > (int64_t)timeout_ms * 1000)
+            {
+                host_clock_advance_us((int64_t)timeout_ms * 1000);
+                pthread_mutex_unlock(&handle->lock);
+                return ESP_ERR_TIMEOUT;
+            }
+            host_clock_advance_us(wait_us > 0 ? wait_us : 0);
+            produce_until(handle, esp_timer_get_time());
+        }
+    }
+    else if (handle->pool_used == 0)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        uint32_t wait_ms = timeout_ms == ADC_MAX_DELAY ? 24 * 3600 * 1000 : timeout_ms;
+        deadline.tv_sec += wait_ms / 1000;
+        deadline.tv_nsec += (long)(wait_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        while (handle->pool_used == 0 && handle->running)
+        {
+            if (pthread_cond_timedwait(&handle->data_ready, &handle->lock, &deadline) != 0)
+            {
+                break;
+            }
+        }
+    }
+
+    if (handle->pool_used == 0)
+    {
+        pthread_mutex_unlock(&handle->lock);
+        return ESP_ERR_TIMEOUT;
+    }
+    uint32_t capacity = handle->handle_config.max_store_buf_size;
+    uint32_t length = handle->pool_used < length_max ? handle->pool_used : length_max;
+    for (uint32_t i = 0; i < length; ++i)
+    {
+        buf[i] = handle->pool[(handle->pool_head + i) % capacity];
+    }
+    handle->pool_head = (handle->pool_head + length) % capacity;
+    handle->pool_used -= length;
+    *out_length = length;
+    pthread_mutex_unlock(&handle->lock);
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle)
+{
+    if (!handle || !handle->running)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pthread_mutex_lock(&handle->lock);
+    handle->running = false;
+    pthread_cond_broadcast(&handle->data_ready);
+    pthread_mutex_unlock(&handle->lock);
+    if (handle->dma_thread_running)
+    {
+        pthread_join(handle->dma_thread, NULL);
+        handle->dma_thread_running = false;
+    }
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle)
+{
+    if (!handle)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->running)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pthread_mutex_destroy(&handle->lock);
+    pthread_cond_destroy(&handle->data_ready);
+    free(handle->dma_frame);
+    free(handle->pool);
+    free(handle);
+    return ESP_OK;
+}
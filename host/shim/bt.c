@@ -0,0 +1,316 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gatts_api.h"
+#include "host_hal.h"
+
+// Minimal in-process model of the controller, Bluedroid and the GATT database:
+// enough for the firmware's registration, connection and report paths to run.
+
+#define HOST_GATTS_MAX_HANDLES 512
+#define HOST_GATTS_FIRST_IF 3
+
+typedef struct
+{
+    bool in_use;
+    esp_gatt_if_t owner;
+    uint16_t max_length;
+    uint16_t length;
+    uint8_t *value;
+} host_attr_t;
+
+static esp_gatts_cb_t gatts_callback;
+static esp_gap_ble_cb_t gap_callback;
+static esp_gatt_if_t next_gatts_if = HOST_GATTS_FIRST_IF;
+static uint16_t next_handle = 1;
+static host_attr_t attrs[HOST_GATTS_MAX_HANDLES];
+
+static host_bt_report_hook_t report_hook;
+static void *report_hook_ctx;
+static uint64_t report_count;
+static uint32_t last_passkey;
+static const esp_bd_addr_t host_peer_addr = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *cfg)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_bluedroid_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_bluedroid_enable(void)
+{
+    return ESP_OK;
+}
+
+// GAP
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback)
+{
+    gap_callback = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_set_device_name(const char *name)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_config_adv_data(esp_ble_adv_data_t *adv_data)
+{
+    if (gap_callback)
+    {
+        esp_ble_gap_cb_param_t param = {.adv_data_cmpl = {.status = ESP_BT_STATUS_SUCCESS}};
+        gap_callback(ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT, &param);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *adv_params)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_security_rsp(esp_bd_addr_t bd_addr, bool accept)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_set_security_param(esp_ble_sm_param_t param_type, void *value, uint8_t len)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_config_local_icon(uint16_t icon)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_passkey_reply(esp_bd_addr_t bd_addr, bool accept, uint32_t passkey)
+{
+    last_passkey = passkey;
+    if (gap_callback && accept)
+    {
+        esp_ble_gap_cb_param_t param = {};
+        memcpy(param.ble_security.auth_cmpl.bd_addr, bd_addr, sizeof(esp_bd_addr_t));
+        param.ble_security.auth_cmpl.success = true;
+        gap_callback(ESP_GAP_BLE_AUTH_CMPL_EVT, &param);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_set_encryption(esp_bd_addr_t bd_addr, esp_ble_sec_act_t sec_act)
+{
+    return ESP_OK;
+}
+
+// GATT server
+
+esp_err_t esp_ble_gatts_register_callback(esp_gatts_cb_t callback)
+{
+    gatts_callback = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_app_register(uint16_t app_id)
+{
+    if (!gatts_callback)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_ble_gatts_cb_param_t param = {.reg = {.status = ESP_GATT_OK, .app_id = app_id}};
+    gatts_callback(ESP_GATTS_REG_EVT, next_gatts_if++, &param);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_app_unregister(esp_gatt_if_t gatts_if)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_create_attr_tab(const esp_gatts_attr_db_t *gatts_attr_db, esp_gatt_if_t gatts_if,
+                                        uint16_t max_nb_attr, uint8_t srvc_inst_id)
+{
+    esp_ble_gatts_cb_param_t param = {};
+    uint16_t *handles = calloc(max_nb_attr, sizeof(uint16_t));
+
+    param.add_attr_tab.status = ESP_GATT_OK;
+    param.add_attr_tab.svc_inst_id = srvc_inst_id;
+    param.add_attr_tab.num_handle = max_nb_attr;
+    param.add_attr_tab.handles = handles;
+
+    if (next_handle + max_nb_attr > HOST_GATTS_MAX_HANDLES)
+    {
+        param.add_attr_tab.status = ESP_GATT_NO_RESOURCES;
+    }
+    else
+    {
+        for (int i = 0; i < max_nb_attr; ++i)
+        {
+            const esp_attr_desc_t *desc = &gatts_attr_db[i].att_desc;
+            host_attr_t *attr = &attrs[next_handle];
+            attr->in_use = true;
+            attr->owner = gatts_if;
+            attr->max_length = desc->max_length > desc->length ? desc->max_length : desc->length;
+            attr->length = desc->value ? desc->length : 0;
+            attr->value = calloc(attr->max_length ? attr->max_length : 1, 1);
+            if (desc->value)
+            {
+                memcpy(attr->value, desc->value, desc->length);
+            }
+            handles[i] = next_handle++;
+        }
+
+        // The service UUID is the value of the service declaration.
+        const esp_attr_desc_t *svc = &gatts_attr_db[0].att_desc;
+        param.add_attr_tab.svc_uuid.len = svc->length;
+        if (svc->length == ESP_UUID_LEN_16)
+        {
+            memcpy(&param.add_attr_tab.svc_uuid.uuid.uuid16, svc->value, ESP_UUID_LEN_16);
+        }
+        else if (svc->length == ESP_UUID_LEN_128)
+        {
+            memcpy(param.add_attr_tab.svc_uuid.uuid.uuid128, svc->value, ESP_UUID_LEN_128);
+        }
+    }
+
+    gatts_callback(ESP_GATTS_CREAT_ATTR_TAB_EVT, gatts_if, &param);
+    free(handles);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_start_service(uint16_t service_handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_stop_service(uint16_t service_handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_delete_service(uint16_t service_handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t gatts_if, uint16_t conn_id, uint16_t attr_handle,
+                                      uint16_t value_len, uint8_t *value, bool need_confirm)
+{
+    if (attr_handle >= HOST_GATTS_MAX_HANDLES || !attrs[attr_handle].in_use)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    report_count++;
+    if (report_hook)
+    {
+        report_hook(conn_id, attr_handle, value_len, value, report_hook_ctx);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_set_attr_value(uint16_t attr_handle, uint16_t length, const uint8_t *value)
+{
+    if (attr_handle >= HOST_GATTS_MAX_HANDLES || !attrs[attr_handle].in_use)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_attr_t *attr = &attrs[attr_handle];
+    if (length > attr->max_length)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(attr->value, value, length);
+    attr->length = length;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_get_attr_value(uint16_t attr_handle, uint16_t *length, const uint8_t **value)
+{
+    if (attr_handle >= HOST_GATTS_MAX_HANDLES || !attrs[attr_handle].in_use)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *length = attrs[attr_handle].length;
+    *value = attrs[attr_handle].value;
+    return ESP_OK;
+}
+
+// Host controls
+
+void host_bt_connect(uint16_t conn_id)
+{
+    esp_ble_gatts_cb_param_t param = {.connect = {.conn_id = conn_id}};
+    memcpy(param.connect.remote_bda, host_peer_addr, sizeof(esp_bd_addr_t));
+    gatts_callback(ESP_GATTS_CONNECT_EVT, ESP_GATT_IF_NONE, &param);
+
+    if (gap_callback)
+    {
+        esp_ble_gap_cb_param_t gap_param = {};
+        memcpy(gap_param.ble_security.auth_cmpl.bd_addr, host_peer_addr, sizeof(esp_bd_addr_t));
+        gap_param.ble_security.auth_cmpl.success = true;
+        gap_callback(ESP_GAP_BLE_AUTH_CMPL_EVT, &gap_param);
+    }
+}
+
+void host_bt_disconnect(uint16_t conn_id)
+{
+    esp_ble_gatts_cb_param_t param = {.disconnect = {.conn_id = conn_id}};
+    memcpy(param.disconnect.remote_bda, host_peer_addr, sizeof(esp_bd_addr_t));
+    gatts_callback(ESP_GATTS_DISCONNECT_EVT, ESP_GATT_IF_NONE, &param);
+}
+
+void host_bt_request_passkey(void)
+{
+    if (gap_callback)
+    {
+        esp_ble_gap_cb_param_t param = {};
+        memcpy(param.ble_security.ble_req.bd_addr, host_peer_addr, sizeof(esp_bd_addr_t));
+        gap_callback(ESP_GAP_BLE_PASSKEY_REQ_EVT, &param);
+    }
+}
+
+uint32_t host_bt_last_passkey(void)
+{
+    return last_passkey;
+}
+
+esp_err_t host_bt_write_attr(uint16_t attr_handle, uint16_t length, const uint8_t *value)
+{
+    esp_err_t err = esp_ble_gatts_set_attr_value(attr_handle, length, value);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    esp_ble_gatts_cb_param_t param = {.write = {.handle = attr_handle, .len = length, .value = (uint8_t *)value}};
+    memcpy(param.write.bda, host_peer_addr, sizeof(esp_bd_addr_t));
+    gatts_callback(ESP_GATTS_WRITE_EVT, attrs[attr_handle].owner, &param);
+    return ESP_OK;
+}
+
+void host_bt_set_report_hook(host_bt_report_hook_t hook, void *ctx)
+{
+    report_hook = hook;
+    report_hook_ctx = ctx;
+}
+
+uint64_t host_bt_report_count(void)
+{
+    return report_count;
+}
@@ -0,0 +1,47 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "esp_timer.h"
+#include "host_hal.h"
+
+static bool clock_virtual = false;
+static _Thread_local int64_t virtual_time_us = 0;
+
+static int64_t monotonic_us(void)
+{
+    static int64_t boot_us = 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t now = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (!boot_us)
+    {
+        boot_us = now;
+    }
+    return now - boot_us;
+}
+
+void host_clock_set_virtual(bool is_virtual)
+{
+    clock_virtual = is_virtual;
+}
+
+bool host_clock_is_virtual(void)
+{
+    return clock_virtual;
+}
+
+void host_clock_set_us(int64_t time_us)
+{
+    virtual_time_us = time_us;
+}
+
+void host_clock_advance_us(int64_t delta_us)
+{
+    virtual_time_us += delta_us;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return clock_virtual ? virtual_time_us : monotonic_us();
+}
@@ -0,0 +1,118 @@
+#include <math.h>
+
+#include "esp_dsp.h"
+
+// Ports of the esp-dsp ANSI reference code; keep the operation order identical so
+// host output matches the device bit for bit.
+
+esp_err_t dsps_biquad_f32_ansi(const float *input, float *output, int len, float *coef, float *w)
+{
+    for (int i = 0; i < len; i++)
+    {
+        float d0 = input[i] - coef[3] * w[0] - coef[4] * w[1];
+        output[i] = coef[0] * d0 + coef[1] * w[0] + coef[2] * w[1];
+        w[1] = w[0];
+        w[0] = d0;
+    }
+    return ESP_OK;
+}
+
+esp_err_t dsps_biquad_gen_bpf_f32(float *coeffs, float f, float qFactor)
+{
+    if (qFactor <= 0.0001)
+    {
+        qFactor = 0.0001;
+    }
+    float Fs = 1;
+
+    float w0 = 2 * M_PI * f / Fs;
+    float c = cosf(w0);
+    float s = sinf(w0);
+    float alpha = s / (2 * qFactor);
+
+    float b0 = s / 2;
+    float b1 = 0;
+    float b2 = -b0;
+    float a0 = 1 + alpha;
+    float a1 = -2 * c;
+    float a2 = 1 - alpha;
+
+    coeffs[0] = b0 / a0;
+    coeffs[1] = b1 / a0;
+    coeffs[2] = b2 / a0;
+    coeffs[3] = a1 / a0;
+    coeffs[4] = a2 / a0;
+    return ESP_OK;
+}
+
+esp_err_t dsps_biquad_gen_lpf_f32(float *coeffs, float f, float qFactor)
+{
+    if (qFactor <= 0.0001)
+    {
+        qFactor = 0.0001;
+    }
+    float Fs = 1;
+
+    float w0 = 2 * M_PI * f / Fs;
+    float c = cosf(w0);
+    float s = sinf(w0);
+    float alpha = s / (2 * qFactor);
+
+    float b0 = (1 - c) / 2;
+    float b1 = 1 - c;
+    float b2 = b0;
+    float a0 = 1 + alpha;
+    float a1 = -2 * c;
+    float a2 = 1 - alpha;
+
+    coeffs[0] = b0 / a0;
+    coeffs[1] = b1 / a0;
+    coeffs[2] = b2 / a0;
+    coeffs[3] = a1 / a0;
+    coeffs[4] = a2 / a0;
+    return ESP_OK;
+}
+
+esp_err_t dsps_biquad_gen_hpf_f32(float *coeffs, float f, float qFactor)
+{
+    if (qFactor <= 0.0001)
+    {
+        qFactor = 0.0001;
+    }
+    float Fs = 1;
+
+    float w0 = 2 * M_PI * f / Fs;
+    float c = cosf(w0);
+    float s = sinf(w0);
+    float alpha = s / (2 * qFactor);
+
+    float b0 = (1 + c) / 2;
+    float b1 = -(1 + c);
+    float b2 = b0;
+    float a0 = 1 + alpha;
+    float a1 = -2 * c;
+    float a2 = 1 - alpha;
+
+    coeffs[0] = b0 / a0;
+    coeffs[1] = b1 / a0;
+    coeffs[2] = b2 / a0;
+    coeffs[3] = a1 / a0;
+    coeffs[4] = a2 / a0;
+    return ESP_OK;
+}
+
+esp_err_t dspm_mult_f32_ansi(const float *A, const float *B, float *C, int m, int n, int k)
+{
+    for (int i = 0; i < m; i++)
+    {
+        for (int j = 0; j < k; j++)
+        {
+            C[i * k + j] = A[i * n] * B[j];
+            for (int s = 1; s < n; s++)
+            {
+                C[i * k + j] += A[i * n + s] * B[s * k + j];
+            }
+        }
+    }
+    return ESP_OK;
+}
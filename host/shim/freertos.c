@@ -0,0 +1,246 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "host_hal.h"
+
+struct host_task
+{
+    pthread_t thread;
+    TaskFunction_t code;
+    void *parameters;
+
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notify_count;
+};
+
+static _Thread_local struct host_task *current_task = NULL;
+
+static struct host_task *task_alloc(void)
+{
+    struct host_task *task = calloc(1, sizeof(struct host_task));
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->notified, NULL);
+    return task;
+}
+
+static void *task_entry(void *arg)
+{
+    struct host_task *task = arg;
+    current_task = task;
+    task->code(task->parameters);
+    return NULL;
+}
+
+// Absolute CLOCK_REALTIME deadline for a wait of the given ticks.
+static struct timespec deadline_after(TickType_t ticks)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    int64_t wait_ms = ticks == portMAX_DELAY ? (int64_t)24 * 3600 * 1000 : (int64_t)ticks * portTICK_PERIOD_MS;
+    deadline.tv_sec += wait_ms / 1000;
+    deadline.tv_nsec += (wait_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return deadline;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pxTaskCode, const char *pcName, uint32_t usStackDepth,
+                                   void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask,
+                                   BaseType_t xCoreID)
+{
+    // Priority and affinity are not modelled; the host scheduler decides.
+    struct host_task *task = task_alloc();
+    task->code = pxTaskCode;
+    task->parameters = pvParameters;
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0)
+    {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (pxCreatedTask)
+    {
+        *pxCreatedTask = task;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char *pcName, uint32_t usStackDepth,
+                       void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask)
+{
+    return xTaskCreatePinnedToCore(pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    if (xTaskToDelete == NULL)
+    {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(xTaskToDelete->thread);
+    free(xTaskToDelete);
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+    int64_t delay_us = (int64_t)xTicksToDelay * portTICK_PERIOD_MS * 1000;
+    if (host_clock_is_virtual())
+    {
+        host_clock_advance_us(delay_us);
+        return;
+    }
+    struct timespec ts = {.tv_sec = delay_us / 1000000, .tv_nsec = (delay_us % 1000000) * 1000};
+    nanosleep(&ts, NULL);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / (portTICK_PERIOD_MS * 1000));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    // Threads the stand-in did not create (main, test threads) get a handle on first use.
+    if (!current_task)
+    {
+        current_task = task_alloc();
+        current_task->thread = pthread_self();
+    }
+    return current_task;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify)
+{
+    pthread_mutex_lock(&xTaskToNotify->lock);
+    xTaskToNotify->notify_count++;
+    pthread_cond_signal(&xTaskToNotify->notified);
+    pthread_mutex_unlock(&xTaskToNotify->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    xTaskNotifyGive(xTaskToNotify);
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline = deadline_after(xTicksToWait);
+    pthread_mutex_lock(&task->lock);
+    while (task->notify_count == 0 && xTicksToWait != 0)
+    {
+        if (pthread_cond_timedwait(&task->notified, &task->lock, &deadline) != 0)
+        {
+            break;
+        }
+    }
+    uint32_t count = task->notify_count;
+    if (count)
+    {
+        task->notify_count = xClearCountOnExit ? 0 : count - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return count;
+}
+
+struct host_queue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t *items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    struct host_queue *queue = calloc(1, sizeof(struct host_queue));
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    queue->length = uxQueueLength;
+    queue->item_size = uxItemSize;
+    queue->items = calloc(uxQueueLength, uxItemSize);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    pthread_mutex_destroy(&xQueue->lock);
+    pthread_cond_destroy(&xQueue->changed);
+    free(xQueue->items);
+    free(xQueue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    struct timespec deadline = deadline_after(xTicksToWait);
+    pthread_mutex_lock(&xQueue->lock);
+    while (xQueue->count == xQueue->length)
+    {
+        if (xTicksToWait == 0 || pthread_cond_timedwait(&xQueue->changed, &xQueue->lock, &deadline) != 0)
+        {
+            pthread_mutex_unlock(&xQueue->lock);
+            return errQUEUE_FULL;
+        }
+    }
+    UBaseType_t tail = (xQueue->head + xQueue->count) % xQueue->length;
+    memcpy(xQueue->items + tail * xQueue->item_size, pvItemToQueue, xQueue->item_size);
+    xQueue->count++;
+    pthread_cond_broadcast(&xQueue->changed);
+    pthread_mutex_unlock(&xQueue->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t xQueue, const void *pvItemToQueue, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken)
+    {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+    return xQueueSend(xQueue, pvItemToQueue, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    struct timespec deadline = deadline_after(xTicksToWait);
+    pthread_mutex_lock(&xQueue->lock);
+    while (xQueue->count == 0)
+    {
+        if (xTicksToWait == 0 || pthread_cond_timedwait(&xQueue->changed, &xQueue->lock, &deadline) != 0)
+        {
+            pthread_mutex_unlock(&xQueue->lock);
+            return errQUEUE_EMPTY;
+        }
+    }
+    memcpy(pvBuffer, xQueue->items + xQueue->head * xQueue->item_size, xQueue->item_size);
+    xQueue->head = (xQueue->head + 1) % xQueue->length;
+    xQueue->count--;
+    pthread_cond_broadcast(&xQueue->changed);
+    pthread_mutex_unlock(&xQueue->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+    pthread_mutex_lock(&xQueue->lock);
+    UBaseType_t count = xQueue->count;
+    pthread_mutex_unlock(&xQueue->lock);
+    return count;
+}
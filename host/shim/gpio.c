@@ -0,0 +1,89 @@
+#include "driver/gpio.h"
+#include "host_hal.h"
+
+typedef struct
+{
+    gpio_mode_t mode;
+    bool pull_up;
+    int forced_level;
+    int output_level;
+} host_gpio_pin_t;
+
+static host_gpio_pin_t pins[GPIO_PIN_COUNT];
+static bool pins_initialized = false;
+
+static void init_pins(void)
+{
+    if (pins_initialized)
+    {
+        return;
+    }
+    for (int i = 0; i < GPIO_PIN_COUNT; ++i)
+    {
+        pins[i].forced_level = -1;
+    }
+    pins_initialized = true;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    init_pins();
+    for (int i = 0; i < GPIO_PIN_COUNT; ++i)
+    {
+        if (!(config->pin_bit_mask & (1ULL << i)))
+        {
+            continue;
+        }
+        pins[i].mode = config->mode;
+        pins[i].pull_up = config->pull_up_en && !config->pull_down_en;
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    init_pins();
+    if (gpio_num < 0 || gpio_num >= GPIO_PIN_COUNT)
+    {
+        return 0;
+    }
+    if (pins[gpio_num].forced_level >= 0)
+    {
+        return pins[gpio_num].forced_level;
+    }
+    if (pins[gpio_num].mode & GPIO_MODE_OUTPUT)
+    {
+        return pins[gpio_num].output_level;
+    }
+    return pins[gpio_num].pull_up;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    init_pins();
+    if (gpio_num < 0 || gpio_num >= GPIO_PIN_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pins[gpio_num].output_level = level ? 1 : 0;
+    return ESP_OK;
+}
+
+void host_gpio_force_level(int gpio_num, int level)
+{
+    init_pins();
+    if (gpio_num >= 0 && gpio_num < GPIO_PIN_COUNT)
+    {
+        pins[gpio_num].forced_level = level;
+    }
+}
+
+int host_gpio_get_output(int gpio_num)
+{
+    init_pins();
+    if (gpio_num < 0 || gpio_num >= GPIO_PIN_COUNT)
+    {
+        return 0;
+    }
+    return pins[gpio_num].output_level;
+}
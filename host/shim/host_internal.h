@@ -0,0 +1,12 @@
+#ifndef HOST_INTERNAL_H__
+#define HOST_INTERNAL_H__
+
+// Shared between the host driver stand-ins; not part of the firmware-facing API.
+
+#include <stdint.h>
+#include "hal/adc_types.h"
+
+// Takes one clamped 12-bit conversion from the configured ADC source.
+int host_adc_sample(adc_unit_t unit, adc_channel_t channel, int64_t time_us);
+
+#endif
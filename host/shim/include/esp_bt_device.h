@@ -0,0 +1,6 @@
+#ifndef ESP_BT_DEVICE_H__
+#define ESP_BT_DEVICE_H__
+
+#include "esp_bt_defs.h"
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef ESP_CPU_H__
+#define ESP_CPU_H__
+
+#include <stdint.h>
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+// Nanoseconds of CLOCK_MONOTONIC, wrapping like the 32-bit CCOUNT register: a
+// host "cycle" is a nanosecond, whatever the virtual clock says.
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
+
+#endif
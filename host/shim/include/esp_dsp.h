@@ -0,0 +1,20 @@
+#ifndef ESP_DSP_H__
+#define ESP_DSP_H__
+
+// Host stand-in for the parts of esp-dsp used by the filters. These follow the
+// esp-dsp ANSI reference implementations so host results match the device.
+
+#include <stdint.h>
+#include "esp_err.h"
+
+esp_err_t dsps_biquad_f32_ansi(const float *input, float *output, int len, float *coef, float *w);
+esp_err_t dsps_biquad_gen_bpf_f32(float *coeffs, float f, float qFactor);
+esp_err_t dsps_biquad_gen_lpf_f32(float *coeffs, float f, float qFactor);
+esp_err_t dsps_biquad_gen_hpf_f32(float *coeffs, float f, float qFactor);
+// C (m x k) = A (m x n) * B (n x k), all row-major.
+esp_err_t dspm_mult_f32_ansi(const float *A, const float *B, float *C, int m, int n, int k);
+
+#define dsps_biquad_f32 dsps_biquad_f32_ansi
+#define dspm_mult_f32 dspm_mult_f32_ansi
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef ESP_EVENT_H__
+#define ESP_EVENT_H__
+
+#include "esp_err.h"
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef ESP_GATT_DEFS_H__
+#define ESP_GATT_DEFS_H__
+
+#include "esp_bt_defs.h"
+
+#define ESP_GATT_UUID_BATTERY_SERVICE_SVC 0x180F
+#define ESP_GATT_UUID_HID_SVC 0x1812
+
+#define ESP_GATT_UUID_PRI_SERVICE 0x2800
+#define ESP_GATT_UUID_SEC_SERVICE 0x2801
+#define ESP_GATT_UUID_INCLUDE_SERVICE 0x2802
+#define ESP_GATT_UUID_CHAR_DECLARE 0x2803
+
+#define ESP_GATT_UUID_CHAR_EXT_PROP 0x2900
+#define ESP_GATT_UUID_CHAR_DESCRIPTION 0x2901
+#define ESP_GATT_UUID_CHAR_CLIENT_CONFIG 0x2902
+#define ESP_GATT_UUID_CHAR_SRVR_CONFIG 0x2903
+#define ESP_GATT_UUID_CHAR_PRESENT_FORMAT 0x2904
+#define ESP_GATT_UUID_CHAR_AGG_FORMAT 0x2905
+#define ESP_GATT_UUID_EXT_RPT_REF_DESCR 0x2907
+#define ESP_GATT_UUID_RPT_REF_DESCR 0x2908
+
+#define ESP_GATT_UUID_BATTERY_LEVEL 0x2A19
+#define ESP_GATT_UUID_HID_INFORMATION 0x2A4A
+#define ESP_GATT_UUID_HID_REPORT_MAP 0x2A4B
+#define ESP_GATT_UUID_HID_CONTROL_POINT 0x2A4C
+#define ESP_GATT_UUID_HID_REPORT 0x2A4D
+#define ESP_GATT_UUID_HID_PROTO_MODE 0x2A4E
+#define ESP_GATT_UUID_HID_BT_KB_INPUT 0x2A22
+#define ESP_GATT_UUID_HID_BT_KB_OUTPUT 0x2A32
+#define ESP_GATT_UUID_HID_BT_MOUSE_INPUT 0x2A33
+
+#define ESP_GATT_PERM_READ (1 << 0)
+#define ESP_GATT_PERM_READ_ENCRYPTED (1 << 1)
+#define ESP_GATT_PERM_READ_ENC_MITM (1 << 2)
+#define ESP_GATT_PERM_WRITE (1 << 4)
+#define ESP_GATT_PERM_WRITE_ENCRYPTED (1 << 5)
+#define ESP_GATT_PERM_WRITE_ENC_MITM (1 << 6)
+#define ESP_GATT_PERM_WRITE_SIGNED (1 << 7)
+#define ESP_GATT_PERM_WRITE_SIGNED_MITM (1 << 8)
+
+#define ESP_GATT_CHAR_PROP_BIT_BROADCAST (1 << 0)
+#define ESP_GATT_CHAR_PROP_BIT_READ (1 << 1)
+#define ESP_GATT_CHAR_PROP_BIT_WRITE_NR (1 << 2)
+#define ESP_GATT_CHAR_PROP_BIT_WRITE (1 << 3)
+#define ESP_GATT_CHAR_PROP_BIT_NOTIFY (1 << 4)
+#define ESP_GATT_CHAR_PROP_BIT_INDICATE (1 << 5)
+#define ESP_GATT_CHAR_PROP_BIT_AUTH (1 << 6)
+#define ESP_GATT_CHAR_PROP_BIT_EXT_PROP (1 << 7)
+
+#define ESP_GATT_RSP_BY_APP 0
+#define ESP_GATT_AUTO_RSP 1
+
+#define ESP_GATT_IF_NONE 0xff
+
+typedef uint8_t esp_gatt_if_t;
+typedef uint16_t esp_gatt_perm_t;
+typedef uint8_t esp_gatt_char_prop_t;
+
+typedef enum
+{
+    ESP_GATT_OK = 0x0,
+    ESP_GATT_INVALID_HANDLE = 0x01,
+    ESP_GATT_ERROR = 0x85,
+    ESP_GATT_NO_RESOURCES = 0x80,
+} esp_gatt_status_t;
+
+typedef struct
+{
+    uint16_t uuid_length;
+    uint8_t *uuid_p;
+    uint16_t perm;
+    uint16_t max_length;
+    uint16_t length;
+    uint8_t *value;
+} esp_attr_desc_t;
+
+typedef struct
+{
+    uint8_t auto_rsp;
+} esp_attr_control_t;
+
+typedef struct
+{
+    esp_attr_control_t attr_control;
+    esp_attr_desc_t att_desc;
+} esp_gatts_attr_db_t;
+
+typedef struct
+{
+    uint16_t start_hdl;
+    uint16_t end_hdl;
+    uint16_t uuid;
+} esp_gatts_incl_svc_desc_t;
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef ESP_LOG_H__
+#define ESP_LOG_H__
+
+// Host stand-in for esp_log.h. Output matches the device format (colours included)
+// so captures taken on host can be fed to the same tools as serial captures.
+
+#include <stdint.h>
+#include <inttypes.h>
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+esp_log_level_t esp_log_level_get(const char *tag);
+uint32_t esp_log_timestamp(void);
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+// Cheap global gate so disabled logging costs a compare, as on device.
+extern esp_log_level_t host_log_max_level;
+
+#define LOG_COLOR_E "\033[0;31m"
+#define LOG_COLOR_W "\033[0;33m"
+#define LOG_COLOR_I "\033[0;32m"
+#define LOG_COLOR_D ""
+#define LOG_COLOR_V ""
+#define LOG_RESET_COLOR "\033[0m"
+
+#define LOG_FORMAT(letter, format) LOG_COLOR_##letter #letter " (%" PRIu32 ") %s: " format LOG_RESET_COLOR "\n"
+
+#define ESP_LOG_LEVEL(level, letter, tag, format, ...)                                               \
+    do                                                                                               \
+    {                                                                                                \
+        if (host_log_max_level >= (level))                                                           \
+        {                                                                                            \
+            esp_log_write((level), (tag), LOG_FORMAT(letter, format), esp_log_timestamp(), (tag), ##__VA_ARGS__); \
+        }                                                                                            \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_ERROR, E, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_WARN, W, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_INFO, I, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_DEBUG, D, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_VERBOSE, V, tag, format, ##__VA_ARGS__)
+
+#endif
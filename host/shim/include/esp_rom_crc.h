@@ -0,0 +1,10 @@
+#ifndef ESP_ROM_CRC_H__
+#define ESP_ROM_CRC_H__
+
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, reflected) as the ROM computes it: pass 0 to start, or the
+// previous result to continue.
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len);
+
+#endif
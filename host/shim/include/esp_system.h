@@ -0,0 +1,10 @@
+#ifndef ESP_SYSTEM_H__
+#define ESP_SYSTEM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+void esp_restart(void);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef ESP_WIFI_H__
+#define ESP_WIFI_H__
+
+#include "esp_err.h"
+
+#endif
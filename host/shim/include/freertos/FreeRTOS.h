@@ -0,0 +1,36 @@
+#ifndef FREERTOS_H__
+#define FREERTOS_H__
+
+// Host stand-in for the FreeRTOS kernel. Tasks are pthreads; time follows the
+// host clock (see host_hal.h), so vTaskDelay is instant under virtual time.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#define configTICK_RATE_HZ 100
+#define configMAX_PRIORITIES 25
+#define configMINIMAL_STACK_SIZE 768
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t StackType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS (pdTRUE)
+#define pdFAIL (pdFALSE)
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(xTimeInMs) ((TickType_t)(((TickType_t)(xTimeInMs) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+
+#define portNUM_PROCESSORS 2
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+
+#define IRAM_ATTR
+
+#endif
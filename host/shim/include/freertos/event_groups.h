@@ -0,0 +1,8 @@
+#ifndef EVENT_GROUPS_H__
+#define EVENT_GROUPS_H__
+
+#include "freertos/FreeRTOS.h"
+
+// Included by main.c; no event group API is used yet.
+
+#endif
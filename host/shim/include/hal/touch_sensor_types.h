@@ -0,0 +1,6 @@
+#ifndef TOUCH_SENSOR_TYPES_H__
+#define TOUCH_SENSOR_TYPES_H__
+
+// Host stand-in. Included by constants.h but no touch sensor types are used.
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef HOST_HAL_H__
+#define HOST_HAL_H__
+
+// Controls for the host stand-ins of the ESP-IDF drivers. Firmware sources never
+// include this; it is for host benchmarks and tools that drive them.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "hal/adc_types.h"
+
+// Clock. In virtual mode esp_timer_get_time only moves when advanced (vTaskDelay
+// advances it too), and it is tracked per thread so independent runs can share a
+// process. In real mode it follows CLOCK_MONOTONIC.
+void host_clock_set_virtual(bool is_virtual);
+bool host_clock_is_virtual(void);
+void host_clock_set_us(int64_t time_us);
+void host_clock_advance_us(int64_t delta_us);
+
+// ADC. The source is asked for a raw reading whenever the firmware samples a channel.
+typedef int (*host_adc_source_t)(adc_unit_t unit, adc_channel_t channel, int64_t time_us, void *ctx);
+void host_adc_set_source(host_adc_source_t source, void *ctx);
+uint64_t host_adc_conversion_count(void);
+
+// GPIO. Inputs read their pull resistor unless a level is forced; -1 clears it.
+void host_gpio_force_level(int gpio_num, int level);
+int host_gpio_get_output(int gpio_num);
+
+// BLE. Connection events run the firmware's GATT/GAP callbacks synchronously.
+void host_bt_connect(uint16_t conn_id);
+void host_bt_disconnect(uint16_t conn_id);
+void host_bt_request_passkey(void);
+uint32_t host_bt_last_passkey(void);
+esp_err_t host_bt_write_attr(uint16_t attr_handle, uint16_t length, const uint8_t *value);
+
+typedef void (*host_bt_report_hook_t)(uint16_t conn_id, uint16_t attr_handle, uint16_t length, const uint8_t *value, void *ctx);
+void host_bt_set_report_hook(host_bt_report_hook_t hook, void *ctx);
+uint64_t host_bt_report_count(void);
+
+// NVS. Blobs live in memory; these carry them from one process to the next, so
+// a benchmark can boot twice. nvs_flash_erase empties the store.
+bool host_nvs_save(const char *path);
+bool host_nvs_load(const char *path);
+
+#endif
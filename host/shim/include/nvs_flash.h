@@ -0,0 +1,9 @@
+#ifndef NVS_FLASH_H__
+#define NVS_FLASH_H__
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif
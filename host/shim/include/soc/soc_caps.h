@@ -0,0 +1,16 @@
+#ifndef SOC_CAPS_H__
+#define SOC_CAPS_H__
+
+// Host stand-in, values follow the ESP32-S3.
+#define SOC_ADC_PERIPH_NUM 2
+#define SOC_ADC_MAX_CHANNEL_NUM 10
+#define SOC_ADC_RTC_MAX_BITWIDTH 12
+#define SOC_ADC_DIGI_MAX_BITWIDTH 12
+#define SOC_ADC_PATT_LEN_MAX 24
+#define SOC_ADC_DIGI_RESULT_BYTES 4
+#define SOC_ADC_DIGI_DATA_BYTES_PER_CONV 4
+#define SOC_ADC_SAMPLE_FREQ_THRES_HIGH 83333
+#define SOC_ADC_SAMPLE_FREQ_THRES_LOW 611
+#define SOC_CPU_CORES_NUM 2
+
+#endif
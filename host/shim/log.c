@@ -0,0 +1,85 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#define MAX_TAG_LEVELS 16
+
+esp_log_level_t host_log_max_level = ESP_LOG_INFO;
+
+static esp_log_level_t default_level = ESP_LOG_INFO;
+
+static struct
+{
+    const char *tag;
+    esp_log_level_t level;
+} tag_levels[MAX_TAG_LEVELS];
+static int tag_level_count = 0;
+
+static void recompute_max_level(void)
+{
+    esp_log_level_t max = default_level;
+    for (int i = 0; i < tag_level_count; ++i)
+    {
+        max = tag_levels[i].level > max ? tag_levels[i].level : max;
+    }
+    host_log_max_level = max;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    if (strcmp(tag, "*") == 0)
+    {
+        default_level = level;
+        tag_level_count = 0;
+        recompute_max_level();
+        return;
+    }
+    for (int i = 0; i < tag_level_count; ++i)
+    {
+        if (strcmp(tag_levels[i].tag, tag) == 0)
+        {
+            tag_levels[i].level = level;
+            recompute_max_level();
+            return;
+        }
+    }
+    if (tag_level_count < MAX_TAG_LEVELS)
+    {
+        tag_levels[tag_level_count].tag = tag;
+        tag_levels[tag_level_count].level = level;
+        tag_level_count++;
+    }
+    recompute_max_level();
+}
+
+esp_log_level_t esp_log_level_get(const char *tag)
+{
+    for (int i = 0; i < tag_level_count; ++i)
+    {
+        if (strcmp(tag_levels[i].tag, tag) == 0)
+        {
+            return tag_levels[i].level;
+        }
+    }
+    return default_level;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (level > esp_log_level_get(tag))
+    {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(stdout, format, args);
+    va_end(args);
+}
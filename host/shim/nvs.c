@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "host_hal.h"
+
+// Blobs in memory, keyed by namespace and key, optionally saved to a file so
+// that a later process boots with them. Writes are visible without nvs_commit.
+
+#define HOST_NVS_MAX_ENTRIES 64
+// Same limits as the IDF.
+#define HOST_NVS_MAX_NAME 16
+#define HOST_NVS_MAX_HANDLES 16
+
+typedef struct
+{
+    bool in_use;
+    char namespace_name[HOST_NVS_MAX_NAME];
+    char key[HOST_NVS_MAX_NAME];
+    size_t length;
+    uint8_t *value;
+} host_nvs_entry_t;
+
+static host_nvs_entry_t entries[HOST_NVS_MAX_ENTRIES];
+// Namespace of each open handle; handle i + 1 is slot i.
+static char handles[HOST_NVS_MAX_HANDLES][HOST_NVS_MAX_NAME];
+static bool handle_writable[HOST_NVS_MAX_HANDLES];
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    for (int i = 0; i < HOST_NVS_MAX_ENTRIES; ++i)
+    {
+        free(entries[i].value);
+    }
+    memset(entries, 0, sizeof(entries));
+    return ESP_OK;
+}
+
+static const char *handle_namespace(nvs_handle_t handle)
+{
+    if (handle < 1 || handle > HOST_NVS_MAX_HANDLES || !handles[handle - 1][0])
+    {
+        return NULL;
+    }
+    return handles[handle - 1];
+}
+
+static host_nvs_entry_t *find(const char *namespace_name, const char *key)
+{
+    for (int i = 0; i < HOST_NVS_MAX_ENTRIES; ++i)
+    {
+        if (entries[i].in_use && strcmp(entries[i].namespace_name, namespace_name) == 0 && strcmp(entries[i].key, key) == 0)
+        {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!namespace_name[0] || strlen(namespace_name) >= HOST_NVS_MAX_NAME)
+    {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    for (int i = 0; i < HOST_NVS_MAX_HANDLES; ++i)
+    {
+        if (!handles[i][0])
+        {
+            strcpy(handles[i], namespace_name);
+            handle_writable[i] = open_mode == NVS_READWRITE;
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    if (handle_namespace(handle))
+    {
+        handles[handle - 1][0] = '\0';
+    }
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    const char *namespace_name = handle_namespace(handle);
+    if (!namespace_name)
+    {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    host_nvs_entry_t *entry = find(namespace_name, key);
+    if (!entry)
+    {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    // Like the IDF: a NULL buffer asks for the length.
+    if (out_value)
+    {
+        if (*length < entry->length)
+        {
+            return ESP_ERR_NVS_INVALID_LENGTH;
+        }
+        memcpy(out_value, entry->value, entry->length);
+    }
+    *length = entry->length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    const char *namespace_name = handle_namespace(handle);
+    if (!namespace_name)
+    {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (!handle_writable[handle - 1])
+    {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (!key[0] || strlen(key) >= HOST_NVS_MAX_NAME)
+    {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    host_nvs_entry_t *entry = find(namespace_name, key);
+    for (int i = 0; !entry && i < HOST_NVS_MAX_ENTRIES; ++i)
+    {
+        if (!entries[i].in_use)
+        {
+            entry = &entries[i];
+            entry->in_use = true;
+            strcpy(entry->namespace_name, namespace_name);
+            strcpy(entry->key, key);
+        }
+    }
+    if (!entry)
+    {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    free(entry->value);
+    entry->value = malloc(length ? length : 1);
+    memcpy(entry->value, value, length);
+    entry->length = length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return nvs_get_blob(handle, key, out_value, length);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return nvs_set_blob(handle, key, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    const char *namespace_name = handle_namespace(handle);
+    if (!namespace_name)
+    {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    host_nvs_entry_t *entry = find(namespace_name, key);
+    if (!entry)
+    {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    free(entry->value);
+    memset(entry, 0, sizeof(*entry));
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return handle_namespace(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+// File: for each entry, its namespace and key as fixed-size fields, a 32-bit
+// length, then the value.
+bool host_nvs_save(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        return false;
+    }
+    bool ok = true;
+    for (int i = 0; ok && i < HOST_NVS_MAX_ENTRIES; ++i)
+    {
+        host_nvs_entry_t *entry = &entries[i];
+        uint32_t length = entry->length;
+        ok = !entry->in_use ||
+             (fwrite(entry->namespace_name, HOST_NVS_MAX_NAME, 1, file) == 1 &&
+              fwrite(entry->key, HOST_NVS_MAX_NAME, 1, file) == 1 &&
+              fwrite(&length, sizeof(length), 1, file) == 1 &&
+              fwrite(entry->value, 1, length, file) == length);
+    }
+    return fclose(file) == 0 && ok;
+}
+
+bool host_nvs_load(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return false;
+    }
+    nvs_flash_erase();
+    bool ok = true;
+    for (int i = 0; ok && i < HOST_NVS_MAX_ENTRIES; ++i)
+    {
+        host_nvs_entry_t *entry = &entries[i];
+        uint32_t length;
+        if (fread(entry->namespace_name, HOST_NVS_MAX_NAME, 1, file) != 1)
+        {
+            break;
+        }
+        ok = fread(entry->key, HOST_NVS_MAX_NAME, 1, file) == 1 &&
+             fread(&length, sizeof(length), 1, file) == 1;
+        if (ok)
+        {
+            entry->value = malloc(length ? length : 1);
+            entry->length = length;
+            ok = fread(entry->value, 1, length, file) == length;
+        }
+        entry->namespace_name[HOST_NVS_MAX_NAME - 1] = '\0';
+        entry->key[HOST_NVS_MAX_NAME - 1] = '\0';
+        entry->in_use = ok;
+    }
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,105 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "esp_timer.h"
+
+// One thread per timer, sleeping to absolute deadlines so periods do not drift.
+struct esp_timer
+{
+    esp_timer_create_args_t args;
+    pthread_mutex_t lock;
+    pthread_t thread;
+    bool running;
+    uint64_t period_us;
+};
+
+static void *timer_thread(void *arg)
+{
+    struct esp_timer *timer = arg;
+    int64_t next_us = esp_timer_get_time() + timer->period_us;
+    while (1)
+    {
+        int64_t delay_us = next_us - esp_timer_get_time();
+        if (delay_us > 0)
+        {
+            struct timespec ts = {.tv_sec = delay_us / 1000000, .tv_nsec = (delay_us % 1000000) * 1000};
+            nanosleep(&ts, NULL);
+        }
+        pthread_mutex_lock(&timer->lock);
+        bool running = timer->running;
+        pthread_mutex_unlock(&timer->lock);
+        if (!running)
+        {
+            return NULL;
+        }
+        timer->args.callback(timer->args.arg);
+
+        next_us += timer->period_us;
+        if (timer->args.skip_unhandled_events)
+        {
+            // Like the device: periods the callback overran are skipped, not replayed.
+            while (next_us < esp_timer_get_time())
+            {
+                next_us += timer->period_us;
+            }
+        }
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (!create_args || !create_args->callback || !out_handle)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct esp_timer *timer = calloc(1, sizeof(struct esp_timer));
+    timer->args = *create_args;
+    pthread_mutex_init(&timer->lock, NULL);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    if (!timer || period == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->running)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->period_us = period;
+    timer->running = true;
+    pthread_create(&timer->thread, NULL, timer_thread, timer);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer || !timer->running)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pthread_mutex_lock(&timer->lock);
+    timer->running = false;
+    pthread_mutex_unlock(&timer->lock);
+    pthread_join(timer->thread, NULL);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (!timer)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->running)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pthread_mutex_destroy(&timer->lock);
+    free(timer);
+    return ESP_OK;
+}
@@ -0,0 +1,642 @@
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "capture.h"
+
+// Longest line kept; the events are far shorter and anything beyond is dropped.
+#define CAPTURE_LINE_MAX 1024
+#define CAPTURE_ALIGN 64
+#define CAPTURE_MAGIC "PAWCOL1\n"
+// The log clock going back by more than this means the device restarted.
+#define CAPTURE_REBOOT_JUMP_MS 1000
+
+typedef enum
+{
+    ENCODING_UTF8,
+    ENCODING_UTF16LE,
+    ENCODING_UTF16BE,
+} text_encoding_t;
+
+static const size_t type_size[] = {
+    [CAPTURE_I32] = 4,
+    [CAPTURE_I64] = 8,
+    [CAPTURE_F32] = 4,
+    [CAPTURE_F64] = 8,
+    [CAPTURE_U8] = 1,
+};
+
+static const char *type_dtype[] = {
+    [CAPTURE_I32] = "<i4",
+    [CAPTURE_I64] = "<i8",
+    [CAPTURE_F32] = "<f4",
+    [CAPTURE_F64] = "<f8",
+    [CAPTURE_U8] = "|u1",
+};
+
+static void add_column(capture_table_t *table, const char *name, capture_type_t type)
+{
+    capture_column_t *column = &table->columns[table->column_count++];
+    snprintf(column->name, sizeof(column->name), "%s", name);
+    column->type = type;
+    column->data = NULL;
+}
+
+static void add_channel_columns(capture_table_t *table, const char *prefix, capture_type_t type)
+{
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        char name[24];
+        snprintf(name, sizeof(name), "%s%d", prefix, i);
+        add_column(table, name, type);
+    }
+}
+
+static capture_table_t *tables(capture_t *capture, int i)
+{
+    capture_table_t *all[] = {&capture->sensor, &capture->filter, &capture->thresholds,
+                              &capture->haptics, &capture->encoding, &capture->frame, &capture->calibration};
+    return i < (int)(sizeof(all) / sizeof(all[0])) ? all[i] : NULL;
+}
+
+void capture_init(capture_t *capture)
+{
+    memset(capture, 0, sizeof(*capture));
+    capture->sensor.name = "sensor";
+    add_column(&capture->sensor, "timestamp_ms", CAPTURE_I64);
+    add_channel_columns(&capture->sensor, "raw", CAPTURE_I32);
+    capture->filter.name = "filter";
+    add_column(&capture->filter, "timestamp_ms", CAPTURE_I64);
+    add_channel_columns(&capture->filter, "filtered", CAPTURE_F32);
+    capture->thresholds.name = "thresholds";
+    add_column(&capture->thresholds, "timestamp_ms", CAPTURE_I64);
+    add_channel_columns(&capture->thresholds, "threshold", CAPTURE_F32);
+    capture->haptics.name = "haptics";
+    add_column(&capture->haptics, "timestamp_ms", CAPTURE_I64);
+    add_column(&capture->haptics, "flags", CAPTURE_I32);
+    add_column(&capture->haptics, "duty", CAPTURE_F64);
+    capture->encoding.name = "encoding";
+    add_column(&capture->encoding, "timestamp_ms", CAPTURE_I64);
+    add_column(&capture->encoding, "key", CAPTURE_U8);
+    capture->frame.name = "frame";
+    add_column(&capture->frame, "sequence", CAPTURE_I64);
+    add_column(&capture->frame, "timestamp_us", CAPTURE_I64);
+    add_column(&capture->frame, "state", CAPTURE_I32);
+    add_column(&capture->frame, "pressed", CAPTURE_I32);
+    capture->calibration.name = "calibration";
+    add_column(&capture->calibration, "timestamp_ms", CAPTURE_I64);
+    add_column(&capture->calibration, "active", CAPTURE_U8);
+    capture_table_t *table;
+    for (int t = 0; (table = tables(capture, t)); ++t)
+    {
+        add_column(table, "boot", CAPTURE_I32);
+    }
+    capture->boot = -1;
+    sensor_log_reader_init(&capture->log_reader);
+}
+
+void capture_free(capture_t *capture)
+{
+    capture_table_t *table;
+    for (int t = 0; (table = tables(capture, t)); ++t)
+    {
+        for (int c = 0; c < table->column_count; ++c)
+        {
+            free(table->columns[c].data);
+        }
+    }
+    memset(capture, 0, sizeof(*capture));
+}
+
+const capture_column_t *capture_column(const capture_table_t *table, const char *name)
+{
+    for (int c = 0; c < table->column_count; ++c)
+    {
+        if (strcmp(table->columns[c].name, name) == 0)
+        {
+            return &table->columns[c];
+        }
+    }
+    return NULL;
+}
+
+// Makes room for one more row, stamped with the current boot, and returns its index.
+static size_t add_row(capture_t *capture, capture_table_t *table)
+{
+    if (table->rows == table->capacity)
+    {
+        table->capacity = table->capacity ? table->capacity * 2 : 1024;
+        for (int c = 0; c < table->column_count; ++c)
+        {
+            capture_column_t *column = &table->columns[c];
+            column->data = realloc(column->data, table->capacity * type_size[column->type]);
+        }
+    }
+    capture_column_t *boot = &table->columns[table->column_count - 1];
+    ((int32_t *)boot->data)[table->rows] = capture->boot;
+    return table->rows++;
+}
+
+static void observe_timestamp(capture_t *capture, int64_t timestamp_ms)
+{
+    if (timestamp_ms + CAPTURE_REBOOT_JUMP_MS < capture->last_timestamp_ms)
+    {
+        capture->boot++;
+    }
+    capture->last_timestamp_ms = timestamp_ms;
+}
+
+#define CELL(table, column, ctype, row) (((ctype *)(table)->columns[column].data)[row])
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static const char *skip_separators(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '|' || *p == ','))
+    {
+        p++;
+    }
+    return p;
+}
+
+static const char *parse_int(const char *p, const char *end, int64_t *value)
+{
+    bool negative = p < end && *p == '-';
+    p += negative;
+    if (p == end || !is_digit(*p))
+    {
+        return NULL;
+    }
+    int64_t v = 0;
+    while (p < end && is_digit(*p))
+    {
+        v = v * 10 + (*p++ - '0');
+    }
+    *value = negative ? -v : v;
+    return p;
+}
+
+// Decimal numbers as printf's %f and %d write them, plus nan and inf.
+static const char *parse_double(const char *p, const char *end, double *value)
+{
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                     1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+    bool negative = p < end && *p == '-';
+    p += negative;
+    if (end - p >= 3 && (memcmp(p, "nan", 3) == 0 || memcmp(p, "inf", 3) == 0))
+    {
+        *value = *p == 'n' ? NAN : negative ? -INFINITY : INFINITY;
+        return p + 3;
+    }
+    if (p == end || !is_digit(*p))
+    {
+        return NULL;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int scale = 0;
+    while (p < end && is_digit(*p))
+    {
+        if (digits < 18)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        }
+        else
+        {
+            scale--;
+        }
+        p++;
+    }
+    if (p < end && *p == '.')
+    {
+        p++;
+        while (p < end && is_digit(*p))
+        {
+            if (digits < 18)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                scale++;
+            }
+            p++;
+        }
+    }
+    double v = (double)mantissa;
+    v = scale >= 0 ? v / powers[scale < 18 ? scale : 18] : v * powers[-scale < 18 ? -scale : 18];
+    *value = negative ? -v : v;
+    return p;
+}
+
+// Reads up to SENSOR_COUNT '|'-separated numbers into row of table, from column 1.
+static void parse_channels(capture_table_t *table, size_t row, const char *p, const char *end)
+{
+    bool integer = table->columns[1].type == CAPTURE_I32;
+    int i = 0;
+    for (; i < SENSOR_COUNT; ++i)
+    {
+        p = skip_separators(p, end);
+        double value;
+        const char *next = parse_double(p, end, &value);
+        if (!next)
+        {
+            break;
+        }
+        if (integer)
+        {
+            CELL(table, 1 + i, int32_t, row) = (int32_t)value;
+        }
+        else
+        {
+            CELL(table, 1 + i, float, row) = (float)value;
+        }
+        p = next;
+    }
+    for (; i < SENSOR_COUNT; ++i)
+    {
+        if (integer)
+        {
+            CELL(table, 1 + i, int32_t, row) = -1;
+        }
+        else
+        {
+            CELL(table, 1 + i, float, row) = NAN;
+        }
+    }
+}
+
+static bool starts_with(const char *p, const char *end, const char *prefix, size_t length)
+{
+    return (size_t)(end - p) >= length && memcmp(p, prefix, length) == 0;
+}
+
+#define STARTS_WITH(p, end, literal) starts_with(p, end, literal, sizeof(literal) - 1)
+
+static void add_log_record(capture_t *capture, const sensor_log_entry_t *entry)
+{
+    int64_t timestamp_ms = entry->timestamp_us / 1000;
+    observe_timestamp(capture, timestamp_ms);
+    size_t row = add_row(capture, &capture->sensor);
+    CELL(&capture->sensor, 0, int64_t, row) = timestamp_ms;
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        CELL(&capture->sensor, 1 + i, int32_t, row) = (int32_t)entry->raw[i];
+    }
+    if (entry->has_filtered)
+    {
+        row = add_row(capture, &capture->filter);
+        CELL(&capture->filter, 0, int64_t, row) = timestamp_ms;
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            CELL(&capture->filter, 1 + i, float, row) = entry->filtered[i];
+        }
+    }
+    row = add_row(capture, &capture->frame);
+    CELL(&capture->frame, 0, int64_t, row) = entry->sequence;
+    CELL(&capture->frame, 1, int64_t, row) = entry->timestamp_us;
+    CELL(&capture->frame, 2, int32_t, row) = (int32_t)entry->state;
+    CELL(&capture->frame, 3, int32_t, row) = (int32_t)entry->pressed;
+}
+
+// One line with colours and line endings already removed:
+// "I (1234) TAG: message".
+static void parse_line(capture_t *capture, const char *line, size_t length)
+{
+    const char *end = line + length;
+    if (length > 2 && line[0] == '$')
+    {
+        sensor_log_entry_t entry;
+        if (sensor_log_reader_line(&capture->log_reader, line, length, &entry))
+        {
+            add_log_record(capture, &entry);
+        }
+        return;
+    }
+    if (length < 8 || line[1] != ' ' || line[2] != '(')
+    {
+        return;
+    }
+    int64_t timestamp;
+    const char *p = parse_int(line + 3, end, &timestamp);
+    if (!p || !STARTS_WITH(p, end, ") "))
+    {
+        return;
+    }
+    observe_timestamp(capture, timestamp);
+    const char *tag = p + 2;
+    const char *colon = memchr(tag, ':', end - tag);
+    if (!colon || colon + 2 > end)
+    {
+        return;
+    }
+    const char *message = colon + 2;
+
+    capture_table_t *table = NULL;
+    if (STARTS_WITH(message, end, "SENSORLOG |"))
+    {
+        table = &capture->sensor;
+    }
+    else if (STARTS_WITH(message, end, "FILTER_LOG |"))
+    {
+        table = &capture->filter;
+    }
+    else if (STARTS_WITH(message, end, "Thresholds |") || STARTS_WITH(message, end, "Exit IIR calibration |"))
+    {
+        table = &capture->thresholds;
+    }
+    if (table)
+    {
+        size_t row = add_row(capture, table);
+        CELL(table, 0, int64_t, row) = timestamp;
+        parse_channels(table, row, memchr(message, '|', end - message), end);
+        return;
+    }
+
+    // The calibration jumper. The IIR filter logs only its start: its "Exit IIR
+    // calibration" is the end of its own countdown, not the jumper's release.
+    bool enter = STARTS_WITH(message, end, "Enter calibration") || STARTS_WITH(message, end, "Enter IIR calibration");
+    if (enter || STARTS_WITH(message, end, "Exit calibration"))
+    {
+        size_t row = add_row(capture, &capture->calibration);
+        CELL(&capture->calibration, 0, int64_t, row) = timestamp;
+        CELL(&capture->calibration, 1, uint8_t, row) = enter;
+    }
+
+    if (STARTS_WITH(message, end, "HAPTICSLOG |"))
+    {
+        int64_t flags;
+        double duty;
+        p = parse_int(skip_separators(message + 12, end), end, &flags);
+        p = p ? parse_double(skip_separators(p, end), end, &duty) : NULL;
+        if (p)
+        {
+            size_t row = add_row(capture, &capture->haptics);
+            CELL(&capture->haptics, 0, int64_t, row) = timestamp;
+            CELL(&capture->haptics, 1, int32_t, row) = (int32_t)flags;
+            CELL(&capture->haptics, 2, double, row) = duty;
+        }
+        return;
+    }
+
+    // The encoder's accepted chord: "| a |", with DEL for the all-fingers chord.
+    if (colon - tag == 8 && memcmp(tag, "ENCODING", 8) == 0 && end - message >= 5 &&
+        message[0] == '|' && message[1] == ' ' && message[3] == ' ' && message[4] == '|')
+    {
+        size_t row = add_row(capture, &capture->encoding);
+        CELL(&capture->encoding, 0, int64_t, row) = timestamp;
+        CELL(&capture->encoding, 1, uint8_t, row) = (uint8_t)message[2];
+    }
+}
+
+static text_encoding_t detect_encoding(const uint8_t *data, size_t length, size_t *skip)
+{
+    *skip = 0;
+    if (length >= 2 && data[0] == 0xff && data[1] == 0xfe)
+    {
+        *skip = 2;
+        return ENCODING_UTF16LE;
+    }
+    if (length >= 2 && data[0] == 0xfe && data[1] == 0xff)
+    {
+        *skip = 2;
+        return ENCODING_UTF16BE;
+    }
+    if (length >= 3 && data[0] == 0xef && data[1] == 0xbb && data[2] == 0xbf)
+    {
+        *skip = 3;
+        return ENCODING_UTF8;
+    }
+    // Without a mark: ASCII text in UTF-16 has a zero in every other byte.
+    size_t zeros[2] = {0, 0};
+    size_t sample = length < 4096 ? length : 4096;
+    for (size_t i = 0; i < sample; ++i)
+    {
+        zeros[i & 1] += data[i] == 0;
+    }
+    if (zeros[1] > sample / 4 && zeros[1] > 4 * zeros[0])
+    {
+        return ENCODING_UTF16LE;
+    }
+    if (zeros[0] > sample / 4 && zeros[0] > 4 * zeros[1])
+    {
+        return ENCODING_UTF16BE;
+    }
+    return ENCODING_UTF8;
+}
+
+// Copies one UTF-16 character into the line, dropping ANSI escape sequences and '\r'.
+// escape tracks a sequence across calls: 0 outside, 1 after ESC, 2 inside "ESC[".
+static inline void put_char(char *line, size_t *length, int *escape, unsigned c)
+{
+    if (*escape)
+    {
+        if (*escape == 1)
+        {
+            *escape = c == '[' ? 2 : 0;
+        }
+        else if (c >= 0x40 && c <= 0x7e)
+        {
+            *escape = 0;
+        }
+        return;
+    }
+    if (c == 0x1b)
+    {
+        *escape = 1;
+        return;
+    }
+    if (c == '\r' || *length == CAPTURE_LINE_MAX)
+    {
+        return;
+    }
+    // Everything the firmware logs is ASCII; other characters just must not match.
+    line[(*length)++] = c < 0x80 ? (char)c : '?';
+}
+
+// Length of the ANSI escape sequence at p, which starts with ESC.
+static size_t escape_length(const uint8_t *p, const uint8_t *end)
+{
+    if (end - p < 2 || p[1] != '[')
+    {
+        return 1;
+    }
+    const uint8_t *q = p + 2;
+    while (q < end && !(*q >= 0x40 && *q <= 0x7e))
+    {
+        q++;
+    }
+    return q < end ? q + 1 - p : end - p;
+}
+
+static void parse_utf8(capture_t *capture, const uint8_t *p, const uint8_t *end)
+{
+    char line[CAPTURE_LINE_MAX];
+    while (p < end)
+    {
+        const uint8_t *newline = memchr(p, '\n', end - p);
+        const uint8_t *stop = newline ? newline : end;
+        // Copy the runs between escape sequences whole; a line has only a couple.
+        size_t length = 0;
+        while (p < stop)
+        {
+            const uint8_t *escape = memchr(p, 0x1b, stop - p);
+            const uint8_t *run_end = escape ? escape : stop;
+            size_t run = run_end - p;
+            run = run < CAPTURE_LINE_MAX - length ? run : CAPTURE_LINE_MAX - length;
+            memcpy(line + length, p, run);
+            length += run;
+            p = escape ? escape + escape_length(escape, stop) : stop;
+        }
+        while (length && line[length - 1] == '\r')
+        {
+            length--;
+        }
+        parse_line(capture, line, length);
+        capture->lines++;
+        p = stop + 1;
+    }
+}
+
+static void parse_utf16(capture_t *capture, const uint8_t *p, const uint8_t *end, bool big_endian)
+{
+    char line[CAPTURE_LINE_MAX];
+    size_t length = 0;
+    int escape = 0;
+    for (; p + 1 < end; p += 2)
+    {
+        unsigned c = big_endian ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+        if (c == '\n')
+        {
+            parse_line(capture, line, length);
+            capture->lines++;
+            length = 0;
+            escape = 0;
+        }
+        else
+        {
+            put_char(line, &length, &escape, c);
+        }
+    }
+    if (length)
+    {
+        parse_line(capture, line, length);
+        capture->lines++;
+    }
+}
+
+void capture_parse(capture_t *capture, const uint8_t *data, size_t length)
+{
+    size_t skip;
+    text_encoding_t encoding = detect_encoding(data, length, &skip);
+    capture->utf16 = encoding != ENCODING_UTF8;
+    // Each file starts a boot of its own.
+    capture->boot++;
+    capture->last_timestamp_ms = 0;
+    capture->bytes += length;
+    if (encoding == ENCODING_UTF8)
+    {
+        parse_utf8(capture, data + skip, data + length);
+    }
+    else
+    {
+        parse_utf16(capture, data + skip, data + length, encoding == ENCODING_UTF16BE);
+    }
+}
+
+bool capture_parse_file(capture_t *capture, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return true;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    capture_parse(capture, data, st.st_size);
+    munmap(data, st.st_size);
+    return true;
+}
+
+bool capture_write_columnar(const capture_t *capture, const char *path)
+{
+    FILE *out = fopen(path, "wb");
+    if (!out)
+    {
+        return false;
+    }
+    uint32_t column_count = 0;
+    const capture_table_t *table;
+    for (int t = 0; (table = tables((capture_t *)capture, t)); ++t)
+    {
+        column_count += table->column_count;
+    }
+
+    uint32_t header[2] = {column_count, 0};
+    fwrite(CAPTURE_MAGIC, 1, 8, out);
+    fwrite(header, sizeof(header), 1, out);
+    uint64_t offset = 16 + 64 * (uint64_t)column_count;
+    for (int t = 0; (table = tables((capture_t *)capture, t)); ++t)
+    {
+        for (int c = 0; c < table->column_count; ++c)
+        {
+            const capture_column_t *column = &table->columns[c];
+            struct
+            {
+                char name[40];
+                char dtype[8];
+                uint64_t rows;
+                uint64_t offset;
+            } descriptor = {{0}, {0}, table->rows, 0};
+            snprintf(descriptor.name, sizeof(descriptor.name), "%s.%s", table->name, column->name);
+            memcpy(descriptor.dtype, type_dtype[column->type], 3);
+            offset = (offset + CAPTURE_ALIGN - 1) & ~(uint64_t)(CAPTURE_ALIGN - 1);
+            descriptor.offset = offset;
+            fwrite(&descriptor, sizeof(descriptor), 1, out);
+            offset += table->rows * type_size[column->type];
+        }
+    }
+
+    static const uint8_t padding[CAPTURE_ALIGN] = {0};
+    long position = ftell(out);
+    for (int t = 0; (table = tables((capture_t *)capture, t)); ++t)
+    {
+        for (int c = 0; c < table->column_count; ++c)
+        {
+            const capture_column_t *column = &table->columns[c];
+            long aligned = (position + CAPTURE_ALIGN - 1) & ~(long)(CAPTURE_ALIGN - 1);
+            fwrite(padding, 1, aligned - position, out);
+            size_t bytes = table->rows * type_size[column->type];
+            if (bytes)
+            {
+                fwrite(column->data, 1, bytes, out);
+            }
+            position = aligned + bytes;
+        }
+    }
+    bool ok = !ferror(out);
+    return fclose(out) == 0 && ok;
+}
@@ -0,0 +1,98 @@
+#ifndef CAPTURE_H__
+#define CAPTURE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "constants.h"
+#include "sensor_log_reader.h"
+
+// Console captures of the firmware parsed into columns. A capture is UTF-8 or
+// UTF-16 (either byte order, with or without a byte order mark), with or without
+// ANSI colours and carriage returns. Lines that are not one of the events below
+// are skipped.
+//
+//   table       source                                      columns
+//   sensor      SENSORLOG lines, binary log records         timestamp_ms, raw0..
+//   filter      FILTER_LOG lines, binary log records        timestamp_ms, filtered0..
+//   thresholds  Thresholds and Exit IIR calibration lines   timestamp_ms, threshold0..
+//   haptics     HAPTICSLOG lines                            timestamp_ms, flags, duty
+//   encoding    ENCODING "| x |" lines (accepted chords)    timestamp_ms, key
+//   frame       binary log records                          sequence, timestamp_us, state, pressed
+//   calibration Enter/Exit calibration lines (the jumper)   timestamp_ms, active
+//
+// There are SENSOR_COUNT value columns; older firmware logged fewer channels, and
+// the rest read -1 (raw) or NaN. Timestamps are the log's milliseconds since boot.
+// Every table also has a boot column counting restarts within the capture:
+// the log clock jumping back, or the next file of a multi-file capture.
+
+typedef enum
+{
+    CAPTURE_I32,
+    CAPTURE_I64,
+    CAPTURE_F32,
+    CAPTURE_F64,
+    CAPTURE_U8,
+} capture_type_t;
+
+typedef struct
+{
+    char name[24];
+    capture_type_t type;
+    void *data;
+} capture_column_t;
+
+#define CAPTURE_MAX_COLUMNS (2 + SENSOR_COUNT)
+
+typedef struct
+{
+    const char *name;
+    int column_count;
+    capture_column_t columns[CAPTURE_MAX_COLUMNS];
+    size_t rows;
+    size_t capacity;
+} capture_table_t;
+
+typedef struct
+{
+    capture_table_t sensor;
+    capture_table_t filter;
+    capture_table_t thresholds;
+    capture_table_t haptics;
+    capture_table_t encoding;
+    capture_table_t frame;
+    capture_table_t calibration;
+
+    bool utf16;
+    int32_t boot;
+    int64_t last_timestamp_ms;
+    uint64_t bytes;
+    uint64_t lines;
+    sensor_log_reader_t log_reader;
+} capture_t;
+
+void capture_init(capture_t *capture);
+void capture_free(capture_t *capture);
+
+// Memory-maps a capture and appends its events. Returns false if it cannot be read.
+bool capture_parse_file(capture_t *capture, const char *path);
+
+// Appends the events in a capture already in memory.
+void capture_parse(capture_t *capture, const uint8_t *data, size_t length);
+
+// Column of a table by name, or NULL.
+const capture_column_t *capture_column(const capture_table_t *table, const char *name);
+
+// Writes every table to a columnar file that util/parse.py maps without parsing:
+//
+//   "PAWCOL1\n"
+//   uint32 column count, uint32 0
+//   per column, 64 bytes: name "table.column" (40, NUL-padded), numpy dtype
+//       string (8, NUL-padded), uint64 rows, uint64 offset of the data
+//   column data, each starting on a 64-byte boundary
+//
+// All integers little-endian.
+bool capture_write_columnar(const capture_t *capture, const char *path);
+
+#endif
@@ -0,0 +1,194 @@
+// Estimates the crosstalk between sensors (crosstalk.h) from the frames of a set
+// of captures, as the device does during calibration, and prints the coupling.
+// Then replays the captures (replay.h) with and without the compensation, and
+// compares the chords: matched, extra, and the sensors that a replayed chord
+// gained or lost against the logged one, with the IIR filter or (-f autocal) the
+// auto-calibrating one.
+//
+//   crosstalk_fit [-f iir|autocal] [-l press_level] [-a alone_fraction] [-m min_frames] [-t tolerance_ms] [-v] capture...
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "constants.h"
+#include "filter.h"
+#include "iir_filter.h"
+#include "autocal_filter.h"
+#include "sensors.h"
+#include "crosstalk.h"
+
+#include "capture.h"
+#include "replay.h"
+
+static filter_handle_t make_iir_filter(void *context)
+{
+    return init_iir_filter_default();
+}
+
+static filter_handle_t make_autocal_filter(void *context)
+{
+    return init_autocal_filter_default();
+}
+
+// Every logged frame, boot by boot: the baseline starts over with each boot.
+static void estimate(crosstalk_estimator *estimator, const capture_t *capture)
+{
+    const capture_table_t *sensor = &capture->sensor;
+    const int32_t *boots = capture_column(sensor, "boot")->data;
+    const int32_t *raw[SENSOR_COUNT];
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "raw%d", i);
+        raw[i] = capture_column(sensor, name)->data;
+    }
+    for (size_t row = 0; row < sensor->rows; ++row)
+    {
+        if (row == 0 || boots[row] != boots[row - 1])
+        {
+            estimator->started = false;
+        }
+        uint32_t frame[SENSOR_COUNT];
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            frame[i] = raw[i][row] < 0 ? 0 : raw[i][row];
+        }
+        crosstalk_estimator_add(estimator, frame);
+    }
+}
+
+static void print_replay(const char *name, const replay_t *replay)
+{
+    printf("%-14s %zu logged, %zu replayed, %zu matched within %lld ms, %zu extra; chords replayed as another: %llu sensors added, %llu lost\n",
+           name, replay->logged_total, replay->replayed_total, replay->matched_total, (long long)replay->tolerance_ms,
+           replay->replayed_total - replay->matched_total, (unsigned long long)replay->phantom_bits,
+           (unsigned long long)replay->dropped_bits);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-f iir|autocal] [-l press_level] [-a alone_fraction] [-m min_frames] [-t tolerance_ms] [-v] capture...\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    crosstalk_estimator_params params = crosstalk_estimator_default_params();
+    int64_t tolerance_ms = 50;
+    filter_handle_t (*make_filter)(void *) = make_iir_filter;
+    bool verbose = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:l:a:m:t:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            if (strcmp(optarg, "iir") != 0 && strcmp(optarg, "autocal") != 0)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            make_filter = strcmp(optarg, "autocal") == 0 ? make_autocal_filter : make_iir_filter;
+            break;
+        case 'l':
+            params.press_level = atof(optarg);
+            break;
+        case 'a':
+            params.alone_fraction = atof(optarg);
+            break;
+        case 'm':
+            params.min_frames = atoi(optarg);
+            break;
+        case 't':
+            tolerance_ms = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind == argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    replay_setup(false);
+    int capture_count = argc - optind;
+    char **paths = &argv[optind];
+    capture_t *captures = calloc(capture_count, sizeof(capture_t));
+    crosstalk_estimator estimator;
+    crosstalk_estimator_init(&estimator, &params);
+    for (int i = 0; i < capture_count; ++i)
+    {
+        capture_init(&captures[i]);
+        if (!capture_parse_file(&captures[i], paths[i]))
+        {
+            perror(paths[i]);
+            return 1;
+        }
+        estimate(&estimator, &captures[i]);
+    }
+
+    float coupling[(SENSOR_COUNT) * (SENSOR_COUNT)];
+    int estimated = crosstalk_estimator_coupling(&estimator, coupling);
+    printf("coupling: column j is how far each sensor moves per count sensor j moves alone\n");
+    printf("        ");
+    for (int j = 0; j < SENSOR_COUNT; ++j)
+    {
+        printf("%7d", j);
+    }
+    printf("\n");
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        printf("%6d  ", i);
+        for (int j = 0; j < SENSOR_COUNT; ++j)
+        {
+            printf("%7.3f", coupling[i * (SENSOR_COUNT) + j]);
+        }
+        printf("\n");
+    }
+    printf("frames  ");
+    for (int j = 0; j < SENSOR_COUNT; ++j)
+    {
+        printf("%7d", estimator.frames[j]);
+    }
+    printf("\n%d sensors estimated\n", estimated);
+
+    crosstalk_compensation compensation;
+    crosstalk_compensation_init(&compensation);
+    if (!crosstalk_estimator_finish(&estimator, &compensation))
+    {
+        printf("no compensation: no sensor had %d frames pressed alone, or the coupling is singular\n", params.min_frames);
+        return 1;
+    }
+
+    replay_t replay;
+    replay_init(&replay);
+    replay.make_filter = make_filter;
+    replay.tolerance_ms = tolerance_ms;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        crosstalk_compensation initial;
+        crosstalk_compensation_init(&initial);
+        pressure_sensor_set_crosstalk(pass ? &compensation : &initial);
+        replay_reset(&replay);
+        replay.report = verbose && pass ? stdout : NULL;
+        for (int i = 0; i < capture_count; ++i)
+        {
+            replay_capture(&replay, &captures[i], paths[i]);
+        }
+        print_replay(pass ? "compensated:" : "uncompensated:", &replay);
+    }
+    replay_free(&replay);
+
+    for (int i = 0; i < capture_count; ++i)
+    {
+        capture_free(&captures[i]);
+    }
+    free(captures);
+    return 0;
+}
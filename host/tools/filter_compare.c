@@ -0,0 +1,246 @@
+// Replays captures through the float IIR filter and the fixed-point one side by
+// side and compares them: press decisions frame by frame, presses per channel,
+// chords against the logged ENCODING events, and the cost of a frame on this
+// host. Both filters get the default iir_filter_params, without adaptive
+// thresholds, which only the float filter has, and the same frames and calibration.
+//
+//   filter_compare [-t tolerance_ms] capture...
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "constants.h"
+#include "filter.h"
+#include "iir_filter.h"
+#include "fixed_filter.h"
+
+#include "capture.h"
+#include "replay.h"
+
+typedef struct
+{
+    uint64_t frames;
+    uint64_t disagreements[SENSOR_COUNT];
+    uint64_t presses[2][SENSOR_COUNT];
+} comparison_t;
+
+// A filter that runs both and passes on the float filter's decisions.
+typedef struct
+{
+    filter_handle_t filters[2];
+    sensor_mask_t pressed[2];
+    comparison_t *comparison;
+} pair_t;
+
+static const char *filter_names[] = {"float", "fixed"};
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static filter_handle_t make_filter(int which)
+{
+    iir_filter_params params = iir_filter_default_params();
+    params.adaptive_thresholds = false;
+    return which == 0 ? init_iir_filter(&params) : init_fixed_filter(&params);
+}
+
+static void pair_process(filter_handle_t handle, uint32_t *adc_raw, sensor_mask_t *pressed)
+{
+    pair_t *pair = handle->filter_data;
+    comparison_t *comparison = pair->comparison;
+    for (int f = 0; f < 2; ++f)
+    {
+        sensor_mask_t last = pair->pressed[f];
+        pair->filters[f]->process(pair->filters[f], adc_raw, &pair->pressed[f]);
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            comparison->presses[f][i] += sensor_mask_test(pair->pressed[f] & ~last, i);
+        }
+    }
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        comparison->disagreements[i] += sensor_mask_test(pair->pressed[0] ^ pair->pressed[1], i);
+    }
+    comparison->frames++;
+    *pressed = pair->pressed[0];
+}
+
+static void pair_calibrate_start(filter_handle_t handle, uint32_t *adc_raw)
+{
+    pair_t *pair = handle->filter_data;
+    for (int f = 0; f < 2; ++f)
+    {
+        pair->filters[f]->calibrate_start(pair->filters[f], adc_raw);
+    }
+}
+
+static void pair_calibrate_end(filter_handle_t handle, uint32_t *adc_raw)
+{
+    pair_t *pair = handle->filter_data;
+    for (int f = 0; f < 2; ++f)
+    {
+        pair->filters[f]->calibrate_end(pair->filters[f], adc_raw);
+    }
+}
+
+static filter_handle_t make_pair(void *context)
+{
+    filter_handle_t handle = malloc(sizeof(filter));
+    pair_t *pair = calloc(1, sizeof(pair_t));
+    pair->filters[0] = make_filter(0);
+    pair->filters[1] = make_filter(1);
+    pair->comparison = context;
+    *handle = (filter){
+        .self = handle,
+        .process = pair_process,
+        .calibrate_start = pair_calibrate_start,
+        .calibrate_end = pair_calibrate_end,
+        .filter_data = pair,
+    };
+    return handle;
+}
+
+static void free_pair(filter_handle_t handle, void *context)
+{
+    pair_t *pair = handle->filter_data;
+    for (int f = 0; f < 2; ++f)
+    {
+        free(pair->filters[f]->filter_data);
+        free(pair->filters[f]);
+    }
+    free(pair);
+    free(handle);
+}
+
+static filter_handle_t make_fixed(void *context)
+{
+    return make_filter(1);
+}
+
+// Runs every logged frame straight through one filter, repeatedly.
+static double time_filter(int which, const capture_t *captures, int capture_count)
+{
+    uint64_t frames = 0;
+    int64_t elapsed_ns = 0;
+    for (int c = 0; c < capture_count; ++c)
+    {
+        const capture_table_t *sensor = &captures[c].sensor;
+        uint32_t *raw = malloc(sensor->rows * (SENSOR_COUNT) * sizeof(uint32_t));
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            char name[16];
+            snprintf(name, sizeof(name), "raw%d", i);
+            const int32_t *column = capture_column(sensor, name)->data;
+            for (size_t row = 0; row < sensor->rows; ++row)
+            {
+                raw[row * (SENSOR_COUNT) + i] = column[row] < 0 ? 0 : column[row];
+            }
+        }
+        for (int repeat = 0; repeat < 20; ++repeat)
+        {
+            filter_handle_t handle = make_filter(which);
+            sensor_mask_t pressed = 0;
+            int64_t t0 = now_ns();
+            for (size_t row = 0; row < sensor->rows; ++row)
+            {
+                handle->process(handle, &raw[row * (SENSOR_COUNT)], &pressed);
+            }
+            elapsed_ns += now_ns() - t0;
+            frames += sensor->rows;
+            free(handle->filter_data);
+            free(handle);
+        }
+        free(raw);
+    }
+    return frames ? (double)elapsed_ns / frames : 0;
+}
+
+int main(int argc, char **argv)
+{
+    int64_t tolerance_ms = 50;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            tolerance_ms = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t tolerance_ms] capture...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind == argc)
+    {
+        fprintf(stderr, "usage: %s [-t tolerance_ms] capture...\n", argv[0]);
+        return 1;
+    }
+
+    int capture_count = argc - optind;
+    char **paths = &argv[optind];
+    capture_t *captures = calloc(capture_count, sizeof(capture_t));
+    for (int i = 0; i < capture_count; ++i)
+    {
+        capture_init(&captures[i]);
+        if (!capture_parse_file(&captures[i], paths[i]))
+        {
+            perror(paths[i]);
+            return 1;
+        }
+    }
+
+    replay_setup(false);
+    comparison_t comparison = {0};
+    replay_t replays[2];
+    for (int f = 0; f < 2; ++f)
+    {
+        replay_init(&replays[f]);
+        replays[f].tolerance_ms = tolerance_ms;
+    }
+    // The float filter drives the pair; the fixed-point one is replayed on its own for its chords.
+    replays[0].make_filter = make_pair;
+    replays[0].free_filter = free_pair;
+    replays[0].filter_context = &comparison;
+    replays[1].make_filter = make_fixed;
+    for (int f = 0; f < 2; ++f)
+    {
+        for (int i = 0; i < capture_count; ++i)
+        {
+            replay_capture(&replays[f], &captures[i], paths[i]);
+        }
+    }
+
+    printf("%llu frames\n", (unsigned long long)comparison.frames);
+    printf("sensor  presses float  presses fixed  frames decided differently\n");
+    uint64_t total_disagreements = 0;
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        printf("%6d  %13llu  %13llu  %llu (%.3f%%)\n", i, (unsigned long long)comparison.presses[0][i],
+               (unsigned long long)comparison.presses[1][i], (unsigned long long)comparison.disagreements[i],
+               comparison.frames ? 100.0 * comparison.disagreements[i] / comparison.frames : 0.0);
+        total_disagreements += comparison.disagreements[i];
+    }
+    printf("decisions agree on %.3f%% of sensor frames\n",
+           comparison.frames ? 100.0 - 100.0 * total_disagreements / ((double)comparison.frames * (SENSOR_COUNT)) : 100.0);
+    for (int f = 0; f < 2; ++f)
+    {
+        printf("%s: chords %zu logged, %zu replayed, %zu matched within %lld ms; %.1f ns/frame on this host\n",
+               filter_names[f], replays[f].logged_total, replays[f].replayed_total, replays[f].matched_total,
+               (long long)tolerance_ms, time_filter(f, captures, capture_count));
+        replay_free(&replays[f]);
+    }
+
+    for (int i = 0; i < capture_count; ++i)
+    {
+        capture_free(&captures[i]);
+    }
+    free(captures);
+    return 0;
+}
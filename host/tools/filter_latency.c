@@ -0,0 +1,455 @@
+// Reports the delay an iir_filter_params configuration puts between a press
+// and the key going down. For each sensor it prints the biquad's group delay at
+// a few frequencies, then the detection latency measured by running the
+// firmware's filter over synthetic presses: linear ramps of a given amplitude
+// and rise time on a noisy baseline, after the usual boot calibration on idle
+// noise. Holdable sensors also get the latency of their release. With
+// captures, it also replays them (replay.h) and reports matched chords and
+// press-to-accept latency; -v lists the chords that did not match.
+//
+// -w name=value (same names as -p) swaps those parameters into the running
+// filter (filter.reconfigure) in the idle gap before the middle press, keeping
+// the calibrated thresholds: the presses after it use the new coefficients, and
+// a swap that upsets the filter shows up as false presses. A new response
+// recalibrates instead, over the presses that follow, so those show up missed.
+//
+//   filter_latency [-a amplitude] [-r rise_ms] [-s noise] [-n presses] [-p name=value]... [-w name=value]... [-t tolerance_ms] [-v] [capture...]
+#include <complex.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "constants.h"
+#include "filter.h"
+#include "iir_filter.h"
+
+#include "capture.h"
+#include "replay.h"
+
+#define BASELINE 150
+#define HOLD_MS 300
+#define IDLE_MS 1000
+// Presses that start this soon after a release are its tail, not false presses.
+#define SETTLE_MS 200
+
+static const float delay_frequencies[] = {0.5f, 1, 2, 5, 10};
+#define DELAY_FREQUENCIES (sizeof(delay_frequencies) / sizeof(delay_frequencies[0]))
+
+typedef struct
+{
+    int presses;
+    int missed;
+    int false_presses;
+    int *press_ms;
+    int *release_ms;
+    int releases;
+} sensor_result_t;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+
+static double uniform(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return ((rng_state >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static double gaussian(void)
+{
+    return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+}
+
+// Group delay in samples of c[0] + c[1] z^-1 + c[2] z^-2 at w radians per sample.
+static double polynomial_delay(const double *c, double w)
+{
+    double complex sum = 0, weighted = 0;
+    for (int k = 0; k < 3; ++k)
+    {
+        double complex term = c[k] * cexp(-I * w * k);
+        sum += term;
+        weighted += k * term;
+    }
+    return creal(weighted / sum);
+}
+
+static double group_delay_ms(const iir_filter_params *params, int sensor, float frequency)
+{
+    float coeffs[5];
+    iir_filter_coefficients(params, sensor, coeffs);
+    double numerator[3] = {coeffs[0], coeffs[1], coeffs[2]};
+    double denominator[3] = {1, coeffs[3], coeffs[4]};
+    double w = 2 * M_PI * frequency / params->sample_rate;
+    return (polynomial_delay(numerator, w) - polynomial_delay(denominator, w)) * 1000 / params->sample_rate;
+}
+
+static int compare_int(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+static uint32_t reading(float level, float noise)
+{
+    double value = BASELINE + level + noise * gaussian();
+    return value < 0 ? 0 : (uint32_t)lround(value);
+}
+
+// Presses every sensor at once, n times, and times each sensor's decisions.
+static void measure(const iir_filter_params *params, const iir_filter_params *swap, float amplitude, int rise_ms,
+                    float noise, int n, sensor_result_t *results)
+{
+    filter_handle_t filter = init_iir_filter((iir_filter_params *)params);
+    const int frame_ms = 1000 / params->sample_rate;
+    const int rise = rise_ms / frame_ms > 0 ? rise_ms / frame_ms : 1;
+    const int hold = HOLD_MS / frame_ms;
+    const int idle = IDLE_MS / frame_ms;
+    const int settle = SETTLE_MS / frame_ms;
+    sensor_mask_t pressed = 0;
+    uint32_t raw[SENSOR_COUNT];
+
+    // Boot calibration on idle noise, then a second to settle.
+    int boot = (params->calibration_time_seconds + 3) * params->sample_rate;
+    for (int frame = 0; frame < boot; ++frame)
+    {
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            raw[i] = reading(0, noise);
+        }
+        filter->process(filter, raw, &pressed);
+    }
+
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        results[i] = (sensor_result_t){
+            .press_ms = calloc(n, sizeof(int)),
+            .release_ms = calloc(n, sizeof(int)),
+        };
+    }
+    for (int press = 0; press < n; ++press)
+    {
+        int pressed_at[SENSOR_COUNT];
+        int released_at[SENSOR_COUNT];
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            pressed_at[i] = -1;
+            released_at[i] = -1;
+        }
+        // Rise, hold, fall, then idle.
+        int length = 2 * rise + hold + idle;
+        for (int k = 0; k < length; ++k)
+        {
+            float level;
+            if (k < rise)
+            {
+                level = amplitude * (k + 1) / rise;
+            }
+            else if (k < rise + hold)
+            {
+                level = amplitude;
+            }
+            else if (k < 2 * rise + hold)
+            {
+                level = amplitude * (2 * rise + hold - k - 1) / rise;
+            }
+            else
+            {
+                level = 0;
+            }
+            if (swap && press == n / 2 - 1 && k == 2 * rise + hold + settle)
+            {
+                filter->reconfigure(filter, swap);
+            }
+            for (int i = 0; i < SENSOR_COUNT; ++i)
+            {
+                raw[i] = reading(level, noise);
+            }
+            sensor_mask_t was_pressed = pressed;
+            filter->process(filter, raw, &pressed);
+            for (int i = 0; i < SENSOR_COUNT; ++i)
+            {
+                bool down = sensor_mask_test(pressed & ~was_pressed, i);
+                if (down && pressed_at[i] < 0 && k < rise + hold)
+                {
+                    pressed_at[i] = k;
+                }
+                else if (down && k >= 2 * rise + hold + settle)
+                {
+                    results[i].false_presses++;
+                }
+                if (sensor_mask_test(~pressed & was_pressed, i) && released_at[i] < 0 && k >= rise + hold)
+                {
+                    released_at[i] = k - (rise + hold);
+                }
+            }
+        }
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            sensor_result_t *result = &results[i];
+            if (pressed_at[i] < 0)
+            {
+                result->missed++;
+                continue;
+            }
+            result->press_ms[result->presses++] = (pressed_at[i] + 1) * frame_ms;
+            if (params->holdable[i] && released_at[i] >= 0)
+            {
+                result->release_ms[result->releases++] = (released_at[i] + 1) * frame_ms;
+            }
+        }
+    }
+    free(filter->filter_data);
+    free(filter);
+}
+
+static filter_handle_t make_filter(void *context)
+{
+    return init_iir_filter(context);
+}
+
+static bool parse_response(const char *value, iir_filter_response *response)
+{
+    if (strcmp(value, "band-pass") == 0)
+    {
+        *response = IIR_FILTER_BAND_PASS;
+        return true;
+    }
+    if (strcmp(value, "onset") == 0)
+    {
+        *response = IIR_FILTER_ONSET;
+        return true;
+    }
+    return false;
+}
+
+// name=value. freq, q and response set the normal sensors, held_freq, held_q
+// and held_response the holdable ones.
+static bool parse_param(iir_filter_params *params, const char *arg)
+{
+    char name[32];
+    const char *equals = strchr(arg, '=');
+    if (!equals || equals - arg >= (int)sizeof(name))
+    {
+        return false;
+    }
+    memcpy(name, arg, equals - arg);
+    name[equals - arg] = '\0';
+    const char *value = equals + 1;
+    char *end;
+    float number = strtof(value, &end);
+    bool numeric = end != value && !*end;
+
+    bool held = strncmp(name, "held_", 5) == 0;
+    const char *field = held ? name + 5 : name;
+    iir_filter_response response;
+    if (strcmp(field, "freq") == 0 || strcmp(field, "q") == 0 || strcmp(field, "response") == 0)
+    {
+        bool is_response = strcmp(field, "response") == 0;
+        if (is_response ? !parse_response(value, &response) : !numeric)
+        {
+            return false;
+        }
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            if (params->holdable[i] != held)
+            {
+                continue;
+            }
+            if (is_response)
+            {
+                params->response[i] = response;
+            }
+            else if (field[0] == 'f')
+            {
+                params->target_frequency[i] = number;
+            }
+            else
+            {
+                params->qfactor[i] = number;
+            }
+        }
+        return true;
+    }
+    if (held || !numeric)
+    {
+        return false;
+    }
+    if (strcmp(name, "multiplier") == 0)
+    {
+        params->calibration_peak_multiplier = number;
+    }
+    else if (strcmp(name, "debounce") == 0)
+    {
+        params->debounce_count = (int)number;
+    }
+    else if (strcmp(name, "min_threshold") == 0)
+    {
+        params->min_threshold = number;
+    }
+    else if (strcmp(name, "adaptive") == 0)
+    {
+        params->adaptive_thresholds = number != 0;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-a amplitude] [-r rise_ms] [-s noise] [-n presses] [-p name=value]... [-w name=value]... [-t tolerance_ms] [-v] [capture...]\n", name);
+    fprintf(stderr, "parameters, starting from iir_filter_default_params() for -p and from those for -w:\n");
+    fprintf(stderr, "  freq, held_freq          target_frequency of normal and holdable sensors\n");
+    fprintf(stderr, "  q, held_q                qfactor\n");
+    fprintf(stderr, "  response, held_response  band-pass or onset\n");
+    fprintf(stderr, "  multiplier, debounce, min_threshold, adaptive (0 or 1)\n");
+}
+
+int main(int argc, char **argv)
+{
+    iir_filter_params params = iir_filter_default_params();
+    float amplitude = 300;
+    int rise_ms = 80;
+    float noise = 6;
+    int presses = 50;
+    int64_t tolerance_ms = 50;
+    bool verbose = false;
+    // -w applies on top of -p wherever they come on the command line.
+    const char *swap_args[argc];
+    int swaps = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:r:s:n:p:w:t:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'a':
+            amplitude = atof(optarg);
+            break;
+        case 'r':
+            rise_ms = atoi(optarg);
+            break;
+        case 's':
+            noise = atof(optarg);
+            break;
+        case 'n':
+            presses = atoi(optarg);
+            break;
+        case 'p':
+            if (!parse_param(&params, optarg))
+            {
+                fprintf(stderr, "bad parameter %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'w':
+            swap_args[swaps++] = optarg;
+            break;
+        case 't':
+            tolerance_ms = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (presses < 1 || rise_ms < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    iir_filter_params swap = params;
+    for (int i = 0; i < swaps; ++i)
+    {
+        if (!parse_param(&swap, swap_args[i]))
+        {
+            fprintf(stderr, "bad parameter %s\n", swap_args[i]);
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    replay_setup(false);
+
+    sensor_result_t results[SENSOR_COUNT];
+    measure(&params, swaps ? &swap : NULL, amplitude, rise_ms, noise, presses, results);
+
+    printf("%d presses of %g counts rising over %d ms, noise %g counts rms\n", presses, amplitude, rise_ms, noise);
+    if (swaps)
+    {
+        printf("parameters swapped before press %d; responses and delays below are from before the swap\n", presses / 2 + 1);
+    }
+    printf("sensor  response   freq     q  group delay ms at");
+    for (size_t f = 0; f < DELAY_FREQUENCIES; ++f)
+    {
+        printf(" %4g Hz", delay_frequencies[f]);
+    }
+    printf("  press ms median/max  missed  false  release ms median/max\n");
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        sensor_result_t *result = &results[i];
+        printf("%6d  %-9s %5g %5g %18s", i, params.response[i] == IIR_FILTER_ONSET ? "onset" : "band-pass",
+               params.target_frequency[i], params.qfactor[i], "");
+        for (size_t f = 0; f < DELAY_FREQUENCIES; ++f)
+        {
+            printf(" %7.1f", group_delay_ms(&params, i, delay_frequencies[f]));
+        }
+        if (result->presses)
+        {
+            qsort(result->press_ms, result->presses, sizeof(int), compare_int);
+            printf("  %10d/%-9d", result->press_ms[result->presses / 2], result->press_ms[result->presses - 1]);
+        }
+        else
+        {
+            printf("  %20s", "-");
+        }
+        printf("  %6d  %5d", result->missed, result->false_presses);
+        if (result->releases)
+        {
+            qsort(result->release_ms, result->releases, sizeof(int), compare_int);
+            printf("  %10d/%d", result->release_ms[result->releases / 2], result->release_ms[result->releases - 1]);
+        }
+        printf("\n");
+        free(result->press_ms);
+        free(result->release_ms);
+    }
+
+    if (optind == argc)
+    {
+        return 0;
+    }
+    replay_t replay;
+    replay_init(&replay);
+    replay.make_filter = make_filter;
+    replay.filter_context = &params;
+    replay.tolerance_ms = tolerance_ms;
+    replay.report = verbose ? stdout : NULL;
+    for (int i = optind; i < argc; ++i)
+    {
+        capture_t capture;
+        capture_init(&capture);
+        if (!capture_parse_file(&capture, argv[i]))
+        {
+            perror(argv[i]);
+            return 1;
+        }
+        replay_capture(&replay, &capture, argv[i]);
+        capture_free(&capture);
+    }
+    printf("captures: %zu chords logged, %zu replayed, %zu matched within %lld ms", replay.logged_total,
+           replay.replayed_total, replay.matched_total, (long long)replay.tolerance_ms);
+    if (replay.matched_total)
+    {
+        printf(", press to accept %.1f ms mean", replay.matched_latency_us / 1e3 / replay.matched_total);
+    }
+    printf("\n");
+    replay_free(&replay);
+    return 0;
+}
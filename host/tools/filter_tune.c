@@ -0,0 +1,467 @@
+// Searches iir_filter_params for the values that best reproduce the chords typed
+// in a set of captures. Every combination of the swept parameters is replayed
+// through the firmware (replay.h) against the captures' ENCODING events, spread
+// over one worker process per core. Candidates are ranked by F1 score of the
+// replayed chords against the logged ones, then by mean press-to-accept latency.
+// The best one is printed as a C initializer and as a remote-config payload.
+//
+//   filter_tune [-j workers] [-t tolerance_ms] [-n top] [-p name=values]... capture...
+//
+// values is a list (2,5,10) or a range (1:4:0.5); sweeps holds the parameters and
+// the values tried by default.
+#include <getopt.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "constants.h"
+#include "filter.h"
+#include "iir_filter.h"
+
+#include "capture.h"
+#include "replay.h"
+
+#define MAX_VALUES 64
+
+typedef enum
+{
+    PARAM_FREQ,
+    PARAM_HELD_FREQ,
+    PARAM_Q,
+    PARAM_HELD_Q,
+    PARAM_MULTIPLIER,
+    PARAM_DEBOUNCE,
+    PARAM_MIN_THRESHOLD,
+    PARAM_COUNT,
+} param_t;
+
+typedef struct
+{
+    const char *name;
+    const char *description;
+    const char *default_values;
+    int count;
+    float values[MAX_VALUES];
+} sweep_t;
+
+static sweep_t sweeps[PARAM_COUNT] = {
+    [PARAM_FREQ] = {"freq", "target_frequency of normal sensors", "1,1.5,2,3,4"},
+    [PARAM_HELD_FREQ] = {"held_freq", "target_frequency of holdable sensors", "10"},
+    [PARAM_Q] = {"q", "qfactor of normal sensors", "0.25,0.5,1"},
+    [PARAM_HELD_Q] = {"held_q", "qfactor of holdable sensors", "0.5"},
+    [PARAM_MULTIPLIER] = {"multiplier", "calibration_peak_multiplier", "1.5,2,2.5,3,4"},
+    [PARAM_DEBOUNCE] = {"debounce", "debounce_count", "2,4,6"},
+    [PARAM_MIN_THRESHOLD] = {"min_threshold", "min_threshold", "1,10,50"},
+};
+
+typedef struct
+{
+    uint32_t candidate;
+    uint32_t logged;
+    uint32_t replayed;
+    uint32_t matched;
+    int64_t latency_us;
+} result_t;
+
+// Shared between the workers: each claims the next candidate and fills its result.
+typedef struct
+{
+    _Atomic uint32_t next;
+    _Atomic uint32_t done;
+    result_t results[];
+} work_t;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool parse_values(sweep_t *sweep, const char *spec)
+{
+    float start, stop, step;
+    if (sscanf(spec, "%f:%f:%f", &start, &stop, &step) == 3)
+    {
+        if (step <= 0 || stop < start)
+        {
+            return false;
+        }
+        sweep->count = 0;
+        for (int i = 0; sweep->count < MAX_VALUES; ++i)
+        {
+            float value = start + i * step;
+            if (value > stop + step * 1e-3f)
+            {
+                break;
+            }
+            sweep->values[sweep->count++] = value;
+        }
+        return true;
+    }
+    sweep->count = 0;
+    const char *p = spec;
+    while (*p && sweep->count < MAX_VALUES)
+    {
+        char *end;
+        sweep->values[sweep->count++] = strtof(p, &end);
+        if (end == p || (*end && *end != ','))
+        {
+            return false;
+        }
+        p = *end ? end + 1 : end;
+    }
+    return sweep->count > 0 && !*p;
+}
+
+static bool parse_sweep(const char *arg)
+{
+    const char *equals = strchr(arg, '=');
+    if (!equals)
+    {
+        return false;
+    }
+    for (int i = 0; i < PARAM_COUNT; ++i)
+    {
+        if (strlen(sweeps[i].name) == (size_t)(equals - arg) && strncmp(arg, sweeps[i].name, equals - arg) == 0)
+        {
+            return parse_values(&sweeps[i], equals + 1);
+        }
+    }
+    return false;
+}
+
+static uint32_t candidate_count(void)
+{
+    uint32_t count = 1;
+    for (int i = 0; i < PARAM_COUNT; ++i)
+    {
+        count *= sweeps[i].count;
+    }
+    return count;
+}
+
+// Candidate index to parameter values, the first parameter varying slowest.
+static void candidate_values(uint32_t candidate, float *values)
+{
+    for (int i = PARAM_COUNT - 1; i >= 0; --i)
+    {
+        values[i] = sweeps[i].values[candidate % sweeps[i].count];
+        candidate /= sweeps[i].count;
+    }
+}
+
+static iir_filter_params candidate_params(uint32_t candidate)
+{
+    float values[PARAM_COUNT];
+    candidate_values(candidate, values);
+    iir_filter_params params = iir_filter_default_params();
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        params.target_frequency[i] = params.holdable[i] ? values[PARAM_HELD_FREQ] : values[PARAM_FREQ];
+        params.qfactor[i] = params.holdable[i] ? values[PARAM_HELD_Q] : values[PARAM_Q];
+    }
+    params.calibration_peak_multiplier = values[PARAM_MULTIPLIER];
+    params.debounce_count = (int)values[PARAM_DEBOUNCE];
+    params.min_threshold = values[PARAM_MIN_THRESHOLD];
+    return params;
+}
+
+static filter_handle_t make_candidate_filter(void *context)
+{
+    return init_iir_filter((iir_filter_params *)context);
+}
+
+static void run_worker(work_t *work, uint32_t count, capture_t *captures, char **paths, int capture_count, int64_t tolerance_ms)
+{
+    replay_setup(false);
+    replay_t replay;
+    replay_init(&replay);
+    replay.tolerance_ms = tolerance_ms;
+    replay.make_filter = make_candidate_filter;
+
+    uint32_t candidate;
+    while ((candidate = atomic_fetch_add(&work->next, 1)) < count)
+    {
+        iir_filter_params params = candidate_params(candidate);
+        replay.filter_context = &params;
+        replay_reset(&replay);
+        for (int i = 0; i < capture_count; ++i)
+        {
+            replay_capture(&replay, &captures[i], paths[i]);
+        }
+        work->results[candidate] = (result_t){
+            .candidate = candidate,
+            .logged = replay.logged_total,
+            .replayed = replay.replayed_total,
+            .matched = replay.matched_total,
+            .latency_us = replay.matched_total ? replay.matched_latency_us / (int64_t)replay.matched_total : 0,
+        };
+        atomic_fetch_add(&work->done, 1);
+    }
+    replay_free(&replay);
+}
+
+static double f1_score(const result_t *result)
+{
+    uint32_t total = result->logged + result->replayed;
+    return total ? 2.0 * result->matched / total : 1.0;
+}
+
+static int compare_results(const void *a, const void *b)
+{
+    const result_t *x = a;
+    const result_t *y = b;
+    double fx = f1_score(x);
+    double fy = f1_score(y);
+    if (fx != fy)
+    {
+        return fx > fy ? -1 : 1;
+    }
+    if (x->latency_us != y->latency_us)
+    {
+        return x->latency_us < y->latency_us ? -1 : 1;
+    }
+    return x->candidate < y->candidate ? -1 : 1;
+}
+
+static void print_float_array(const char *name, const float *values)
+{
+    printf("    .%s = {", name);
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        printf("%s%g", i ? ", " : "", values[i]);
+    }
+    printf("},\n");
+}
+
+static void print_initializer(const iir_filter_params *params)
+{
+    printf("static iir_filter_params default_filter_params = {\n");
+    printf("    .sample_rate = SENSOR_FRAME_RATE_HZ,\n");
+    print_float_array("target_frequency", params->target_frequency);
+    print_float_array("qfactor", params->qfactor);
+    printf("    .holdable = {");
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        printf("%s%d", i ? ", " : "", params->holdable[i]);
+    }
+    printf("},\n");
+    printf("    .calibration_peak_multiplier = %g,\n", params->calibration_peak_multiplier);
+    printf("    .calibration_time_seconds = %g,\n", params->calibration_time_seconds);
+    printf("    .debounce_count = %d,\n", params->debounce_count);
+    printf("    .min_threshold = %g};\n", params->min_threshold);
+}
+
+// The remote-config service takes one byte per value, each divided by a shared
+// denominator. Picks the denominator that represents the values most closely.
+static void print_remote_config(const float *values)
+{
+    static const char *names[] = {"nf", "nq", "hf", "hq"};
+    const float wanted[] = {values[PARAM_FREQ], values[PARAM_Q], values[PARAM_HELD_FREQ], values[PARAM_HELD_Q]};
+    int best_denominator = 0;
+    float best_error = INFINITY;
+    for (int denominator = 1; denominator <= 255; ++denominator)
+    {
+        float error = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            float numerator = roundf(wanted[i] * denominator);
+            if (numerator < 1 || numerator > 255)
+            {
+                error = INFINITY;
+                break;
+            }
+            error = fmaxf(error, fabsf(numerator / denominator - wanted[i]) / wanted[i]);
+        }
+        // Strictly better only, so the smallest exact denominator wins.
+        if (error < best_error - 1e-6f)
+        {
+            best_error = error;
+            best_denominator = denominator;
+        }
+    }
+    if (!best_denominator)
+    {
+        printf("not representable: each value times a denominator up to 255 must fit in a byte\n");
+        return;
+    }
+    printf("characteristic  value\n");
+    for (int i = 0; i < 4; ++i)
+    {
+        int numerator = (int)roundf(wanted[i] * best_denominator);
+        printf("lilypawsconf.%-3s %5d  (%g)\n", names[i], numerator, (float)numerator / best_denominator);
+    }
+    printf("lilypawsconf.den %5d\n", best_denominator);
+    if (best_error > 1e-6f)
+    {
+        printf("closest representation is %.1f%% off\n", best_error * 100);
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-j workers] [-t tolerance_ms] [-n top] [-p name=values]... capture...\n", name);
+    fprintf(stderr, "values is a list (2,5,10) or a range (1:4:0.5); parameters:\n");
+    for (int i = 0; i < PARAM_COUNT; ++i)
+    {
+        fprintf(stderr, "  %-14s %-38s default %s\n", sweeps[i].name, sweeps[i].description, sweeps[i].default_values);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 0; i < PARAM_COUNT; ++i)
+    {
+        parse_values(&sweeps[i], sweeps[i].default_values);
+    }
+    long workers = sysconf(_SC_NPROCESSORS_ONLN);
+    int64_t tolerance_ms = 50;
+    int top = 10;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:t:n:p:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j':
+            workers = atoi(optarg);
+            break;
+        case 't':
+            tolerance_ms = atoi(optarg);
+            break;
+        case 'n':
+            top = atoi(optarg);
+            break;
+        case 'p':
+            if (!parse_sweep(optarg))
+            {
+                fprintf(stderr, "bad sweep %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind == argc || workers < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int capture_count = argc - optind;
+    char **paths = &argv[optind];
+    capture_t *captures = calloc(capture_count, sizeof(capture_t));
+    size_t logged = 0;
+    for (int i = 0; i < capture_count; ++i)
+    {
+        capture_init(&captures[i]);
+        if (!capture_parse_file(&captures[i], paths[i]))
+        {
+            perror(paths[i]);
+            return 1;
+        }
+        logged += captures[i].encoding.rows;
+    }
+    if (!logged)
+    {
+        fprintf(stderr, "no ENCODING events to score against\n");
+        return 1;
+    }
+
+    uint32_t count = candidate_count();
+    workers = workers > count ? count : workers;
+    size_t work_size = sizeof(work_t) + count * sizeof(result_t);
+    // The firmware's state is global, so workers are processes rather than threads.
+    work_t *work = mmap(NULL, work_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (work == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+    atomic_init(&work->next, 0);
+    atomic_init(&work->done, 0);
+
+    fprintf(stderr, "%u candidates over %ld workers\n", count, workers);
+    int64_t t0 = now_ns();
+    for (long w = 0; w < workers; ++w)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("fork");
+            return 1;
+        }
+        if (pid == 0)
+        {
+            run_worker(work, count, captures, paths, capture_count, tolerance_ms);
+            _exit(0);
+        }
+    }
+    bool failed = false;
+    int status;
+    while (wait(&status) > 0)
+    {
+        failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    int64_t elapsed_ns = now_ns() - t0;
+    if (failed || atomic_load(&work->done) != count)
+    {
+        fprintf(stderr, "a worker failed; %u of %u candidates scored\n", atomic_load(&work->done), count);
+        return 1;
+    }
+    fprintf(stderr, "scored in %.2f s, %.2f ms per candidate per core\n", elapsed_ns / 1e9,
+            elapsed_ns / 1e6 * workers / count);
+
+    qsort(work->results, count, sizeof(result_t), compare_results);
+    printf("%-4s %6s %9s %6s %10s", "rank", "f1", "matched", "extra", "latency");
+    for (int i = 0; i < PARAM_COUNT; ++i)
+    {
+        printf(" %*s", (int)(strlen(sweeps[i].name) > 6 ? strlen(sweeps[i].name) : 6), sweeps[i].name);
+    }
+    printf("\n");
+    for (uint32_t r = 0; r < count && r < (uint32_t)top; ++r)
+    {
+        const result_t *result = &work->results[r];
+        float values[PARAM_COUNT];
+        candidate_values(result->candidate, values);
+        printf("%-4u %6.3f %4u/%-4u %6u %7.1f ms", r + 1, f1_score(result), result->matched, result->logged,
+               result->replayed - result->matched, result->latency_us / 1e3);
+        for (int i = 0; i < PARAM_COUNT; ++i)
+        {
+            printf(" %*g", (int)(strlen(sweeps[i].name) > 6 ? strlen(sweeps[i].name) : 6), values[i]);
+        }
+        printf("\n");
+    }
+
+    const result_t *best = &work->results[0];
+    iir_filter_params params = candidate_params(best->candidate);
+    float values[PARAM_COUNT];
+    candidate_values(best->candidate, values);
+    printf("\n");
+    print_initializer(&params);
+    printf("\n");
+    print_remote_config(values);
+    iir_filter_params remote = iir_filter_default_params();
+    if (params.calibration_peak_multiplier != remote.calibration_peak_multiplier ||
+        params.debounce_count != remote.debounce_count || params.min_threshold != remote.min_threshold)
+    {
+        printf("remote config only sets frequencies and Q factors; multiplier, debounce and min_threshold need the initializer\n");
+    }
+
+    munmap(work, work_size);
+    for (int i = 0; i < capture_count; ++i)
+    {
+        capture_free(&captures[i]);
+    }
+    free(captures);
+    return 0;
+}
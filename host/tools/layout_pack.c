@@ -0,0 +1,359 @@
+// Builds a layout blob (main/layout.h) from a text description, for NVS or the
+// remote-config service, and checks it the way the firmware will.
+//
+//   # comment
+//   layer alpha          starts a layer; the first one is typed with no modifiers
+//   1 a                  chord (1 to 31) and key, with modifiers: 17 shift+1
+//   select numeric 5     the layer typed while sensors 5.. are held; with several
+//                        rules held at once, the one with the most sensors wins
+//   modifier 6 shift     sensor 6 adds shift (shift, ctrl, alt, gui)
+//   passkey numeric      the layer typed while the host asks for a passkey
+//
+// Keys are letters, digits, names (space, enter, return, backspace, tab, escape,
+// caps, minus, equal, lbracket, rbracket, backslash, semicolon, quote, grave,
+// comma, dot, slash, left, right, up, down, home, end, pageup, pagedown, insert,
+// deletefwd, f1 to f12) or a HID code in hex (0x2c).
+//
+// -o writes the blob, header included, for nvs_partition_gen (key LAYOUT_KEY in
+// namespace FILTER_STORE_NAMESPACE). -r prints the remote-config writes that
+// upload it. util/default.layout describes the built-in layout.
+//
+//   layout_pack [-o layout.bin] [-r] layout.txt
+#include <ctype.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "layout.h"
+
+#define REMOTE_PIECE 128
+
+typedef struct
+{
+    const char *name;
+    keyboard_cmd_t hid;
+} key_name;
+
+static const key_name key_names[] = {
+    {"space", HID_KEY_SPACEBAR},      {"enter", HID_KEY_ENTER},         {"return", HID_KEY_RETURN},
+    {"backspace", HID_KEY_DELETE},    {"tab", HID_KEY_TAB},             {"escape", HID_KEY_ESCAPE},
+    {"caps", HID_KEY_CAPS_LOCK},      {"minus", HID_KEY_MINUS},         {"equal", HID_KEY_EQUAL},
+    {"lbracket", HID_KEY_LEFT_BRKT},  {"rbracket", HID_KEY_RIGHT_BRKT}, {"backslash", HID_KEY_BACK_SLASH},
+    {"semicolon", HID_KEY_SEMI_COLON}, {"quote", HID_KEY_SGL_QUOTE},    {"grave", HID_KEY_GRV_ACCENT},
+    {"comma", HID_KEY_COMMA},         {"dot", HID_KEY_DOT},             {"slash", HID_KEY_FWD_SLASH},
+    {"left", HID_KEY_LEFT_ARROW},     {"right", HID_KEY_RIGHT_ARROW},   {"up", HID_KEY_UP_ARROW},
+    {"down", HID_KEY_DOWN_ARROW},     {"home", HID_KEY_HOME},           {"end", HID_KEY_END},
+    {"pageup", HID_KEY_PAGE_UP},      {"pagedown", HID_KEY_PAGE_DOWN},  {"insert", HID_KEY_INSERT},
+    {"deletefwd", HID_KEY_DELETE_FWD},
+};
+
+static const key_name modifier_names[] = {
+    {"shift", LEFT_SHIFT_KEY_MASK},
+    {"ctrl", LEFT_CONTROL_KEY_MASK},
+    {"alt", LEFT_ALT_KEY_MASK},
+    {"gui", LEFT_GUI_KEY_MASK},
+};
+
+typedef struct
+{
+    int layer;
+    int sensors;
+} select_rule;
+
+typedef struct
+{
+    char names[LAYOUT_MAX_LAYERS][32];
+    int layer_count;
+    select_rule selects[LAYOUT_MODIFIER_CHORDS];
+    int select_count;
+    key_mask_t sensor_modifiers[MODIFIER_SENSOR_COUNT];
+    int passkey_layer;
+    union
+    {
+        layout_blob blob;
+        uint8_t bytes[LAYOUT_BLOB_SIZE(LAYOUT_MAX_LAYERS)];
+    } body;
+} layout_source;
+
+static int find_name(const key_name *names, int count, const char *name)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        if (strcasecmp(names[i].name, name) == 0)
+        {
+            return names[i].hid;
+        }
+    }
+    return -1;
+}
+
+static bool parse_key(char *text, layout_key *key)
+{
+    key->modifiers = 0;
+    char *plus;
+    while ((plus = strchr(text, '+')) && plus[1])
+    {
+        *plus = '\0';
+        int modifier = find_name(modifier_names, sizeof(modifier_names) / sizeof(modifier_names[0]), text);
+        if (modifier < 0)
+        {
+            return false;
+        }
+        key->modifiers |= modifier;
+        text = plus + 1;
+    }
+    int hid = -1;
+    if (strlen(text) == 1 && isalpha((unsigned char)text[0]))
+    {
+        hid = HID_KEY_A + tolower((unsigned char)text[0]) - 'a';
+    }
+    else if (strlen(text) == 1 && isdigit((unsigned char)text[0]))
+    {
+        hid = text[0] == '0' ? HID_KEY_0 : HID_KEY_1 + text[0] - '1';
+    }
+    else if ((text[0] == 'f' || text[0] == 'F') && atoi(text + 1) >= 1 && atoi(text + 1) <= 12)
+    {
+        hid = HID_KEY_F1 + atoi(text + 1) - 1;
+    }
+    else if (strncmp(text, "0x", 2) == 0)
+    {
+        char *end;
+        long code = strtol(text, &end, 16);
+        hid = *end || code <= 0 || code > 255 ? -1 : code;
+    }
+    else
+    {
+        hid = find_name(key_names, sizeof(key_names) / sizeof(key_names[0]), text);
+    }
+    key->hid = hid < 0 ? 0 : hid;
+    return hid >= 0;
+}
+
+static int find_layer(const layout_source *source, const char *name)
+{
+    for (int l = 0; l < source->layer_count; ++l)
+    {
+        if (strcmp(source->names[l], name) == 0)
+        {
+            return l;
+        }
+    }
+    return -1;
+}
+
+static int parse_sensor(const char *text)
+{
+    char *end;
+    long sensor = strtol(text, &end, 10);
+    return *end || sensor < ENCODING_SENSOR_COUNT || sensor >= (SENSOR_COUNT) ? -1 : sensor - ENCODING_SENSOR_COUNT;
+}
+
+static bool parse_line(layout_source *source, char *line, const char **error)
+{
+    char *words[8];
+    int count = 0;
+    for (char *word = strtok(line, " \t\r\n"); word && count < 8; word = strtok(NULL, " \t\r\n"))
+    {
+        words[count++] = word;
+    }
+    if (count == 0)
+    {
+        return true;
+    }
+    if (strcmp(words[0], "layer") == 0 && count == 2)
+    {
+        if (source->layer_count == LAYOUT_MAX_LAYERS || find_layer(source, words[1]) >= 0)
+        {
+            *error = "too many layers, or a name used twice";
+            return false;
+        }
+        snprintf(source->names[source->layer_count++], sizeof(source->names[0]), "%s", words[1]);
+        return true;
+    }
+    if (strcmp(words[0], "select") == 0 && count >= 3)
+    {
+        select_rule rule = {.layer = find_layer(source, words[1])};
+        for (int w = 2; w < count; ++w)
+        {
+            int sensor = parse_sensor(words[w]);
+            if (sensor < 0)
+            {
+                *error = "modifier sensors are 5 to 9";
+                return false;
+            }
+            rule.sensors |= 1 << sensor;
+        }
+        if (rule.layer < 0 || source->select_count == LAYOUT_MODIFIER_CHORDS)
+        {
+            *error = "select names a layer not defined above";
+            return false;
+        }
+        source->selects[source->select_count++] = rule;
+        return true;
+    }
+    if (strcmp(words[0], "modifier") == 0 && count == 3)
+    {
+        int sensor = parse_sensor(words[1]);
+        int modifier = find_name(modifier_names, sizeof(modifier_names) / sizeof(modifier_names[0]), words[2]);
+        if (sensor < 0 || modifier < 0)
+        {
+            *error = "modifier takes a sensor from 5 to 9 and shift, ctrl, alt or gui";
+            return false;
+        }
+        source->sensor_modifiers[sensor] |= modifier;
+        return true;
+    }
+    if (strcmp(words[0], "passkey") == 0 && count == 2)
+    {
+        source->passkey_layer = find_layer(source, words[1]);
+        *error = "passkey names a layer not defined above";
+        return source->passkey_layer >= 0;
+    }
+    char *end;
+    long chord = strtol(words[0], &end, 10);
+    if (!*end && count == 2)
+    {
+        if (!source->layer_count || chord < 1 || chord >= LAYOUT_CHORDS)
+        {
+            *error = "chords are 1 to 31, after a layer line";
+            return false;
+        }
+        *error = "unknown key";
+        return parse_key(words[1], &source->body.blob.keys[source->layer_count - 1][chord]);
+    }
+    *error = "unknown line";
+    return false;
+}
+
+// Spreads the select and modifier rules over every combination of modifier
+// sensors, as the firmware looks them up.
+static void expand(layout_source *source)
+{
+    layout_blob *blob = &source->body.blob;
+    blob->layer_count = source->layer_count;
+    blob->passkey_layer = source->passkey_layer;
+    for (int held = 0; held < LAYOUT_MODIFIER_CHORDS; ++held)
+    {
+        int best = -1;
+        blob->layers[held] = 0;
+        for (int r = 0; r < source->select_count; ++r)
+        {
+            const select_rule *rule = &source->selects[r];
+            int sensors = __builtin_popcount(rule->sensors);
+            if ((held & rule->sensors) == rule->sensors && sensors >= best)
+            {
+                best = sensors;
+                blob->layers[held] = rule->layer;
+            }
+        }
+        blob->modifiers[held] = 0;
+        for (int s = 0; s < MODIFIER_SENSOR_COUNT; ++s)
+        {
+            blob->modifiers[held] |= held & 1 << s ? source->sensor_modifiers[s] : 0;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = NULL;
+    bool remote = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:r")) != -1)
+    {
+        switch (opt)
+        {
+        case 'o':
+            out_path = optarg;
+            break;
+        case 'r':
+            remote = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-o layout.bin] [-r] layout.txt\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        fprintf(stderr, "usage: %s [-o layout.bin] [-r] layout.txt\n", argv[0]);
+        return 1;
+    }
+    FILE *in = fopen(argv[optind], "r");
+    if (!in)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    static layout_source source;
+    char line[256];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), in))
+    {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment)
+        {
+            *comment = '\0';
+        }
+        const char *error = NULL;
+        if (!parse_line(&source, line, &error))
+        {
+            fprintf(stderr, "%s:%d: %s\n", argv[optind], line_number, error);
+            return 1;
+        }
+    }
+    fclose(in);
+    if (!source.layer_count)
+    {
+        fprintf(stderr, "%s: no layers\n", argv[optind]);
+        return 1;
+    }
+    expand(&source);
+
+    static uint8_t blob[LAYOUT_MAX_SIZE];
+    size_t size = LAYOUT_BLOB_SIZE(source.layer_count);
+    layout_header header = layout_make_header(&source.body.blob, size);
+    memcpy(blob, &header, sizeof(header));
+    memcpy(blob + sizeof(header), source.body.bytes, size);
+    size_t length = sizeof(header) + size;
+    const char *error = layout_check(blob, length);
+    if (error)
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], error);
+        return 1;
+    }
+
+    static uint8_t builtin[LAYOUT_MAX_SIZE];
+    size_t builtin_length = layout_default_blob(builtin, sizeof(builtin));
+    bool same = builtin_length == length && memcmp(builtin, blob, length) == 0;
+    printf("%d layers, %zu bytes%s\n", source.layer_count, length, same ? ", same as the built-in layout" : "");
+
+    if (out_path)
+    {
+        FILE *out = fopen(out_path, "wb");
+        if (!out || fwrite(blob, 1, length, out) != length || fclose(out) != 0)
+        {
+            perror(out_path);
+            return 1;
+        }
+    }
+    if (remote)
+    {
+        // Each write: the offset, little-endian, then up to REMOTE_PIECE bytes.
+        for (size_t offset = 0; offset < length; offset += REMOTE_PIECE)
+        {
+            size_t piece = length - offset < REMOTE_PIECE ? length - offset : REMOTE_PIECE;
+            printf("lilypawsconf.lay %02x%02x", (unsigned)(offset & 0xff), (unsigned)(offset >> 8));
+            for (size_t i = 0; i < piece; ++i)
+            {
+                printf("%02x", blob[offset + i]);
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
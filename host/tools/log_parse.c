@@ -0,0 +1,107 @@
+// Parses firmware console captures (see capture.h) and reports what they hold
+// and how fast they parsed; with -o, also writes all events to a columnar file
+// that util/parse.py loads directly.
+//
+//   log_parse [-o out.pawcol] capture...
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "capture.h"
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int channels_seen(const capture_table_t *table)
+{
+    // A value column is in use if any row has it.
+    int seen = 0;
+    for (int c = 1; c <= SENSOR_COUNT; ++c)
+    {
+        for (size_t row = 0; row < table->rows; ++row)
+        {
+            const capture_column_t *column = &table->columns[c];
+            bool present = column->type == CAPTURE_I32 ? ((int32_t *)column->data)[row] != -1
+                                                       : ((float *)column->data)[row] == ((float *)column->data)[row];
+            if (present)
+            {
+                seen = c;
+                break;
+            }
+        }
+    }
+    return seen;
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'o':
+            out_path = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-o out.pawcol] capture...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind == argc)
+    {
+        fprintf(stderr, "usage: %s [-o out.pawcol] capture...\n", argv[0]);
+        return 1;
+    }
+
+    capture_t capture;
+    capture_init(&capture);
+    int64_t t0 = now_ns();
+    for (int i = optind; i < argc; ++i)
+    {
+        if (!capture_parse_file(&capture, argv[i]))
+        {
+            perror(argv[i]);
+            return 1;
+        }
+    }
+    int64_t elapsed = now_ns() - t0;
+
+    printf("%llu bytes, %llu lines%s in %.1f ms, %.0f MB/s\n", (unsigned long long)capture.bytes,
+           (unsigned long long)capture.lines, capture.utf16 ? " (UTF-16)" : "", elapsed / 1e6,
+           capture.bytes / (elapsed / 1e3 + 1e-9));
+    const capture_table_t *tables[] = {&capture.sensor, &capture.filter, &capture.thresholds,
+                                       &capture.haptics, &capture.encoding, &capture.frame, &capture.calibration};
+    for (size_t t = 0; t < sizeof(tables) / sizeof(tables[0]); ++t)
+    {
+        const capture_table_t *table = tables[t];
+        if (table == &capture.sensor || table == &capture.filter || table == &capture.thresholds)
+        {
+            printf("%-11s %8zu rows, %d channels\n", table->name, table->rows, channels_seen(table));
+        }
+        else
+        {
+            printf("%-11s %8zu rows\n", table->name, table->rows);
+        }
+    }
+    if (capture.log_reader.corrupt || capture.log_reader.missing)
+    {
+        printf("binary log: %lu corrupt records, %lu frames missing\n", (unsigned long)capture.log_reader.corrupt,
+               (unsigned long)capture.log_reader.missing);
+    }
+
+    int status = 0;
+    if (out_path && !capture_write_columnar(&capture, out_path))
+    {
+        perror(out_path);
+        status = 1;
+    }
+    capture_free(&capture);
+    return status;
+}
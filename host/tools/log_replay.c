@@ -0,0 +1,365 @@
+// Replays the sensor frames of a console capture through the firmware's filter
+// and encoder, the hid_task loop in virtual time, and compares the chords it
+// accepts with the ENCODING "| x |" events the device logged (see replay.h).
+// Runs as fast as the CPU allows, and the same capture always replays the same
+// way, so a trace (-e) can be diffed between filter versions.
+//
+// -f pipeline replays a filter pipeline (filter_pipeline.h) built from -p spec,
+// and reports the time each stage took per frame.
+//
+// -s spec runs a pipeline built from spec in the shadow of the replayed filter
+// (shadow_filter.h), as SHADOW_FILTER does on the device, and reports how often
+// they disagree and what each costs; -v also lists the disagreements.
+//
+// -c encodes with early commit (ENVELOPE_EARLY_COMMIT), and reports how many
+// chords were committed early, how much sooner, and how many the envelope then
+// changed. The device logged its chords where the grace period ended, so give
+// -t room for the time gained when matching them.
+//
+// -a types chords ahead (ENVELOPE_SPECULATIVE_OUTPUT) through the report queue
+// the device uses, and reports how many were typed ahead, taken back or
+// withheld, and the boots whose typed text differs from their accepted chords.
+// Press to accept then runs to the press the host saw.
+//
+// -l learns the envelope timing (ENVELOPE_ADAPTIVE_TIMING) from boot to boot and
+// capture to capture, in the order given, and reports the windows it ends with.
+//
+// -r lets the next chord start while the last one is still releasing
+// (ENVELOPE_ROLLOVER), and reports how many chords rolled over.
+//
+//   log_replay [-f iir|fixed|autocal|old|pipeline] [-p spec] [-s spec] [-c] [-a] [-l] [-r] [-t tolerance_ms] [-e trace.csv] [-v] capture...
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "filter.h"
+#include "iir_filter.h"
+#include "old_filter.h"
+#include "fixed_filter.h"
+#include "autocal_filter.h"
+#include "filter_pipeline.h"
+#include "shadow_filter.h"
+
+#include "capture.h"
+#include "replay.h"
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static filter_handle_t make_iir_filter(void *context)
+{
+    return init_iir_filter_default();
+}
+
+static filter_handle_t make_fixed_filter(void *context)
+{
+    return init_fixed_filter_default();
+}
+
+static filter_handle_t make_autocal_filter(void *context)
+{
+    return init_autocal_filter_default();
+}
+
+static filter_handle_t make_old_filter(void *context)
+{
+    return init_old_filter(NULL);
+}
+
+// Stage statistics summed over every boot's pipeline.
+typedef struct
+{
+    const char *spec;
+    int stage_count;
+    filter_stage_stats stats[FILTER_PIPELINE_MAX_STAGES];
+} pipeline_context_t;
+
+static filter_handle_t make_pipeline(void *context)
+{
+    pipeline_context_t *pipeline = context;
+    return init_filter_pipeline(pipeline->spec);
+}
+
+static void free_pipeline(filter_handle_t filter, void *context)
+{
+    pipeline_context_t *pipeline = context;
+    filter_stage_stats stats[FILTER_PIPELINE_MAX_STAGES];
+    pipeline->stage_count = filter_pipeline_get_stats(filter, stats, FILTER_PIPELINE_MAX_STAGES);
+    for (int s = 0; s < pipeline->stage_count; ++s)
+    {
+        filter_stage_stats *total = &pipeline->stats[s];
+        total->name = stats[s].name;
+        total->frames += stats[s].frames;
+        total->cycles += stats[s].cycles;
+        total->max_cycles = stats[s].max_cycles > total->max_cycles ? stats[s].max_cycles : total->max_cycles;
+    }
+    free_filter_pipeline(filter);
+}
+
+// The replayed filter, with a candidate pipeline in its shadow.
+typedef struct
+{
+    filter_handle_t (*make_filter)(void *);
+    void (*free_filter)(filter_handle_t, void *);
+    void *filter_context;
+    const char *spec;
+    filter_handle_t production;
+    filter_handle_t candidate;
+    // Where to list the disagreements, if anywhere.
+    FILE *report;
+} shadow_context_t;
+
+static filter_handle_t make_shadow(void *context)
+{
+    shadow_context_t *shadow = context;
+    shadow->production = shadow->make_filter(shadow->filter_context);
+    shadow->candidate = init_filter_pipeline(shadow->spec);
+    return init_shadow_filter(shadow->production, shadow->candidate);
+}
+
+static void free_shadow(filter_handle_t filter, void *context)
+{
+    shadow_context_t *shadow = context;
+    shadow_record records[64];
+    size_t count;
+    while ((count = shadow_filter_read(records, sizeof(records) / sizeof(records[0]))))
+    {
+        for (size_t r = 0; shadow->report && r < count; ++r)
+        {
+            fprintf(shadow->report, "shadow %10lu ms  production %04x  candidate %04x\n", (unsigned long)records[r].timestamp_ms,
+                    records[r].production, records[r].candidate);
+        }
+    }
+    free_shadow_filter(filter);
+    if (shadow->free_filter)
+    {
+        shadow->free_filter(shadow->production, shadow->filter_context);
+    }
+    else
+    {
+        free(shadow->production->filter_data);
+        free(shadow->production);
+    }
+    free_filter_pipeline(shadow->candidate);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-f iir|fixed|autocal|old|pipeline] [-p spec] [-s spec] [-c] [-a] [-l] [-r] [-t tolerance_ms] [-e trace.csv] [-v] capture...\n", name);
+    fprintf(stderr, "pipeline stages:");
+    for (int t = 0; t < filter_stage_type_count; ++t)
+    {
+        fprintf(stderr, " %s", filter_stage_types[t].name);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv)
+{
+    replay_t replay;
+    replay_init(&replay);
+    replay.report = stdout;
+    const char *filter_name = "iir";
+    const char *trace_path = NULL;
+    pipeline_context_t pipeline = {.spec = "band_pass(2, 0.5) > threshold(2.5, 1, 0.5)"};
+    shadow_context_t shadow = {0};
+    bool verbose = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:p:s:calrt:e:v")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            filter_name = optarg;
+            break;
+        case 'p':
+            pipeline.spec = optarg;
+            break;
+        case 's':
+            shadow.spec = optarg;
+            break;
+        case 'c':
+            replay.early_commit = true;
+            break;
+        case 'a':
+            replay.speculate = true;
+            break;
+        case 'l':
+            replay.adaptive_timing = true;
+            break;
+        case 'r':
+            replay.rollover = true;
+            break;
+        case 't':
+            replay.tolerance_ms = atoi(optarg);
+            break;
+        case 'e':
+            trace_path = optarg;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind == argc || (strcmp(filter_name, "iir") != 0 && strcmp(filter_name, "fixed") != 0 &&
+                           strcmp(filter_name, "autocal") != 0 && strcmp(filter_name, "old") != 0 &&
+                           strcmp(filter_name, "pipeline") != 0))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (trace_path)
+    {
+        replay.trace = fopen(trace_path, "w");
+        if (!replay.trace)
+        {
+            perror(trace_path);
+            return 1;
+        }
+        fprintf(replay.trace, "timestamp_us,event,value\n");
+    }
+
+    replay.make_filter = make_iir_filter;
+    if (strcmp(filter_name, "fixed") == 0)
+    {
+        replay.make_filter = make_fixed_filter;
+    }
+    else if (strcmp(filter_name, "autocal") == 0)
+    {
+        replay.make_filter = make_autocal_filter;
+    }
+    else if (strcmp(filter_name, "old") == 0)
+    {
+        replay.make_filter = make_old_filter;
+    }
+    else if (strcmp(filter_name, "pipeline") == 0)
+    {
+        replay.make_filter = make_pipeline;
+        replay.free_filter = free_pipeline;
+        replay.filter_context = &pipeline;
+    }
+    replay_setup(verbose);
+    // Checked once here, rather than failing on the first boot.
+    const char *specs[] = {replay.make_filter == make_pipeline ? pipeline.spec : NULL, shadow.spec};
+    for (int p = 0; p < 2; ++p)
+    {
+        filter_handle_t filter = specs[p] ? init_filter_pipeline(specs[p]) : NULL;
+        if (specs[p] && !filter)
+        {
+            fprintf(stderr, "invalid pipeline '%s'\n", specs[p]);
+            usage(argv[0]);
+            return 1;
+        }
+        if (filter)
+        {
+            free_filter_pipeline(filter);
+        }
+    }
+    if (shadow.spec)
+    {
+        shadow.make_filter = replay.make_filter;
+        shadow.free_filter = replay.free_filter;
+        shadow.filter_context = replay.filter_context;
+        shadow.report = verbose ? stdout : NULL;
+        replay.make_filter = make_shadow;
+        replay.free_filter = free_shadow;
+        replay.filter_context = &shadow;
+    }
+
+    int64_t elapsed_ns = 0;
+    for (int i = optind; i < argc; ++i)
+    {
+        capture_t capture;
+        capture_init(&capture);
+        if (!capture_parse_file(&capture, argv[i]))
+        {
+            perror(argv[i]);
+            return 1;
+        }
+        int64_t t0 = now_ns();
+        replay_capture(&replay, &capture, argv[i]);
+        elapsed_ns += now_ns() - t0;
+        capture_free(&capture);
+    }
+    if (replay.trace)
+    {
+        fclose(replay.trace);
+    }
+
+    printf("%llu frames (%.1f s of capture) replayed in %.1f ms, %.0fx real time, %s filter\n",
+           (unsigned long long)replay.frames, replay.virtual_ms / 1e3, elapsed_ns / 1e6,
+           elapsed_ns ? replay.virtual_ms * 1e6 / elapsed_ns : 0.0, filter_name);
+    printf("%llu pin transitions, %llu HID changes, envelopes %llu, accepted %llu, rejected %llu, grip %llu\n",
+           (unsigned long long)replay.pin_transitions, (unsigned long long)replay.hid_changes,
+           (unsigned long long)replay.envelopes, (unsigned long long)replay.flag_counts[ENCODER_FLAG_ACCEPTED],
+           (unsigned long long)replay.flag_counts[ENCODER_FLAG_REJECTED], (unsigned long long)replay.flag_counts[ENCODER_FLAG_GRIP]);
+    printf("chords: %zu logged, %zu replayed, %zu matched within %lld ms, %zu missed, %zu extra\n", replay.logged_total,
+           replay.replayed_total, replay.matched_total, (long long)replay.tolerance_ms,
+           replay.logged_total - replay.matched_total, replay.replayed_total - replay.matched_total);
+    printf("chords replayed as another: %llu sensors added, %llu lost\n", (unsigned long long)replay.phantom_bits,
+           (unsigned long long)replay.dropped_bits);
+    if (replay.swallowed_presses)
+    {
+        printf("presses in no chord: %llu\n", (unsigned long long)replay.swallowed_presses);
+    }
+    if (replay.matched_total)
+    {
+        printf("press to accept: %.1f ms mean over matched chords\n", replay.matched_latency_us / 1e3 / replay.matched_total);
+    }
+    if (replay.early_commit)
+    {
+        envelope_commit_stats *commits = &replay.commit_stats;
+        uint32_t held = commits->commits - commits->mispredictions;
+        printf("early commit: %u of %llu accepted chords, %.1f ms sooner mean, %u changed after the commit\n",
+               commits->commits, (unsigned long long)replay.flag_counts[ENCODER_FLAG_ACCEPTED],
+               held ? commits->gained_us / 1e3 / held : 0.0, commits->mispredictions);
+    }
+    if (replay.speculate)
+    {
+        envelope_speculation_stats *speculation = &replay.speculation_stats;
+        printf("type ahead: %u chords typed ahead, %u taken back, %u withheld; typed text differs on %llu boots\n",
+               speculation->typed_ahead, speculation->retracted, speculation->withheld,
+               (unsigned long long)replay.text_mismatches);
+    }
+    if (replay.rollover)
+    {
+        printf("rollover: %llu of %llu accepted chords started while the one before was releasing\n",
+               (unsigned long long)replay.rollovers, (unsigned long long)replay.flag_counts[ENCODER_FLAG_ACCEPTED]);
+    }
+    if (replay.adaptive_timing)
+    {
+        envelope_timing *timing = &replay.timing;
+        printf("adaptive timing: grace %u ms, reject after %u ms, from %u chords; onset spread p95 %u ms, hold p99 %u ms, release spread p99 %u ms\n",
+               timing->grace_us / 1000, timing->reject_us / 1000, timing->chords,
+               envelope_timing_percentile(&timing->onset, ENVELOPE_TIMING_SPREAD_BIN_USEC, 0.95f) / 1000,
+               envelope_timing_percentile(&timing->hold, ENVELOPE_TIMING_HOLD_BIN_USEC, 0.99f) / 1000,
+               envelope_timing_percentile(&timing->release, ENVELOPE_TIMING_SPREAD_BIN_USEC, 0.99f) / 1000);
+    }
+    for (int s = 0; s < pipeline.stage_count; ++s)
+    {
+        filter_stage_stats *stats = &pipeline.stats[s];
+        printf("stage %d %-10s %8.1f ns mean, %7.1f us max per frame\n", s, stats->name,
+               stats->frames ? (double)stats->cycles / stats->frames : 0.0, stats->max_cycles / 1e3);
+    }
+    if (shadow.spec)
+    {
+        shadow_filter_stats stats = shadow_filter_get_stats();
+        printf("shadow '%s': differs on %u of %u frames (%.3f%%) in %u runs, %u records, %u dropped\n", shadow.spec,
+               stats.disagreement_frames, stats.frames, stats.frames ? 100.0 * stats.disagreement_frames / stats.frames : 0.0,
+               stats.disagreements, stats.records, stats.dropped_records);
+        printf("shadow cost: %s %.1f ns mean, %.1f us max; candidate %.1f ns mean, %.1f us max per frame\n", filter_name,
+               stats.frames ? (double)stats.cycles[0] / stats.frames : 0.0, stats.max_cycles[0] / 1e3,
+               stats.frames ? (double)stats.cycles[1] / stats.frames : 0.0, stats.max_cycles[1] / 1e3);
+    }
+    replay_free(&replay);
+    return 0;
+}
@@ -0,0 +1,513 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_hidd_prf_api.h"
+
+#include "constants.h"
+#include "state.h"
+#include "sensors.h"
+#include "encoding.h"
+#include "haptics.h"
+#include "bluetooth.h"
+#include "filter.h"
+#include "layout.h"
+
+#include "host_hal.h"
+#include "replay.h"
+
+static const char *flag_names[] = {"none", "envelope", "rejected", "accepted", "grip"};
+
+static void add_chord(replay_chord_list_t *list, int64_t timestamp_ms, char key, int64_t latency_us)
+{
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        list->chords = realloc(list->chords, list->capacity * sizeof(replay_chord_t));
+    }
+    list->chords[list->count++] = (replay_chord_t){timestamp_ms, key, latency_us};
+}
+
+static void print_key(FILE *out, char key)
+{
+    if (key == 127)
+    {
+        fputs("del", out);
+    }
+    else
+    {
+        fputc(key, out);
+    }
+}
+
+// Drives a jumper to the wanted state whatever its wiring polarity.
+static void set_jumper(int gpio, bool active)
+{
+    host_gpio_force_level(gpio, 1);
+    jumper_states_t jumpers = read_jumpers();
+    bool is_active = gpio == GPIO_CALIBRATION_PIN ? jumpers.calibration : jumpers.enhanced_logging;
+    if (is_active != active)
+    {
+        host_gpio_force_level(gpio, 0);
+    }
+}
+
+// What a text field would hold: keys appended, HID_KEY_DELETE taking the last off.
+typedef struct
+{
+    keyboard_cmd_t *keys;
+    size_t length;
+    size_t capacity;
+} text_t;
+
+static void text_type(text_t *text, keyboard_cmd_t key)
+{
+    if (key == HID_KEY_DELETE)
+    {
+        text->length -= text->length > 0;
+        return;
+    }
+    if (text->length == text->capacity)
+    {
+        text->capacity = text->capacity ? text->capacity * 2 : 256;
+        text->keys = realloc(text->keys, text->capacity * sizeof(keyboard_cmd_t));
+    }
+    text->keys[text->length++] = key;
+}
+
+typedef struct
+{
+    filter_handle_t filter;
+    envelope_encoder_state encoder_state;
+    command_decoder_state command_state;
+    keyboard_system_command_t last_command;
+    keyboard_cmd_t last_tx_key;
+    key_mask_t last_tx_mask;
+    encoder_flags_t last_flags;
+    sensor_mask_t last_pressed;
+    uint64_t entered_at;
+    int64_t envelope_start_us;
+    // The chord of the envelope committed early, until the envelope ends.
+    bool commit_open;
+    size_t commit_chord;
+    // Encoding sensors pressed and not in a chord yet.
+    char last_pins;
+    char unsettled;
+    // Speculative output: what the reports typed, the last key pressed and when,
+    // and the text of the accepted chords to compare with.
+    text_t typed;
+    text_t accepted;
+    keyboard_cmd_t last_report_key;
+    keyboard_cmd_t last_press_key;
+    int64_t last_press_us;
+} session_t;
+
+// Keyboard reports as the host receives them: mask, reserved, keys.
+static void record_report(uint16_t conn_id, uint16_t attr_handle, uint16_t length, const uint8_t *value, void *context)
+{
+    session_t *session = context;
+    keyboard_cmd_t key = length >= 3 ? value[2] : 0;
+    if (key && key != session->last_report_key)
+    {
+        text_type(&session->typed, key);
+        if (key != HID_KEY_DELETE)
+        {
+            session->last_press_key = key;
+            session->last_press_us = esp_timer_get_time();
+        }
+    }
+    session->last_report_key = key;
+}
+
+static void start_session(replay_t *replay, session_t *session)
+{
+    memset(session, 0, sizeof(*session));
+    envelope_encoder_init(&session->encoder_state, replay->early_commit, replay->speculate, replay->adaptive_timing,
+                          replay->rollover);
+    if (replay->adaptive_timing)
+    {
+        envelope_timing_restore(&session->encoder_state.timing);
+    }
+    session->filter = replay->make_filter(replay->filter_context);
+    default_filter_init(session->filter);
+    if (replay->speculate)
+    {
+        host_bt_set_report_hook(record_report, session);
+    }
+    set_jumper(GPIO_CALIBRATION_PIN, false);
+    set_jumper(GPIO_LOGGING_PIN, false);
+}
+
+static void end_session(replay_t *replay, session_t *session)
+{
+    envelope_commit_stats *stats = &session->encoder_state.commit_stats;
+    replay->commit_stats.commits += stats->commits;
+    replay->commit_stats.mispredictions += stats->mispredictions;
+    replay->commit_stats.gained_us += stats->gained_us;
+    if (replay->adaptive_timing)
+    {
+        // As if the device had run long enough to save it.
+        envelope_timing_snapshot(&session->encoder_state.timing);
+        envelope_timing_flush();
+        replay->timing = session->encoder_state.timing;
+    }
+    envelope_speculation_stats *speculation = &session->encoder_state.speculation_stats;
+    replay->speculation_stats.typed_ahead += speculation->typed_ahead;
+    replay->speculation_stats.retracted += speculation->retracted;
+    replay->speculation_stats.withheld += speculation->withheld;
+    replay->rollovers += session->encoder_state.rollovers;
+    if (replay->speculate)
+    {
+        // The reports still queued.
+        for (int r = 0; r < BT_REPORT_QUEUE_LENGTH; ++r)
+        {
+            bt_send_queued(0);
+        }
+        host_bt_set_report_hook(NULL, NULL);
+        replay->text_mismatches += session->typed.length != session->accepted.length ||
+                                   memcmp(session->typed.keys, session->accepted.keys, session->typed.length * sizeof(keyboard_cmd_t));
+    }
+    free(session->typed.keys);
+    free(session->accepted.keys);
+    if (replay->free_filter)
+    {
+        replay->free_filter(session->filter, replay->filter_context);
+        return;
+    }
+    free(session->filter->filter_data);
+    free(session->filter);
+}
+
+// One pass of hid_task for a recorded frame, recording what changed.
+static void replay_frame(replay_t *replay, session_t *session, sensor_frame_t *frame)
+{
+    host_clock_set_us(frame->timestamp_us);
+    update_state(session->last_command);
+    char pins = pressure_sensor_replay_frame(frame);
+    encoder_output_t out = envelope_encode(&session->encoder_state, pins, device_state);
+    layout_apply();
+    convert_to_hid_code(&out, device_state);
+    do_feedback(out.encoder_flags);
+    session->last_command = decode_command(&session->command_state, out);
+
+    int64_t timestamp_us = frame->timestamp_us;
+    if (replay->speculate)
+    {
+        // As hid_task does while connected.
+        if (out.retracted_bitstring)
+        {
+            bt_retract();
+        }
+        if (out.hid && out.speculative)
+        {
+            bt_type_ahead(out.mask, out.hid);
+        }
+        else if (out.hid)
+        {
+            bt_type(out.mask, out.hid);
+        }
+        bt_send_queued(out.mask);
+        if (out.encoder_flags == ENCODER_FLAG_ACCEPTED && out.hid)
+        {
+            text_type(&session->accepted, out.hid);
+        }
+        if (replay->trace && out.retracted_bitstring)
+        {
+            fprintf(replay->trace, "%lld,retract,", (long long)timestamp_us);
+            print_key(replay->trace, out.retracted_bitstring + 'a' - 1);
+            fputc('\n', replay->trace);
+        }
+    }
+    if (session->commit_open && !session->encoder_state._committed)
+    {
+        session->commit_open = false;
+        replay->replayed.chords[session->commit_chord].timestamp_ms = timestamp_us / 1000;
+    }
+    sensor_mask_t changed = pins_pressed ^ session->last_pressed;
+    session->last_pressed = pins_pressed;
+    replay->pin_transitions += sensor_mask_count(changed);
+    for (int i = 0; replay->trace && i < SENSOR_COUNT; ++i)
+    {
+        if (sensor_mask_test(changed, i))
+        {
+            fprintf(replay->trace, "%lld,%s,%d\n", (long long)timestamp_us, sensor_mask_test(pins_pressed, i) ? "press" : "release", i);
+        }
+    }
+    if (out.encoder_flags != session->last_flags)
+    {
+        session->last_flags = out.encoder_flags;
+        replay->flag_counts[out.encoder_flags]++;
+        if (replay->trace)
+        {
+            fprintf(replay->trace, "%lld,flags,%s\n", (long long)timestamp_us, flag_names[out.encoder_flags]);
+        }
+    }
+    // What bt_send would be asked to send while connected.
+    if (out.hid != session->last_tx_key || out.mask != session->last_tx_mask)
+    {
+        session->last_tx_key = out.hid;
+        session->last_tx_mask = out.mask;
+        replay->hid_changes++;
+        if (replay->trace)
+        {
+            fprintf(replay->trace, "%lld,hid,%d:%d\n", (long long)timestamp_us, out.hid, out.mask);
+        }
+    }
+    if (out.encoder_flags == ENCODER_FLAG_ACCEPTED)
+    {
+        char key = out.accumulated_bitstring + 'a' - 1;
+        int64_t typed_us = timestamp_us;
+        // Typed ahead, and the key the host saw last.
+        if (replay->speculate && out.hid == session->last_press_key && session->last_press_us >= session->envelope_start_us)
+        {
+            typed_us = session->last_press_us;
+        }
+        add_chord(&replay->replayed, timestamp_us / 1000, key, typed_us - session->envelope_start_us);
+        if (session->encoder_state._committed)
+        {
+            session->commit_open = true;
+            session->commit_chord = replay->replayed.count - 1;
+        }
+        if (replay->trace)
+        {
+            fprintf(replay->trace, "%lld,chord,", (long long)timestamp_us);
+            print_key(replay->trace, key);
+            fputc('\n', replay->trace);
+        }
+    }
+    // After the chord, which a rollover accepts on the frame the next one takes
+    // over the envelope.
+    if (session->encoder_state._entered_at != session->entered_at)
+    {
+        session->entered_at = session->encoder_state._entered_at;
+        session->envelope_start_us = session->entered_at;
+        replay->envelopes++;
+    }
+    // Every press ends in a chord, or is rejected with its envelope.
+    session->unsettled |= pins & ~session->last_pins;
+    session->last_pins = pins;
+    if (out.encoder_flags == ENCODER_FLAG_ACCEPTED)
+    {
+        session->unsettled &= ~out.accumulated_bitstring;
+    }
+    if (out.encoder_flags == ENCODER_FLAG_REJECTED || out.encoder_flags == ENCODER_FLAG_GRIP)
+    {
+        session->unsettled = 0;
+    }
+    if (!session->encoder_state._in_envelope && session->unsettled)
+    {
+        replay->swallowed_presses += __builtin_popcount(session->unsettled);
+        session->unsettled = 0;
+    }
+    replay->frames++;
+}
+
+static void report_chord(FILE *report, const char *what, const replay_chord_t *chord)
+{
+    if (report)
+    {
+        fprintf(report, "  %-7s %8lld ms  ", what, (long long)chord->timestamp_ms);
+        print_key(report, chord->key);
+        fputc('\n', report);
+    }
+}
+
+// The sensor bits of a chord, from its key ('a' is sensor 0 alone).
+static int chord_bits(char key)
+{
+    return (key - ('a' - 1)) & ((1 << ENCODING_SENSOR_COUNT) - 1);
+}
+
+// Pairs logged and replayed chords in time order: same key, within tolerance.
+static void match_chords(replay_t *replay)
+{
+    const replay_chord_list_t *logged = &replay->logged;
+    const replay_chord_list_t *replayed = &replay->replayed;
+    FILE *report = replay->report;
+    size_t r = 0;
+    for (size_t l = 0; l < logged->count; ++l)
+    {
+        // Replayed chords too early for this logged one are extras.
+        while (r < replayed->count && replayed->chords[r].timestamp_ms < logged->chords[l].timestamp_ms - replay->tolerance_ms)
+        {
+            report_chord(report, "extra", &replayed->chords[r]);
+            r++;
+        }
+        if (r < replayed->count && replayed->chords[r].key == logged->chords[l].key &&
+            replayed->chords[r].timestamp_ms <= logged->chords[l].timestamp_ms + replay->tolerance_ms)
+        {
+            replay->matched_total++;
+            replay->matched_latency_us += replayed->chords[r].latency_us;
+            r++;
+            continue;
+        }
+        bool replaced = r < replayed->count && replayed->chords[r].timestamp_ms <= logged->chords[l].timestamp_ms + replay->tolerance_ms;
+        if (replaced)
+        {
+            int logged_bits = chord_bits(logged->chords[l].key);
+            int replayed_bits = chord_bits(replayed->chords[r].key);
+            replay->phantom_bits += __builtin_popcount(replayed_bits & ~logged_bits);
+            replay->dropped_bits += __builtin_popcount(logged_bits & ~replayed_bits);
+        }
+        if (report)
+        {
+            fprintf(report, "  missed  %8lld ms  ", (long long)logged->chords[l].timestamp_ms);
+            print_key(report, logged->chords[l].key);
+            if (replaced)
+            {
+                fprintf(report, " (replayed ");
+                print_key(report, replayed->chords[r].key);
+                fprintf(report, " at %lld ms)", (long long)replayed->chords[r].timestamp_ms);
+            }
+            fputc('\n', report);
+        }
+        r += replaced;
+    }
+    for (; r < replayed->count; ++r)
+    {
+        report_chord(report, "extra", &replayed->chords[r]);
+    }
+}
+
+#define COLUMN(table, name, ctype) ((const ctype *)capture_column(table, name)->data)
+
+// Replays sensor rows [begin, end), all from one boot, then compares chords.
+static void replay_boot(replay_t *replay, const capture_t *capture, const char *path, size_t begin, size_t end)
+{
+    // Binary log records carry microsecond timestamps and the device state;
+    // text captures only have milliseconds and the calibration lines.
+    bool binary = capture->frame.rows == capture->sensor.rows;
+    const int64_t *timestamps_ms = COLUMN(&capture->sensor, "timestamp_ms", int64_t);
+    const int64_t *timestamps_us = COLUMN(&capture->frame, "timestamp_us", int64_t);
+    const int32_t *states = COLUMN(&capture->frame, "state", int32_t);
+    const int32_t *raw[SENSOR_COUNT];
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "raw%d", i);
+        raw[i] = COLUMN(&capture->sensor, name, int32_t);
+    }
+    int32_t boot = COLUMN(&capture->sensor, "boot", int32_t)[begin];
+    const int64_t *calibration_ms = COLUMN(&capture->calibration, "timestamp_ms", int64_t);
+    const uint8_t *calibration_active = COLUMN(&capture->calibration, "active", uint8_t);
+    const int32_t *calibration_boot = COLUMN(&capture->calibration, "boot", int32_t);
+    size_t next_calibration = 0;
+    while (next_calibration < capture->calibration.rows && calibration_boot[next_calibration] < boot)
+    {
+        next_calibration++;
+    }
+
+    session_t session;
+    start_session(replay, &session);
+    replay->replayed.count = 0;
+    replay->logged.count = 0;
+    for (size_t row = begin; row < end; ++row)
+    {
+        int64_t timestamp_ms = timestamps_ms[row];
+        if (binary)
+        {
+            set_jumper(GPIO_CALIBRATION_PIN, states[row] & KEYBOARD_STATE_SENSOR_CALIBRATION);
+        }
+        else
+        {
+            while (next_calibration < capture->calibration.rows && calibration_boot[next_calibration] == boot &&
+                   calibration_ms[next_calibration] <= timestamp_ms)
+            {
+                set_jumper(GPIO_CALIBRATION_PIN, calibration_active[next_calibration]);
+                next_calibration++;
+            }
+        }
+
+        sensor_frame_t frame = {
+            .sequence = row - begin,
+            .timestamp_us = binary ? timestamps_us[row] : timestamp_ms * 1000,
+        };
+        for (int i = 0; i < SENSOR_COUNT && i < ADC_SENSOR_COUNT; ++i)
+        {
+            // Channels the capture did not log read idle.
+            frame.adc_raw[i] = raw[i][row] < 0 ? 0 : raw[i][row];
+        }
+        replay_frame(replay, &session, &frame);
+    }
+    end_session(replay, &session);
+
+    // Only chords accepted while frames were being logged can be reproduced.
+    int64_t first_ms = timestamps_ms[begin];
+    int64_t last_ms = timestamps_ms[end - 1];
+    replay->virtual_ms += last_ms - first_ms;
+    const int64_t *encoding_ms = COLUMN(&capture->encoding, "timestamp_ms", int64_t);
+    const uint8_t *keys = COLUMN(&capture->encoding, "key", uint8_t);
+    const int32_t *encoding_boot = COLUMN(&capture->encoding, "boot", int32_t);
+    for (size_t row = 0; row < capture->encoding.rows; ++row)
+    {
+        if (encoding_boot[row] == boot && encoding_ms[row] >= first_ms && encoding_ms[row] <= last_ms)
+        {
+            add_chord(&replay->logged, encoding_ms[row], keys[row], 0);
+        }
+    }
+
+    if (replay->report && (replay->logged.count || replay->replayed.count))
+    {
+        fprintf(replay->report, "%s, boot %d, %lld-%lld ms:\n", path, boot, (long long)first_ms, (long long)last_ms);
+    }
+    match_chords(replay);
+    replay->logged_total += replay->logged.count;
+    replay->replayed_total += replay->replayed.count;
+}
+
+void replay_capture(replay_t *replay, const capture_t *capture, const char *path)
+{
+    const int32_t *boots = COLUMN(&capture->sensor, "boot", int32_t);
+    size_t begin = 0;
+    for (size_t row = 1; row <= capture->sensor.rows; ++row)
+    {
+        if (row == capture->sensor.rows || boots[row] != boots[begin])
+        {
+            replay_boot(replay, capture, path, begin, row);
+            begin = row;
+        }
+    }
+}
+
+void replay_setup(bool verbose)
+{
+    esp_log_level_set("*", verbose ? ESP_LOG_INFO : ESP_LOG_NONE);
+    host_clock_set_virtual(true);
+    bt_init();
+    sensor_init();
+    initialize_feedback();
+}
+
+void replay_init(replay_t *replay)
+{
+    memset(replay, 0, sizeof(*replay));
+    replay->tolerance_ms = 50;
+}
+
+void replay_reset(replay_t *replay)
+{
+    replay->frames = 0;
+    replay->pin_transitions = 0;
+    replay->hid_changes = 0;
+    memset(replay->flag_counts, 0, sizeof(replay->flag_counts));
+    replay->envelopes = 0;
+    replay->swallowed_presses = 0;
+    replay->virtual_ms = 0;
+    replay->logged_total = 0;
+    replay->replayed_total = 0;
+    replay->matched_total = 0;
+    replay->matched_latency_us = 0;
+    replay->phantom_bits = 0;
+    replay->dropped_bits = 0;
+    memset(&replay->commit_stats, 0, sizeof(replay->commit_stats));
+    memset(&replay->speculation_stats, 0, sizeof(replay->speculation_stats));
+    replay->text_mismatches = 0;
+    replay->rollovers = 0;
+}
+
+void replay_free(replay_t *replay)
+{
+    free(replay->logged.chords);
+    free(replay->replayed.chords);
+}
@@ -0,0 +1,109 @@
+#ifndef REPLAY_H__
+#define REPLAY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "filter.h"
+#include "encoding.h"
+#include "capture.h"
+
+// Replays the sensor frames of a parsed capture through the firmware's filter and
+// encoder, the hid_task loop in virtual time, and compares the chords it accepts
+// with the ENCODING "| x |" events the device logged. The calibration jumper
+// follows the capture: the binary log's state, or the Enter/Exit calibration
+// lines of older captures. Each boot of a capture is replayed from a new filter.
+//
+// The firmware keeps its state in globals, so there is one replay per process.
+
+typedef struct
+{
+    int64_t timestamp_ms;
+    char key;
+    // From the envelope opening to the chord being accepted.
+    int64_t latency_us;
+} replay_chord_t;
+
+typedef struct
+{
+    replay_chord_t *chords;
+    size_t count;
+    size_t capacity;
+} replay_chord_list_t;
+
+typedef struct
+{
+    // Returns the filter each boot is replayed with.
+    filter_handle_t (*make_filter)(void *context);
+    // Optional: frees it after the boot. By default the handle and its
+    // filter_data are freed, which is all the firmware's filters allocate.
+    void (*free_filter)(filter_handle_t filter, void *context);
+    void *filter_context;
+    // Encode with early commit and speculative output (envelope_encoder_init).
+    // Speculative output is typed through the report queue (bt_type_ahead), and
+    // the chords' latency runs to the press the host saw.
+    bool early_commit;
+    bool speculate;
+    // Learn the envelope timing, carried from boot to boot through NVS as on the
+    // device.
+    bool adaptive_timing;
+    // Let the next chord start while the last one releases.
+    bool rollover;
+    // Logged and replayed chords this far apart still match. A chord committed
+    // early is matched where its envelope ended, which is where the device that
+    // logged it accepted it; its latency still runs to the commit.
+    int64_t tolerance_ms;
+    // Optional: every pin transition, flag change, HID code and chord as CSV.
+    FILE *trace;
+    // Optional: the chords that did not match, per boot.
+    FILE *report;
+
+    uint64_t frames;
+    uint64_t pin_transitions;
+    uint64_t hid_changes;
+    uint64_t flag_counts[ENCODER_FLAG_GRIP + 1];
+    // Envelopes opened, rather than changes to ENCODER_FLAG_ENVELOPE, which an
+    // early commit makes twice per envelope.
+    uint64_t envelopes;
+    // Presses of the encoding sensors that ended in no accepted or rejected
+    // chord: the encoder swallowed them.
+    uint64_t swallowed_presses;
+    int64_t virtual_ms;
+    size_t logged_total;
+    size_t replayed_total;
+    size_t matched_total;
+    // Summed over matched chords.
+    int64_t matched_latency_us;
+    // Logged chords replayed in time but as a different chord: sensors the
+    // replay added to them, and sensors it lost.
+    uint64_t phantom_bits;
+    uint64_t dropped_bits;
+    envelope_commit_stats commit_stats;
+    envelope_speculation_stats speculation_stats;
+    // The timing learned by the last boot.
+    envelope_timing timing;
+    // Chords started while the one before was still releasing.
+    uint64_t rollovers;
+    // Boots whose typed text, backspaces applied, differs from their accepted chords.
+    uint64_t text_mismatches;
+
+    // Chords of the boot being replayed.
+    replay_chord_list_t replayed;
+    replay_chord_list_t logged;
+} replay_t;
+
+// Virtual clock, quiet log and the firmware modules the loop uses. Once per process.
+void replay_setup(bool verbose);
+
+void replay_init(replay_t *replay);
+void replay_free(replay_t *replay);
+
+// Replays every boot of the capture and adds to the totals. path names it in the report.
+void replay_capture(replay_t *replay, const capture_t *capture, const char *path);
+
+// Clears the totals, keeping the configuration.
+void replay_reset(replay_t *replay);
+
+#endif
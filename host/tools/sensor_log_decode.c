@@ -0,0 +1,239 @@
+// Decodes the binary sensor log out of console captures into CSV, one row per
+// frame: sequence, timestamp, raw and filtered values for every sensor, device
+// state and pressed mask. Other console output is ignored. Captures saved as
+// UTF-16LE (with a byte order mark) are read too.
+//
+// -s decodes the shadow filter's disagreement records (shadow_filter.h) instead:
+// timestamp, then the production and candidate pressed masks.
+//
+//   sensor_log_decode [-s] [-o out.csv] capture...
+//
+// The result loads straight into numpy.loadtxt(path, delimiter=",", skiprows=1).
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sensor_log_reader.h"
+#include "shadow_filter.h"
+
+// Narrows a UTF-16LE line to ASCII in place; the records are plain ASCII.
+static size_t narrow_utf16(char *line, size_t length)
+{
+    size_t n = 0;
+    for (size_t i = 0; i + 1 < length; i += 2)
+    {
+        line[n++] = line[i + 1] ? '?' : line[i];
+    }
+    return n;
+}
+
+static void write_header(FILE *out)
+{
+    fprintf(out, "sequence,timestamp_us");
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        fprintf(out, ",raw%d", i);
+    }
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        fprintf(out, ",filtered%d", i);
+    }
+    fprintf(out, ",state,pressed\n");
+}
+
+static void write_entry(FILE *out, const sensor_log_entry_t *entry)
+{
+    fprintf(out, "%lu,%lld", (unsigned long)entry->sequence, (long long)entry->timestamp_us);
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        fprintf(out, ",%lu", (unsigned long)entry->raw[i]);
+    }
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        // Frames logged without filtered values get nan.
+        if (entry->has_filtered)
+        {
+            fprintf(out, ",%g", entry->filtered[i]);
+        }
+        else
+        {
+            fprintf(out, ",nan");
+        }
+    }
+    fprintf(out, ",%lu,%lu\n", (unsigned long)entry->state, (unsigned long)entry->pressed);
+}
+
+static uint8_t crc8(const uint8_t *data, size_t length)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+typedef struct
+{
+    uint32_t records;
+    uint32_t corrupt;
+} shadow_reader_t;
+
+// The shadow record in a line, if it holds one: SHADOW_FILTER_PREFIX, then 8
+// bytes and their CRC-8 in hex.
+static bool shadow_line(shadow_reader_t *reader, const char *line, size_t length, shadow_record *record)
+{
+    const size_t prefix_length = sizeof(SHADOW_FILTER_PREFIX) - 1;
+    const char *start = line;
+    const char *line_end = line + length;
+    while ((start = memchr(start, SHADOW_FILTER_PREFIX[0], line_end - start)) &&
+           ((size_t)(line_end - start) < prefix_length || memcmp(start, SHADOW_FILTER_PREFIX, prefix_length) != 0))
+    {
+        start++;
+    }
+    if (!start)
+    {
+        return false;
+    }
+    start += prefix_length;
+    uint8_t bytes[9];
+    for (int b = 0; b < 9; ++b)
+    {
+        unsigned int value;
+        if (start + 2 * b + 2 > line_end || sscanf(start + 2 * b, "%2x", &value) != 1)
+        {
+            reader->corrupt++;
+            return false;
+        }
+        bytes[b] = value;
+    }
+    if (crc8(bytes, 8) != bytes[8])
+    {
+        reader->corrupt++;
+        return false;
+    }
+    record->timestamp_ms = bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+    record->production = bytes[4] | bytes[5] << 8;
+    record->candidate = bytes[6] | bytes[7] << 8;
+    reader->records++;
+    return true;
+}
+
+static int decode_file(const char *path, FILE *out, bool shadow)
+{
+    FILE *in = fopen(path, "rb");
+    if (!in)
+    {
+        perror(path);
+        return 1;
+    }
+    unsigned char bom[2] = {0};
+    bool utf16 = fread(bom, 1, 2, in) == 2 && bom[0] == 0xff && bom[1] == 0xfe;
+    if (!utf16)
+    {
+        rewind(in);
+    }
+
+    sensor_log_reader_t reader;
+    sensor_log_reader_init(&reader);
+    shadow_reader_t shadow_reader = {0};
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    // UTF-16 newlines are "\n\0": getline splits just after the '\n', leaving the
+    // '\0' at the start of the next line, which keeps the pairs aligned from there.
+    bool odd = false;
+    while ((length = getline(&line, &capacity, in)) > 0)
+    {
+        size_t n = length;
+        if (utf16)
+        {
+            char *start = line + odd;
+            n = narrow_utf16(start, length - odd);
+            memmove(line, start, n);
+            odd = (length - odd) % 2;
+        }
+        sensor_log_entry_t entry;
+        shadow_record record;
+        if (shadow)
+        {
+            if (shadow_line(&shadow_reader, line, n, &record))
+            {
+                fprintf(out, "%lu,%u,%u\n", (unsigned long)record.timestamp_ms, record.production, record.candidate);
+            }
+        }
+        else if (sensor_log_reader_line(&reader, line, n, &entry))
+        {
+            write_entry(out, &entry);
+        }
+    }
+    free(line);
+    fclose(in);
+    if (shadow)
+    {
+        fprintf(stderr, "%s: %lu shadow records, %lu corrupt\n", path, (unsigned long)shadow_reader.records,
+                (unsigned long)shadow_reader.corrupt);
+        return 0;
+    }
+    fprintf(stderr, "%s: %lu records, %lu corrupt, %lu skipped before a keyframe, %lu frames missing\n", path,
+            (unsigned long)reader.records, (unsigned long)reader.corrupt, (unsigned long)reader.unsynced,
+            (unsigned long)reader.missing);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = NULL;
+    bool shadow = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "so:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            shadow = true;
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s] [-o out.csv] capture...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind == argc)
+    {
+        fprintf(stderr, "usage: %s [-s] [-o out.csv] capture...\n", argv[0]);
+        return 1;
+    }
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out)
+    {
+        perror(out_path);
+        return 1;
+    }
+    if (shadow)
+    {
+        fprintf(out, "timestamp_ms,production,candidate\n");
+    }
+    else
+    {
+        write_header(out);
+    }
+    int errors = 0;
+    for (int i = optind; i < argc; ++i)
+    {
+        errors += decode_file(argv[i], out, shadow);
+    }
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    return errors != 0;
+}
@@ -0,0 +1,186 @@
+#include <string.h>
+
+#include "sensor_log_reader.h"
+
+static uint8_t crc8_table[256];
+// Base64 alphabet to values, -1 elsewhere.
+static int8_t base64_values[256];
+static void tables_init(void);
+
+void sensor_log_reader_init(sensor_log_reader_t *reader)
+{
+    memset(reader, 0, sizeof(*reader));
+    if (!crc8_table[1])
+    {
+        tables_init();
+    }
+}
+
+// Decodes base64 up to the first character outside the alphabet.
+static size_t base64_decode(const char *in, size_t length, uint8_t *out, size_t max)
+{
+    uint32_t bits = 0;
+    int count = 0;
+    size_t n = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        int v = base64_values[(uint8_t)in[i]];
+        if (v < 0)
+        {
+            break;
+        }
+        bits = (bits << 6) | v;
+        count += 6;
+        if (count >= 8)
+        {
+            count -= 8;
+            if (n == max)
+            {
+                return 0;
+            }
+            out[n++] = (uint8_t)(bits >> count);
+        }
+    }
+    return n;
+}
+
+static void tables_init(void)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    memset(base64_values, -1, sizeof(base64_values));
+    for (int i = 0; i < 64; ++i)
+    {
+        base64_values[(uint8_t)alphabet[i]] = i;
+    }
+    for (int i = 0; i < 256; ++i)
+    {
+        uint8_t crc = i;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+        crc8_table[i] = crc;
+    }
+}
+
+static uint8_t crc8(const uint8_t *data, size_t length)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        crc = crc8_table[crc ^ data[i]];
+    }
+    return crc;
+}
+
+static bool get_varint(const uint8_t **p, const uint8_t *end, int64_t *delta)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (*p == end)
+        {
+            return false;
+        }
+        uint8_t byte = *(*p)++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            *delta = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool sensor_log_reader_line(sensor_log_reader_t *reader, const char *line, size_t length, sensor_log_entry_t *entry)
+{
+    // The prefix is usually at the start of the line; memmem is slow to set up.
+    const size_t prefix_length = sizeof(SENSOR_LOG_PREFIX) - 1;
+    const char *start = line;
+    const char *line_end = line + length;
+    while ((start = memchr(start, SENSOR_LOG_PREFIX[0], line_end - start)) &&
+           ((size_t)(line_end - start) < prefix_length || memcmp(start, SENSOR_LOG_PREFIX, prefix_length) != 0))
+    {
+        start++;
+    }
+    if (!start)
+    {
+        return false;
+    }
+    start += prefix_length;
+    uint8_t record[SENSOR_LOG_MAX_RECORD];
+    size_t size = base64_decode(start, line_end - start, record, sizeof(record));
+    if (size < 2 || crc8(record, size - 1) != record[size - 1])
+    {
+        // The next delta would be applied to the wrong record.
+        reader->corrupt++;
+        reader->synced = false;
+        return false;
+    }
+
+    uint8_t flags = record[0];
+    bool keyframe = flags & SENSOR_LOG_FLAG_KEYFRAME;
+    if (!keyframe && !reader->synced)
+    {
+        reader->unsynced++;
+        return false;
+    }
+    sensor_log_fields_t fields = reader->last;
+    if (keyframe)
+    {
+        memset(&fields, 0, sizeof(fields));
+    }
+    entry->has_filtered = flags & SENSOR_LOG_FLAG_FILTERED;
+    if (!entry->has_filtered)
+    {
+        memset(fields.filtered, 0, sizeof(fields.filtered));
+    }
+
+    const uint8_t *p = record + 1;
+    const uint8_t *end = record + size - 1;
+    int64_t delta;
+    bool ok = get_varint(&p, end, &delta);
+    fields.sequence += delta;
+    ok = ok && get_varint(&p, end, &delta);
+    fields.timestamp_us += delta;
+    for (int i = 0; i < SENSOR_COUNT && ok; ++i)
+    {
+        ok = get_varint(&p, end, &delta);
+        fields.raw[i] += delta;
+    }
+    for (int i = 0; i < SENSOR_COUNT && ok && entry->has_filtered; ++i)
+    {
+        ok = get_varint(&p, end, &delta);
+        fields.filtered[i] += delta;
+    }
+    ok = ok && get_varint(&p, end, &delta);
+    fields.state += delta;
+    ok = ok && get_varint(&p, end, &delta);
+    fields.pressed += delta;
+    if (!ok || p != end)
+    {
+        reader->corrupt++;
+        reader->synced = false;
+        return false;
+    }
+
+    if (reader->records && fields.sequence > reader->last.sequence + 1)
+    {
+        reader->missing += fields.sequence - reader->last.sequence - 1;
+    }
+    reader->synced = true;
+    reader->last = fields;
+
+    entry->sequence = fields.sequence;
+    entry->timestamp_us = fields.timestamp_us;
+    memcpy(entry->raw, fields.raw, sizeof(entry->raw));
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        entry->filtered[i] = (float)fields.filtered[i] / SENSOR_LOG_FILTER_SCALE;
+    }
+    entry->state = fields.state;
+    entry->pressed = fields.pressed;
+    reader->records++;
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef SENSOR_LOG_READER_H__
+#define SENSOR_LOG_READER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sensor_log.h"
+
+// Decoder for the binary sensor log described in main/sensor_log.h.
+
+typedef struct
+{
+    uint32_t sequence;
+    int64_t timestamp_us;
+    uint32_t raw[SENSOR_COUNT];
+    bool has_filtered;
+    float filtered[SENSOR_COUNT];
+    uint32_t state;
+    uint32_t pressed;
+} sensor_log_entry_t;
+
+// Fields as encoded, which the next record is a difference from.
+typedef struct
+{
+    uint32_t sequence;
+    int64_t timestamp_us;
+    uint32_t raw[SENSOR_COUNT];
+    int32_t filtered[SENSOR_COUNT];
+    uint32_t state;
+    uint32_t pressed;
+} sensor_log_fields_t;
+
+typedef struct
+{
+    bool synced;
+    sensor_log_fields_t last;
+
+    uint32_t records;
+    // Lines that failed to decode or did not match their CRC.
+    uint32_t corrupt;
+    // Delta records skipped while waiting for a keyframe.
+    uint32_t unsynced;
+    // Frames missing between decoded records, whether dropped, corrupt or skipped.
+    uint32_t missing;
+} sensor_log_reader_t;
+
+void sensor_log_reader_init(sensor_log_reader_t *reader);
+
+// Decodes the record in a line of console output, if it holds one. The line may
+// carry other text before the record. Returns true with entry filled in.
+bool sensor_log_reader_line(sensor_log_reader_t *reader, const char *line, size_t length, sensor_log_entry_t *entry);
+
+#endif
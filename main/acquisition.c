@@ -0,0 +1,221 @@
+#include <string.h>
+#include "soc/soc_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_oneshot.h"
+
+#include "constants.h"
+#include "acquisition.h"
+#include "decimator.h"
+
+const static char *TAG = "ACQUISITION";
+
+static adc_channel_t adc_channels[] = SENSOR_ADC_CHANNELS;
+static acquisition_stats_t stats;
+
+#ifdef ADC_CONTINUOUS_MODE
+
+#define ACQUISITION_SCAN_RATE_HZ (SENSOR_FRAME_RATE_HZ * ADC_SCANS_PER_FRAME)
+#define ACQUISITION_SCAN_PERIOD_US (1000000 / ACQUISITION_SCAN_RATE_HZ)
+// One DMA frame per sensor frame, so the driver interrupts once per frame.
+#define ACQUISITION_DMA_FRAME_BYTES (ADC_SCANS_PER_FRAME * ADC_SENSOR_COUNT * SOC_ADC_DIGI_RESULT_BYTES)
+// The pool holds this many frames. A reader that falls further behind loses the
+// backlog rather than working through stale data.
+#define ACQUISITION_POOL_FRAMES 4
+
+// Position of each ADC channel in the scan pattern, -1 if unused.
+static int8_t channel_slot[SOC_ADC_MAX_CHANNEL_NUM];
+
+static adc_continuous_handle_t adc_handle;
+static volatile uint32_t pool_overflows = 0;
+static uint32_t seen_pool_overflows = 0;
+
+// Large enough to drain the pool in one read, which resync_after_overrun relies on.
+static uint8_t dma_buf[ACQUISITION_DMA_FRAME_BYTES * ACQUISITION_POOL_FRAMES];
+static uint32_t dma_buf_len = 0;
+static uint32_t dma_buf_pos = 0;
+
+static uint32_t scan[ADC_SENSOR_COUNT];
+static cic_decimator decimator;
+static int next_slot = 0;
+// Complete scans since start, counting the ones lost to overruns.
+static uint32_t scan_count = 0;
+static int64_t start_us;
+
+static bool on_pool_ovf(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+{
+    pool_overflows++;
+    return false;
+}
+
+void acquisition_init(void)
+{
+    memset(channel_slot, -1, sizeof(channel_slot));
+    adc_digi_pattern_config_t pattern[ADC_SENSOR_COUNT] = {0};
+    for (int i = 0; i < ADC_SENSOR_COUNT; ++i)
+    {
+        pattern[i].atten = ADC_ATTENUATION;
+        pattern[i].channel = adc_channels[i];
+        pattern[i].unit = ADC_UNIT_1;
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+        channel_slot[adc_channels[i]] = i;
+    }
+
+    adc_continuous_handle_cfg_t handle_config = {
+        .max_store_buf_size = ACQUISITION_DMA_FRAME_BYTES * ACQUISITION_POOL_FRAMES,
+        .conv_frame_size = ACQUISITION_DMA_FRAME_BYTES,
+        .flags.flush_pool = 1,
+    };
+    ESP_ERROR_CHECK(cic_decimator_init(&decimator, ADC_DECIMATOR_ORDER, ADC_SCANS_PER_FRAME));
+
+    ESP_ERROR_CHECK(adc_continuous_new_handle(&handle_config, &adc_handle));
+
+    adc_continuous_config_t config = {
+        .pattern_num = ADC_SENSOR_COUNT,
+        .adc_pattern = pattern,
+        .sample_freq_hz = ACQUISITION_SCAN_RATE_HZ * ADC_SENSOR_COUNT,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE2,
+    };
+    ESP_ERROR_CHECK(adc_continuous_config(adc_handle, &config));
+
+    adc_continuous_evt_cbs_t cbs = {
+        .on_pool_ovf = on_pool_ovf,
+    };
+    ESP_ERROR_CHECK(adc_continuous_register_event_callbacks(adc_handle, &cbs, NULL));
+
+    start_us = esp_timer_get_time();
+    ESP_ERROR_CHECK(adc_continuous_start(adc_handle));
+    ESP_LOGI(TAG, "Scanning %d channels at %d Hz, order %d CIC decimating by %d", ADC_SENSOR_COUNT, ACQUISITION_SCAN_RATE_HZ, ADC_DECIMATOR_ORDER, ADC_SCANS_PER_FRAME);
+}
+
+// Everything the pool held before the flush is gone. Called right after the first
+// read that follows an overflow: restart on a scan boundary and take the scan count
+// from the clock. DMA frames complete on frame boundaries, so if the read drained
+// the pool its data ends at the last whole frame.
+static void resync_after_overrun(uint32_t overflows)
+{
+    stats.overruns += overflows - seen_pool_overflows;
+    seen_pool_overflows = overflows;
+
+    stats.discarded_conversions += next_slot;
+    next_slot = 0;
+    cic_decimator_reset(&decimator);
+
+    // A frame is complete once its last conversion is, one conversion before its period ends.
+    int64_t elapsed_us = esp_timer_get_time() - start_us + ACQUISITION_SCAN_PERIOD_US / ADC_SENSOR_COUNT;
+    int64_t completed_frames = elapsed_us / (ACQUISITION_SCAN_PERIOD_US * ADC_SCANS_PER_FRAME);
+    int64_t resume_scan = completed_frames * ADC_SCANS_PER_FRAME - dma_buf_len / (ADC_SENSOR_COUNT * SOC_ADC_DIGI_RESULT_BYTES);
+    if (resume_scan > scan_count)
+    {
+        stats.dropped_scans += resume_scan - scan_count;
+        scan_count = resume_scan;
+    }
+}
+
+// Places one conversion in the scan being assembled. Returns true when it completes the scan.
+static bool accept_conversion(const adc_digi_output_data_t *result)
+{
+    int slot = result->type2.channel < SOC_ADC_MAX_CHANNEL_NUM ? channel_slot[result->type2.channel] : -1;
+    if (slot != next_slot)
+    {
+        // Out of pattern order: drop the partial scan and wait for the pattern to start over.
+        stats.discarded_conversions += next_slot + 1;
+        next_slot = 0;
+        if (slot != 0)
+        {
+            return false;
+        }
+        stats.discarded_conversions--;
+    }
+    scan[slot] = result->type2.data;
+    if (++next_slot < ADC_SENSOR_COUNT)
+    {
+        return false;
+    }
+    next_slot = 0;
+    scan_count++;
+    stats.scans++;
+    return true;
+}
+
+bool acquisition_read_frame(sensor_frame_t *frame, uint32_t timeout_ms)
+{
+    while (1)
+    {
+        while (dma_buf_pos < dma_buf_len)
+        {
+            const adc_digi_output_data_t *result = (const adc_digi_output_data_t *)&dma_buf[dma_buf_pos];
+            dma_buf_pos += SOC_ADC_DIGI_RESULT_BYTES;
+            if (accept_conversion(result) && cic_decimator_push(&decimator, scan, frame->adc_raw))
+            {
+                frame->sequence = scan_count / ADC_SCANS_PER_FRAME - 1;
+                frame->timestamp_us = start_us + (int64_t)(scan_count - 1) * ACQUISITION_SCAN_PERIOD_US;
+                stats.frames++;
+                return true;
+            }
+        }
+
+        dma_buf_pos = 0;
+        esp_err_t ret = adc_continuous_read(adc_handle, dma_buf, sizeof(dma_buf), &dma_buf_len, timeout_ms);
+        if (ret == ESP_ERR_TIMEOUT)
+        {
+            dma_buf_len = 0;
+            return false;
+        }
+        ESP_ERROR_CHECK(ret);
+        uint32_t overflows = pool_overflows;
+        if (overflows != seen_pool_overflows)
+        {
+            resync_after_overrun(overflows);
+        }
+    }
+}
+
+#else
+
+// Oneshot fallback: the channels are read one after another when a frame is asked
+// for, so the caller sets the rate.
+static adc_oneshot_unit_handle_t adc1_handle;
+
+void acquisition_init(void)
+{
+    adc_oneshot_unit_init_cfg_t init_config1 = {
+        .unit_id = ADC_UNIT_1,
+    };
+    ESP_ERROR_CHECK(adc_oneshot_new_unit(&init_config1, &adc1_handle));
+
+    adc_oneshot_chan_cfg_t config = {
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+        .atten = ADC_ATTENUATION,
+    };
+
+    for (int i = 0; i < ADC_SENSOR_COUNT; ++i)
+    {
+        ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, adc_channels[i], &config));
+    }
+    ESP_LOGI(TAG, "Reading %d channels with oneshot reads", ADC_SENSOR_COUNT);
+}
+
+bool acquisition_read_frame(sensor_frame_t *frame, uint32_t timeout_ms)
+{
+    frame->sequence = stats.frames;
+    frame->timestamp_us = esp_timer_get_time();
+    for (int i = 0; i < ADC_SENSOR_COUNT; ++i)
+    {
+        int tmp;
+        ESP_ERROR_CHECK(adc_oneshot_read(adc1_handle, adc_channels[i], &tmp));
+        frame->adc_raw[i] = tmp;
+    }
+    stats.frames++;
+    stats.scans++;
+    return true;
+}
+
+#endif
+
+acquisition_stats_t acquisition_get_stats(void)
+{
+    return stats;
+}
@@ -0,0 +1,52 @@
+#ifndef ACQUISITION_H__
+#define ACQUISITION_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "constants.h"
+#include "sensor_mask.h"
+
+// Acquisition of the ADC sensors. In ADC_CONTINUOUS_MODE the converter scans
+// every channel in SENSOR_ADC_CHANNELS as one DMA pattern, ADC_SCANS_PER_FRAME
+// times per frame, and a CIC decimator (decimator.h) reduces the scans to one
+// frame. Otherwise each frame is one round of adc_oneshot reads.
+
+typedef struct
+{
+    // Frame index since acquisition_init. A gap means frames were lost to an
+    // overrun, or held back while the decimator refilled.
+    uint32_t sequence;
+    // esp_timer time at which the frame's last scan started. The channels follow
+    // in pattern order within one scan period; the readings themselves lag by the
+    // decimator's group delay.
+    int64_t timestamp_us;
+    // Decimated readings in SENSOR_ADC_CHANNELS order, in ADC counts.
+    uint32_t adc_raw[ADC_SENSOR_COUNT];
+
+    // Filled in by the filter stage before the frame leaves the sampler.
+    sensor_mask_t pressed;
+    // Encoding sensors as bits, as returned by pressure_sensor_read.
+    char pins;
+} sensor_frame_t;
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t scans;
+    // DMA pool overflows reported by the driver; each flushes the buffered scans.
+    uint32_t overruns;
+    uint32_t dropped_scans;
+    // Conversions that did not line up with the scan pattern and were skipped.
+    uint32_t discarded_conversions;
+} acquisition_stats_t;
+
+void acquisition_init(void);
+
+// Continuous mode: blocks until the next frame is complete, and returns false if
+// the driver had no data within timeout_ms. Oneshot mode: reads the channels now.
+bool acquisition_read_frame(sensor_frame_t *frame, uint32_t timeout_ms);
+
+acquisition_stats_t acquisition_get_stats(void);
+
+#endif
@@ -0,0 +1,207 @@
+#include <stdlib.h>
+
+#include "esp_log.h"
+
+#include "filter.h"
+#include "constants.h"
+#include "autocal_filter.h"
+#include "state.h"
+#include "sensor_log.h"
+
+const static char *TAG = "FILTER";
+
+// Presses move the reading up with a common positive, down otherwise.
+#ifdef ADC_COMMON_POSITIVE
+#define PRESS_DIRECTION 1.0f
+#else
+#define PRESS_DIRECTION -1.0f
+#endif
+
+typedef struct
+{
+    float smoothed[SENSOR_COUNT];
+    float baseline[SENSOR_COUNT];
+    float variance[SENSOR_COUNT];
+
+    int consecutive_movement[SENSOR_COUNT];
+    int held_frames[SENSOR_COUNT];
+    // Idle frames too far from the baseline to learn from, without being in
+    // press range, since the last one it learned from: a step the other way, or
+    // one too small to press.
+    int drift_frames[SENSOR_COUNT];
+    // Largest delta of the current press.
+    float peak[SENSOR_COUNT];
+    // Released but not yet back under the press threshold.
+    bool rearming[SENSOR_COUNT];
+    bool started;
+
+    // Per-frame weights of the averages, from the time constants.
+    float smoothing_weight;
+    float baseline_weight;
+    float press_variances;
+    float release_variances;
+    float min_variance;
+    int max_hold_frames;
+
+    autocal_filter_params params;
+} autocal_filter_data;
+
+static void autocal_filter_start(autocal_filter_data *data, uint32_t *adc_raw)
+{
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        data->smoothed[i] = (float)adc_raw[i];
+        data->baseline[i] = (float)adc_raw[i];
+        data->variance[i] = data->min_variance;
+        data->consecutive_movement[i] = 0;
+        data->held_frames[i] = 0;
+        data->drift_frames[i] = 0;
+        data->rearming[i] = false;
+    }
+    data->started = true;
+}
+
+// A press or release tail that never ends, or an idle reading that stays out of
+// range, is the sensor settling somewhere new.
+static void autocal_filter_rebase(autocal_filter_data *data, int i)
+{
+    ESP_LOGI(TAG, "Sensor %d out of range for %.0f s, moving its baseline", i, data->params.max_hold_seconds);
+    data->baseline[i] = data->smoothed[i];
+    data->rearming[i] = false;
+    data->drift_frames[i] = 0;
+}
+
+void autocal_filter_process(filter_handle_t filter_handle, uint32_t *adc_raw, sensor_mask_t *pressed)
+{
+    autocal_filter_data *data = (autocal_filter_data *)filter_handle->filter_data;
+    if (!data->started)
+    {
+        autocal_filter_start(data, adc_raw);
+    }
+
+    float deltas[SENSOR_COUNT];
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        float in = (float)adc_raw[i];
+        data->smoothed[i] += data->smoothing_weight * (in - data->smoothed[i]);
+        float delta = PRESS_DIRECTION * (data->smoothed[i] - data->baseline[i]);
+        deltas[i] = delta;
+
+        if (!sensor_mask_test(*pressed, i))
+        {
+            // Idle: learn the baseline and the noise around it. Readings in press
+            // range are left out, or presses and release tails would inflate the
+            // variance, and with it the next threshold.
+            float deviation = in - data->baseline[i];
+            if (deviation * deviation <= data->press_variances * data->variance[i])
+            {
+                data->baseline[i] += data->baseline_weight * deviation;
+                data->variance[i] = (1 - data->baseline_weight) * (data->variance[i] + data->baseline_weight * deviation * deviation);
+                data->variance[i] = data->variance[i] > data->min_variance ? data->variance[i] : data->min_variance;
+                data->drift_frames[i] = 0;
+            }
+            else if ((delta <= data->params.min_delta || delta * delta <= data->press_variances * data->variance[i]) &&
+                     ++data->drift_frames[i] > data->max_hold_frames)
+            {
+                // Out of range and not pressing, which learning alone would never
+                // leave: the baseline follows, as it does for a press that never ends.
+                // Presses in between do not restart the count, or typing would
+                // keep the baseline where it was.
+                autocal_filter_rebase(data, i);
+                delta = PRESS_DIRECTION * (data->smoothed[i] - data->baseline[i]);
+                deltas[i] = delta;
+            }
+
+            // Squared, to compare with the variance without a square root.
+            bool pressing = delta > data->params.min_delta && delta * delta > data->press_variances * data->variance[i];
+            if (data->rearming[i])
+            {
+                // After a release, a new press starts only once the reading has
+                // dropped out of press range.
+                data->rearming[i] = pressing;
+                if (pressing && ++data->held_frames[i] > data->max_hold_frames)
+                {
+                    autocal_filter_rebase(data, i);
+                }
+                continue;
+            }
+            data->consecutive_movement[i] = pressing ? data->consecutive_movement[i] + 1 : 0;
+            if (data->consecutive_movement[i] > data->params.debounce_count)
+            {
+                *pressed |= SENSOR_MASK_BIT(i);
+                data->consecutive_movement[i] = 0;
+                data->held_frames[i] = 0;
+                data->peak[i] = delta;
+            }
+        }
+        else if (delta < data->params.release_fraction * data->peak[i] ||
+                 delta * delta < data->release_variances * data->variance[i])
+        {
+            *pressed &= ~SENSOR_MASK_BIT(i);
+            data->rearming[i] = true;
+        }
+        else if (++data->held_frames[i] > data->max_hold_frames)
+        {
+            autocal_filter_rebase(data, i);
+            *pressed &= ~SENSOR_MASK_BIT(i);
+        }
+        else
+        {
+            data->peak[i] = delta > data->peak[i] ? delta : data->peak[i];
+        }
+    }
+    if (test_state(KEYBOARD_STATE_SENSOR_LOGGING))
+    {
+        sensor_log_filtered(deltas);
+    }
+}
+
+void autocal_filter_calibration_start(filter_handle_t filter_handle, uint32_t *adc_raw)
+{
+    ESP_LOGI(TAG, "Enter calibration: restarting baselines");
+    autocal_filter_data *data = (autocal_filter_data *)filter_handle->filter_data;
+    autocal_filter_start(data, adc_raw);
+}
+
+void autocal_filter_calibration_end(filter_handle_t filter_handle, uint32_t *adc_raw) {}
+
+void *init_autocal_filter(autocal_filter_params *params)
+{
+    filter_handle_t filter_handle = malloc(sizeof(filter));
+    filter_handle->self = filter_handle;
+    filter_handle->process = autocal_filter_process;
+    filter_handle->calibrate_start = autocal_filter_calibration_start;
+    filter_handle->calibrate_end = autocal_filter_calibration_end;
+    filter_handle->reconfigure = NULL;
+    filter_handle->save = NULL;
+    filter_handle->restore = NULL;
+
+    autocal_filter_data *data = calloc(1, sizeof(autocal_filter_data));
+    data->params = *params;
+    data->smoothing_weight = 1 / (1 + params->smoothing_seconds * params->sample_rate);
+    data->baseline_weight = 1 / (1 + params->baseline_seconds * params->sample_rate);
+    data->press_variances = params->press_deviations * params->press_deviations;
+    data->release_variances = params->release_deviations * params->release_deviations;
+    data->min_variance = params->min_deviation * params->min_deviation;
+    data->max_hold_frames = params->max_hold_seconds * params->sample_rate;
+    filter_handle->filter_data = (void *)data;
+
+    return filter_handle;
+}
+
+static autocal_filter_params default_filter_params = {
+    .sample_rate = SENSOR_FRAME_RATE_HZ,
+    .smoothing_seconds = 0.03,
+    .baseline_seconds = 5,
+    .press_deviations = 6,
+    .release_deviations = 3,
+    .release_fraction = 0.5,
+    .min_delta = 20,
+    .min_deviation = 2,
+    .debounce_count = 1,
+    .max_hold_seconds = 30};
+
+void *init_autocal_filter_default(void)
+{
+    return init_autocal_filter(&default_filter_params);
+}
@@ -0,0 +1,51 @@
+#ifndef AUTOCAL_FILTER_H__
+#define AUTOCAL_FILTER_H__
+
+#include <stdbool.h>
+
+#include "constants.h"
+
+// Filter that calibrates itself continuously, so neither the calibration jumper
+// nor a calibration pause is needed. The firmware version of
+// autocalibrateWithStandardDev in util/parse.py.
+//
+// Per sensor it keeps a short smoothing average of the reading, and a slow
+// baseline with the variance of the reading around it. Both are exponentially
+// weighted, so each is a couple of multiply-adds per frame with no history
+// buffer. A sensor is pressed once the smoothed reading moves from the
+// baseline by press_deviations standard deviations (and at least min_delta
+// counts). It is released when the reading falls below release_fraction of
+// the press's peak, or back within release_deviations of the baseline.
+//
+// The statistics only learn from idle readings, so a held key does not become
+// the new baseline. A press (or release) longer than max_hold_seconds is taken
+// to be a shift in the sensor instead: the baseline jumps to the reading. So is
+// an idle reading that stays too far from the baseline to learn from for as
+// long without pressing, such as a step away from the press direction. Starting
+// calibration with the jumper also restarts the statistics from the current
+// readings.
+
+typedef struct
+{
+    float sample_rate;
+    // Time constants of the smoothing average and of the baseline and variance.
+    float smoothing_seconds;
+    float baseline_seconds;
+
+    float press_deviations;
+    float release_deviations;
+    float release_fraction;
+    // In ADC counts: the smallest press, and a floor on the standard deviation
+    // for sensors that are quieter than the ADC's resolution.
+    float min_delta;
+    float min_deviation;
+
+    // Extra frames a press must last, as in iir_filter_params.
+    int debounce_count;
+    float max_hold_seconds;
+} autocal_filter_params;
+
+void *init_autocal_filter(autocal_filter_params *params);
+void *init_autocal_filter_default(void);
+
+#endif
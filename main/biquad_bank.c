@@ -0,0 +1,108 @@
+#include <string.h>
+
+#include "biquad_bank.h"
+
+// Vector v of a frame; lanes past SENSOR_COUNT read zero. Whole vectors are one
+// unaligned load, and with the loops unrolled the test is resolved at compile time.
+static inline biquad_bank_vector load_vector(const float *frame, int v)
+{
+    biquad_bank_vector x = {0};
+    if ((v + 1) * BIQUAD_BANK_LANES <= (SENSOR_COUNT))
+    {
+        memcpy(&x, &frame[v * BIQUAD_BANK_LANES], sizeof(x));
+    }
+    else
+    {
+        for (int lane = 0; lane < (SENSOR_COUNT) - v * BIQUAD_BANK_LANES; ++lane)
+        {
+            x[lane] = frame[v * BIQUAD_BANK_LANES + lane];
+        }
+    }
+    return x;
+}
+
+static inline void store_vector(float *frame, int v, biquad_bank_vector y)
+{
+    if ((v + 1) * BIQUAD_BANK_LANES <= (SENSOR_COUNT))
+    {
+        memcpy(&frame[v * BIQUAD_BANK_LANES], &y, sizeof(y));
+    }
+    else
+    {
+        for (int lane = 0; lane < (SENSOR_COUNT) - v * BIQUAD_BANK_LANES; ++lane)
+        {
+            frame[v * BIQUAD_BANK_LANES + lane] = y[lane];
+        }
+    }
+}
+
+void biquad_bank_init(biquad_bank *bank)
+{
+    memset(bank, 0, sizeof(*bank));
+}
+
+void biquad_bank_set(biquad_bank *bank, int channel, const float *coeffs)
+{
+    int v = channel / BIQUAD_BANK_LANES;
+    int lane = channel % BIQUAD_BANK_LANES;
+    bank->b0[v][lane] = coeffs[0];
+    bank->b1[v][lane] = coeffs[1];
+    bank->b2[v][lane] = coeffs[2];
+    bank->a1[v][lane] = coeffs[3];
+    bank->a2[v][lane] = coeffs[4];
+}
+
+void biquad_bank_reset(biquad_bank *bank)
+{
+    memset(bank->w0, 0, sizeof(bank->w0));
+    memset(bank->w1, 0, sizeof(bank->w1));
+}
+
+void biquad_bank_settle(biquad_bank *bank, const float *in)
+{
+    for (int v = 0; v < BIQUAD_BANK_VECTORS; ++v)
+    {
+        // Direct form II at rest: w = x - a1 w - a2 w.
+        biquad_bank_vector gain = 1 + bank->a1[v] + bank->a2[v];
+        biquad_bank_vector x = load_vector(in, v);
+        for (int lane = 0; lane < BIQUAD_BANK_LANES; ++lane)
+        {
+            float w = gain[lane] != 0 ? x[lane] / gain[lane] : 0;
+            bank->w0[v][lane] = w;
+            bank->w1[v][lane] = w;
+        }
+    }
+}
+
+void biquad_bank_process(biquad_bank *bank, const float *in, float *out)
+{
+    biquad_bank_process_block(bank, in, out, 1);
+}
+
+void biquad_bank_process_block(biquad_bank *bank, const float *in, float *out, int count)
+{
+    // State stays in locals (registers, where there are enough) for the whole block.
+    biquad_bank_vector w0[BIQUAD_BANK_VECTORS];
+    biquad_bank_vector w1[BIQUAD_BANK_VECTORS];
+    memcpy(w0, bank->w0, sizeof(w0));
+    memcpy(w1, bank->w1, sizeof(w1));
+
+    for (int n = 0; n < count; ++n)
+    {
+        const float *x = &in[n * (SENSOR_COUNT)];
+        float *y = &out[n * (SENSOR_COUNT)];
+        // Unrolled so the state never goes through memory between frames.
+#pragma GCC unroll 8
+        for (int v = 0; v < BIQUAD_BANK_VECTORS; ++v)
+        {
+            // Same order as dsps_biquad_f32_ansi.
+            biquad_bank_vector d0 = load_vector(x, v) - bank->a1[v] * w0[v] - bank->a2[v] * w1[v];
+            store_vector(y, v, bank->b0[v] * d0 + bank->b1[v] * w0[v] + bank->b2[v] * w1[v]);
+            w1[v] = w0[v];
+            w0[v] = d0;
+        }
+    }
+
+    memcpy(bank->w0, w0, sizeof(w0));
+    memcpy(bank->w1, w1, sizeof(w1));
+}
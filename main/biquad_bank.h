@@ -0,0 +1,60 @@
+#ifndef BIQUAD_BANK_H__
+#define BIQUAD_BANK_H__
+
+#include "constants.h"
+
+// One biquad per sensor, advanced together. Coefficients and state are stored
+// per term across channels (structure of arrays), padded to whole vectors, so a
+// frame is a handful of vector multiply-adds instead of SENSOR_COUNT calls of
+// dsps_biquad_f32_ansi with a length of 1.
+//
+// Each lane does the same operations in the same order as dsps_biquad_f32_ansi
+// (direct form II, coefficients b0 b1 b2 a1 a2), so the output is identical as
+// long as both are compiled with the same floating-point contraction.
+// host/bench/bench_biquad checks this.
+//
+// The vectors are GCC generic vectors: SSE/NEON on a host, and split into scalar
+// FPU operations on the ESP32-S3, whose PIE vector unit has no float arithmetic.
+
+#define BIQUAD_BANK_LANES 4
+#define BIQUAD_BANK_VECTORS ((SENSOR_COUNT + BIQUAD_BANK_LANES - 1) / BIQUAD_BANK_LANES)
+
+// Only float-aligned, so a bank can live in memory from malloc (8-byte aligned on
+// the ESP32-S3).
+typedef float biquad_bank_vector __attribute__((vector_size(BIQUAD_BANK_LANES * sizeof(float)), aligned(sizeof(float))));
+
+typedef struct
+{
+    biquad_bank_vector b0[BIQUAD_BANK_VECTORS];
+    biquad_bank_vector b1[BIQUAD_BANK_VECTORS];
+    biquad_bank_vector b2[BIQUAD_BANK_VECTORS];
+    biquad_bank_vector a1[BIQUAD_BANK_VECTORS];
+    biquad_bank_vector a2[BIQUAD_BANK_VECTORS];
+    biquad_bank_vector w0[BIQUAD_BANK_VECTORS];
+    biquad_bank_vector w1[BIQUAD_BANK_VECTORS];
+} biquad_bank;
+
+// All coefficients and state zero: every channel outputs zero.
+void biquad_bank_init(biquad_bank *bank);
+
+// Coefficients of one channel, in the esp-dsp order {b0, b1, b2, a1, a2}. The
+// channel's state is kept.
+void biquad_bank_set(biquad_bank *bank, int channel, const float *coeffs);
+
+// Clears the state of every channel.
+void biquad_bank_reset(biquad_bank *bank);
+
+// Sets every channel's state to where a long run of the constant input in would
+// have left it, so new coefficients start on a running signal without a step
+// transient. For filters that block DC the next output is then that of the
+// change in input alone.
+void biquad_bank_settle(biquad_bank *bank, const float *in);
+
+// Advances every channel by one sample. in and out hold SENSOR_COUNT values.
+void biquad_bank_process(biquad_bank *bank, const float *in, float *out);
+
+// Advances every channel by count samples. in and out hold count frames of
+// SENSOR_COUNT values each; they may be the same buffer.
+void biquad_bank_process_block(biquad_bank *bank, const float *in, float *out, int count);
+
+#endif
@@ -1,3 +1,4 @@
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,6 +16,7 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "esp_bt.h"
 
@@ -27,6 +29,32 @@ const static char *TAG = "BT";
 uint16_t hid_conn_id = 0;
 esp_bd_addr_t passkey_response_addr;
 
+// Time since boot of the first key sent, or -1.
+static int64_t first_key_us = -1;
+
+#define BT_REPORT_QUEUE_MASK (BT_REPORT_QUEUE_LENGTH - 1)
+
+_Static_assert((BT_REPORT_QUEUE_LENGTH & BT_REPORT_QUEUE_MASK) == 0, "BT_REPORT_QUEUE_LENGTH must be a power of two");
+
+typedef struct
+{
+    key_mask_t mask;
+    keyboard_cmd_t key;
+} bt_report;
+
+// Only hid_task touches the queue. Reports are numbered as queued; the queue
+// holds [report_sent, report_queued).
+static bt_report report_queue[BT_REPORT_QUEUE_LENGTH];
+static uint32_t report_queued;
+static uint32_t report_sent;
+static bt_report last_report;
+// The key typed ahead and not yet confirmed, and the number of its press report.
+static bool typed_ahead;
+static bt_report typed_ahead_report;
+static uint32_t typed_ahead_number;
+// Set by the BT task on a disconnect; hid_task then empties the queue.
+static atomic_bool disconnected;
+
 static void hidd_event_callback(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *param);
 
 #define HIDD_DEVICE_NAME "PAWBOARD"
@@ -200,6 +228,7 @@ static void hidd_event_callback(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *
     {
         update_bt_state(KEYBOARD_STATE_BT_UNCONNECTED);
         ESP_LOGI(TAG, "ESP_HIDD_EVENT_BLE_DISCONNECT");
+        atomic_store(&disconnected, true);
         esp_ble_gap_start_advertising(&hidd_adv_params);
         break;
     }
@@ -315,15 +344,119 @@ void bt_init(void)
 void bt_send(key_mask_t mask, keyboard_cmd_t key)
 {
     ESP_LOGI(TAG, "Send key | %d | %d", mask, key);
+    if (key && first_key_us < 0)
+    {
+        first_key_us = esp_timer_get_time();
+        ESP_LOGI(TAG, "First key %lld ms after boot", first_key_us / 1000);
+    }
     uint8_t key_value[] = {0};
     key_value[0] = key;
 
     esp_hidd_send_keyboard_value(hid_conn_id, mask, key_value, (key ? 1 : 0));
 }
 
+// hid_task side, before any use of the queue: after a disconnect, nothing is
+// sent or taken back on the next host.
+static void take_disconnect(void)
+{
+    if (atomic_exchange(&disconnected, false))
+    {
+        report_sent = report_queued;
+        typed_ahead = false;
+    }
+}
+
+// Press and release, or nothing if the queue is full.
+static bool queue_key(key_mask_t mask, keyboard_cmd_t key)
+{
+    if (report_queued - report_sent > BT_REPORT_QUEUE_LENGTH - 2)
+    {
+        ESP_LOGW(TAG, "Report queue full, dropping key %d", key);
+        return false;
+    }
+    report_queue[report_queued++ & BT_REPORT_QUEUE_MASK] = (bt_report){mask, key};
+    report_queue[report_queued++ & BT_REPORT_QUEUE_MASK] = (bt_report){mask, 0};
+    return true;
+}
+
+// Characters, and only with shift, so that a backspace undoes them.
+static bool retractable(key_mask_t mask, keyboard_cmd_t key)
+{
+    return !(mask & ~(LEFT_SHIFT_KEY_MASK | RIGHT_SHIFT_KEY_MASK)) &&
+           ((key >= HID_KEY_A && key <= HID_KEY_0) || key == HID_KEY_SPACEBAR);
+}
+
+void bt_retract(void)
+{
+    take_disconnect();
+    if (!typed_ahead)
+    {
+        return;
+    }
+    typed_ahead = false;
+    if (report_sent <= typed_ahead_number)
+    {
+        // Still waiting, and the last key queued.
+        ESP_LOGI(TAG, "Drop key | %d | %d", typed_ahead_report.mask, typed_ahead_report.key);
+        report_queued = typed_ahead_number;
+        return;
+    }
+    ESP_LOGI(TAG, "Retract key | %d | %d", typed_ahead_report.mask, typed_ahead_report.key);
+    queue_key(0, HID_KEY_DELETE);
+}
+
+void bt_type_ahead(key_mask_t mask, keyboard_cmd_t key)
+{
+    take_disconnect();
+    bt_retract();
+    if (!retractable(mask, key))
+    {
+        return;
+    }
+    uint32_t number = report_queued;
+    if (queue_key(mask, key))
+    {
+        typed_ahead = true;
+        typed_ahead_report = (bt_report){mask, key};
+        typed_ahead_number = number;
+    }
+}
+
+void bt_type(key_mask_t mask, keyboard_cmd_t key)
+{
+    take_disconnect();
+    if (typed_ahead && typed_ahead_report.mask == mask && typed_ahead_report.key == key)
+    {
+        typed_ahead = false;
+        return;
+    }
+    bt_retract();
+    queue_key(mask, key);
+}
+
+void bt_send_queued(key_mask_t mask)
+{
+    take_disconnect();
+    bt_report report = {mask, 0};
+    if (report_sent != report_queued)
+    {
+        report = report_queue[report_sent++ & BT_REPORT_QUEUE_MASK];
+    }
+    if (report.mask != last_report.mask || report.key != last_report.key)
+    {
+        last_report = report;
+        bt_send(report.mask, report.key);
+    }
+}
+
 char passkey_buffer[6] = {0};
 int passkey_buffer_idx = 0;
 
+int64_t bt_first_key_us(void)
+{
+    return first_key_us;
+}
+
 void bt_passkey_append(int digit)
 {
     if (digit < 0 || digit > 9)
@@ -3,10 +3,31 @@
 
 void bt_send(key_mask_t mask, keyboard_cmd_t key);
 
+// Report queue for speculative output (ENVELOPE_SPECULATIVE_OUTPUT). A key goes
+// in as a press and a release report, and bt_send_queued sends one report per
+// call, once per frame, so each press is seen for a frame as with bt_send.
+//
+// bt_type_ahead types a key before its chord is accepted; only characters, which
+// a backspace undoes, are typed ahead. bt_type then types the accepted key, or
+// confirms the one typed ahead if it is the same. bt_retract takes the key typed
+// ahead back: dropped from the queue while its press is still waiting, or else
+// deleted with HID_KEY_DELETE.
+// Reports, a power of two.
+#define BT_REPORT_QUEUE_LENGTH 16
+
+void bt_type(key_mask_t mask, keyboard_cmd_t key);
+void bt_type_ahead(key_mask_t mask, keyboard_cmd_t key);
+void bt_retract(void);
+// Sends the next report queued, or mask alone when it changed and nothing is queued.
+void bt_send_queued(key_mask_t mask);
+
 void bt_passkey_process(char number);
 
 void bt_init(void);
 
+// Time since boot of the first keystroke sent to the host, or -1 before it.
+int64_t bt_first_key_us(void);
+
 esp_err_t ble_register_profile(uint16_t app_id, esp_gatts_cb_t callback);
 
 #endif
\ No newline at end of file
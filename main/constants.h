@@ -5,12 +5,38 @@
 #include "hal/touch_sensor_types.h"
 
 
-#define POLLING_PERIOD_MS = 50;
-#define WAIT_TO_CONFIRM_INPUT_MS = 300;
-#define SEND_FEEDBACK_TIME_MS = 300;
-
-#define MAX_ENVELOPE_LENGTH_USEC 2000000;
-#define ENVELOPE_GRACE_PERIOD_USEC  100000;
+#define POLLING_PERIOD_MS 50
+#define WAIT_TO_CONFIRM_INPUT_MS 300
+#define SEND_FEEDBACK_TIME_MS 300
+
+#define MAX_ENVELOPE_LENGTH_USEC 2000000
+#define ENVELOPE_GRACE_PERIOD_USEC 100000
+// Learn the grace period and the reject window from the typist's chords, within
+// these bounds and the two above, and keep them in NVS (envelope_timing.h).
+// Holding all five past MAX_ENVELOPE_LENGTH_USEC is still the grip. Compare with
+// host/tools/log_replay -l.
+// #define ENVELOPE_ADAPTIVE_TIMING
+#define ENVELOPE_GRACE_MIN_USEC 40000
+#define ENVELOPE_REJECT_MIN_USEC 1000000
+// Accept each chord once it can no longer change instead of a grace period after
+// the last finger lifts: once a finger has lifted and no sensor has joined for a
+// commit window, which grows from ENVELOPE_EARLY_COMMIT_MIN_USEC to cover the
+// typist's late presses (encoding.h). Compare with host/tools/log_replay -c.
+// #define ENVELOPE_EARLY_COMMIT
+#define ENVELOPE_EARLY_COMMIT_MIN_USEC 30000
+// Type each chord ahead once it has not grown for ENVELOPE_SPECULATE_USEC, and
+// take it back with a backspace if it grows or is rejected after all. Only
+// characters are typed ahead, and no chord that has been corrected more often
+// than ENVELOPE_SPECULATE_MAX_CORRECTED_PERCENT lately (encoding.h). Compare
+// with host/tools/log_replay -a.
+// #define ENVELOPE_SPECULATIVE_OUTPUT
+#define ENVELOPE_SPECULATE_USEC 30000
+#define ENVELOPE_SPECULATE_MAX_CORRECTED_PERCENT 20
+// Let the next chord start while the last one is still releasing: once a finger
+// of the chord has lifted, sensors pressed after it open a second envelope, and
+// the first is accepted as soon as its own fingers are up (encoding.h). Compare
+// with host/tools/log_replay -r.
+// #define ENVELOPE_ROLLOVER
 
 
 #define ADC_SENSOR_COUNT 10
@@ -24,8 +50,40 @@
 // ADC on pins labeled on Arduino as A0,A1,A2,A3,D7; D2,D3,D4,D5,D6
 #define SENSOR_ADC_CHANNELS {ADC_CHANNEL_0, ADC_CHANNEL_1, ADC_CHANNEL_2, ADC_CHANNEL_3, ADC_CHANNEL_9, ADC_CHANNEL_4, ADC_CHANNEL_5, ADC_CHANNEL_6, ADC_CHANNEL_7, ADC_CHANNEL_8}
 #define ADC_ATTENUATION ADC_ATTEN_DB_2_5
+// Read the ADC with the continuous (DMA) driver. Comment out to fall back to adc_oneshot reads.
+#define ADC_CONTINUOUS_MODE
+// Frames handed to the filter per second. Matches the filter's sample_rate.
+#define SENSOR_FRAME_RATE_HZ 100
+// Continuous mode scans all channels this many times per frame and decimates the
+// scans into the frame. A fast scan also keeps the channels of a frame within one
+// scan period (1 ms here) of each other.
+#define ADC_SCANS_PER_FRAME 10
+// CIC decimator order. Each order adds (ADC_SCANS_PER_FRAME - 1) / 2 scans of delay
+// and sharper rejection of noise that would alias into the filter band. Order 1
+// keeps the delay under half a frame.
+#define ADC_DECIMATOR_ORDER 1
 // Select positive/negative for pins. Defaults to common ground
 #define ADC_COMMON_POSITIVE
+// Filter in integer arithmetic (fixed_filter.h) instead of float. Same parameters
+// and decisions, within rounding; compare them with host/tools/filter_compare.
+// #define FIXED_POINT_FILTER
+// IIR filter thresholds that keep following each sensor's press peaks and idle
+// noise after calibration (iir_filter_params.adaptive_thresholds).
+// #define IIR_ADAPTIVE_THRESHOLDS
+// Filter that calibrates itself continuously (autocal_filter.h); the calibration
+// jumper is then optional. Takes precedence over FIXED_POINT_FILTER.
+// #define AUTOCAL_FILTER
+// Measure crosstalk between sensors while the calibration jumper is set, and
+// compensate it from then on (crosstalk.h). Each calibration then expects every
+// finger pressed alone, not all together as old_filter does.
+// #define CROSSTALK_CALIBRATION
+// Filter composed of stages (filter_pipeline.h) from this spec, unless NVS holds
+// another. Takes precedence over FIXED_POINT_FILTER.
+// #define FILTER_PIPELINE "band_pass(2, 0.5) > threshold(2.5, 1, 0.5)"
+// Candidate filter pipeline (filter_pipeline.h) run in the shadow of the filter
+// selected above, which keeps driving the keys; their disagreements and cost go
+// to the console (shadow_filter.h).
+// #define SHADOW_FILTER "dc_block(0.5) > low_pass(8) > threshold(2.5, 1, 0.5)"
 
 // Technically, these shouldn't go through filtering. However, held button filters shouldn't interfere with them.
 #define DIGITAL_SENSORS {}
@@ -0,0 +1,235 @@
+#include <math.h>
+#include <string.h>
+
+#include "esp_dsp.h"
+#include "esp_log.h"
+
+#include "constants.h"
+#include "crosstalk.h"
+
+const static char *TAG = "CROSSTALK";
+
+#define N (SENSOR_COUNT)
+
+// Deviations times PRESS_SIGN grow with a press.
+#ifdef ADC_COMMON_POSITIVE
+#define PRESS_SIGN 1.0f
+#else
+#define PRESS_SIGN -1.0f
+#endif
+
+// Pivots smaller than this make the coupling singular.
+#define MIN_PIVOT 1e-3f
+
+void crosstalk_compensation_init(crosstalk_compensation *compensation)
+{
+    memset(compensation, 0, sizeof(*compensation));
+    for (int i = 0; i < N; ++i)
+    {
+        compensation->matrix[i * N + i] = 1;
+    }
+}
+
+void crosstalk_compensation_apply(const crosstalk_compensation *compensation, uint32_t *adc_raw)
+{
+    if (!compensation->enabled)
+    {
+        return;
+    }
+    float deviation[N];
+    float compensated[N];
+    for (int i = 0; i < N; ++i)
+    {
+        deviation[i] = (float)adc_raw[i] - compensation->baseline[i];
+    }
+    dspm_mult_f32(compensation->matrix, deviation, compensated, N, N, 1);
+    for (int i = 0; i < N; ++i)
+    {
+        float value = compensation->baseline[i] + compensated[i];
+        adc_raw[i] = value > 0 ? (uint32_t)lrintf(value) : 0;
+    }
+}
+
+static const crosstalk_estimator_params default_estimator_params = {
+    .press_level = 100,
+    .alone_fraction = 0.3,
+    .min_frames = 50,
+    .baseline_weight = 0.01};
+
+crosstalk_estimator_params crosstalk_estimator_default_params(void)
+{
+    return default_estimator_params;
+}
+
+void crosstalk_estimator_init(crosstalk_estimator *estimator, const crosstalk_estimator_params *params)
+{
+    memset(estimator, 0, sizeof(*estimator));
+    estimator->params = *params;
+}
+
+void crosstalk_estimator_add(crosstalk_estimator *estimator, const uint32_t *adc_raw)
+{
+    if (!estimator->started)
+    {
+        for (int i = 0; i < N; ++i)
+        {
+            estimator->baseline[i] = (float)adc_raw[i];
+        }
+        estimator->started = true;
+        return;
+    }
+
+    float deviation[N];
+    int strongest = 0;
+    for (int i = 0; i < N; ++i)
+    {
+        deviation[i] = (float)adc_raw[i] - estimator->baseline[i];
+        strongest = PRESS_SIGN * deviation[i] > PRESS_SIGN * deviation[strongest] ? i : strongest;
+    }
+    float press = PRESS_SIGN * deviation[strongest];
+    if (press < estimator->params.press_level)
+    {
+        // Idle, as far as we can tell: follow the baseline.
+        for (int i = 0; i < N; ++i)
+        {
+            estimator->baseline[i] += estimator->params.baseline_weight * deviation[i];
+        }
+        return;
+    }
+    for (int i = 0; i < N; ++i)
+    {
+        if (i != strongest && fabsf(deviation[i]) >= estimator->params.alone_fraction * press)
+        {
+            // More than one finger: a chord says nothing about a single column.
+            return;
+        }
+    }
+    for (int i = 0; i < N; ++i)
+    {
+        estimator->products[i * N + strongest] += deviation[i] * deviation[strongest];
+    }
+    estimator->energy[strongest] += deviation[strongest] * deviation[strongest];
+    estimator->frames[strongest]++;
+}
+
+int crosstalk_estimator_coupling(const crosstalk_estimator *estimator, float *coupling)
+{
+    int estimated = 0;
+    for (int j = 0; j < N; ++j)
+    {
+        bool enough = estimator->frames[j] >= estimator->params.min_frames;
+        estimated += enough;
+        for (int i = 0; i < N; ++i)
+        {
+            coupling[i * N + j] = enough ? estimator->products[i * N + j] / estimator->energy[j] : i == j;
+        }
+    }
+    return estimated;
+}
+
+// Gauss-Jordan elimination with partial pivoting. false if singular.
+static bool invert(const float *matrix, float *inverse)
+{
+    float work[N][2 * N];
+    for (int i = 0; i < N; ++i)
+    {
+        for (int j = 0; j < N; ++j)
+        {
+            work[i][j] = matrix[i * N + j];
+            work[i][N + j] = i == j;
+        }
+    }
+    for (int column = 0; column < N; ++column)
+    {
+        int pivot = column;
+        for (int i = column + 1; i < N; ++i)
+        {
+            pivot = fabsf(work[i][column]) > fabsf(work[pivot][column]) ? i : pivot;
+        }
+        if (fabsf(work[pivot][column]) < MIN_PIVOT)
+        {
+            return false;
+        }
+        if (pivot != column)
+        {
+            float row[2 * N];
+            memcpy(row, work[pivot], sizeof(row));
+            memcpy(work[pivot], work[column], sizeof(row));
+            memcpy(work[column], row, sizeof(row));
+        }
+        float scale = 1 / work[column][column];
+        for (int j = 0; j < 2 * N; ++j)
+        {
+            work[column][j] *= scale;
+        }
+        for (int i = 0; i < N; ++i)
+        {
+            float factor = work[i][column];
+            if (i == column || factor == 0)
+            {
+                continue;
+            }
+            for (int j = 0; j < 2 * N; ++j)
+            {
+                work[i][j] -= factor * work[column][j];
+            }
+        }
+    }
+    for (int i = 0; i < N; ++i)
+    {
+        memcpy(&inverse[i * N], &work[i][N], N * sizeof(float));
+    }
+    return true;
+}
+
+int crosstalk_estimator_fit(const crosstalk_estimator *estimator, crosstalk_compensation *compensation)
+{
+    float coupling[N * N];
+    int estimated = crosstalk_estimator_coupling(estimator, coupling);
+    if (!estimated)
+    {
+        ESP_LOGD(TAG, "No lone presses, keeping the compensation");
+        return 0;
+    }
+    float inverse[N * N];
+    if (!invert(coupling, inverse))
+    {
+        ESP_LOGD(TAG, "Coupling is singular, keeping the compensation");
+        return 0;
+    }
+    memcpy(compensation->matrix, inverse, sizeof(inverse));
+    memcpy(compensation->baseline, estimator->baseline, sizeof(estimator->baseline));
+    compensation->enabled = true;
+    return estimated;
+}
+
+bool crosstalk_estimator_finish(const crosstalk_estimator *estimator, crosstalk_compensation *compensation)
+{
+    int estimated = crosstalk_estimator_fit(estimator, compensation);
+    if (estimated)
+    {
+        ESP_LOGI(TAG, "Compensating crosstalk measured on %d sensors", estimated);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Crosstalk not estimated, keeping the compensation");
+    }
+    return estimated != 0;
+}
+
+void crosstalk_estimator_decay(crosstalk_estimator *estimator)
+{
+    for (int j = 0; j < N; ++j)
+    {
+        if (estimator->frames[j] < 2 * estimator->params.min_frames)
+        {
+            continue;
+        }
+        for (int i = 0; i < N; ++i)
+        {
+            estimator->products[i * N + j] *= 0.5f;
+        }
+        estimator->energy[j] *= 0.5f;
+        estimator->frames[j] /= 2;
+    }
+}
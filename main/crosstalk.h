@@ -0,0 +1,79 @@
+#ifndef CROSSTALK_H__
+#define CROSSTALK_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "constants.h"
+
+// Compensation for sensors that move each other's readings: pressing one
+// Velostat pad also loads its neighbours through the glove and the board.
+// Modelled as linear around the idle baseline: the deviations the ADC sees are
+// a coupling matrix, with ones on its diagonal, times the deviations each finger
+// causes on its own sensor. Every frame is multiplied by the inverse of the
+// coupling before it is filtered, so a press no longer leaks into its neighbours
+// and the thresholds can stay where they are.
+//
+// The coupling is estimated from frames where one sensor is pressed alone:
+// column j holds the least-squares slope of every sensor's deviation against
+// sensor j's. With CROSSTALK_CALIBRATION the device runs the estimator while
+// the calibration jumper is set: once the filter has calibrated, press each
+// finger alone a few times, then remove the jumper. host/tools/crosstalk_fit
+// runs it over captures instead.
+
+typedef struct
+{
+    bool enabled;
+    float baseline[SENSOR_COUNT];
+    // Inverse of the coupling, row-major.
+    float matrix[(SENSOR_COUNT) * (SENSOR_COUNT)];
+} crosstalk_compensation;
+
+typedef struct
+{
+    // Deviation from idle, in ADC counts, that makes a sensor pressed.
+    float press_level;
+    // A press is alone when every other sensor moves by less than this fraction of it.
+    float alone_fraction;
+    // Frames of lone presses a sensor needs before its column is estimated.
+    int min_frames;
+    // Weight of each idle frame in the running baseline.
+    float baseline_weight;
+} crosstalk_estimator_params;
+
+typedef struct
+{
+    crosstalk_estimator_params params;
+    bool started;
+    float baseline[SENSOR_COUNT];
+    // Over the lone presses of sensor j: sums of deviation i times deviation j
+    // (row i, column j), and of deviation j squared.
+    float products[(SENSOR_COUNT) * (SENSOR_COUNT)];
+    float energy[SENSOR_COUNT];
+    int frames[SENSOR_COUNT];
+} crosstalk_estimator;
+
+// Identity and disabled.
+void crosstalk_compensation_init(crosstalk_compensation *compensation);
+// Compensates the readings in place. Nothing to do while disabled.
+void crosstalk_compensation_apply(const crosstalk_compensation *compensation, uint32_t *adc_raw);
+
+crosstalk_estimator_params crosstalk_estimator_default_params(void);
+void crosstalk_estimator_init(crosstalk_estimator *estimator, const crosstalk_estimator_params *params);
+void crosstalk_estimator_add(crosstalk_estimator *estimator, const uint32_t *adc_raw);
+// The coupling estimated so far, row-major. Sensors without enough lone presses
+// get the identity's column. Returns how many sensors had enough.
+int crosstalk_estimator_coupling(const crosstalk_estimator *estimator, float *coupling);
+// Replaces the compensation with the inverse of the estimated coupling. Returns
+// false, leaving it unchanged, when no sensor had enough lone presses or the
+// coupling cannot be inverted.
+bool crosstalk_estimator_finish(const crosstalk_estimator *estimator, crosstalk_compensation *compensation);
+// The same without logging, for refits that run all the time. Returns how many
+// sensors the compensation was estimated on, or 0 if it is unchanged.
+int crosstalk_estimator_fit(const crosstalk_estimator *estimator, crosstalk_compensation *compensation);
+// Halves the sums of the sensors with at least twice min_frames lone presses,
+// so that a running estimator follows the coupling as it changes and its sums
+// stay bounded. Every sensor estimated before still is after.
+void crosstalk_estimator_decay(crosstalk_estimator *estimator);
+
+#endif
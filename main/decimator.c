@@ -0,0 +1,85 @@
+#include <string.h>
+
+#include "decimator.h"
+
+// 12-bit input; each stage adds log2(ratio) bits.
+#define DECIMATOR_INPUT_BITS 12
+#define DECIMATOR_REGISTER_BITS 32
+
+static int ceil_log2(int value)
+{
+    int bits = 0;
+    while ((1 << bits) < value)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+esp_err_t cic_decimator_init(cic_decimator *decimator, int order, int ratio)
+{
+    if (order < 1 || order > DECIMATOR_MAX_ORDER || ratio < 1 ||
+        DECIMATOR_INPUT_BITS + order * ceil_log2(ratio) > DECIMATOR_REGISTER_BITS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    decimator->order = order;
+    decimator->ratio = ratio;
+    decimator->gain = 1;
+    for (int i = 0; i < order; ++i)
+    {
+        decimator->gain *= ratio;
+    }
+    cic_decimator_reset(decimator);
+    return ESP_OK;
+}
+
+void cic_decimator_reset(cic_decimator *decimator)
+{
+    memset(decimator->integrator, 0, sizeof(decimator->integrator));
+    memset(decimator->comb, 0, sizeof(decimator->comb));
+    decimator->phase = 0;
+    // The window spans order * (ratio - 1) + 1 scans, which takes `order` frames to fill.
+    decimator->warmup = decimator->order - 1;
+}
+
+bool cic_decimator_push(cic_decimator *decimator, const uint32_t *scan, uint32_t *out)
+{
+    for (int i = 0; i < ADC_SENSOR_COUNT; ++i)
+    {
+        decimator->integrator[0][i] += scan[i];
+    }
+    for (int stage = 1; stage < decimator->order; ++stage)
+    {
+        for (int i = 0; i < ADC_SENSOR_COUNT; ++i)
+        {
+            decimator->integrator[stage][i] += decimator->integrator[stage - 1][i];
+        }
+    }
+
+    if (++decimator->phase < decimator->ratio)
+    {
+        return false;
+    }
+    decimator->phase = 0;
+
+    const uint32_t *last_integrator = decimator->integrator[decimator->order - 1];
+    for (int i = 0; i < ADC_SENSOR_COUNT; ++i)
+    {
+        uint32_t value = last_integrator[i];
+        for (int stage = 0; stage < decimator->order; ++stage)
+        {
+            uint32_t delayed = decimator->comb[stage][i];
+            decimator->comb[stage][i] = value;
+            value -= delayed;
+        }
+        out[i] = (value + decimator->gain / 2) / decimator->gain;
+    }
+
+    if (decimator->warmup > 0)
+    {
+        decimator->warmup--;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef DECIMATOR_H__
+#define DECIMATOR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "constants.h"
+
+// Cascaded integrator-comb decimator for the oversampled ADC scans. Takes one
+// scan of every ADC channel at a time and returns one frame per `ratio` scans.
+// The output stays in ADC counts (the gain of ratio^order is divided out), with
+// the noise averaged down over the window.
+//
+// Group delay is order * (ratio - 1) / 2 scans.
+
+#define DECIMATOR_MAX_ORDER 4
+
+typedef struct
+{
+    int order;
+    int ratio;
+    // Scans since the last output.
+    int phase;
+    // Outputs still to hold back after a reset, until the comb history is real data.
+    int warmup;
+    uint32_t gain;
+
+    // Registers wrap modulo 2^32. The comb differences are exact as long as the
+    // output fits, which cic_decimator_init checks.
+    uint32_t integrator[DECIMATOR_MAX_ORDER][ADC_SENSOR_COUNT];
+    uint32_t comb[DECIMATOR_MAX_ORDER][ADC_SENSOR_COUNT];
+} cic_decimator;
+
+esp_err_t cic_decimator_init(cic_decimator *decimator, int order, int ratio);
+
+// Clears the history, e.g. after scans were lost.
+void cic_decimator_reset(cic_decimator *decimator);
+
+// Feeds one scan. Returns true and fills out when a frame is due.
+bool cic_decimator_push(cic_decimator *decimator, const uint32_t *scan, uint32_t *out);
+
+#endif
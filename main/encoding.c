@@ -7,6 +7,7 @@
 #include "soc/soc_caps.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
 
 // Key mapping
 #include "hid_dev.h"
@@ -16,15 +17,335 @@
 #include "encoding.h"
 #include "constants.h"
 #include "state.h"
+#include "envelope_timing.h"
+#include "layout.h"
 
 const static char *TAG = "ENCODING";
 
+// Same clock gettimeofday reads (CONFIG_ESP_TIME_FUNCS_USE_ESP_TIMER), without
+// the struct conversion, and replaceable by a virtual clock on host.
 int64_t gettime()
 {
-  struct timeval tv_now;
-  gettimeofday(&tv_now, NULL);
-  uint64_t time_us = (int64_t)tv_now.tv_sec * 1000000L + (int64_t)tv_now.tv_usec;
-  return time_us;
+  return esp_timer_get_time();
+}
+
+// Quantile of the late presses the commit window waits out, and the frame of
+// margin it adds to them.
+#define EARLY_COMMIT_QUANTILE 0.9f
+#define EARLY_COMMIT_MARGIN_USEC (1000000 / SENSOR_FRAME_RATE_HZ)
+
+// Stable spells kept per chord for speculative output; past it, the counts are
+// halved so that they follow the typist.
+#define SPECULATION_HISTORY 32
+
+void envelope_encoder_init(envelope_encoder_state *envelope_state, bool early_commit, bool speculate, bool adaptive_timing,
+                           bool rollover)
+{
+  memset(envelope_state, 0, sizeof(*envelope_state));
+  envelope_state->early_commit = early_commit;
+  envelope_state->speculate = speculate;
+  envelope_state->adaptive_timing = adaptive_timing;
+  envelope_state->rollover = rollover;
+  p2_quantile_init(&envelope_state->_late_presses, EARLY_COMMIT_QUANTILE);
+  envelope_timing_init(&envelope_state->timing);
+}
+
+static uint64_t envelope_grace_us(const envelope_encoder_state *envelope_state)
+{
+  return envelope_state->adaptive_timing ? envelope_state->timing.grace_us : ENVELOPE_GRACE_PERIOD_USEC;
+}
+
+static uint64_t envelope_reject_us(const envelope_encoder_state *envelope_state)
+{
+  return envelope_state->adaptive_timing ? envelope_state->timing.reject_us : MAX_ENVELOPE_LENGTH_USEC;
+}
+
+static uint64_t early_commit_window(const envelope_encoder_state *envelope_state)
+{
+  uint64_t window = ENVELOPE_EARLY_COMMIT_MIN_USEC;
+  uint64_t grace = envelope_grace_us(envelope_state);
+  if (envelope_state->_late_presses.count)
+  {
+    uint64_t late = p2_quantile_get(&envelope_state->_late_presses) + EARLY_COMMIT_MARGIN_USEC;
+    window = late > window ? late : window;
+  }
+  return window < grace ? window : grace;
+}
+
+// Accepts the chord once the commit window has passed since the first finger
+// lifted, unless the envelope could still run out of time and be rejected.
+static void early_commit(envelope_encoder_state *envelope_state, uint64_t _current_time, encoder_output_t *out)
+{
+  uint64_t grace = envelope_grace_us(envelope_state);
+  if (envelope_state->_committed || envelope_state->_rejected || !envelope_state->_released_at ||
+      _current_time < envelope_state->_released_at + early_commit_window(envelope_state) ||
+      _current_time + grace >= envelope_state->_reject_envelope_at)
+  {
+    return;
+  }
+  envelope_state->_committed = true;
+  envelope_state->_committed_bitstring = envelope_state->_accumulated;
+  envelope_state->_committed_at = _current_time;
+  envelope_state->commit_stats.commits++;
+  // Typed for good: a chord typed ahead is confirmed, and not taken back.
+  envelope_state->_stable = 0;
+  envelope_state->_typed_ahead = false;
+  ESP_LOGI(TAG, "| %c |", envelope_state->_accumulated + 'a' - 1);
+  ESP_LOGI(TAG, "Commit envelope %c (early)", envelope_state->_accumulated + 'a' - 1);
+  out->accumulated_bitstring = envelope_state->_accumulated;
+  out->encoder_flags = ENCODER_FLAG_ACCEPTED;
+}
+
+// Where the envelope ends: whether the commit was what it went on to accept.
+static void early_commit_end(envelope_encoder_state *envelope_state, uint64_t _current_time, bool accepted)
+{
+  if (!envelope_state->_committed)
+  {
+    return;
+  }
+  if (accepted && envelope_state->_accumulated == envelope_state->_committed_bitstring)
+  {
+    envelope_state->commit_stats.gained_us += _current_time - envelope_state->_committed_at;
+  }
+  else
+  {
+    envelope_state->commit_stats.mispredictions++;
+    ESP_LOGI(TAG, "Committed %c, envelope went on to %c (%s)", envelope_state->_committed_bitstring + 'a' - 1,
+             envelope_state->_accumulated + 'a' - 1, accepted ? "accepted" : "rejected");
+  }
+  envelope_state->_committed = false;
+}
+
+// The stable chord turned out wrong: it is counted against, and taken back if
+// it was typed ahead.
+static void speculation_correct(envelope_encoder_state *envelope_state, encoder_output_t *out)
+{
+  if (!envelope_state->_stable)
+  {
+    return;
+  }
+  envelope_state->_corrected_counts[(int)envelope_state->_stable]++;
+  if (envelope_state->_typed_ahead)
+  {
+    ESP_LOGI(TAG, "Retract %c", envelope_state->_stable + 'a' - 1);
+    out->retracted_bitstring = envelope_state->_stable;
+    envelope_state->speculation_stats.retracted++;
+  }
+  envelope_state->_stable = 0;
+  envelope_state->_typed_ahead = false;
+}
+
+// Before the frame's sensors join the chord: when it last grew, when a finger
+// first lifted since, and when the last one did. Returns the sensors that join.
+static char envelope_track(envelope_encoder_state *envelope_state, char pin_bitstring, uint64_t _current_time)
+{
+  char added = pin_bitstring & ~envelope_state->_accumulated;
+  char released = envelope_state->_accumulated & ~pin_bitstring;
+  if (added)
+  {
+    if (envelope_state->early_commit && envelope_state->_released_at)
+    {
+      // A late press: the early commit window learns from it.
+      p2_quantile_add(&envelope_state->_late_presses, _current_time - envelope_state->_released_at);
+      ESP_LOGI(TAG, "Late press %c after %llu us, commit window %llu us", (envelope_state->_accumulated | pin_bitstring) + 'a' - 1,
+               _current_time - envelope_state->_released_at, early_commit_window(envelope_state));
+    }
+    envelope_state->_grown_at = _current_time;
+    envelope_state->_released_at = 0;
+    if (!envelope_state->_first_released_at)
+    {
+      envelope_state->_formed_at = _current_time;
+    }
+  }
+  if (released && !envelope_state->_released_at)
+  {
+    envelope_state->_released_at = _current_time;
+  }
+  if (released && !envelope_state->_first_released_at)
+  {
+    envelope_state->_first_released_at = _current_time;
+  }
+  if (pin_bitstring)
+  {
+    envelope_state->_lifted_at = 0;
+  }
+  else if (!envelope_state->_lifted_at)
+  {
+    envelope_state->_lifted_at = _current_time;
+  }
+  return added;
+}
+
+// An accepted envelope: the onset spread and hold of the chord as first formed,
+// before any finger lifted, and the release spread from there. Sensors that join
+// later are late presses, or the next chord run into this one, and would teach
+// the grace period to wait for them.
+static void envelope_learn_timing(envelope_encoder_state *envelope_state)
+{
+  envelope_timing_add(&envelope_state->timing, envelope_state->_formed_at - envelope_state->_entered_at,
+                      envelope_state->_first_released_at - envelope_state->_formed_at,
+                      envelope_state->_lifted_at - envelope_state->_first_released_at);
+  if (envelope_state->timing.chords % ENVELOPE_TIMING_SAVE_CHORDS == 0)
+  {
+    envelope_timing_snapshot(&envelope_state->timing);
+  }
+}
+
+// Types the chord ahead once it has not grown for ENVELOPE_SPECULATE_USEC,
+// unless it has been corrected too often lately.
+static void speculate(envelope_encoder_state *envelope_state, uint64_t _current_time, encoder_output_t *out)
+{
+  if (envelope_state->_stable || envelope_state->_committed || envelope_state->_rejected ||
+      _current_time < envelope_state->_grown_at + ENVELOPE_SPECULATE_USEC)
+  {
+    return;
+  }
+  int chord = envelope_state->_accumulated;
+  envelope_state->_stable = chord;
+  uint8_t *stable_count = &envelope_state->_stable_counts[chord];
+  uint8_t *corrected_count = &envelope_state->_corrected_counts[chord];
+  if (*stable_count == SPECULATION_HISTORY)
+  {
+    *stable_count /= 2;
+    *corrected_count /= 2;
+  }
+  ++*stable_count;
+  if (*corrected_count * 100 > *stable_count * ENVELOPE_SPECULATE_MAX_CORRECTED_PERCENT)
+  {
+    envelope_state->speculation_stats.withheld++;
+    return;
+  }
+  ESP_LOGI(TAG, "Type ahead %c", chord + 'a' - 1);
+  envelope_state->_typed_ahead = true;
+  envelope_state->speculation_stats.typed_ahead++;
+  out->accumulated_bitstring = chord;
+  out->speculative = true;
+}
+
+static void envelope_enter(envelope_encoder_state *envelope_state, char bitstring, uint64_t _current_time)
+{
+  envelope_state->_in_envelope = true;
+  envelope_state->_reject_envelope_at = _current_time + envelope_reject_us(envelope_state);
+  envelope_state->_rejected = false;
+  envelope_state->_accept_input_at = _current_time + envelope_grace_us(envelope_state);
+  envelope_state->_accumulated = bitstring;
+  envelope_state->_committed = false;
+  envelope_state->_entered_at = _current_time;
+  envelope_state->_grown_at = _current_time;
+  envelope_state->_formed_at = _current_time;
+  envelope_state->_released_at = 0;
+  envelope_state->_first_released_at = 0;
+  envelope_state->_lifted_at = 0;
+  envelope_state->_stable = 0;
+  envelope_state->_typed_ahead = false;
+
+  ESP_LOGI(TAG, "Enter envelope %c ", envelope_state->_accumulated + 'a' - 1);
+}
+
+// A sensor joined a committed chord: the chord is typed already, so the
+// sensors that joined start an envelope of their own. The committed fingers
+// still down are spent until they lift. Returns the sensors the new envelope
+// runs on.
+static char early_commit_split(envelope_encoder_state *envelope_state, char pin_bitstring, char added,
+                               uint64_t _current_time)
+{
+  ESP_LOGI(TAG, "Exit envelope %c (committed, %c pressed after)", envelope_state->_committed_bitstring + 'a' - 1,
+           added + 'a' - 1);
+  envelope_state->_accumulated |= added;
+  early_commit_end(envelope_state, _current_time, true);
+  envelope_state->_spent = pin_bitstring & ~added;
+  envelope_enter(envelope_state, added, _current_time);
+  return added;
+}
+
+// Rollover: notes when each sensor was pressed and lifted, and splits the
+// sensors down between this chord and the next. Once a finger of this chord has
+// lifted, every press goes to the next one. Returns this chord's sensors, which
+// the envelope runs on as if they were all that is down.
+static char rollover_split(envelope_encoder_state *envelope_state, char pin_bitstring, uint64_t _current_time)
+{
+  char pressed = pin_bitstring & ~envelope_state->_pins;
+  char lifted = envelope_state->_pins & ~pin_bitstring;
+  for (int s = 0; s < ENCODING_SENSOR_COUNT; ++s)
+  {
+    if (pressed & (1 << s))
+    {
+      envelope_state->_sensor_pressed_at[s] = _current_time;
+    }
+    if (lifted & (1 << s))
+    {
+      envelope_state->_sensor_lifted_at[s] = _current_time;
+    }
+  }
+  envelope_state->_pins = pin_bitstring;
+  if (!envelope_state->_in_envelope)
+  {
+    envelope_state->_held = pin_bitstring;
+    return pin_bitstring;
+  }
+
+  bool releasing = envelope_state->_first_released_at || (envelope_state->_held & ~pin_bitstring);
+  if (pressed && (envelope_state->_next || releasing))
+  {
+    if (!envelope_state->_next)
+    {
+      envelope_state->_next_entered_at = _current_time;
+      envelope_state->rollovers++;
+      ESP_LOGI(TAG, "Roll over %c into %c", envelope_state->_accumulated + 'a' - 1, pressed + 'a' - 1);
+    }
+    envelope_state->_next |= pressed;
+  }
+  envelope_state->_held = envelope_state->_next ? envelope_state->_held & pin_bitstring : pin_bitstring;
+  if (envelope_state->_next && !envelope_state->_held)
+  {
+    // Nothing can join this chord any more.
+    envelope_state->_accept_input_at = _current_time;
+  }
+  return envelope_state->_held;
+}
+
+// Rollover: the next chord takes over the envelope, timed from its sensors'
+// presses and lifts rather than from now.
+static void rollover_promote(envelope_encoder_state *envelope_state, uint64_t _current_time)
+{
+  char chord = envelope_state->_next;
+  envelope_enter(envelope_state, chord, _current_time);
+  envelope_state->_next = 0;
+  // This chord's fingers are all up, so whatever is down is the next one's.
+  envelope_state->_held = envelope_state->_pins;
+  envelope_state->_entered_at = envelope_state->_next_entered_at;
+  envelope_state->_reject_envelope_at = envelope_state->_entered_at + envelope_reject_us(envelope_state);
+
+  uint64_t grown_at = 0;
+  for (int s = 0; s < ENCODING_SENSOR_COUNT; ++s)
+  {
+    if ((chord & (1 << s)) && envelope_state->_sensor_pressed_at[s] > grown_at)
+    {
+      grown_at = envelope_state->_sensor_pressed_at[s];
+    }
+  }
+  uint64_t first_released_at = 0, released_at = 0, lifted_at = 0;
+  for (int s = 0; s < ENCODING_SENSOR_COUNT; ++s)
+  {
+    uint64_t sensor_lifted_at = envelope_state->_sensor_lifted_at[s];
+    if (!(chord & (1 << s)) || sensor_lifted_at <= envelope_state->_sensor_pressed_at[s])
+    {
+      continue;
+    }
+    first_released_at = !first_released_at || sensor_lifted_at < first_released_at ? sensor_lifted_at : first_released_at;
+    if (sensor_lifted_at >= grown_at)
+    {
+      released_at = !released_at || sensor_lifted_at < released_at ? sensor_lifted_at : released_at;
+    }
+    lifted_at = sensor_lifted_at > lifted_at ? sensor_lifted_at : lifted_at;
+  }
+  envelope_state->_grown_at = grown_at;
+  envelope_state->_released_at = released_at;
+  envelope_state->_first_released_at = first_released_at;
+  // Formed before any finger lifted; if the chord grew after, the first lift
+  // bounds it.
+  envelope_state->_formed_at = first_released_at && first_released_at < grown_at ? first_released_at : grown_at;
+  envelope_state->_lifted_at = chord & envelope_state->_pins ? 0 : lifted_at;
 }
 
 encoder_output_t envelope_encode(envelope_encoder_state *envelope_state, char pin_bitstring, keyboard_state_t mode)
@@ -33,24 +354,39 @@ encoder_output_t envelope_encode(envelope_encoder_state *envelope_state, char pi
 
   encoder_output_t out = {};
 
+  if (envelope_state->rollover)
+  {
+    pin_bitstring = rollover_split(envelope_state, pin_bitstring, _current_time);
+  }
+  if (envelope_state->_spent)
+  {
+    envelope_state->_spent &= pin_bitstring;
+    pin_bitstring &= ~envelope_state->_spent;
+  }
   if (!pin_bitstring && !envelope_state->_in_envelope)
   {
     ESP_LOGV(TAG, "No envelope | %c |", pin_bitstring + 'a' - 1);
   }
   if (pin_bitstring && !envelope_state->_in_envelope)
   {
-    envelope_state->_in_envelope = true;
+    envelope_enter(envelope_state, pin_bitstring, _current_time);
     out.encoder_flags = ENCODER_FLAG_ENVELOPE;
-    envelope_state->_reject_envelope_at = _current_time + MAX_ENVELOPE_LENGTH_USEC;
-    envelope_state->_rejected = false;
-    envelope_state->_accept_input_at = _current_time + ENVELOPE_GRACE_PERIOD_USEC;
-    envelope_state->_accumulated = pin_bitstring;
-
-    ESP_LOGI(TAG, "Enter envelope %c ", envelope_state->_accumulated + 'a' - 1);
+  }
+  if (envelope_state->_in_envelope)
+  {
+    char added = envelope_track(envelope_state, pin_bitstring, _current_time);
+    if (added && envelope_state->speculate)
+    {
+      speculation_correct(envelope_state, &out);
+    }
+    if (added && envelope_state->_committed)
+    {
+      pin_bitstring = early_commit_split(envelope_state, pin_bitstring, added, _current_time);
+    }
   }
   if (pin_bitstring && envelope_state->_in_envelope)
   {
-    envelope_state->_accept_input_at = _current_time + ENVELOPE_GRACE_PERIOD_USEC;
+    envelope_state->_accept_input_at = _current_time + envelope_grace_us(envelope_state);
     ESP_LOGV(TAG, "| %c + %c = %c|", envelope_state->_accumulated + 'a' - 1, pin_bitstring + 'a' - 1, (envelope_state->_accumulated | pin_bitstring) + 'a' - 1);
     envelope_state->_accumulated = envelope_state->_accumulated | pin_bitstring;
     out.encoder_flags = ENCODER_FLAG_ENVELOPE;
@@ -70,7 +406,10 @@ encoder_output_t envelope_encode(envelope_encoder_state *envelope_state, char pi
     if (_current_time >= envelope_state->_reject_envelope_at)
     {
       ESP_LOGI(TAG, "Exit envelope %c (rejected)", envelope_state->_accumulated + 'a' - 1);
-      if (envelope_state->_accumulated == 31)
+      // Learned timing may reject sooner, but the grip is a hold of all five
+      // past the longest envelope.
+      uint64_t grip_at = envelope_state->_entered_at + MAX_ENVELOPE_LENGTH_USEC;
+      if (envelope_state->_accumulated == 31 && _current_time >= grip_at)
       {
         out.encoder_flags = ENCODER_FLAG_GRIP;
       }
@@ -78,164 +417,73 @@ encoder_output_t envelope_encode(envelope_encoder_state *envelope_state, char pi
       {
         out.encoder_flags = ENCODER_FLAG_REJECTED;
       }
+      early_commit_end(envelope_state, _current_time, false);
+      speculation_correct(envelope_state, &out);
       envelope_state->_accumulated = 0;
       envelope_state->_in_envelope = false;
       envelope_state->_rejected = true;
     }
     if (_current_time >= envelope_state->_accept_input_at && !envelope_state->_rejected)
     {
-      ESP_LOGI(TAG, "| %c |", envelope_state->_accumulated + 'a' - 1);
-      out.accumulated_bitstring = envelope_state->_accumulated;
-      ESP_LOGI(TAG, "Exit envelope %c (accepted)", envelope_state->_accumulated + 'a' - 1);
-      out.encoder_flags = ENCODER_FLAG_ACCEPTED;
+      if (envelope_state->_committed)
+      {
+        // Typed at the commit already.
+        ESP_LOGI(TAG, "Exit envelope %c (committed)", envelope_state->_accumulated + 'a' - 1);
+        early_commit_end(envelope_state, _current_time, true);
+      }
+      else
+      {
+        ESP_LOGI(TAG, "| %c |", envelope_state->_accumulated + 'a' - 1);
+        out.accumulated_bitstring = envelope_state->_accumulated;
+        ESP_LOGI(TAG, "Exit envelope %c (accepted)", envelope_state->_accumulated + 'a' - 1);
+        out.encoder_flags = ENCODER_FLAG_ACCEPTED;
+      }
+      if (envelope_state->adaptive_timing)
+      {
+        envelope_learn_timing(envelope_state);
+      }
+      // Confirms a chord typed ahead.
+      envelope_state->_stable = 0;
+      envelope_state->_typed_ahead = false;
       envelope_state->_accumulated = 0;
       envelope_state->_in_envelope = false;
       envelope_state->_rejected = false;
     }
   }
+  if (envelope_state->early_commit && envelope_state->_in_envelope)
+  {
+    early_commit(envelope_state, _current_time, &out);
+  }
+  if (envelope_state->speculate && envelope_state->_in_envelope)
+  {
+    speculate(envelope_state, _current_time, &out);
+  }
+  // After the frame's output is settled, which is this chord's accept.
+  if (envelope_state->rollover && !envelope_state->_in_envelope && envelope_state->_next)
+  {
+    rollover_promote(envelope_state, _current_time);
+  }
   return out;
 }
 
-keyboard_cmd_t convert_to_hid_code_alpha(char bitstring);
-keyboard_cmd_t convert_to_hid_code_numeric(char bitstring);
-
-
 void convert_to_hid_code(encoder_output_t *out, keyboard_state_t mode)
 {
   char bitstring = out->accumulated_bitstring;
-  char hid;
-
-  bool layoutswitch = pins_pressed[5];
-
-  key_mask_t mask = 0;
-  mask |= pins_pressed[6] ? LEFT_SHIFT_KEY_MASK : 0;
-
-  #ifndef DISABLECTRLALTWIN
-  mask |= pins_pressed[7] ? LEFT_CONTROL_KEY_MASK : 0;
-  mask |= pins_pressed[8] ? LEFT_ALT_KEY_MASK : 0;
-  mask |= pins_pressed[9] ? LEFT_GUI_KEY_MASK : 0;
-  #endif
-
-  if (test_state(KEYBOARD_STATE_BT_PASSKEY_ENTRY)){
-    hid = convert_to_hid_code_numeric(bitstring);
-  } else {
-    hid = layoutswitch ? convert_to_hid_code_numeric(bitstring) : convert_to_hid_code_alpha(bitstring);
-    out->mask = mask;
+  bool passkey = test_state(KEYBOARD_STATE_BT_PASSKEY_ENTRY);
+  layout_key key = layout_lookup(bitstring, pins_pressed, passkey);
+  if (!passkey)
+  {
+    out->mask = key.modifiers;
   }
 
-  out->hid = hid;
-  if (bitstring && !hid)
+  out->hid = key.hid;
+  // A chord typed ahead may still grow into one that has a key.
+  if (bitstring && !key.hid && !out->speculative)
   {
     out->encoder_flags = ENCODER_FLAG_REJECTED;
   }
 }
 
-keyboard_cmd_t convert_to_hid_code_numeric(char bitstring)
-{
-  // NUMERIC ONLY. If you need a number+symbol layout make a new one.
-  switch (bitstring)
-  {
-  case 1:
-    return HID_KEY_1;
-  case 2:
-    return HID_KEY_2;
-  case 3:
-    return HID_KEY_3;
-  case 4:
-    return HID_KEY_4;
-  case 5:
-    return HID_KEY_5;
-  case 6:
-    return HID_KEY_6;
-  case 7:
-    return HID_KEY_7;
-  case 8:
-    return HID_KEY_8;
-  case 9:
-    return HID_KEY_9;
-  case 10:
-    return HID_KEY_0;
-  case 31:
-    return HID_KEY_ENTER;
-  default:
-    return 0;
-  };
-}
-
-keyboard_cmd_t convert_to_hid_code_alpha(char bitstring)
-{
-  switch (bitstring)
-  {
-  case 1:
-    return HID_KEY_A;
-  case 2:
-    return HID_KEY_B;
-  case 3:
-    return HID_KEY_C;
-  case 4:
-    return HID_KEY_D;
-  case 5:
-    return HID_KEY_E;
-  case 6:
-    return HID_KEY_F;
-  case 7:
-    return HID_KEY_G;
-  case 8:
-    return HID_KEY_H;
-  case 9:
-    return HID_KEY_I;
-  case 10:
-    return HID_KEY_J;
-  case 11:
-    return HID_KEY_K;
-  case 12:
-    return HID_KEY_L;
-  case 13:
-    return HID_KEY_M;
-  case 14:
-    return HID_KEY_N;
-  case 15:
-    return HID_KEY_O;
-  case 16:
-    return HID_KEY_P;
-  case 17:
-    return HID_KEY_Q;
-  case 18:
-    return HID_KEY_R;
-  case 19:
-    return HID_KEY_S;
-  case 20:
-    return HID_KEY_T;
-  case 21:
-    return HID_KEY_U;
-  case 22:
-    return HID_KEY_V;
-  case 23:
-    return HID_KEY_W;
-  case 24:
-    return HID_KEY_X;
-  case 25:
-    return HID_KEY_Y;
-  case 26:
-    return HID_KEY_Z;
-
-  case 27:
-    return HID_KEY_CAPS_LOCK;
-  case 28:
-    return HID_KEY_SPACEBAR;
-  case 29:
-    return HID_KEY_SPACEBAR;
-
-  case 30:
-    return HID_KEY_DELETE;
-  case 31:
-    return HID_KEY_ENTER;
-
-  default:
-    return 0;
-  };
-}
-
 keyboard_system_command_t decode_command(command_decoder_state *command_state, encoder_output_t out)
 {
   switch (out.encoder_flags)
@@ -1,8 +1,13 @@
 #ifndef ENCODING_H__
 #define ENCODING_H__
 
+#include <stdint.h>
+
+#include "constants.h"
 #include "state.h"
 #include "hid_dev.h"
+#include "p2_quantile.h"
+#include "envelope_timing.h"
 
 typedef enum {
   ENCODER_FLAG_NONE,
@@ -18,23 +23,126 @@ typedef struct {
     key_mask_t mask;
     char accumulated_bitstring;
     encoder_flags_t encoder_flags;
+    // Speculative output: the chord is typed ahead of its accept, which then
+    // confirms it, and a chord typed ahead that grows or is rejected is taken
+    // back (bt_type_ahead, bt_retract).
+    bool speculative;
+    char retracted_bitstring;
 } encoder_output_t;
 
 
+typedef struct {
+  // Chords accepted early, and those the envelope changed afterwards: a sensor
+  // joined after the commit, or the chord was held past MAX_ENVELOPE_LENGTH_USEC.
+  uint32_t commits;
+  uint32_t mispredictions;
+  // Summed over the commits that held: from the commit to where the chord would
+  // have been accepted without early commit.
+  uint64_t gained_us;
+} envelope_commit_stats;
+
+typedef struct {
+  // Chords typed ahead, and those of them taken back.
+  uint32_t typed_ahead;
+  uint32_t retracted;
+  // Chords not typed ahead because they are corrected too often.
+  uint32_t withheld;
+} envelope_speculation_stats;
+
+#define ENCODING_CHORD_COUNT (1 << ENCODING_SENSOR_COUNT)
+
 typedef struct {
   bool _in_envelope;
   char _accumulated;
   bool _rejected;
 
-unsigned long _accept_input_at;
- unsigned long _reject_envelope_at;
+  // Microsecond deadlines, 64-bit like the times below so that they do not
+  // wrap after 71 minutes where long is 32-bit.
+  uint64_t _accept_input_at;
+  uint64_t _reject_envelope_at;
+
+  // When the envelope opened, the chord last grew, a finger first lifted since
+  // (0 while none) and the last finger lifted (0 while some are down). Formed
+  // and first released are the same for the chord before any finger lifted.
+  uint64_t _entered_at;
+  uint64_t _grown_at;
+  uint64_t _released_at;
+  uint64_t _lifted_at;
+  uint64_t _formed_at;
+  uint64_t _first_released_at;
+
+  // Early commit, see envelope_encoder_init. The envelope itself runs as without
+  // it; only the chord is accepted sooner, until a sensor joins after the
+  // commit. The committed chord's fingers still down then stay out of the next.
+  bool early_commit;
+  bool _committed;
+  char _committed_bitstring;
+  uint64_t _committed_at;
+  char _spent;
+  // Release-to-new-sensor gaps of the chords that grew after a release.
+  p2_quantile _late_presses;
+  envelope_commit_stats commit_stats;
+
+  // Speculative output, see envelope_encoder_init.
+  bool speculate;
+  // The chord once it has been stable for ENVELOPE_SPECULATE_USEC, 0 before,
+  // and whether it was typed ahead.
+  char _stable;
+  bool _typed_ahead;
+  // Per chord, recent times it was stable and times it was corrected after
+  // that, whether typed ahead or not.
+  uint8_t _stable_counts[ENCODING_CHORD_COUNT];
+  uint8_t _corrected_counts[ENCODING_CHORD_COUNT];
+  envelope_speculation_stats speculation_stats;
+
+  // Adaptive timing, see envelope_encoder_init.
+  bool adaptive_timing;
+  envelope_timing timing;
 
+  // Rollover, see envelope_encoder_init. Per sensor, when it was last pressed
+  // and last lifted; the sensors down the frame before; the fingers of this
+  // chord still down; and the next chord, pressed while this one releases,
+  // with when it started.
+  bool rollover;
+  uint64_t _sensor_pressed_at[ENCODING_SENSOR_COUNT];
+  uint64_t _sensor_lifted_at[ENCODING_SENSOR_COUNT];
+  char _pins;
+  char _held;
+  char _next;
+  uint64_t _next_entered_at;
+  // Chords started while another was still releasing.
+  uint32_t rollovers;
 } envelope_encoder_state;
 
 typedef struct {
   int sequence_idx;
 } command_decoder_state;
 
+// A zeroed state encodes without early commit. With it, a chord is accepted as
+// soon as a finger has lifted and no sensor has joined for a commit window,
+// rather than ENVELOPE_GRACE_PERIOD_USEC after the last finger lifts. The
+// window starts at ENVELOPE_EARLY_COMMIT_MIN_USEC and follows a high quantile of
+// the typist's late presses, sensors added after another finger had lifted.
+// A sensor that joins after the commit ends the committed envelope and starts
+// the next, without the committed chord's fingers still down.
+//
+// With speculate, the chord is also typed ahead once it has not grown for
+// ENVELOPE_SPECULATE_USEC, fingers still down, and taken back with
+// HID_KEY_DELETE if it then grows or is rejected. Chords that are corrected
+// more often than ENVELOPE_SPECULATE_MAX_CORRECTED_PERCENT are not typed ahead.
+//
+// With adaptive_timing, the grace period and the reject window follow timing,
+// which learns from every accepted chord (envelope_timing.h). Load a saved
+// timing into it after init.
+//
+// With rollover, two envelopes can be in flight. Once a finger of the chord has
+// lifted, it can no longer grow: sensors pressed from then on, including a
+// finger of the chord pressed again, start the next chord. The chord is
+// accepted as soon as its own fingers are all up, without waiting out the grace
+// period, and the next one takes over the envelope. A sensor that lands after
+// another has lifted is a new chord, not a late press.
+void envelope_encoder_init(envelope_encoder_state* envelope_state, bool early_commit, bool speculate, bool adaptive_timing,
+                           bool rollover);
 encoder_output_t envelope_encode(envelope_encoder_state* envelope_state, char pin_bitstring, keyboard_state_t mode);
 void convert_to_hid_code(encoder_output_t* out, keyboard_state_t mode);
 
@@ -0,0 +1,197 @@
+#include <stdatomic.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+
+#include "constants.h"
+#include "filter_store.h"
+#include "envelope_timing.h"
+
+#define ENVELOPE_TIMING_MAGIC 0x54574150 // "PAWT"
+#define ENVELOPE_TIMING_MARGIN_USEC (1000000 / SENSOR_FRAME_RATE_HZ)
+
+#define ENVELOPE_TIMING_TASK_PRIORITY 1
+#define ENVELOPE_TIMING_TASK_STACK 3072
+
+const static char *TAG = "ENVELOPE_TIMING";
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    // Of the size bytes that follow.
+    uint32_t crc;
+} envelope_timing_header;
+
+// The snapshot waiting for the writer, as in filter_store.c: hid_task fills it
+// only while pending is false, and the writer reads it only while it is true.
+static struct
+{
+    envelope_timing_header header;
+    envelope_timing timing;
+} snapshot;
+static atomic_bool pending;
+static TaskHandle_t writer_task_handle = NULL;
+
+void envelope_timing_init(envelope_timing *timing)
+{
+    memset(timing, 0, sizeof(*timing));
+    timing->grace_us = ENVELOPE_GRACE_PERIOD_USEC;
+    timing->reject_us = MAX_ENVELOPE_LENGTH_USEC;
+}
+
+static void histogram_add(envelope_timing_histogram *histogram, uint32_t bin_us, uint32_t value_us)
+{
+    if (histogram->total == ENVELOPE_TIMING_HISTORY)
+    {
+        histogram->total = 0;
+        for (int b = 0; b < ENVELOPE_TIMING_BINS; ++b)
+        {
+            histogram->counts[b] /= 2;
+            histogram->total += histogram->counts[b];
+        }
+    }
+    uint32_t bin = value_us / bin_us;
+    histogram->counts[bin < ENVELOPE_TIMING_BINS ? bin : ENVELOPE_TIMING_BINS - 1]++;
+    histogram->total++;
+}
+
+uint32_t envelope_timing_percentile(const envelope_timing_histogram *histogram, uint32_t bin_us, float q)
+{
+    uint32_t rank = q * histogram->total;
+    uint32_t count = 0;
+    for (int b = 0; b < ENVELOPE_TIMING_BINS; ++b)
+    {
+        count += histogram->counts[b];
+        if (count > rank)
+        {
+            return (b + 1) * bin_us;
+        }
+    }
+    return ENVELOPE_TIMING_BINS * bin_us;
+}
+
+static uint32_t clamp(uint32_t value, uint32_t low, uint32_t high)
+{
+    return value < low ? low : value > high ? high : value;
+}
+
+void envelope_timing_add(envelope_timing *timing, uint32_t onset_us, uint32_t hold_us, uint32_t release_us)
+{
+    histogram_add(&timing->onset, ENVELOPE_TIMING_SPREAD_BIN_USEC, onset_us);
+    histogram_add(&timing->hold, ENVELOPE_TIMING_HOLD_BIN_USEC, hold_us);
+    histogram_add(&timing->release, ENVELOPE_TIMING_SPREAD_BIN_USEC, release_us);
+    if (++timing->chords < ENVELOPE_TIMING_MIN_CHORDS)
+    {
+        return;
+    }
+    uint32_t grace_us = envelope_timing_percentile(&timing->onset, ENVELOPE_TIMING_SPREAD_BIN_USEC, 0.95f) + ENVELOPE_TIMING_MARGIN_USEC;
+    uint32_t length_us = envelope_timing_percentile(&timing->onset, ENVELOPE_TIMING_SPREAD_BIN_USEC, 0.99f) +
+                         envelope_timing_percentile(&timing->hold, ENVELOPE_TIMING_HOLD_BIN_USEC, 0.99f) +
+                         envelope_timing_percentile(&timing->release, ENVELOPE_TIMING_SPREAD_BIN_USEC, 0.99f);
+    grace_us = clamp(grace_us, ENVELOPE_GRACE_MIN_USEC, ENVELOPE_GRACE_PERIOD_USEC);
+    uint32_t reject_us = clamp(2 * length_us, ENVELOPE_REJECT_MIN_USEC, MAX_ENVELOPE_LENGTH_USEC);
+    if (grace_us != timing->grace_us || reject_us != timing->reject_us)
+    {
+        ESP_LOGI(TAG, "Grace %lu ms, reject after %lu ms, from %lu chords", grace_us / 1000, reject_us / 1000, timing->chords);
+    }
+    timing->grace_us = grace_us;
+    timing->reject_us = reject_us;
+}
+
+bool envelope_timing_restore(envelope_timing *timing)
+{
+    nvs_handle_t handle;
+    if (nvs_open(FILTER_STORE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        ESP_LOGI(TAG, "No saved envelope timing");
+        return false;
+    }
+    size_t length = sizeof(snapshot);
+    esp_err_t err = nvs_get_blob(handle, ENVELOPE_TIMING_KEY, &snapshot, &length);
+    nvs_close(handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGI(TAG, "No saved envelope timing (%s)", esp_err_to_name(err));
+        return false;
+    }
+    if (length != sizeof(snapshot) || snapshot.header.magic != ENVELOPE_TIMING_MAGIC ||
+        snapshot.header.version != ENVELOPE_TIMING_VERSION || snapshot.header.size != sizeof(envelope_timing) ||
+        snapshot.header.crc != esp_rom_crc32_le(0, (const uint8_t *)&snapshot.timing, sizeof(envelope_timing)))
+    {
+        ESP_LOGW(TAG, "Saved envelope timing is invalid, learning anew");
+        return false;
+    }
+    *timing = snapshot.timing;
+    ESP_LOGI(TAG, "Restored envelope timing from %lu chords: grace %lu ms, reject after %lu ms", timing->chords,
+             timing->grace_us / 1000, timing->reject_us / 1000);
+    return true;
+}
+
+void envelope_timing_snapshot(const envelope_timing *timing)
+{
+    if (atomic_load_explicit(&pending, memory_order_acquire))
+    {
+        return;
+    }
+    snapshot.timing = *timing;
+    snapshot.header = (envelope_timing_header){
+        .magic = ENVELOPE_TIMING_MAGIC,
+        .version = ENVELOPE_TIMING_VERSION,
+        .size = sizeof(envelope_timing),
+        .crc = esp_rom_crc32_le(0, (const uint8_t *)&snapshot.timing, sizeof(envelope_timing)),
+    };
+    atomic_store_explicit(&pending, true, memory_order_release);
+    if (writer_task_handle)
+    {
+        xTaskNotifyGive(writer_task_handle);
+    }
+}
+
+bool envelope_timing_flush(void)
+{
+    if (!atomic_load_explicit(&pending, memory_order_acquire))
+    {
+        return false;
+    }
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(FILTER_STORE_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK)
+    {
+        err = nvs_set_blob(handle, ENVELOPE_TIMING_KEY, &snapshot, sizeof(snapshot));
+        if (err == ESP_OK)
+        {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Saved envelope timing, %lu chords", snapshot.timing.chords);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Failed to save envelope timing (%s)", esp_err_to_name(err));
+    }
+    atomic_store_explicit(&pending, false, memory_order_release);
+    return err == ESP_OK;
+}
+
+static void envelope_timing_task(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        envelope_timing_flush();
+    }
+}
+
+void envelope_timing_start(void)
+{
+    xTaskCreate(&envelope_timing_task, "envelope_timing", ENVELOPE_TIMING_TASK_STACK, NULL, ENVELOPE_TIMING_TASK_PRIORITY, &writer_task_handle);
+}
@@ -0,0 +1,81 @@
+#ifndef ENVELOPE_TIMING_H__
+#define ENVELOPE_TIMING_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Learns how a typist's chords unfold and sizes the encoder's envelope windows
+// to them (ENVELOPE_ADAPTIVE_TIMING). Each accepted chord adds three spans to a
+// histogram of its own: onset spread, from the first finger down to the last
+// sensor joining before any finger lifts; hold, from there to the first finger
+// lifting; and release spread, from there to the last finger lifting. The
+// histograms have fixed bins and halve their counts every
+// ENVELOPE_TIMING_HISTORY chords, so they take constant memory and follow the
+// typist as they get faster.
+//
+// The grace period waits for a sensor that joins late, so it covers the 95th
+// percentile of onset spread, plus a frame. The reject window is twice the
+// 99th percentiles of the three spans added up. Both stay within
+// [ENVELOPE_GRACE_MIN_USEC, ENVELOPE_GRACE_PERIOD_USEC] and
+// [ENVELOPE_REJECT_MIN_USEC, MAX_ENVELOPE_LENGTH_USEC], and keep those
+// defaults until ENVELOPE_TIMING_MIN_CHORDS chords have been seen.
+//
+// The histograms live in NVS as ENVELOPE_TIMING_KEY, in the filter store's
+// namespace: a header with a magic number, ENVELOPE_TIMING_VERSION and a CRC-32,
+// then the struct. hid_task takes a snapshot every ENVELOPE_TIMING_SAVE_CHORDS
+// chords (envelope_timing_snapshot), and a low-priority writer task puts it in
+// flash.
+
+#define ENVELOPE_TIMING_BINS 32
+// Bin widths: onset and release spreads up to 160 ms, holds up to 1.6 s. The last
+// bin takes everything longer.
+#define ENVELOPE_TIMING_SPREAD_BIN_USEC 5000
+#define ENVELOPE_TIMING_HOLD_BIN_USEC 50000
+#define ENVELOPE_TIMING_HISTORY 1024
+#define ENVELOPE_TIMING_MIN_CHORDS 20
+#define ENVELOPE_TIMING_SAVE_CHORDS 256
+
+#define ENVELOPE_TIMING_KEY "timing"
+#define ENVELOPE_TIMING_VERSION 1
+
+typedef struct
+{
+    uint16_t counts[ENVELOPE_TIMING_BINS];
+    uint16_t total;
+} envelope_timing_histogram;
+
+typedef struct
+{
+    envelope_timing_histogram onset;
+    envelope_timing_histogram hold;
+    envelope_timing_histogram release;
+    // Chords learned, over every boot.
+    uint32_t chords;
+    // The windows the encoder uses.
+    uint32_t grace_us;
+    uint32_t reject_us;
+} envelope_timing;
+
+// Empty histograms and the default windows.
+void envelope_timing_init(envelope_timing *timing);
+
+// Learns one accepted chord and updates the windows.
+void envelope_timing_add(envelope_timing *timing, uint32_t onset_us, uint32_t hold_us, uint32_t release_us);
+
+// Percentile q, in [0, 1], of a histogram: the upper edge of the bin it falls in.
+uint32_t envelope_timing_percentile(const envelope_timing_histogram *histogram, uint32_t bin_us, float q);
+
+// Loads what NVS holds into timing. Returns false, leaving timing as it was,
+// when nothing valid was saved.
+bool envelope_timing_restore(envelope_timing *timing);
+
+// hid_task side: hands a copy to the writer, unless one is still pending.
+void envelope_timing_snapshot(const envelope_timing *timing);
+
+// Starts the writer task. Without it, envelope_timing_flush does the writing.
+void envelope_timing_start(void);
+
+// Writes a pending snapshot now. Returns true if one was written.
+bool envelope_timing_flush(void);
+
+#endif
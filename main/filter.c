@@ -7,8 +7,8 @@ inline void default_filter_init(filter_handle_t filter) {
     default_filter = filter;
 }
 
-void default_filter_process(uint32_t *adc_raw, bool *pins_pressed){
-    default_filter->process(default_filter, adc_raw, pins_pressed);
+void default_filter_process(uint32_t *adc_raw, sensor_mask_t *pressed){
+    default_filter->process(default_filter, adc_raw, pressed);
 }
 
 void default_filter_calibrate_start(uint32_t *adc_raw){
@@ -17,4 +17,25 @@ void default_filter_calibrate_start(uint32_t *adc_raw){
 
 void default_filter_calibrate_end(uint32_t *adc_raw){
     default_filter->calibrate_end(default_filter, adc_raw);
+}
+
+bool default_filter_reconfigure(const void *params){
+    if (!default_filter || !default_filter->reconfigure) {
+        return false;
+    }
+    return default_filter->reconfigure(default_filter, params);
+}
+
+size_t default_filter_save(void *blob, size_t size){
+    if (!default_filter || !default_filter->save) {
+        return 0;
+    }
+    return default_filter->save(default_filter, blob, size);
+}
+
+bool default_filter_restore(const void *blob, size_t size){
+    if (!default_filter || !default_filter->restore) {
+        return false;
+    }
+    return default_filter->restore(default_filter, blob, size);
 }
\ No newline at end of file
@@ -1,26 +1,47 @@
 #ifndef FILTER_H__
 #define FILTER_H__
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "sensor_mask.h"
+
 typedef struct filter{
 
     struct filter* self;
-    // Runs every sample, including during calibration.
-    void (*process)(struct filter* filter_handle, uint32_t *adc_raw, bool *pins_pressed);
+    // Runs every sample, including during calibration. pressed holds the
+    // decisions of the last frame, and is updated with this one's.
+    void (*process)(struct filter* filter_handle, uint32_t *adc_raw, sensor_mask_t *pressed);
     // Runs at pushbutton press.
     void (*calibrate_start)(struct filter* filter_handle,  uint32_t *adc_raw);
     // Runs at pushbutton release.
     void (*calibrate_end)(struct filter* filter_handle, uint32_t *adc_raw);
+    // Optional (NULL if unsupported): takes new parameters, of the filter's own
+    // params type, while running. Safe to call from another task than process;
+    // they apply from the next frame. Returns false, without waiting, if the
+    // filter is busy with an earlier reconfiguration or a calibration.
+    bool (*reconfigure)(struct filter* filter_handle, const void *params);
+    // Optional (NULL if unsupported): the state that survives a reset, see
+    // filter_store.h. save runs between frames; it writes at most size bytes and
+    // returns how many, or 0 while there is nothing worth keeping (calibrating).
+    // restore runs before the first frame, and returns false if the blob does not
+    // fit this filter.
+    size_t (*save)(struct filter* filter_handle, void *blob, size_t size);
+    bool (*restore)(struct filter* filter_handle, const void *blob, size_t size);
     void* filter_data;
 } filter;
 
 typedef filter* filter_handle_t;
 
 void default_filter_init(filter_handle_t filter);
-void default_filter_process(uint32_t *adc_raw, bool *pins_pressed);
+void default_filter_process(uint32_t *adc_raw, sensor_mask_t *pressed);
 void default_filter_calibrate_start(uint32_t *adc_raw);
 void default_filter_calibrate_end(uint32_t *adc_raw);
+// Returns false if the filter cannot be reconfigured while running, or is busy.
+bool default_filter_reconfigure(const void *params);
+// 0 and false if the filter keeps no state across resets.
+size_t default_filter_save(void *blob, size_t size);
+bool default_filter_restore(const void *blob, size_t size);
 
 
 #endif
\ No newline at end of file
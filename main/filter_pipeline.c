@@ -0,0 +1,299 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "constants.h"
+#include "filter.h"
+#include "filter_pipeline.h"
+#include "filter_store.h"
+#include "state.h"
+#include "sensor_log.h"
+
+const static char *TAG = "PIPELINE";
+
+#define SETTLE_FRAMES (FILTER_PIPELINE_SETTLE_S * SENSOR_FRAME_RATE_HZ)
+#define CALIBRATION_FRAMES (FILTER_PIPELINE_CALIBRATION_S * SENSOR_FRAME_RATE_HZ)
+// Stage statistics go to the debug log this often.
+#define STATS_LOG_FRAMES (60 * SENSOR_FRAME_RATE_HZ)
+
+typedef struct
+{
+    filter_stage *stages[FILTER_PIPELINE_MAX_STAGES];
+    filter_stage_stats stats[FILTER_PIPELINE_MAX_STAGES];
+    int stage_count;
+    // Frames left of settling then calibrating; nothing is pressed until 0.
+    int calibration_countdown;
+    int frames;
+} filter_pipeline_data;
+
+static void filter_pipeline_run_stage(filter_pipeline_data *data, int s, filter_frame *frame)
+{
+    filter_stage *stage = data->stages[s];
+    filter_stage_stats *stats = &data->stats[s];
+    esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+    stage->process(stage, frame);
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    stats->frames++;
+    stats->cycles += cycles;
+    stats->max_cycles = cycles > stats->max_cycles ? cycles : stats->max_cycles;
+}
+
+void filter_pipeline_process(filter_handle_t filter_handle, uint32_t *adc_raw, sensor_mask_t *pressed)
+{
+    filter_pipeline_data *data = (filter_pipeline_data *)filter_handle->filter_data;
+    filter_frame frame = {
+        .adc_raw = adc_raw,
+        .pressed = *pressed,
+        .calibrating = data->calibration_countdown && data->calibration_countdown <= CALIBRATION_FRAMES,
+    };
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        frame.values[i] = (float)adc_raw[i];
+    }
+
+    if (data->calibration_countdown == CALIBRATION_FRAMES)
+    {
+        for (int s = 0; s < data->stage_count; ++s)
+        {
+            if (data->stages[s]->calibrate_start)
+            {
+                data->stages[s]->calibrate_start(data->stages[s]);
+            }
+        }
+    }
+
+    // The detector is last.
+    for (int s = 0; s < data->stage_count - 1; ++s)
+    {
+        filter_pipeline_run_stage(data, s, &frame);
+    }
+    if (test_state(KEYBOARD_STATE_SENSOR_LOGGING))
+    {
+        sensor_log_filtered(frame.values);
+    }
+    filter_pipeline_run_stage(data, data->stage_count - 1, &frame);
+    *pressed = frame.pressed;
+
+    if (++data->frames % STATS_LOG_FRAMES == 0)
+    {
+        for (int s = 0; s < data->stage_count; ++s)
+        {
+            filter_stage_stats *stats = &data->stats[s];
+            ESP_LOGD(TAG, "%s | %llu cycles mean | %lu max", stats->name, stats->cycles / stats->frames, stats->max_cycles);
+        }
+    }
+
+    if (data->calibration_countdown)
+    {
+        *pressed = 0;
+        if (--data->calibration_countdown == 0)
+        {
+            for (int s = 0; s < data->stage_count; ++s)
+            {
+                if (data->stages[s]->calibrate_end)
+                {
+                    data->stages[s]->calibrate_end(data->stages[s]);
+                }
+            }
+            ESP_LOGI(TAG, "Exit pipeline calibration");
+        }
+    }
+}
+
+void filter_pipeline_calibration_start(filter_handle_t filter_handle, uint32_t *adc_raw)
+{
+    ESP_LOGI(TAG, "Enter pipeline calibration");
+    filter_pipeline_data *data = (filter_pipeline_data *)filter_handle->filter_data;
+    data->calibration_countdown = SETTLE_FRAMES + CALIBRATION_FRAMES;
+}
+
+void filter_pipeline_calibration_end(filter_handle_t filter_handle, uint32_t *adc_raw) {}
+
+static const filter_stage_type *find_stage_type(const char *name, size_t length)
+{
+    for (int t = 0; t < filter_stage_type_count; ++t)
+    {
+        if (strlen(filter_stage_types[t].name) == length && strncmp(filter_stage_types[t].name, name, length) == 0)
+        {
+            return &filter_stage_types[t];
+        }
+    }
+    return NULL;
+}
+
+static const char *skip_spaces(const char *p)
+{
+    while (isspace((unsigned char)*p))
+    {
+        ++p;
+    }
+    return p;
+}
+
+// One "name(arg, ...)" at *p, which is left after it. NULL on a syntax error.
+static filter_stage *parse_stage(const char **p)
+{
+    const char *name = skip_spaces(*p);
+    const char *end = name;
+    while (isalnum((unsigned char)*end) || *end == '_')
+    {
+        ++end;
+    }
+    const filter_stage_type *type = find_stage_type(name, end - name);
+    if (!type)
+    {
+        ESP_LOGE(TAG, "Unknown stage '%.*s'", (int)(end - name), name);
+        return NULL;
+    }
+
+    float args[FILTER_PIPELINE_MAX_ARGS];
+    memcpy(args, type->defaults, sizeof(args));
+    const char *q = skip_spaces(end);
+    if (*q == '(')
+    {
+        q = skip_spaces(q + 1);
+        for (int a = 0; *q != ')'; ++a)
+        {
+            char *number_end;
+            float value = strtof(q, &number_end);
+            if (a == type->arg_count || number_end == q)
+            {
+                ESP_LOGE(TAG, "Bad arguments to %s", type->name);
+                return NULL;
+            }
+            args[a] = value;
+            q = skip_spaces(number_end);
+            if (*q == ',')
+            {
+                q = skip_spaces(q + 1);
+            }
+            else if (*q != ')')
+            {
+                ESP_LOGE(TAG, "Bad arguments to %s", type->name);
+                return NULL;
+            }
+        }
+        q++;
+    }
+    *p = skip_spaces(q);
+
+    filter_stage *stage = type->create(args);
+    if (!stage)
+    {
+        ESP_LOGE(TAG, "Arguments out of range for %s", type->name);
+    }
+    return stage;
+}
+
+static void free_stages(filter_pipeline_data *data)
+{
+    for (int s = 0; s < data->stage_count; ++s)
+    {
+        free(data->stages[s]->stage_data);
+        free(data->stages[s]);
+    }
+    data->stage_count = 0;
+}
+
+filter_handle_t init_filter_pipeline(const char *spec)
+{
+    filter_pipeline_data *data = calloc(1, sizeof(filter_pipeline_data));
+    const char *p = spec;
+    bool ok = true;
+    while (ok && *skip_spaces(p))
+    {
+        if (data->stage_count == FILTER_PIPELINE_MAX_STAGES)
+        {
+            ESP_LOGE(TAG, "More than %d stages", FILTER_PIPELINE_MAX_STAGES);
+            ok = false;
+            break;
+        }
+        filter_stage *stage = parse_stage(&p);
+        if (!stage)
+        {
+            ok = false;
+            break;
+        }
+        data->stats[data->stage_count].name = stage->name;
+        data->stages[data->stage_count++] = stage;
+        if (*p == '>')
+        {
+            p++;
+        }
+        else if (*p)
+        {
+            ESP_LOGE(TAG, "Expected '>' at '%s'", p);
+            ok = false;
+        }
+    }
+    for (int s = 0; ok && s < data->stage_count; ++s)
+    {
+        bool last = s == data->stage_count - 1;
+        if ((data->stages[s]->kind == FILTER_STAGE_DETECTOR) != last)
+        {
+            ESP_LOGE(TAG, "The last stage, and only it, must be a detector");
+            ok = false;
+        }
+    }
+    if (!ok || !data->stage_count)
+    {
+        ESP_LOGE(TAG, "Invalid pipeline '%s'", spec);
+        free_stages(data);
+        free(data);
+        return NULL;
+    }
+
+    filter_handle_t filter_handle = malloc(sizeof(filter));
+    filter_handle->self = filter_handle;
+    filter_handle->process = filter_pipeline_process;
+    filter_handle->calibrate_start = filter_pipeline_calibration_start;
+    filter_handle->calibrate_end = filter_pipeline_calibration_end;
+    filter_handle->reconfigure = NULL;
+    filter_handle->save = NULL;
+    filter_handle->restore = NULL;
+    filter_handle->filter_data = data;
+    data->calibration_countdown = SETTLE_FRAMES + CALIBRATION_FRAMES;
+    ESP_LOGI(TAG, "Pipeline '%s', %d stages", spec, data->stage_count);
+    return filter_handle;
+}
+
+filter_handle_t init_filter_pipeline_configured(const char *fallback)
+{
+    char spec[FILTER_PIPELINE_MAX_SPEC];
+    size_t length = sizeof(spec);
+    nvs_handle_t handle;
+    if (nvs_open(FILTER_STORE_NAMESPACE, NVS_READONLY, &handle) == ESP_OK)
+    {
+        esp_err_t err = nvs_get_str(handle, FILTER_PIPELINE_KEY, spec, &length);
+        nvs_close(handle);
+        if (err == ESP_OK)
+        {
+            filter_handle_t filter_handle = init_filter_pipeline(spec);
+            if (filter_handle)
+            {
+                return filter_handle;
+            }
+            ESP_LOGW(TAG, "Ignoring the pipeline saved in NVS");
+        }
+    }
+    return init_filter_pipeline(fallback);
+}
+
+void free_filter_pipeline(filter_handle_t filter_handle)
+{
+    free_stages(filter_handle->filter_data);
+    free(filter_handle->filter_data);
+    free(filter_handle);
+}
+
+int filter_pipeline_get_stats(filter_handle_t filter_handle, filter_stage_stats *stats, int max)
+{
+    filter_pipeline_data *data = (filter_pipeline_data *)filter_handle->filter_data;
+    int count = data->stage_count < max ? data->stage_count : max;
+    memcpy(stats, data->stats, count * sizeof(*stats));
+    return data->stage_count;
+}
@@ -0,0 +1,104 @@
+#ifndef FILTER_PIPELINE_H__
+#define FILTER_PIPELINE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constants.h"
+#include "filter.h"
+
+// A filter (filter.h) built from a chain of small stages, so an experiment such
+// as DC block -> low-pass -> crosstalk -> detector is a line of configuration
+// instead of a new filter. Every stage works in place on one frame buffer:
+// transforms rewrite its values, and the detector, always last, turns them into
+// pressed pins.
+//
+// A pipeline is described by a spec, stages separated by '>', each a name from
+// the table in filter_stages.c with optional numeric arguments:
+//
+//   "dc_block(0.5) > low_pass(8) > crosstalk > threshold(2.5, 1, 0.5)"
+//
+// FILTER_PIPELINE in constants.h selects one at build time, and a spec stored
+// as the string FILTER_PIPELINE_KEY in the FILTER_STORE_NAMESPACE NVS namespace
+// replaces it at boot.
+//
+// Calibration works as in the IIR filter: at boot and whenever the jumper is
+// set, the stages settle for FILTER_PIPELINE_SETTLE_S, then calibrate for
+// FILTER_PIPELINE_CALIBRATION_S, with nothing pressed in the meantime.
+//
+// The pipeline counts the CPU cycles each stage takes (filter_pipeline_get_stats).
+
+#define FILTER_PIPELINE_MAX_STAGES 8
+#define FILTER_PIPELINE_MAX_ARGS 4
+#define FILTER_PIPELINE_MAX_SPEC 128
+#define FILTER_PIPELINE_KEY "pipeline"
+#define FILTER_PIPELINE_SETTLE_S 2
+#define FILTER_PIPELINE_CALIBRATION_S 2
+
+// The buffer every stage of a frame works on.
+typedef struct
+{
+    // This frame's readings.
+    const uint32_t *adc_raw;
+    // Starts as the readings; rewritten by each transform.
+    float values[SENSOR_COUNT];
+    // The last frame's decisions, updated by the detector.
+    sensor_mask_t pressed;
+    // Between calibrate_start and calibrate_end.
+    bool calibrating;
+} filter_frame;
+
+typedef enum
+{
+    // values in, values out.
+    FILTER_STAGE_TRANSFORM,
+    // values in, pressed out. Exactly one, last.
+    FILTER_STAGE_DETECTOR,
+} filter_stage_kind;
+
+typedef struct filter_stage
+{
+    const char *name;
+    filter_stage_kind kind;
+    void (*process)(struct filter_stage *stage, filter_frame *frame);
+    // Optional: around the frames a calibration measures.
+    void (*calibrate_start)(struct filter_stage *stage);
+    void (*calibrate_end)(struct filter_stage *stage);
+    void *stage_data;
+} filter_stage;
+
+typedef struct
+{
+    const char *name;
+    uint32_t frames;
+    uint64_t cycles;
+    uint32_t max_cycles;
+} filter_stage_stats;
+
+// A stage the spec can name. Missing arguments take their defaults.
+typedef struct
+{
+    const char *name;
+    filter_stage_kind kind;
+    int arg_count;
+    float defaults[FILTER_PIPELINE_MAX_ARGS];
+    // Returns NULL if the arguments are out of range.
+    filter_stage *(*create)(const float *args);
+} filter_stage_type;
+
+// Stage types, in filter_stages.c.
+extern const filter_stage_type filter_stage_types[];
+extern const int filter_stage_type_count;
+
+// A filter running spec, or NULL (with the reason logged) if it does not parse
+// or does not end in exactly one detector.
+filter_handle_t init_filter_pipeline(const char *spec);
+// The spec saved in NVS if there is a valid one, otherwise fallback.
+filter_handle_t init_filter_pipeline_configured(const char *fallback);
+void free_filter_pipeline(filter_handle_t filter_handle);
+
+// Copies the statistics of each stage, in order. Returns the stage count.
+int filter_pipeline_get_stats(filter_handle_t filter_handle, filter_stage_stats *stats, int max);
+
+#endif
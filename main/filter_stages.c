@@ -0,0 +1,286 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_dsp.h"
+#include "esp_log.h"
+
+#include "constants.h"
+#include "filter_pipeline.h"
+#include "biquad_bank.h"
+#include "crosstalk.h"
+
+// The stages filter_pipeline.h specs can name. Each keeps its state in
+// stage_data, which the pipeline frees with the stage.
+
+const static char *TAG = "STAGES";
+
+#define N (SENSOR_COUNT)
+
+// Filtered values times PRESS_SIGN grow with a press.
+#ifdef ADC_COMMON_POSITIVE
+#define PRESS_SIGN 1.0f
+#else
+#define PRESS_SIGN -1.0f
+#endif
+
+static filter_stage *stage_alloc(const char *name, filter_stage_kind kind,
+                                 void (*process)(filter_stage *, filter_frame *), size_t data_size)
+{
+    filter_stage *stage = calloc(1, sizeof(filter_stage));
+    stage->name = name;
+    stage->kind = kind;
+    stage->process = process;
+    stage->stage_data = calloc(1, data_size);
+    return stage;
+}
+
+// Pole of a one-pole filter with the given cutoff.
+static float one_pole(float cutoff_hz)
+{
+    return expf(-2 * M_PI * cutoff_hz / SENSOR_FRAME_RATE_HZ);
+}
+
+// dc_block(cutoff_hz): one-pole high-pass, the reading minus its slow drift. The
+// first frame is taken as the baseline, so it starts at zero.
+typedef struct
+{
+    float pole;
+    bool started;
+    float last_in[N];
+    float last_out[N];
+} dc_block_data;
+
+static void dc_block_process(filter_stage *stage, filter_frame *frame)
+{
+    dc_block_data *data = stage->stage_data;
+    for (int i = 0; i < N; ++i)
+    {
+        float in = frame->values[i];
+        float out = data->started ? in - data->last_in[i] + data->pole * data->last_out[i] : 0;
+        data->last_in[i] = in;
+        data->last_out[i] = out;
+        frame->values[i] = out;
+    }
+    data->started = true;
+}
+
+static filter_stage *dc_block_create(const float *args)
+{
+    if (args[0] <= 0 || args[0] >= SENSOR_FRAME_RATE_HZ / 2)
+    {
+        return NULL;
+    }
+    filter_stage *stage = stage_alloc("dc_block", FILTER_STAGE_TRANSFORM, dc_block_process, sizeof(dc_block_data));
+    ((dc_block_data *)stage->stage_data)->pole = one_pole(args[0]);
+    return stage;
+}
+
+// low_pass(cutoff_hz): one-pole low-pass, starting at the first frame.
+typedef struct
+{
+    float pole;
+    bool started;
+    float state[N];
+} low_pass_data;
+
+static void low_pass_process(filter_stage *stage, filter_frame *frame)
+{
+    low_pass_data *data = stage->stage_data;
+    for (int i = 0; i < N; ++i)
+    {
+        float in = frame->values[i];
+        data->state[i] = data->started ? data->state[i] + (1 - data->pole) * (in - data->state[i]) : in;
+        frame->values[i] = data->state[i];
+    }
+    data->started = true;
+}
+
+static filter_stage *low_pass_create(const float *args)
+{
+    if (args[0] <= 0 || args[0] >= SENSOR_FRAME_RATE_HZ / 2)
+    {
+        return NULL;
+    }
+    filter_stage *stage = stage_alloc("low_pass", FILTER_STAGE_TRANSFORM, low_pass_process, sizeof(low_pass_data));
+    ((low_pass_data *)stage->stage_data)->pole = one_pole(args[0]);
+    return stage;
+}
+
+// band_pass(frequency_hz, q): the IIR filter's band-pass on every sensor, with
+// the delay lines settled on the first frame.
+typedef struct
+{
+    bool started;
+    biquad_bank bank;
+} band_pass_data;
+
+static void band_pass_process(filter_stage *stage, filter_frame *frame)
+{
+    band_pass_data *data = stage->stage_data;
+    if (!data->started)
+    {
+        biquad_bank_settle(&data->bank, frame->values);
+        data->started = true;
+    }
+    biquad_bank_process(&data->bank, frame->values, frame->values);
+}
+
+static filter_stage *band_pass_create(const float *args)
+{
+    float coeffs[5];
+    if (args[0] <= 0 || args[0] >= SENSOR_FRAME_RATE_HZ / 2 || args[1] <= 0 ||
+        dsps_biquad_gen_bpf_f32(coeffs, args[0] / SENSOR_FRAME_RATE_HZ, args[1]) != ESP_OK)
+    {
+        return NULL;
+    }
+    filter_stage *stage = stage_alloc("band_pass", FILTER_STAGE_TRANSFORM, band_pass_process, sizeof(band_pass_data));
+    band_pass_data *data = stage->stage_data;
+    biquad_bank_init(&data->bank);
+    for (int i = 0; i < N; ++i)
+    {
+        biquad_bank_set(&data->bank, i, coeffs);
+    }
+    return stage;
+}
+
+// crosstalk(refit_s): compensates crosstalk (crosstalk.h) on values that are
+// already deviations from idle, so it goes after dc_block or band_pass. The
+// coupling is estimated all the time from the readings of single-finger chords,
+// and the compensation refitted every refit_s seconds, after which older presses
+// count half as much. A refit is logged only when the number of sensors it
+// covers changes.
+typedef struct
+{
+    int refit_frames;
+    int frames;
+    int estimated;
+    crosstalk_estimator estimator;
+    crosstalk_compensation compensation;
+} crosstalk_stage_data;
+
+static void crosstalk_stage_process(filter_stage *stage, filter_frame *frame)
+{
+    crosstalk_stage_data *data = stage->stage_data;
+    crosstalk_estimator_add(&data->estimator, frame->adc_raw);
+    if (++data->frames >= data->refit_frames)
+    {
+        data->frames = 0;
+        int estimated = crosstalk_estimator_fit(&data->estimator, &data->compensation);
+        if (estimated && estimated != data->estimated)
+        {
+            ESP_LOGI(TAG, "crosstalk | compensating on %d sensors", estimated);
+            data->estimated = estimated;
+        }
+        if (estimated)
+        {
+            crosstalk_estimator_decay(&data->estimator);
+        }
+    }
+    if (data->compensation.enabled)
+    {
+        float compensated[N];
+        dspm_mult_f32(data->compensation.matrix, frame->values, compensated, N, N, 1);
+        memcpy(frame->values, compensated, sizeof(compensated));
+    }
+}
+
+static filter_stage *crosstalk_stage_create(const float *args)
+{
+    if (args[0] < 1)
+    {
+        return NULL;
+    }
+    filter_stage *stage = stage_alloc("crosstalk", FILTER_STAGE_TRANSFORM, crosstalk_stage_process, sizeof(crosstalk_stage_data));
+    crosstalk_stage_data *data = stage->stage_data;
+    crosstalk_estimator_params params = crosstalk_estimator_default_params();
+    data->refit_frames = args[0] * SENSOR_FRAME_RATE_HZ;
+    crosstalk_estimator_init(&data->estimator, &params);
+    crosstalk_compensation_init(&data->compensation);
+    return stage;
+}
+
+// threshold(multiplier, min_threshold, release_fraction): detector. A sensor is
+// pressed from when its value reaches its threshold until it falls below
+// release_fraction of it. Calibration sets each threshold to multiplier times
+// the largest swing seen while calibrating, plus min_threshold.
+typedef struct
+{
+    float multiplier;
+    float min_threshold;
+    float release_fraction;
+    float peak[N];
+    float thresholds[N];
+} threshold_data;
+
+static void threshold_process(filter_stage *stage, filter_frame *frame)
+{
+    threshold_data *data = stage->stage_data;
+    sensor_mask_t over = 0;
+    sensor_mask_t held = 0;
+    for (int i = N - 1; i >= 0; --i)
+    {
+        float movement = PRESS_SIGN * frame->values[i];
+        if (frame->calibrating)
+        {
+            float swing = fabsf(movement);
+            data->peak[i] = swing > data->peak[i] ? swing : data->peak[i];
+        }
+        over = over << 1 | (movement >= data->thresholds[i]);
+        held = held << 1 | (movement >= data->release_fraction * data->thresholds[i]);
+    }
+    frame->pressed = (~frame->pressed & over) | (frame->pressed & held);
+}
+
+static void threshold_calibrate_start(filter_stage *stage)
+{
+    threshold_data *data = stage->stage_data;
+    memset(data->peak, 0, sizeof(data->peak));
+}
+
+static void threshold_calibrate_end(filter_stage *stage)
+{
+    threshold_data *data = stage->stage_data;
+    for (int i = 0; i < N; ++i)
+    {
+        data->thresholds[i] = data->peak[i] * data->multiplier + data->min_threshold;
+    }
+    char line[16 * N + 16];
+    int length = snprintf(line, sizeof(line), "threshold |");
+    for (int i = 0; i < N && length < (int)sizeof(line); ++i)
+    {
+        length += snprintf(line + length, sizeof(line) - length, " %4f |", data->thresholds[i]);
+    }
+    ESP_LOGI(TAG, "%s", line);
+}
+
+static filter_stage *threshold_create(const float *args)
+{
+    if (args[0] <= 0 || args[1] < 0 || args[2] <= 0 || args[2] > 1)
+    {
+        return NULL;
+    }
+    filter_stage *stage = stage_alloc("threshold", FILTER_STAGE_DETECTOR, threshold_process, sizeof(threshold_data));
+    stage->calibrate_start = threshold_calibrate_start;
+    stage->calibrate_end = threshold_calibrate_end;
+    threshold_data *data = stage->stage_data;
+    data->multiplier = args[0];
+    data->min_threshold = args[1];
+    data->release_fraction = args[2];
+    for (int i = 0; i < N; ++i)
+    {
+        data->thresholds[i] = args[1];
+    }
+    return stage;
+}
+
+const filter_stage_type filter_stage_types[] = {
+    {"dc_block", FILTER_STAGE_TRANSFORM, 1, {0.5f}, dc_block_create},
+    {"low_pass", FILTER_STAGE_TRANSFORM, 1, {10}, low_pass_create},
+    {"band_pass", FILTER_STAGE_TRANSFORM, 2, {2, 0.5f}, band_pass_create},
+    {"crosstalk", FILTER_STAGE_TRANSFORM, 1, {10}, crosstalk_stage_create},
+    {"threshold", FILTER_STAGE_DETECTOR, 3, {2.5f, 1, 1}, threshold_create},
+};
+
+const int filter_stage_type_count = sizeof(filter_stage_types) / sizeof(filter_stage_types[0]);
@@ -0,0 +1,188 @@
+#include <stdatomic.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#include "constants.h"
+#include "filter.h"
+#include "filter_store.h"
+
+#define FILTER_STORE_MAGIC 0x46574150 // "PAWF"
+
+// The filter is asked for a snapshot once a second.
+#define FILTER_STORE_CHECK_FRAMES SENSOR_FRAME_RATE_HZ
+#define FILTER_STORE_PERIOD_FRAMES (FILTER_STORE_PERIOD_S * SENSOR_FRAME_RATE_HZ)
+
+#define FILTER_STORE_TASK_PRIORITY 1
+#define FILTER_STORE_TASK_STACK 3072
+
+const static char *TAG = "FILTER_STORE";
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    // Of the size bytes that follow.
+    uint32_t crc;
+} filter_store_header;
+
+// The snapshot waiting for the writer, header first. The sampler fills it only
+// while pending is false, and the writer reads it only while it is true.
+static uint8_t snapshot[sizeof(filter_store_header) + FILTER_STORE_MAX_BLOB];
+static atomic_bool pending;
+static TaskHandle_t writer_task_handle = NULL;
+
+// Sampler side.
+static uint32_t frames = 0;
+static uint32_t last_snapshot_frame = 0;
+static bool calibrating = true;
+
+// Writer side: what is in flash already.
+static uint32_t written_crc = 0;
+static uint16_t written_size = 0;
+
+static filter_store_stats_t stats = {.restored_us = -1};
+
+bool filter_store_restore(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(FILTER_STORE_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+    {
+        // The namespace does not exist until the first write.
+        ESP_LOGI(TAG, "No saved filter state");
+        return false;
+    }
+    size_t length = sizeof(snapshot);
+    err = nvs_get_blob(handle, FILTER_STORE_KEY, snapshot, &length);
+    nvs_close(handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGI(TAG, "No saved filter state (%s)", esp_err_to_name(err));
+        return false;
+    }
+
+    filter_store_header header;
+    memcpy(&header, snapshot, sizeof(header));
+    const uint8_t *blob = snapshot + sizeof(header);
+    if (length < sizeof(header) || header.magic != FILTER_STORE_MAGIC || header.version != FILTER_STORE_VERSION ||
+        header.size != length - sizeof(header) || header.crc != esp_rom_crc32_le(0, blob, header.size))
+    {
+        ESP_LOGW(TAG, "Saved filter state is invalid, calibrating");
+        return false;
+    }
+    if (!default_filter_restore(blob, header.size))
+    {
+        ESP_LOGW(TAG, "Saved filter state does not fit this filter, calibrating");
+        return false;
+    }
+
+    // Already in flash, and calibrated.
+    written_crc = header.crc;
+    written_size = header.size;
+    calibrating = false;
+    stats.restored_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Restored filter state, %d bytes, %lld ms after boot", header.size, stats.restored_us / 1000);
+    return true;
+}
+
+void filter_store_frame(void)
+{
+    if (++frames % FILTER_STORE_CHECK_FRAMES != 0 || atomic_load_explicit(&pending, memory_order_acquire))
+    {
+        return;
+    }
+    uint8_t *blob = snapshot + sizeof(filter_store_header);
+    size_t size = default_filter_save(blob, FILTER_STORE_MAX_BLOB);
+    bool calibrated = size && calibrating;
+    calibrating = !size;
+    if (!size || (!calibrated && frames - last_snapshot_frame < FILTER_STORE_PERIOD_FRAMES))
+    {
+        return;
+    }
+
+    filter_store_header header = {
+        .magic = FILTER_STORE_MAGIC,
+        .version = FILTER_STORE_VERSION,
+        .size = size,
+        .crc = esp_rom_crc32_le(0, blob, size),
+    };
+    memcpy(snapshot, &header, sizeof(header));
+    last_snapshot_frame = frames;
+    stats.snapshots++;
+    atomic_store_explicit(&pending, true, memory_order_release);
+    if (writer_task_handle)
+    {
+        xTaskNotifyGive(writer_task_handle);
+    }
+}
+
+bool filter_store_flush(void)
+{
+    if (!atomic_load_explicit(&pending, memory_order_acquire))
+    {
+        return false;
+    }
+    filter_store_header header;
+    memcpy(&header, snapshot, sizeof(header));
+    bool written = false;
+    if (header.crc == written_crc && header.size == written_size)
+    {
+        // Idle since the last write: spare the flash.
+        stats.unchanged++;
+    }
+    else
+    {
+        nvs_handle_t handle;
+        esp_err_t err = nvs_open(FILTER_STORE_NAMESPACE, NVS_READWRITE, &handle);
+        if (err == ESP_OK)
+        {
+            err = nvs_set_blob(handle, FILTER_STORE_KEY, snapshot, sizeof(header) + header.size);
+            if (err == ESP_OK)
+            {
+                err = nvs_commit(handle);
+            }
+            nvs_close(handle);
+        }
+        if (err == ESP_OK)
+        {
+            written_crc = header.crc;
+            written_size = header.size;
+            stats.writes++;
+            written = true;
+            ESP_LOGI(TAG, "Saved filter state, %d bytes", header.size);
+        }
+        else
+        {
+            stats.write_errors++;
+            ESP_LOGE(TAG, "Failed to save filter state (%s)", esp_err_to_name(err));
+        }
+    }
+    atomic_store_explicit(&pending, false, memory_order_release);
+    return written;
+}
+
+static void filter_store_task(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        filter_store_flush();
+    }
+}
+
+void filter_store_start(void)
+{
+    xTaskCreate(&filter_store_task, "filter_store", FILTER_STORE_TASK_STACK, NULL, FILTER_STORE_TASK_PRIORITY, &writer_task_handle);
+}
+
+filter_store_stats_t filter_store_get_stats(void)
+{
+    return stats;
+}
@@ -0,0 +1,55 @@
+#ifndef FILTER_STORE_H__
+#define FILTER_STORE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Keeps the default filter's calibration in NVS, so a reset or a crash does not
+// cost a calibration before the keyboard types again. The filter decides what to
+// keep (filter.save and filter.restore); for the IIR filter that is its
+// parameters, thresholds and adaptive estimates.
+//
+// The blob is FILTER_STORE_KEY in namespace FILTER_STORE_NAMESPACE: a header
+// with a magic number, FILTER_STORE_VERSION, the length and a CRC-32 of what
+// follows, then the filter's own bytes. Anything that does not check out is
+// ignored and the filter calibrates as usual.
+//
+// The sampler task takes a snapshot between frames (filter_store_frame): right
+// after a calibration, then every FILTER_STORE_PERIOD_S while the state moves.
+// A low-priority writer task puts it in flash, so the sampler never waits on it.
+
+#define FILTER_STORE_NAMESPACE "paw"
+#define FILTER_STORE_KEY "filter"
+#define FILTER_STORE_VERSION 1
+// Largest filter blob.
+#define FILTER_STORE_MAX_BLOB 4096
+#define FILTER_STORE_PERIOD_S 900
+
+typedef struct
+{
+    uint32_t snapshots;
+    uint32_t writes;
+    uint32_t write_errors;
+    // Snapshots identical to the last one written.
+    uint32_t unchanged;
+    // Time since boot when the saved state was restored, or -1 if it was not.
+    int64_t restored_us;
+} filter_store_stats_t;
+
+// Loads the saved state into the default filter. Call once the filter is set and
+// before any frame is processed. Returns false, and leaves the filter
+// calibrating, when nothing valid was saved.
+bool filter_store_restore(void);
+
+// Sampler side, once per frame after filtering.
+void filter_store_frame(void);
+
+// Starts the writer task. Without it, filter_store_flush does the writing.
+void filter_store_start(void);
+
+// Writes a pending snapshot now. Returns true if one was written.
+bool filter_store_flush(void);
+
+filter_store_stats_t filter_store_get_stats(void);
+
+#endif
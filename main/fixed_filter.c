@@ -0,0 +1,242 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "filter.h"
+#include "constants.h"
+#include "fixed_filter.h"
+#include "state.h"
+#include "remote_config.h"
+#include "sensor_log.h"
+
+const static char *TAG = "FILTER";
+
+#ifdef ADC_COMMON_POSITIVE
+#define ADC_LT_OPERATOR <
+#define ADC_GE_OPERATOR >
+#else
+#define ADC_LT_OPERATOR >
+#define ADC_GE_OPERATOR <
+#endif
+
+#define SAMPLE_MAX ((INT16_MAX) >> FIXED_FILTER_FRACTION_BITS)
+#define COEFF_ONE (1 << FIXED_FILTER_COEFF_BITS)
+// calibration_peak_multiplier is applied in Q8.
+#define MULTIPLIER_BITS 8
+
+typedef struct
+{
+    // Q14 coefficients, structure of arrays: b0 b1 b2 a1 a2 of every channel.
+    int16_t b0[SENSOR_COUNT];
+    int16_t b1[SENSOR_COUNT];
+    int16_t b2[SENSOR_COUNT];
+    int16_t a1[SENSOR_COUNT];
+    int16_t a2[SENSOR_COUNT];
+    // Direct form I history: the last two inputs and outputs.
+    int16_t x1[SENSOR_COUNT];
+    int16_t x2[SENSOR_COUNT];
+    int16_t y1[SENSOR_COUNT];
+    int16_t y2[SENSOR_COUNT];
+
+    int16_t thresholds[SENSOR_COUNT];
+    int16_t min_threshold;
+    int32_t peak_multiplier;
+
+    sensor_debounce debounce;
+    // params.holdable as a mask.
+    sensor_mask_t holdable;
+
+    int calibration_countdown;
+
+    iir_filter_params params;
+} fixed_filter_data;
+
+static inline int16_t saturate16(int32_t value)
+{
+    return value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : (int16_t)value;
+}
+
+static int16_t to_q14(float coeff)
+{
+    return saturate16((int32_t)lrintf(coeff * COEFF_ONE));
+}
+
+void fixed_filter_process_filter(fixed_filter_data *data, uint32_t *adc_raw, int16_t *out)
+{
+    // Written as whole-array passes so the compiler can vectorise them.
+    int16_t x[SENSOR_COUNT];
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        uint32_t raw = adc_raw[i] > SAMPLE_MAX ? SAMPLE_MAX : adc_raw[i];
+        x[i] = (int16_t)(raw << FIXED_FILTER_FRACTION_BITS);
+    }
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        int32_t acc = data->b0[i] * x[i] + data->b1[i] * data->x1[i] + data->b2[i] * data->x2[i] -
+                      data->a1[i] * data->y1[i] - data->a2[i] * data->y2[i];
+        out[i] = saturate16((acc + (COEFF_ONE >> 1)) >> FIXED_FILTER_COEFF_BITS);
+    }
+    memcpy(data->x2, data->x1, sizeof(data->x2));
+    memcpy(data->x1, x, sizeof(data->x1));
+    memcpy(data->y2, data->y1, sizeof(data->y2));
+    memcpy(data->y1, out, sizeof(data->y1));
+    if (test_state(KEYBOARD_STATE_SENSOR_LOGGING))
+    {
+        float filtered[SENSOR_COUNT];
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            filtered[i] = (float)out[i] / (1 << FIXED_FILTER_FRACTION_BITS);
+        }
+        sensor_log_filtered(filtered);
+    }
+}
+
+// Same decisions as the float filter without adaptation: holdable sensors wait
+// for a release of the same size as a press, the others follow the threshold.
+void fixed_filter_process_normal(fixed_filter_data *data, int16_t *filtered_data, sensor_mask_t *pressed)
+{
+    sensor_mask_t over = 0;
+    sensor_mask_t swung = 0;
+    for (int i = SENSOR_COUNT - 1; i >= 0; --i)
+    {
+        over = over << 1 | (filtered_data[i] ADC_GE_OPERATOR data->thresholds[i]);
+        swung = swung << 1 | (filtered_data[i] ADC_LT_OPERATOR(-data->thresholds[i]));
+    }
+    sensor_mask_t releasing = (data->holdable & swung) | (~data->holdable & ~over);
+    *pressed = sensor_mask_decide(*pressed, over, releasing, data->holdable, data->params.debounce_count,
+                                  &data->debounce);
+}
+
+void fixed_filter_process_calibration(fixed_filter_data *data, int16_t *filtered_data)
+{
+    // Overtime represents a startup initialization delay, allowing filters to stabilize.
+    if (data->calibration_countdown > (data->params.calibration_time_seconds) * (data->params.sample_rate))
+    {
+        return;
+    }
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        int16_t abs = saturate16(filtered_data[i] > 0 ? filtered_data[i] : -filtered_data[i]);
+        data->thresholds[i] = data->thresholds[i] ADC_GE_OPERATOR abs ? data->thresholds[i] : abs;
+    }
+    if (data->calibration_countdown == 0)
+    {
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            int32_t scaled = (data->thresholds[i] * data->peak_multiplier + (1 << (MULTIPLIER_BITS - 1))) >> MULTIPLIER_BITS;
+#ifdef ADC_COMMON_POSITIVE
+            data->thresholds[i] = saturate16(scaled + data->min_threshold);
+#else
+            data->thresholds[i] = saturate16(-scaled + data->min_threshold);
+#endif
+        }
+        memset(&data->debounce, 0, sizeof(data->debounce));
+        // Same line as the float filter, so the log tools read the thresholds.
+        const float scale = 1.0f / (1 << FIXED_FILTER_FRACTION_BITS);
+        ESP_LOGI(TAG, "Exit IIR calibration | %4f | %4f | %4f | %4f | %4f |", data->thresholds[0] * scale, data->thresholds[1] * scale,
+                 data->thresholds[2] * scale, data->thresholds[3] * scale, data->thresholds[4] * scale);
+    }
+}
+
+void fixed_sensor_process(filter_handle_t filter_handle, uint32_t *adc_raw, sensor_mask_t *pressed)
+{
+    fixed_filter_data *data = (fixed_filter_data *)filter_handle->filter_data;
+    int16_t filtered_data[SENSOR_COUNT];
+
+    fixed_filter_process_filter(data, adc_raw, filtered_data);
+
+    if (!data->calibration_countdown)
+    {
+        fixed_filter_process_normal(data, filtered_data, pressed);
+    }
+    else
+    {
+        data->calibration_countdown--;
+        *pressed = 0;
+        fixed_filter_process_calibration(data, filtered_data);
+    }
+}
+
+void fixed_filter_load_params(filter_handle_t filter_handle, iir_filter_params *params)
+{
+    fixed_filter_data *data = (fixed_filter_data *)filter_handle->filter_data;
+    data->params = *params;
+    data->holdable = sensor_mask_from_bools(params->holdable);
+
+    // Same coefficients as the float filter, rounded to Q14.
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        float coeffs[5];
+        esp_err_t err = iir_filter_coefficients(params, i, coeffs);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Operation error = %i", err);
+        }
+        data->b0[i] = to_q14(coeffs[0]);
+        data->b1[i] = to_q14(coeffs[1]);
+        data->b2[i] = to_q14(coeffs[2]);
+        data->a1[i] = to_q14(coeffs[3]);
+        data->a2[i] = to_q14(coeffs[4]);
+
+        int32_t sum = abs(data->b0[i]) + abs(data->b1[i]) + abs(data->b2[i]) + abs(data->a1[i]) + abs(data->a2[i]);
+        if ((int64_t)sum * INT16_MAX + (COEFF_ONE >> 1) > INT32_MAX)
+        {
+            ESP_LOGW(TAG, "Sensor %d: coefficients too large, output may wrap", i);
+        }
+    }
+    data->min_threshold = saturate16((int32_t)lrintf(params->min_threshold * (1 << FIXED_FILTER_FRACTION_BITS)));
+    data->peak_multiplier = (int32_t)lrintf(params->calibration_peak_multiplier * (1 << MULTIPLIER_BITS));
+
+    data->calibration_countdown = (data->params.calibration_time_seconds + 2) * (data->params.sample_rate);
+}
+
+void fixed_filter_calibration_start(filter_handle_t filter_handle, uint32_t *adc_raw)
+{
+    ESP_LOGI(TAG, "Enter IIR calibration");
+
+    fixed_filter_data *data = (fixed_filter_data *)filter_handle->filter_data;
+
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        data->thresholds[i] = 0;
+    }
+
+    iir_filter_params new_params = get_remote_config();
+    if (new_params.sample_rate != 0)
+    {
+        fixed_filter_load_params(filter_handle, &new_params);
+    }
+    else
+    {
+        data->calibration_countdown = (data->params.calibration_time_seconds) * (data->params.sample_rate);
+    }
+}
+
+void fixed_filter_calibration_end(filter_handle_t filter_handle, uint32_t *adc_raw) {}
+
+void *init_fixed_filter(iir_filter_params *params)
+{
+    filter_handle_t filter_handle = malloc(sizeof(filter));
+    filter_handle->self = filter_handle;
+    filter_handle->process = fixed_sensor_process;
+    filter_handle->calibrate_start = fixed_filter_calibration_start;
+    filter_handle->calibrate_end = fixed_filter_calibration_end;
+    filter_handle->reconfigure = NULL;
+    filter_handle->save = NULL;
+    filter_handle->restore = NULL;
+
+    fixed_filter_data *data = calloc(1, sizeof(fixed_filter_data));
+    filter_handle->filter_data = (void *)data;
+    fixed_filter_load_params(filter_handle, params);
+
+    return filter_handle;
+}
+
+void *init_fixed_filter_default(void)
+{
+    iir_filter_params params = iir_filter_default_params();
+    return init_fixed_filter(&params);
+}
@@ -0,0 +1,27 @@
+#ifndef FIXED_FILTER_H__
+#define FIXED_FILTER_H__
+
+#include "iir_filter.h"
+
+// Integer version of the IIR filter: the same biquads, calibration and
+// press decisions, configured by the same iir_filter_params, with no float
+// arithmetic per frame.
+//
+// Samples are int16 ADC counts with FIXED_FILTER_FRACTION_BITS of fraction (a
+// 12-bit reading uses the whole range). Coefficients are Q14, since the
+// feedback coefficient a1 reaches -2. Each biquad is direct form I with a 32-bit
+// accumulator. For the band-pass and onset biquads the coefficient magnitudes
+// sum to less than 4, so the accumulator cannot overflow. The output is rounded
+// and saturated to int16. Thresholds are in the same units as the samples. They
+// stay as calibrated: adaptive_thresholds is ignored.
+//
+// host/tools/filter_compare replays captures through this filter and the float
+// one and compares their decisions.
+
+#define FIXED_FILTER_FRACTION_BITS 3
+#define FIXED_FILTER_COEFF_BITS 14
+
+void *init_fixed_filter(iir_filter_params *params);
+void *init_fixed_filter_default(void);
+
+#endif
@@ -0,0 +1,53 @@
+#include "frame_ring.h"
+
+#define FRAME_RING_MASK (FRAME_RING_CAPACITY - 1)
+
+_Static_assert((FRAME_RING_CAPACITY & FRAME_RING_MASK) == 0, "FRAME_RING_CAPACITY must be a power of two");
+
+void frame_ring_init(frame_ring_t *ring)
+{
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->cached_tail = 0;
+    ring->cached_head = 0;
+}
+
+bool frame_ring_push(frame_ring_t *ring, const sensor_frame_t *frame)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    // Only reload the consumer's index when the cached one says the ring is full.
+    if (head - ring->cached_tail == FRAME_RING_CAPACITY)
+    {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head - ring->cached_tail == FRAME_RING_CAPACITY)
+        {
+            return false;
+        }
+    }
+    ring->frames[head & FRAME_RING_MASK] = *frame;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool frame_ring_pop(frame_ring_t *ring, sensor_frame_t *frame)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail == ring->cached_head)
+    {
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail == ring->cached_head)
+        {
+            return false;
+        }
+    }
+    *frame = ring->frames[tail & FRAME_RING_MASK];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+uint32_t frame_ring_count(frame_ring_t *ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
@@ -0,0 +1,43 @@
+#ifndef FRAME_RING_H__
+#define FRAME_RING_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "acquisition.h"
+
+// Wait-free single-producer/single-consumer ring of sensor frames. One task may
+// push and one other task may pop, on either core; neither ever blocks or takes
+// a lock. Waking a waiting consumer is up to the caller.
+
+// Power of two, so indices can run freely and wrap with a mask.
+#define FRAME_RING_CAPACITY 16
+// Keeps the producer's and consumer's indices on separate cache lines.
+#define FRAME_RING_ALIGN 64
+
+typedef struct
+{
+    // Written only by the producer.
+    _Alignas(FRAME_RING_ALIGN) _Atomic uint32_t head;
+    uint32_t cached_tail;
+
+    // Written only by the consumer.
+    _Alignas(FRAME_RING_ALIGN) _Atomic uint32_t tail;
+    uint32_t cached_head;
+
+    _Alignas(FRAME_RING_ALIGN) sensor_frame_t frames[FRAME_RING_CAPACITY];
+} frame_ring_t;
+
+void frame_ring_init(frame_ring_t *ring);
+
+// Producer side. Returns false, leaving the ring unchanged, if it is full.
+bool frame_ring_push(frame_ring_t *ring, const sensor_frame_t *frame);
+
+// Consumer side. Returns false if the ring is empty.
+bool frame_ring_pop(frame_ring_t *ring, sensor_frame_t *frame);
+
+// Frames waiting; exact only when called from one of the two sides.
+uint32_t frame_ring_count(frame_ring_t *ring);
+
+#endif
@@ -159,7 +159,7 @@ void multi_motor_feedback(bool force_off, bool force_full)
   {
     for (int i = 0; i < 5; ++i)
     {
-      gpio_set_level(output_gpio_ids[i], FEEDBACK_SIGN_OPERATOR pins_pressed[i]);
+      gpio_set_level(output_gpio_ids[i], FEEDBACK_SIGN_OPERATOR sensor_mask_test(pins_pressed, i));
     }
   }
 }
@@ -1,12 +1,24 @@
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "esp_dsp.h"
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include "filter.h"
 #include "constants.h"
 #include "iir_filter.h"
 #include "state.h"
 #include "remote_config.h"
+#include "sensor_log.h"
+#include "biquad_bank.h"
+#include "p2_quantile.h"
+#include "filter_store.h"
 
 
 const static char *TAG = "FILTER";
@@ -19,80 +31,321 @@ const static char *TAG = "FILTER";
 #define ADC_GE_OPERATOR <
 #endif
 
+// Filtered readings times PRESS_SIGN grow with a press.
+#ifdef ADC_COMMON_POSITIVE
+#define PRESS_SIGN 1.0f
+#else
+#define PRESS_SIGN -1.0f
+#endif
+
+// Adaptive thresholds (iir_filter_params.adaptive_thresholds). A sensor's
+// threshold follows a fraction of its median press peak, and its release a
+// fraction of its median release trough, but neither goes below a margin over
+// the idle noise.
+#define ADAPT_PEAK_QUANTILE 0.5f
+#define ADAPT_PEAK_FRACTION 0.4f
+#define ADAPT_NOISE_QUANTILE 0.5f
+#define ADAPT_NOISE_MARGIN 4.0f
+// Presses (or releases) before the estimate is trusted, and after which it starts over.
+#define ADAPT_MIN_PEAKS 8
+#define ADAPT_PEAK_WINDOW 64
+// Same, in idle readings. One frame in ADAPT_NOISE_STRIDE is a reading.
+#define ADAPT_NOISE_STRIDE 8
+#define ADAPT_MIN_NOISE 50
+#define ADAPT_NOISE_WINDOW 400
+// How far a threshold moves towards its new estimate at each update.
+#define ADAPT_RATE 0.25f
+
+// Live reconfiguration (iir_filter_reconfigure): the writer stages the new
+// frequencies, Q factors and responses with their coefficients, touching
+// nothing the sampler uses, then marks them ready; the sampler merges them into
+// its params and switches banks at the start of its next frame. Loading params
+// (calibration, restore) drops what is staged, and cancels a staging still
+// being written, so neither lands on top of them a frame later.
+enum
+{
+    IIR_SWAP_IDLE,
+    IIR_SWAP_WRITING,
+    IIR_SWAP_READY,
+    IIR_SWAP_SWAPPING,
+    // Params were loaded while the writer was staging: it drops what it wrote.
+    IIR_SWAP_CANCELLED,
+};
+
 typedef struct
 {
-    float coeffs[SENSOR_COUNT][5];
-    float delay_line[SENSOR_COUNT][2];
-    float thresholds[SENSOR_COUNT];
+    // biquads[active] filters; the other one takes the next coefficients.
+    biquad_bank biquads[2];
+    int active;
+    float staged_frequency[SENSOR_COUNT];
+    float staged_qfactor[SENSOR_COUNT];
+    iir_filter_response staged_response[SENSOR_COUNT];
+    float staged_coeffs[SENSOR_COUNT][5];
+    _Atomic int swap_state;
 
-    int consecutive_movement[SENSOR_COUNT];
+    float thresholds[SENSOR_COUNT];
+    // Holdable sensors release below -release_thresholds. Non-holdable ones
+    // release below release_thresholds, which without adaptation are the thresholds.
+    float release_thresholds[SENSOR_COUNT];
+
+    sensor_debounce debounce;
+    // params.holdable as a mask.
+    sensor_mask_t holdable;
+
+    // Adaptive thresholds: press peaks, release troughs and idle readings, in
+    // the press direction. peak and trough are those of the excursion in progress, or 0.
+    p2_quantile peaks[SENSOR_COUNT];
+    p2_quantile troughs[SENSOR_COUNT];
+    p2_quantile noise[SENSOR_COUNT];
+    float peak[SENSOR_COUNT];
+    float trough[SENSOR_COUNT];
+    float noise_level[SENSOR_COUNT];
+    uint32_t adapt_frames;
 
     int calibration_countdown;
+    // Restored from flash: frames left before filtering starts, and the sum of
+    // their readings, on whose mean the delay lines settle.
+    int warmup_frames;
+    float warmup_sum[SENSOR_COUNT];
 
     iir_filter_params params;
+    // Of the params the filter was built with (iir_filter_params_crc).
+    uint32_t built_params_crc;
 } iir_filter_data;
 
-void iir_filter_process_filter(iir_filter_data *data, uint32_t *adc_raw, float *out)
+// What survives a reset (filter_store.h): everything calibrated or learnt. The
+// delay lines are not kept: they settle on the mean of the first
+// IIR_FILTER_WARMUP_FRAMES after boot, which matches the readings of the day
+// better than any saved state. Settling on a single frame would turn its noise
+// into a step as large as the calibrated thresholds.
+// A snapshot also records the params the filter was built with, and is only
+// restored by a build with the same: after a reflash with new defaults the
+// saved calibration would silently win over them.
+// Bump IIR_FILTER_SNAPSHOT_VERSION whenever the layout changes.
+#define IIR_FILTER_SNAPSHOT_VERSION 2
+#define IIR_FILTER_WARMUP_FRAMES 8
+
+typedef struct
+{
+    uint32_t version;
+    uint32_t sensor_count;
+    uint32_t built_params_crc;
+    iir_filter_params params;
+    float thresholds[SENSOR_COUNT];
+    float release_thresholds[SENSOR_COUNT];
+    p2_quantile peaks[SENSOR_COUNT];
+    p2_quantile troughs[SENSOR_COUNT];
+    p2_quantile noise[SENSOR_COUNT];
+    float noise_level[SENSOR_COUNT];
+} iir_filter_snapshot;
+
+_Static_assert(sizeof(iir_filter_snapshot) <= FILTER_STORE_MAX_BLOB, "IIR filter snapshot too large to store");
+
+// Field by field, so padding bytes do not count.
+#define IIR_CRC_FIELD(crc, p, field) esp_rom_crc32_le((crc), (const uint8_t *)&(p)->field, sizeof((p)->field))
+static uint32_t iir_filter_params_crc(const iir_filter_params *p)
 {
+    uint32_t crc = IIR_CRC_FIELD(0, p, sample_rate);
+    crc = IIR_CRC_FIELD(crc, p, target_frequency);
+    crc = IIR_CRC_FIELD(crc, p, qfactor);
+    crc = IIR_CRC_FIELD(crc, p, response);
+    crc = IIR_CRC_FIELD(crc, p, calibration_peak_multiplier);
+    crc = IIR_CRC_FIELD(crc, p, calibration_time_seconds);
+    crc = IIR_CRC_FIELD(crc, p, holdable);
+    crc = IIR_CRC_FIELD(crc, p, debounce_count);
+    crc = IIR_CRC_FIELD(crc, p, min_threshold);
+    return IIR_CRC_FIELD(crc, p, adaptive_thresholds);
+}
 
-    // Actual filtering.
+// Takes staged coefficients, if any, between two frames. The new bank starts
+// settled on the current readings rather than on the old bank's state, so it
+// outputs no step; thresholds and pressed state carry over.
+static void iir_filter_swap(iir_filter_data *data, const float *in)
+{
+    int ready = IIR_SWAP_READY;
+    if (!atomic_compare_exchange_strong_explicit(&data->swap_state, &ready, IIR_SWAP_SWAPPING,
+                                                 memory_order_acquire, memory_order_relaxed))
+    {
+        return;
+    }
+    int next = !data->active;
     for (int i = 0; i < SENSOR_COUNT; ++i)
     {
-        float in = (float)adc_raw[i];
-        dsps_biquad_f32_ansi(&in, &(out[i]), 1, data->coeffs[i], data->delay_line[i]);
+        biquad_bank_set(&data->biquads[next], i, data->staged_coeffs[i]);
     }
-    if (test_state(KEYBOARD_STATE_SENSOR_LOGGING))
+    biquad_bank_settle(&data->biquads[next], in);
+    data->active = next;
+    // Thresholds are in the units of the response, so a new response is
+    // calibrated for rather than swapped in place.
+    bool recalibrate = memcmp(data->params.response, data->staged_response, sizeof(data->staged_response)) != 0;
+    memcpy(data->params.target_frequency, data->staged_frequency, sizeof(data->staged_frequency));
+    memcpy(data->params.qfactor, data->staged_qfactor, sizeof(data->staged_qfactor));
+    memcpy(data->params.response, data->staged_response, sizeof(data->staged_response));
+    if (recalibrate)
     {
-        ESP_LOGI(TAG, "FILTER_LOG | %4f | %4f | %4f | %4f | %4f | %4f | %4f | %4f | %4f | %4f |", out[0], out[1], out[2], out[3], out[4], out[5], out[6], out[7], out[8], out[9]);
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            data->thresholds[i] = 0;
+        }
+        data->calibration_countdown = (data->params.calibration_time_seconds + 2) * (data->params.sample_rate);
     }
+    atomic_store_explicit(&data->swap_state, IIR_SWAP_IDLE, memory_order_release);
+    ESP_LOGI(TAG, "Swapped in new IIR coefficients%s", recalibrate ? ", recalibrating for the new response" : "");
 }
 
-void iir_filter_process_holdable(iir_filter_data *data, float *filtered_data, bool *pins_pressed, int i)
+// Sampler side, before loading params: a reconfiguration staged and not taken
+// yet is dropped, and one being written is cancelled.
+static void iir_filter_drop_staged(iir_filter_data *data)
 {
-    if (pins_pressed[i])
+    int state = atomic_load_explicit(&data->swap_state, memory_order_relaxed);
+    while (state == IIR_SWAP_READY || state == IIR_SWAP_WRITING)
     {
-        // If pressed, wait for a "release".
-        // I fear this may lead to the sensor getting "sticky", but it's needed for held heys.
-        bool releasing = filtered_data[i] ADC_LT_OPERATOR(-data->thresholds[i]);
-        data->consecutive_movement[i] = releasing ? data->consecutive_movement[i] + 1 : 0;
-
-        if (data->consecutive_movement[i] > data->params.debounce_count)
+        int dropped = state == IIR_SWAP_READY ? IIR_SWAP_IDLE : IIR_SWAP_CANCELLED;
+        if (atomic_compare_exchange_weak_explicit(&data->swap_state, &state, dropped, memory_order_acq_rel,
+                                                  memory_order_relaxed))
         {
-            pins_pressed[i] = false;
-            data->consecutive_movement[i] = 0;
+            ESP_LOGI(TAG, "Dropped staged IIR coefficients");
+            return;
         }
     }
-    else
+}
+
+void iir_filter_process_filter(iir_filter_data *data, uint32_t *adc_raw, float *out)
+{
+
+    // Actual filtering.
+    float in[SENSOR_COUNT];
+    for (int i = 0; i < SENSOR_COUNT; ++i)
     {
-        // If not pressed, wait until it goes over the threshold.
-        bool pressing = filtered_data[i] ADC_GE_OPERATOR data->thresholds[i];
-        data->consecutive_movement[i] = pressing ? data->consecutive_movement[i] + 1 : 0;
-        if (data->consecutive_movement[i] > data->params.debounce_count)
-        {
-            pins_pressed[i] = true;
-            data->consecutive_movement[i] = 0;
-        }
+        in[i] = (float)adc_raw[i];
+    }
+    iir_filter_swap(data, in);
+    biquad_bank_process(&data->biquads[data->active], in, out);
+    if (test_state(KEYBOARD_STATE_SENSOR_LOGGING))
+    {
+        sensor_log_filtered(out);
     }
 }
 
-void iir_filter_process_nonholdable(iir_filter_data *data, float *filtered_data, bool *pins_pressed, int i)
+static void iir_filter_adapt_reset(iir_filter_data *data)
 {
-    pins_pressed[i] = filtered_data[i] ADC_GE_OPERATOR data->thresholds[i];
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        p2_quantile_init(&data->peaks[i], ADAPT_PEAK_QUANTILE);
+        p2_quantile_init(&data->troughs[i], ADAPT_PEAK_QUANTILE);
+        p2_quantile_init(&data->noise[i], ADAPT_NOISE_QUANTILE);
+        data->peak[i] = 0;
+        data->trough[i] = 0;
+        data->noise_level[i] = 0;
+        data->release_thresholds[i] = data->thresholds[i];
+    }
 }
 
-void iir_filter_process_normal(iir_filter_data *data, float *filtered_data, bool *pins_pressed)
+// Moves a threshold magnitude towards a fraction of the estimated peak, keeping
+// it over the noise. The estimate starts over once its window is full.
+static float iir_filter_adapt_level(float level, p2_quantile *peaks, float floor)
 {
+    if (peaks->count >= ADAPT_MIN_PEAKS)
+    {
+        float target = ADAPT_PEAK_FRACTION * p2_quantile_get(peaks);
+        target = target > floor ? target : floor;
+        level += ADAPT_RATE * (target - level);
+        if (peaks->count >= ADAPT_PEAK_WINDOW)
+        {
+            p2_quantile_init(peaks, ADAPT_PEAK_QUANTILE);
+        }
+    }
+    return level > floor ? level : floor;
+}
+
+void iir_filter_adapt(iir_filter_data *data, float *filtered_data, sensor_mask_t pressed)
+{
+    bool sample_noise = ++data->adapt_frames % ADAPT_NOISE_STRIDE == 0;
     for (int i = 0; i < SENSOR_COUNT; ++i)
     {
-        if (data->params.holdable[i])
+        float movement = PRESS_SIGN * filtered_data[i];
+        float threshold = PRESS_SIGN * data->thresholds[i];
+        float release = PRESS_SIGN * data->release_thresholds[i];
+        bool holdable = sensor_mask_test(data->holdable, i);
+        bool update = false;
+
+        // Peak of each excursion over the threshold, press or not, so that a
+        // threshold set too high still sees the presses it misses by a little.
+        if (movement >= threshold)
+        {
+            data->peak[i] = movement > data->peak[i] ? movement : data->peak[i];
+        }
+        else if (data->peak[i] > 0)
+        {
+            p2_quantile_add(&data->peaks[i], data->peak[i]);
+            data->peak[i] = 0;
+            update = true;
+        }
+        // Holdable sensors release on the swing back below zero.
+        if (holdable && -movement >= release)
         {
-            iir_filter_process_holdable(data, filtered_data, pins_pressed, i);
+            data->trough[i] = -movement > data->trough[i] ? -movement : data->trough[i];
+        }
+        else if (data->trough[i] > 0)
+        {
+            p2_quantile_add(&data->troughs[i], data->trough[i]);
+            data->trough[i] = 0;
+            update = true;
+        }
+
+        float magnitude = movement > 0 ? movement : -movement;
+        if (sample_noise && !sensor_mask_test(pressed, i) && magnitude < threshold && !data->trough[i])
+        {
+            p2_quantile_add(&data->noise[i], magnitude);
+            if (data->noise[i].count >= ADAPT_MIN_NOISE && data->noise[i].count % ADAPT_MIN_NOISE == 0)
+            {
+                data->noise_level[i] = p2_quantile_get(&data->noise[i]);
+                update = true;
+            }
+            if (data->noise[i].count >= ADAPT_NOISE_WINDOW)
+            {
+                p2_quantile_init(&data->noise[i], ADAPT_NOISE_QUANTILE);
+            }
+        }
+        if (!update)
+        {
+            continue;
+        }
+
+        float floor = ADAPT_NOISE_MARGIN * data->noise_level[i];
+        threshold = iir_filter_adapt_level(threshold, &data->peaks[i], floor);
+        if (holdable)
+        {
+            release = iir_filter_adapt_level(release, &data->troughs[i], floor);
         }
         else
         {
-            iir_filter_process_nonholdable(data, filtered_data, pins_pressed, i);
+            // Hysteresis: a press lasts until the reading is back down in the noise.
+            release = floor > 0 && floor < threshold ? floor : threshold;
         }
+        data->thresholds[i] = PRESS_SIGN * threshold;
+        data->release_thresholds[i] = PRESS_SIGN * release;
+    }
+}
+
+// Every sensor compared with its levels, then decided together (sensor_mask.h).
+// Holdable sensors press over the threshold and release once they swing back
+// below -release_thresholds, which may make them "sticky" but is needed for held
+// keys; the others stay pressed while over release_thresholds.
+void iir_filter_process_normal(iir_filter_data *data, float *filtered_data, sensor_mask_t *pressed)
+{
+    sensor_mask_t over = 0;
+    sensor_mask_t held = 0;
+    sensor_mask_t swung = 0;
+    for (int i = SENSOR_COUNT - 1; i >= 0; --i)
+    {
+        over = over << 1 | (filtered_data[i] ADC_GE_OPERATOR data->thresholds[i]);
+        held = held << 1 | (filtered_data[i] ADC_GE_OPERATOR data->release_thresholds[i]);
+        swung = swung << 1 | (filtered_data[i] ADC_LT_OPERATOR(-data->release_thresholds[i]));
     }
+    sensor_mask_t releasing = (data->holdable & swung) | (~data->holdable & ~held);
+    *pressed = sensor_mask_decide(*pressed, over, releasing, data->holdable, data->params.debounce_count,
+                                  &data->debounce);
 }
 
 void iir_filter_process_calibration(iir_filter_data *data, float *filtered_data)
@@ -117,52 +370,104 @@ void iir_filter_process_calibration(iir_filter_data *data, float *filtered_data)
 #else
             data->thresholds[i] = -data->thresholds[i] * data->params.calibration_peak_multiplier + data->params.min_threshold;
 #endif
-            data->consecutive_movement[i] = 0;
         }
+        memset(&data->debounce, 0, sizeof(data->debounce));
+        iir_filter_adapt_reset(data);
         ESP_LOGI(TAG, "Exit IIR calibration | %4f | %4f | %4f | %4f | %4f |", data->thresholds[0], data->thresholds[1], data->thresholds[2], data->thresholds[3], data->thresholds[4]);
     }
 }
-void iir_sensor_process(filter_handle_t filter_handle, uint32_t *adc_raw, bool *pins_pressed)
+// Averages the first frames after a restore, with nothing pressed, then settles
+// the delay lines on them.
+static void iir_filter_warmup(iir_filter_data *data, uint32_t *adc_raw, sensor_mask_t *pressed)
+{
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        data->warmup_sum[i] += (float)adc_raw[i];
+    }
+    *pressed = 0;
+    if (--data->warmup_frames == 0)
+    {
+        float mean[SENSOR_COUNT];
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            mean[i] = data->warmup_sum[i] / IIR_FILTER_WARMUP_FRAMES;
+        }
+        biquad_bank_settle(&data->biquads[data->active], mean);
+    }
+}
+
+void iir_sensor_process(filter_handle_t filter_handle, uint32_t *adc_raw, sensor_mask_t *pressed)
 {
     iir_filter_data *data = (iir_filter_data *)filter_handle->filter_data;
     float filtered_data[SENSOR_COUNT];
 
+    if (data->warmup_frames)
+    {
+        iir_filter_warmup(data, adc_raw, pressed);
+        return;
+    }
+
     iir_filter_process_filter(data, adc_raw, filtered_data);
 
     if (!data->calibration_countdown)
     {
-        iir_filter_process_normal(data, filtered_data, pins_pressed);
+        iir_filter_process_normal(data, filtered_data, pressed);
+        if (data->params.adaptive_thresholds)
+        {
+            iir_filter_adapt(data, filtered_data, *pressed);
+        }
     }
     else
     {
         data->calibration_countdown--;
-        for (int i = 0; i < SENSOR_COUNT; ++i)
-        {
-            pins_pressed[i] = false;
-        }
+        *pressed = 0;
         iir_filter_process_calibration(data, filtered_data);
     }
     return;
 }
 
-void iir_filter_load_params(filter_handle_t filter_handle, iir_filter_params *params)
+esp_err_t iir_filter_coefficients(const iir_filter_params *params, int sensor, float *coeffs)
 {
-    iir_filter_data *data = (iir_filter_data *)filter_handle->filter_data;
-    data->params = *params;
+    float freq = params->target_frequency[sensor] / params->sample_rate;
+    if (params->response[sensor] == IIR_FILTER_ONSET)
+    {
+        // (1 - pole) * (1 - z^-1) / (1 - pole * z^-1): unity gain to a ramp's slope.
+        float pole = expf(-2 * M_PI * freq);
+        coeffs[0] = 1 - pole;
+        coeffs[1] = -(1 - pole);
+        coeffs[2] = 0;
+        coeffs[3] = -pole;
+        coeffs[4] = 0;
+        return ESP_OK;
+    }
+    return dsps_biquad_gen_bpf_f32(coeffs, freq, params->qfactor[sensor]);
+}
 
+static void iir_filter_set_coefficients(biquad_bank *bank, const iir_filter_params *params)
+{
     esp_err_t err = ESP_OK;
 
     // Calculate iir filter coefficients
     for (int i = 0; i < SENSOR_COUNT; ++i)
     {
-        float freq = params->target_frequency[i] / params->sample_rate;
-        float qFactor = params->qfactor[i];
-        err = dsps_biquad_gen_bpf_f32(data->coeffs[i], freq, qFactor);
+        float coeffs[5];
+        err = iir_filter_coefficients(params, i, coeffs);
         if (err != ESP_OK)
         {
             ESP_LOGE(TAG, "Operation error = %i", err);
         }
+        biquad_bank_set(bank, i, coeffs);
     }
+}
+
+void iir_filter_load_params(filter_handle_t filter_handle, iir_filter_params *params)
+{
+    iir_filter_data *data = (iir_filter_data *)filter_handle->filter_data;
+    iir_filter_drop_staged(data);
+    data->params = *params;
+    data->holdable = sensor_mask_from_bools(params->holdable);
+
+    iir_filter_set_coefficients(&data->biquads[data->active], params);
 
     data->calibration_countdown = (data->params.calibration_time_seconds + 2) * (data->params.sample_rate);
     data->params = *params;
@@ -190,7 +495,129 @@ void iir_filter_calibration_start(filter_handle_t filter_handle, uint32_t *adc_r
 
 void iir_filter_calibration_end(filter_handle_t filter_handle, uint32_t *adc_raw) {}
 
+// New coefficients without recalibrating, from any task. Only the frequencies,
+// Q factors and responses are taken; the running settings, whether built in,
+// calibrated or restored, stay. Nothing the sampler uses is read or written
+// here. Only one reconfiguration is staged at a time: a later one replaces it if
+// the sampler has not taken it yet. While it is being taken, or params are
+// being loaded, this returns false at once rather than wait, as it runs in BT
+// event handlers.
+bool iir_filter_reconfigure(filter_handle_t filter_handle, const void *new_params)
+{
+    iir_filter_data *data = (iir_filter_data *)filter_handle->filter_data;
+    const iir_filter_params *params = new_params;
 
+    int state = atomic_load_explicit(&data->swap_state, memory_order_relaxed);
+    do
+    {
+        if (state != IIR_SWAP_IDLE && state != IIR_SWAP_READY)
+        {
+            ESP_LOGW(TAG, "IIR filter busy, not reconfigured");
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&data->swap_state, &state, IIR_SWAP_WRITING, memory_order_acquire,
+                                                    memory_order_relaxed));
+
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        esp_err_t err = iir_filter_coefficients(params, i, data->staged_coeffs[i]);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Operation error = %i", err);
+        }
+    }
+    memcpy(data->staged_frequency, params->target_frequency, sizeof(data->staged_frequency));
+    memcpy(data->staged_qfactor, params->qfactor, sizeof(data->staged_qfactor));
+    memcpy(data->staged_response, params->response, sizeof(data->staged_response));
+
+    int writing = IIR_SWAP_WRITING;
+    if (!atomic_compare_exchange_strong_explicit(&data->swap_state, &writing, IIR_SWAP_READY, memory_order_release,
+                                                 memory_order_relaxed))
+    {
+        // Cancelled: params loaded meanwhile win.
+        atomic_store_explicit(&data->swap_state, IIR_SWAP_IDLE, memory_order_release);
+        ESP_LOGI(TAG, "Params loaded while staging, IIR coefficients dropped");
+        return false;
+    }
+    ESP_LOGI(TAG, "Staged new IIR coefficients");
+    return true;
+}
+
+
+
+size_t iir_filter_save(filter_handle_t filter_handle, void *blob, size_t size)
+{
+    iir_filter_data *data = (iir_filter_data *)filter_handle->filter_data;
+    if (data->calibration_countdown || size < sizeof(iir_filter_snapshot))
+    {
+        return 0;
+    }
+    iir_filter_snapshot *snapshot = blob;
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->version = IIR_FILTER_SNAPSHOT_VERSION;
+    snapshot->sensor_count = SENSOR_COUNT;
+    snapshot->built_params_crc = data->built_params_crc;
+    snapshot->params = data->params;
+    memcpy(snapshot->thresholds, data->thresholds, sizeof(snapshot->thresholds));
+    memcpy(snapshot->release_thresholds, data->release_thresholds, sizeof(snapshot->release_thresholds));
+    memcpy(snapshot->peaks, data->peaks, sizeof(snapshot->peaks));
+    memcpy(snapshot->troughs, data->troughs, sizeof(snapshot->troughs));
+    memcpy(snapshot->noise, data->noise, sizeof(snapshot->noise));
+    memcpy(snapshot->noise_level, data->noise_level, sizeof(snapshot->noise_level));
+    return sizeof(*snapshot);
+}
+
+bool iir_filter_restore(filter_handle_t filter_handle, const void *blob, size_t size)
+{
+    iir_filter_data *data = (iir_filter_data *)filter_handle->filter_data;
+    iir_filter_snapshot snapshot;
+    if (size != sizeof(snapshot))
+    {
+        return false;
+    }
+    memcpy(&snapshot, blob, sizeof(snapshot));
+    if (snapshot.version != IIR_FILTER_SNAPSHOT_VERSION || snapshot.sensor_count != SENSOR_COUNT ||
+        snapshot.params.sample_rate != data->params.sample_rate)
+    {
+        return false;
+    }
+    if (snapshot.built_params_crc != data->built_params_crc)
+    {
+        ESP_LOGW(TAG, "Saved IIR calibration is for other built-in filter params, discarding it");
+        return false;
+    }
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        float coeffs[5];
+        if (!isfinite(snapshot.thresholds[i]) || !isfinite(snapshot.release_thresholds[i]) ||
+            iir_filter_coefficients(&snapshot.params, i, coeffs) != ESP_OK)
+        {
+            return false;
+        }
+    }
+
+    iir_filter_drop_staged(data);
+    data->params = snapshot.params;
+    data->holdable = sensor_mask_from_bools(data->params.holdable);
+    iir_filter_set_coefficients(&data->biquads[data->active], &data->params);
+    memcpy(data->thresholds, snapshot.thresholds, sizeof(data->thresholds));
+    memcpy(data->release_thresholds, snapshot.release_thresholds, sizeof(data->release_thresholds));
+    memcpy(data->peaks, snapshot.peaks, sizeof(data->peaks));
+    memcpy(data->troughs, snapshot.troughs, sizeof(data->troughs));
+    memcpy(data->noise, snapshot.noise, sizeof(data->noise));
+    memcpy(data->noise_level, snapshot.noise_level, sizeof(data->noise_level));
+    memset(&data->debounce, 0, sizeof(data->debounce));
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        data->peak[i] = 0;
+        data->trough[i] = 0;
+        data->warmup_sum[i] = 0;
+    }
+    data->calibration_countdown = 0;
+    data->warmup_frames = IIR_FILTER_WARMUP_FRAMES;
+    ESP_LOGI(TAG, "Restored IIR calibration | %4f | %4f | %4f | %4f | %4f |", data->thresholds[0], data->thresholds[1], data->thresholds[2], data->thresholds[3], data->thresholds[4]);
+    return true;
+}
 
 void *init_iir_filter(iir_filter_params *params)
 {
@@ -199,24 +626,38 @@ void *init_iir_filter(iir_filter_params *params)
     filter_handle->process = iir_sensor_process;
     filter_handle->calibrate_start = iir_filter_calibration_start;
     filter_handle->calibrate_end = iir_filter_calibration_end;
+    filter_handle->reconfigure = iir_filter_reconfigure;
+    filter_handle->save = iir_filter_save;
+    filter_handle->restore = iir_filter_restore;
 
     iir_filter_data *data = calloc(1, sizeof(iir_filter_data));
+    atomic_init(&data->swap_state, IIR_SWAP_IDLE);
     filter_handle->filter_data = (void *)data;
+    data->built_params_crc = iir_filter_params_crc(params);
     iir_filter_load_params(filter_handle, params);
 
     return filter_handle;
 }
 
 static iir_filter_params default_filter_params = {
-    .sample_rate = 100,
+    .sample_rate = SENSOR_FRAME_RATE_HZ,
     .target_frequency = {2, 2, 2, 2, 2, 10, 10, 10, 10, 10},
     .qfactor = {0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5},
     .holdable = {0, 0, 0, 0, 0, 1, 1, 1, 1, 1},
     .calibration_peak_multiplier = 2.5,
     .calibration_time_seconds = 2,
     .debounce_count = 4,
-    .min_threshold = 1};
+    .min_threshold = 1,
+#ifdef IIR_ADAPTIVE_THRESHOLDS
+    .adaptive_thresholds = true,
+#endif
+};
 
 void *init_iir_filter_default(void){
     return (init_iir_filter(&default_filter_params));
+}
+
+iir_filter_params iir_filter_default_params(void)
+{
+    return default_filter_params;
 }
\ No newline at end of file
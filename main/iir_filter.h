@@ -1,12 +1,26 @@
 #ifndef IIR_FILTER_H__
 #define IIR_FILTER_H__
 #include "constants.h"
+#include "esp_err.h"
+
+// What each sensor's biquad computes.
+typedef enum
+{
+    // Band-pass at target_frequency with qfactor.
+    IIR_FILTER_BAND_PASS = 0,
+    // Onset detector: the frame-to-frame difference of a one-pole low-pass at
+    // target_frequency, in counts per frame (qfactor is unused). It rises as soon
+    // as a press does, with a group delay of about fs / (2 pi target_frequency)
+    // frames, instead of waiting for a slow band-pass to ring up.
+    IIR_FILTER_ONSET,
+} iir_filter_response;
 
 typedef struct
 {
     float sample_rate;
     float target_frequency[SENSOR_COUNT];
     float qfactor[SENSOR_COUNT];
+    iir_filter_response response[SENSOR_COUNT];
     float calibration_peak_multiplier;
     float calibration_time_seconds;
 
@@ -17,9 +31,16 @@ typedef struct
 
     // for sensors that somehow read zero when idle
     float min_threshold;
+
+    // Keep re-deriving thresholds and releases from the presses and idle noise
+    // seen while typing, starting from the calibrated ones.
+    bool adaptive_thresholds;
 } iir_filter_params;
 
 void *init_iir_filter(iir_filter_params *params);
 void *init_iir_filter_default(void);
+iir_filter_params iir_filter_default_params(void);
+// Biquad coefficients of one sensor, in the esp-dsp order {b0, b1, b2, a1, a2}.
+esp_err_t iir_filter_coefficients(const iir_filter_params *params, int sensor, float *coeffs);
 
 #endif
@@ -0,0 +1,287 @@
+#include <stdatomic.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+
+#include "filter_store.h"
+#include "layout.h"
+
+#define LAYOUT_MAGIC 0x4C574150 // "PAWL"
+
+#define LAYOUT_TASK_PRIORITY 1
+#define LAYOUT_TASK_STACK 3072
+
+const static char *TAG = "LAYOUT";
+
+// Sensor 5 of the modifiers selects the numeric layer, and the other four add
+// shift, control, alt and GUI.
+#define BUILTIN_LAYER(held) ((held) & 1)
+#ifndef DISABLECTRLALTWIN
+#define BUILTIN_MODIFIERS(held) (((held) & 2 ? LEFT_SHIFT_KEY_MASK : 0) | ((held) & 4 ? LEFT_CONTROL_KEY_MASK : 0) | \
+                                 ((held) & 8 ? LEFT_ALT_KEY_MASK : 0) | ((held) & 16 ? LEFT_GUI_KEY_MASK : 0))
+#else
+#define BUILTIN_MODIFIERS(held) ((held) & 2 ? LEFT_SHIFT_KEY_MASK : 0)
+#endif
+#define BUILTIN_LAYERS_8(h) BUILTIN_LAYER(h), BUILTIN_LAYER(h + 1), BUILTIN_LAYER(h + 2), BUILTIN_LAYER(h + 3), \
+                            BUILTIN_LAYER(h + 4), BUILTIN_LAYER(h + 5), BUILTIN_LAYER(h + 6), BUILTIN_LAYER(h + 7)
+#define BUILTIN_MODIFIERS_8(h) BUILTIN_MODIFIERS(h), BUILTIN_MODIFIERS(h + 1), BUILTIN_MODIFIERS(h + 2), BUILTIN_MODIFIERS(h + 3), \
+                               BUILTIN_MODIFIERS(h + 4), BUILTIN_MODIFIERS(h + 5), BUILTIN_MODIFIERS(h + 6), BUILTIN_MODIFIERS(h + 7)
+
+_Static_assert(LAYOUT_MODIFIER_CHORDS == 32, "the built-in layout spells out five modifier sensors");
+
+static const layout_blob builtin = {
+    .layer_count = 2,
+    .passkey_layer = 1,
+    .layers = {BUILTIN_LAYERS_8(0), BUILTIN_LAYERS_8(8), BUILTIN_LAYERS_8(16), BUILTIN_LAYERS_8(24)},
+    .modifiers = {BUILTIN_MODIFIERS_8(0), BUILTIN_MODIFIERS_8(8), BUILTIN_MODIFIERS_8(16), BUILTIN_MODIFIERS_8(24)},
+    .keys = {
+        // Alpha.
+        {
+            [1] = {HID_KEY_A},
+            [2] = {HID_KEY_B},
+            [3] = {HID_KEY_C},
+            [4] = {HID_KEY_D},
+            [5] = {HID_KEY_E},
+            [6] = {HID_KEY_F},
+            [7] = {HID_KEY_G},
+            [8] = {HID_KEY_H},
+            [9] = {HID_KEY_I},
+            [10] = {HID_KEY_J},
+            [11] = {HID_KEY_K},
+            [12] = {HID_KEY_L},
+            [13] = {HID_KEY_M},
+            [14] = {HID_KEY_N},
+            [15] = {HID_KEY_O},
+            [16] = {HID_KEY_P},
+            [17] = {HID_KEY_Q},
+            [18] = {HID_KEY_R},
+            [19] = {HID_KEY_S},
+            [20] = {HID_KEY_T},
+            [21] = {HID_KEY_U},
+            [22] = {HID_KEY_V},
+            [23] = {HID_KEY_W},
+            [24] = {HID_KEY_X},
+            [25] = {HID_KEY_Y},
+            [26] = {HID_KEY_Z},
+            [27] = {HID_KEY_CAPS_LOCK},
+            [28] = {HID_KEY_SPACEBAR},
+            [29] = {HID_KEY_SPACEBAR},
+            [30] = {HID_KEY_DELETE},
+            [31] = {HID_KEY_ENTER},
+        },
+        // Numeric only. A number and symbol layout is a layer of its own.
+        {
+            [1] = {HID_KEY_1},
+            [2] = {HID_KEY_2},
+            [3] = {HID_KEY_3},
+            [4] = {HID_KEY_4},
+            [5] = {HID_KEY_5},
+            [6] = {HID_KEY_6},
+            [7] = {HID_KEY_7},
+            [8] = {HID_KEY_8},
+            [9] = {HID_KEY_9},
+            [10] = {HID_KEY_0},
+            [31] = {HID_KEY_ENTER},
+        },
+    },
+};
+
+const layout_blob *layout = &builtin;
+
+// A staged blob, as in filter_store.c the other way round: the loader fills it
+// only while pending is false, and hid_task copies it out only while it is true.
+// The copy is the one lookups read, so the loader never writes under them.
+static union
+{
+    layout_blob blob;
+    uint8_t bytes[LAYOUT_BLOB_SIZE(LAYOUT_MAX_LAYERS)];
+} staged, active;
+static atomic_bool pending;
+
+// A blob waiting for the writer, header included, filled and read the same way,
+// so that the caller of layout_load never waits on flash.
+static uint8_t to_save[LAYOUT_MAX_SIZE];
+static size_t to_save_length;
+static atomic_bool save_pending;
+static TaskHandle_t writer_task_handle = NULL;
+
+layout_header layout_make_header(const layout_blob *body, size_t size)
+{
+    return (layout_header){
+        .magic = LAYOUT_MAGIC,
+        .version = LAYOUT_VERSION,
+        .size = size,
+        .crc = esp_rom_crc32_le(0, (const uint8_t *)body, size),
+    };
+}
+
+const char *layout_check(const uint8_t *blob, size_t length)
+{
+    layout_header header;
+    if (length < sizeof(header) + sizeof(layout_blob))
+    {
+        return "too short";
+    }
+    memcpy(&header, blob, sizeof(header));
+    const layout_blob *body = (const layout_blob *)(blob + sizeof(header));
+    if (header.magic != LAYOUT_MAGIC || header.version != LAYOUT_VERSION)
+    {
+        return "not a layout of this version";
+    }
+    if (body->layer_count == 0 || body->layer_count > LAYOUT_MAX_LAYERS)
+    {
+        return "bad layer count";
+    }
+    if (header.size != LAYOUT_BLOB_SIZE(body->layer_count) || length != sizeof(header) + header.size)
+    {
+        return "size does not match the layer count";
+    }
+    if (header.crc != esp_rom_crc32_le(0, (const uint8_t *)body, header.size))
+    {
+        return "CRC mismatch";
+    }
+    if (body->passkey_layer >= body->layer_count)
+    {
+        return "passkey layer out of range";
+    }
+    for (int held = 0; held < LAYOUT_MODIFIER_CHORDS; ++held)
+    {
+        if (body->layers[held] >= body->layer_count)
+        {
+            return "modifier chord selects a missing layer";
+        }
+    }
+    return NULL;
+}
+
+bool layout_flush(void)
+{
+    if (!atomic_load_explicit(&save_pending, memory_order_acquire))
+    {
+        return false;
+    }
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(FILTER_STORE_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK)
+    {
+        err = nvs_set_blob(handle, LAYOUT_KEY, to_save, to_save_length);
+        if (err == ESP_OK)
+        {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Saved layout, %d bytes", (int)to_save_length);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Failed to save layout (%s)", esp_err_to_name(err));
+    }
+    atomic_store_explicit(&save_pending, false, memory_order_release);
+    return err == ESP_OK;
+}
+
+bool layout_load(const uint8_t *blob, size_t length, bool save)
+{
+    const char *error = layout_check(blob, length);
+    if (error)
+    {
+        ESP_LOGE(TAG, "Invalid layout: %s", error);
+        return false;
+    }
+    if (atomic_load_explicit(&pending, memory_order_acquire))
+    {
+        ESP_LOGW(TAG, "A layout is still waiting to be applied");
+        return false;
+    }
+    if (save && atomic_load_explicit(&save_pending, memory_order_acquire))
+    {
+        ESP_LOGW(TAG, "A layout is still waiting to be saved");
+        return false;
+    }
+    if (save)
+    {
+        memcpy(to_save, blob, length);
+        to_save_length = length;
+        atomic_store_explicit(&save_pending, true, memory_order_release);
+        if (writer_task_handle)
+        {
+            xTaskNotifyGive(writer_task_handle);
+        }
+    }
+    memcpy(staged.bytes, blob + sizeof(layout_header), length - sizeof(layout_header));
+    atomic_store_explicit(&pending, true, memory_order_release);
+    ESP_LOGI(TAG, "Layout with %d layers staged", staged.blob.layer_count);
+    return true;
+}
+
+void layout_apply(void)
+{
+    if (!atomic_load_explicit(&pending, memory_order_acquire))
+    {
+        return;
+    }
+    memcpy(active.bytes, staged.bytes, LAYOUT_BLOB_SIZE(staged.blob.layer_count));
+    layout = &active.blob;
+    atomic_store_explicit(&pending, false, memory_order_release);
+    ESP_LOGI(TAG, "Switched to a layout with %d layers", layout->layer_count);
+}
+
+bool layout_init(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(FILTER_STORE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+    {
+        ESP_LOGI(TAG, "Built-in layout");
+        return false;
+    }
+    static uint8_t blob[LAYOUT_MAX_SIZE];
+    size_t length = sizeof(blob);
+    esp_err_t err = nvs_get_blob(handle, LAYOUT_KEY, blob, &length);
+    nvs_close(handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGI(TAG, "Built-in layout (%s)", esp_err_to_name(err));
+        return false;
+    }
+    if (!layout_load(blob, length, false))
+    {
+        ESP_LOGW(TAG, "Ignoring the layout saved in NVS");
+        return false;
+    }
+    layout_apply();
+    return true;
+}
+
+static void layout_task(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        layout_flush();
+    }
+}
+
+void layout_start(void)
+{
+    xTaskCreate(&layout_task, "layout", LAYOUT_TASK_STACK, NULL, LAYOUT_TASK_PRIORITY, &writer_task_handle);
+}
+
+size_t layout_default_blob(uint8_t *blob, size_t capacity)
+{
+    size_t size = LAYOUT_BLOB_SIZE(builtin.layer_count);
+    if (capacity < sizeof(layout_header) + size)
+    {
+        return 0;
+    }
+    layout_header header = layout_make_header(&builtin, size);
+    memcpy(blob, &header, sizeof(header));
+    memcpy(blob + sizeof(header), &builtin, size);
+    return sizeof(header) + size;
+}
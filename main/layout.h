@@ -0,0 +1,110 @@
+#ifndef LAYOUT_H__
+#define LAYOUT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_hidd_prf_api.h"
+#include "hid_dev.h"
+
+#include "constants.h"
+#include "sensor_mask.h"
+
+// Turns an accepted chord and the modifier sensors held with it into a HID key
+// and modifier mask, from tables rather than code. A layer holds one key per
+// 5-bit chord: a HID code, and modifiers it types with, so a layer of symbols
+// can ask for shift. Every combination of the modifier sensors held (sensors
+// ENCODING_SENSOR_COUNT and up) picks a layer and adds modifiers of its own.
+// The built-in layout is the alpha layer, a numeric layer on sensor 5, and
+// shift, control, alt and GUI on sensors 6 to 9.
+//
+// A layout can be replaced without a reflash, as a blob: in NVS under
+// LAYOUT_KEY, in the filter store's namespace, where layout_init finds it at
+// boot, or written to the remote config service (remote_config.h), which
+// applies it and has a low-priority writer task save it. The blob is a header with a magic number,
+// LAYOUT_VERSION, its size and a CRC-32, then layout_blob with layer_count
+// layers. host/tools/layout_pack builds one from a text description.
+
+#define LAYOUT_MODIFIER_CHORDS (1 << MODIFIER_SENSOR_COUNT)
+#define LAYOUT_CHORDS (1 << ENCODING_SENSOR_COUNT)
+#define LAYOUT_MAX_LAYERS 16
+
+#define LAYOUT_KEY "layout"
+#define LAYOUT_VERSION 1
+
+typedef struct
+{
+    keyboard_cmd_t hid;
+    key_mask_t modifiers;
+} layout_key;
+
+typedef layout_key layout_layer[LAYOUT_CHORDS];
+
+typedef struct
+{
+    uint8_t layer_count;
+    // The layer typed while the host asks for a passkey, with no modifiers.
+    uint8_t passkey_layer;
+    // Per combination of modifier sensors held: its layer, and the modifiers
+    // it adds to the key's.
+    uint8_t layers[LAYOUT_MODIFIER_CHORDS];
+    key_mask_t modifiers[LAYOUT_MODIFIER_CHORDS];
+    layout_layer keys[];
+} layout_blob;
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    // Of the size bytes that follow.
+    uint32_t crc;
+} layout_header;
+
+#define LAYOUT_BLOB_SIZE(layers) (sizeof(layout_blob) + (layers) * sizeof(layout_layer))
+#define LAYOUT_MAX_SIZE (sizeof(layout_header) + LAYOUT_BLOB_SIZE(LAYOUT_MAX_LAYERS))
+
+// The layout in use; the built-in one until another is applied.
+extern const layout_blob *layout;
+
+// Key and modifiers for a chord, with the sensors held. With passkey, the
+// passkey layer and no modifiers.
+static inline layout_key layout_lookup(char chord, sensor_mask_t pressed, bool passkey)
+{
+    int held = (pressed >> ENCODING_SENSOR_COUNT) & (LAYOUT_MODIFIER_CHORDS - 1);
+    int layer = passkey ? layout->passkey_layer : layout->layers[held];
+    layout_key key = layout->keys[layer][chord & (LAYOUT_CHORDS - 1)];
+    key.modifiers |= passkey ? 0 : layout->modifiers[held];
+    return key;
+}
+
+// Applies the layout saved in NVS, if there is a valid one. Returns whether it did.
+bool layout_init(void);
+
+// Checks a blob, header included. Returns NULL if it is valid, or why not.
+const char *layout_check(const uint8_t *blob, size_t length);
+
+// Checks a blob and stages it; hid_task applies it on its next frame
+// (layout_apply), so a layout never changes under a lookup. With save, it is
+// also handed to the writer task for NVS. Returns false, changing nothing, if
+// the blob is invalid or another is still staged or being saved.
+bool layout_load(const uint8_t *blob, size_t length, bool save);
+
+// hid_task side, before the frame's lookups: switches to a staged layout.
+void layout_apply(void);
+
+// Starts the writer task. Without it, layout_flush does the writing.
+void layout_start(void);
+
+// Writes a layout waiting to be saved now. Returns true if one was written.
+bool layout_flush(void);
+
+// Writes the built-in layout as a blob, header included. Returns its length, or
+// 0 if it does not fit.
+size_t layout_default_blob(uint8_t *blob, size_t capacity);
+
+// Header, CRC included, for a blob body of size bytes that follows it.
+layout_header layout_make_header(const layout_blob *body, size_t size);
+
+#endif
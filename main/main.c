@@ -17,6 +17,14 @@
 #include "bluetooth.h"
 #include "filter.h"
 #include "iir_filter.h"
+#include "fixed_filter.h"
+#include "autocal_filter.h"
+#include "filter_pipeline.h"
+#include "shadow_filter.h"
+#include "sampler.h"
+#include "sensor_log.h"
+#include "filter_store.h"
+#include "layout.h"
 
 const static char *TAG = "MAIN";
 
@@ -27,18 +35,25 @@ keyboard_system_command_t last_command;
 keyboard_cmd_t last_tx_key;
 key_mask_t last_tx_mask;
 
+// The filter came back calibrated from flash and needs no time to settle.
+static bool filter_restored;
+
 void hid_task(void *pvParameters)
 {
 
     encoder_output_t out;
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    if (!filter_restored)
+    {
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+    }
+    // Frames start once there is someone to take them.
+    sampler_start(xTaskGetCurrentTaskHandle());
     while (1)
     {
         update_state(last_command);
 
-        // Polling period of 10ms to work with the fixed window sizes used by autocalibration.
-        // Any future filtering attempts should use polling frequency when setting thresholds.
-        vTaskDelay(1);
+        // pressure_sensor_read blocks on the sampler's next frame, which sets the
+        // loop period to SENSOR_FRAME_RATE_HZ.
 
         // if (test_state(KEYBOARD_STATE_SENSOR_LOGGING)) {
         //     vTaskDelay(1);
@@ -47,6 +62,7 @@ void hid_task(void *pvParameters)
         // }
         char pins = pressure_sensor_read();
         out = envelope_encode(&encoder_state, pins, device_state);
+        layout_apply();
         convert_to_hid_code(&out, device_state);
         do_feedback(out.encoder_flags);
         last_command = decode_command(&command_state, out);
@@ -56,6 +72,22 @@ void hid_task(void *pvParameters)
         // Move the logic into BT itself, maybe?
         {
         case KEYBOARD_STATE_BT_CONNECTED | KEYBOARD_STATE_SENSOR_NORMAL:
+#if defined(ENVELOPE_SPECULATIVE_OUTPUT)
+            // Through the report queue, which can take back a key typed ahead.
+            if (out.retracted_bitstring)
+            {
+                bt_retract();
+            }
+            if (out.hid && out.speculative)
+            {
+                bt_type_ahead(out.mask, out.hid);
+            }
+            else if (out.hid)
+            {
+                bt_type(out.mask, out.hid);
+            }
+            bt_send_queued(out.mask);
+#else
             // This check definitely needs to be in a BT wrapper.
             if (!((out.mask == last_tx_mask) && (out.hid == last_tx_key)))
             {
@@ -63,9 +95,10 @@ void hid_task(void *pvParameters)
                 last_tx_mask= out.mask;
                 bt_send(out.mask, out.hid);
             }
+#endif
             break;
         case KEYBOARD_STATE_BT_PASSKEY_ENTRY | KEYBOARD_STATE_SENSOR_NORMAL:
-            if (out.hid)
+            if (out.hid && !out.speculative)
             {
                 bt_passkey_process(out.hid);
             }
@@ -79,13 +112,59 @@ void app_main(void)
 {
     bt_init();
     sensor_init();
-
-
-    default_filter_init(init_iir_filter_default());
+    bool early_commit = false;
+    bool speculate = false;
+    bool adaptive_timing = false;
+    bool rollover = false;
+#if defined(ENVELOPE_EARLY_COMMIT)
+    early_commit = true;
+#endif
+#if defined(ENVELOPE_SPECULATIVE_OUTPUT)
+    speculate = true;
+#endif
+#if defined(ENVELOPE_ADAPTIVE_TIMING)
+    adaptive_timing = true;
+#endif
+#if defined(ENVELOPE_ROLLOVER)
+    rollover = true;
+#endif
+    envelope_encoder_init(&encoder_state, early_commit, speculate, adaptive_timing, rollover);
+#if defined(ENVELOPE_ADAPTIVE_TIMING)
+    envelope_timing_restore(&encoder_state.timing);
+    envelope_timing_start();
+#endif
+    layout_init();
+    layout_start();
+
+#if defined(AUTOCAL_FILTER)
+    filter_handle_t filter_handle = init_autocal_filter_default();
+#elif defined(FILTER_PIPELINE)
+    filter_handle_t filter_handle = init_filter_pipeline_configured(FILTER_PIPELINE);
+    filter_handle = filter_handle ? filter_handle : init_iir_filter_default();
+#elif defined(FIXED_POINT_FILTER)
+    filter_handle_t filter_handle = init_fixed_filter_default();
+#else
+    filter_handle_t filter_handle = init_iir_filter_default();
+#endif
+#if defined(SHADOW_FILTER)
+    filter_handle_t candidate = init_filter_pipeline(SHADOW_FILTER);
+    if (candidate)
+    {
+        filter_handle = init_shadow_filter(filter_handle, candidate);
+        shadow_filter_start();
+    }
+#endif
+    default_filter_init(filter_handle);
+    filter_restored = filter_store_restore();
+    filter_store_start();
 
     initialize_feedback();
 
+    sensor_log_start();
+
     ESP_LOGI(TAG, "Start main loop");
 
-    xTaskCreate(&hid_task, "hid_task", 8000, NULL, 5, NULL);
+    // Encoding, haptics and BLE share core 0 with the Bluetooth stack; sampling
+    // and filtering run on the other core, see sampler.h.
+    xTaskCreatePinnedToCore(&hid_task, "hid_task", 8000, NULL, 5, NULL, 0);
 }
\ No newline at end of file
@@ -28,28 +28,20 @@ typedef struct
 
 // Naive approach to handling a read. Hardcoded threshold with
 // a small debouce window later.
-void processInputPins(struct filter* filter_handle, uint32_t *adc_raw, bool *pins_pressed)
+void processInputPins(struct filter* filter_handle, uint32_t *adc_raw, sensor_mask_t *pressed)
 {
     old_filter_data *data = (old_filter_data *)filter_handle->filter_data;
 
-    for (int i = 0; i < SENSOR_COUNT; ++i)
+    // Press over the threshold, release under it less the debounce margin.
+    sensor_mask_t over = 0;
+    sensor_mask_t under = 0;
+    for (int i = SENSOR_COUNT - 1; i >= 0; --i)
     {
         uint32_t value = adc_raw[i];
-        if (!pins_pressed[i])
-        {
-            if (value ADC_GE_OPERATOR data->thresholds[i])
-            {
-                pins_pressed[i] = true;
-            }
-        }
-        else
-        {
-            if (value ADC_LT_OPERATOR data->thresholds[i] - data->debounce[i])
-            {
-                pins_pressed[i] = false;
-            }
-        }
+        over = over << 1 | (value ADC_GE_OPERATOR data->thresholds[i]);
+        under = under << 1 | (value ADC_LT_OPERATOR data->thresholds[i] - data->debounce[i]);
     }
+    *pressed = (~*pressed & over) | (*pressed & ~under);
 }
 
 void calibration_start(filter_handle_t filter_handle, uint32_t *adc_raw)
@@ -90,6 +82,9 @@ void* init_old_filter(void* params)
     filter_handle->process = processInputPins;
     filter_handle->calibrate_start = calibration_start;
     filter_handle->calibrate_end = calibration_end;
+    filter_handle->reconfigure = NULL;
+    filter_handle->save = NULL;
+    filter_handle->restore = NULL;
 
     old_filter_data *data = calloc(1, sizeof(old_filter_data));
     
@@ -0,0 +1,113 @@
+#include "p2_quantile.h"
+
+void p2_quantile_init(p2_quantile *estimator, float quantile)
+{
+    float p = quantile;
+    estimator->quantile = p;
+    estimator->count = 0;
+    for (int i = 0; i < 5; ++i)
+    {
+        estimator->positions[i] = i;
+    }
+    estimator->desired[0] = 0;
+    estimator->desired[1] = 2 * p;
+    estimator->desired[2] = 4 * p;
+    estimator->desired[3] = 2 + 2 * p;
+    estimator->desired[4] = 4;
+    estimator->increments[0] = 0;
+    estimator->increments[1] = p / 2;
+    estimator->increments[2] = p;
+    estimator->increments[3] = (1 + p) / 2;
+    estimator->increments[4] = 1;
+}
+
+// Piecewise-parabolic prediction of marker i moved by d (+1 or -1) positions.
+static float parabolic(const p2_quantile *estimator, int i, int d)
+{
+    const float *q = estimator->heights;
+    const int32_t *n = estimator->positions;
+    return q[i] + (float)d / (n[i + 1] - n[i - 1]) *
+                      ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                       (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+}
+
+static float linear(const p2_quantile *estimator, int i, int d)
+{
+    const float *q = estimator->heights;
+    const int32_t *n = estimator->positions;
+    return q[i] + d * (q[i + d] - q[i]) / (n[i + d] - n[i]);
+}
+
+void p2_quantile_add(p2_quantile *estimator, float value)
+{
+    float *q = estimator->heights;
+    int32_t *n = estimator->positions;
+
+    // The first five values are kept sorted, and become the markers.
+    if (estimator->count < 5)
+    {
+        int i = estimator->count++;
+        for (; i > 0 && q[i - 1] > value; --i)
+        {
+            q[i] = q[i - 1];
+        }
+        q[i] = value;
+        return;
+    }
+    estimator->count++;
+
+    // Cell the value falls in, stretching the extremes if needed.
+    int k;
+    if (value < q[0])
+    {
+        q[0] = value;
+        k = 0;
+    }
+    else if (value >= q[4])
+    {
+        q[4] = value;
+        k = 3;
+    }
+    else
+    {
+        for (k = 0; value >= q[k + 1]; ++k)
+        {
+        }
+    }
+    for (int i = k + 1; i < 5; ++i)
+    {
+        n[i]++;
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+        estimator->desired[i] += estimator->increments[i];
+    }
+
+    // Move the middle markers that are a whole position off.
+    for (int i = 1; i < 4; ++i)
+    {
+        float offset = estimator->desired[i] - n[i];
+        if ((offset >= 1 && n[i + 1] - n[i] > 1) || (offset <= -1 && n[i - 1] - n[i] < -1))
+        {
+            int d = offset > 0 ? 1 : -1;
+            float height = parabolic(estimator, i, d);
+            q[i] = q[i - 1] < height && height < q[i + 1] ? height : linear(estimator, i, d);
+            n[i] += d;
+        }
+    }
+}
+
+float p2_quantile_get(const p2_quantile *estimator)
+{
+    if (estimator->count >= 5)
+    {
+        return estimator->heights[2];
+    }
+    if (estimator->count == 0)
+    {
+        return 0;
+    }
+    // Nearest rank among the values seen so far.
+    int rank = (int)(estimator->quantile * estimator->count);
+    return estimator->heights[rank < (int)estimator->count ? rank : estimator->count - 1];
+}
@@ -0,0 +1,33 @@
+#ifndef P2_QUANTILE_H__
+#define P2_QUANTILE_H__
+
+#include <stdint.h>
+
+// Streaming estimate of one quantile of a series, in constant memory: the P²
+// algorithm of Jain and Chlamtac (1985). Five markers track the minimum, the
+// p/2, p and (1+p)/2 quantiles and the maximum; each observation moves them
+// with a piecewise-parabolic step, so there is no history buffer to sort.
+//
+// The estimate covers everything added since the last p2_quantile_init. To
+// follow a series that drifts, start it over every so often.
+
+typedef struct
+{
+    float quantile;
+    uint32_t count;
+    // Marker heights, their positions, and where they should be.
+    float heights[5];
+    int32_t positions[5];
+    float desired[5];
+    float increments[5];
+} p2_quantile;
+
+// quantile in (0, 1), e.g. 0.5 for the median.
+void p2_quantile_init(p2_quantile *estimator, float quantile);
+
+void p2_quantile_add(p2_quantile *estimator, float value);
+
+// The estimate, exact while fewer than five values have been added, and 0 before any.
+float p2_quantile_get(const p2_quantile *estimator);
+
+#endif
@@ -6,6 +6,8 @@
 
 #include "remote_config.h"
 #include "iir_filter.h"
+#include "filter.h"
+#include "layout.h"
 
 #define CHAR_DECLARATION_SIZE (sizeof(uint8_t))
 
@@ -40,10 +42,17 @@ enum
     IDX_RCFG_CHAR_DENOMINATOR_VAL,
     IDX_RCFG_CHAR_DENOMINATOR_DESC,
 
+    // A layout blob (layout.h), in pieces: see layout_write.
+    IDX_RCFG_CHAR_LAYOUT,
+    IDX_RCFG_CHAR_LAYOUT_VAL,
+    IDX_RCFG_CHAR_LAYOUT_DESC,
+
     IDX_RCFG_NB,
 };
 
 #define RCFG_CHAR_LEN_MAX 1
+// A 16-bit offset and up to 128 bytes of layout.
+#define RCFG_LAYOUT_CHAR_LEN_MAX 130
 uint8_t initial_data = 0;
 uint16_t rcfg_handle_table[IDX_RCFG_NB];
 
@@ -53,6 +62,7 @@ static uint8_t RCFG_CHAR_NQ_UUID[16] = {'l', 'i', 'l', 'y', 'p', 'a', 'w', 's',
 static uint8_t RCFG_CHAR_HF_UUID[16] = {'l', 'i', 'l', 'y', 'p', 'a', 'w', 's', 'c', 'o', 'n', 'f', '.', ' ', 'h', 'f'};
 static uint8_t RCFG_CHAR_HQ_UUID[16] = {'l', 'i', 'l', 'y', 'p', 'a', 'w', 's', 'c', 'o', 'n', 'f', '.', ' ', 'h', 'q'};
 static uint8_t RCFG_CHAR_DEN_UUID[16] = {'l', 'i', 'l', 'y', 'p', 'a', 'w', 's', 'c', 'o', 'n', 'f', '.', 'd', 'e', 'n'};
+static uint8_t RCFG_CHAR_LAY_UUID[16] = {'l', 'i', 'l', 'y', 'p', 'a', 'w', 's', 'c', 'o', 'n', 'f', '.', 'l', 'a', 'y'};
 
 static const uint16_t primary_service_uuid = ESP_GATT_UUID_PRI_SERVICE;
 static const uint16_t character_declaration_uuid = ESP_GATT_UUID_CHAR_DECLARE;
@@ -66,6 +76,7 @@ static  uint8_t NQ_DESC[] = "Q factor of normal sensors (numerator).";
 static  uint8_t HF_DESC[] = "Target frequency of held sensors (numerator).";
 static  uint8_t HQ_DESC[] = "Q factor of held sensors (numerator).";
 static  uint8_t DEN_DESC[] = "Denominator frequency and q factor.";
+static  uint8_t LAY_DESC[] = "Layout blob: 16-bit little-endian offset, then bytes.";
 
 static const esp_gatts_attr_db_t rcfg_gatt_db[IDX_RCFG_NB] =
     {
@@ -115,8 +126,42 @@ static const esp_gatts_attr_db_t rcfg_gatt_db[IDX_RCFG_NB] =
         ,
         [IDX_RCFG_CHAR_DENOMINATOR_DESC] =
             {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&characteristic_description_descriptor, ESP_GATT_PERM_READ, sizeof(DEN_DESC), sizeof(DEN_DESC), DEN_DESC}},
+
+        [IDX_RCFG_CHAR_LAYOUT] =
+            {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ, CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_write}},
+        [IDX_RCFG_CHAR_LAYOUT_VAL] =
+            {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_128, (uint8_t *)&RCFG_CHAR_LAY_UUID, ESP_GATT_PERM_WRITE, RCFG_LAYOUT_CHAR_LEN_MAX, sizeof(initial_data), &initial_data}},
+        [IDX_RCFG_CHAR_LAYOUT_DESC] =
+            {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&characteristic_description_descriptor, ESP_GATT_PERM_READ, sizeof(LAY_DESC), sizeof(LAY_DESC), LAY_DESC}},
 };
 
+// A layout blob is longer than an attribute, so it comes in pieces: each write
+// is a 16-bit little-endian offset and the bytes that go there. The write that
+// ends where the blob's header says it ends applies the layout and saves it.
+static uint8_t layout_upload[LAYOUT_MAX_SIZE];
+
+static void layout_write(const uint8_t *value, uint16_t length)
+{
+    if (length < 2)
+    {
+        return;
+    }
+    size_t offset = value[0] | value[1] << 8;
+    size_t end = offset + length - 2;
+    if (end > sizeof(layout_upload))
+    {
+        ESP_LOGE(TAG, "Layout write past %d bytes", (int)sizeof(layout_upload));
+        return;
+    }
+    memcpy(layout_upload + offset, value + 2, length - 2);
+    layout_header header;
+    memcpy(&header, layout_upload, sizeof(header));
+    if (end >= sizeof(header) && end == sizeof(header) + header.size)
+    {
+        layout_load(layout_upload, end, true);
+    }
+}
+
 void remote_config_gatt_callback_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
                                          esp_ble_gatts_cb_param_t *param)
 {
@@ -127,7 +172,23 @@ void remote_config_gatt_callback_handler(esp_gatts_cb_event_t event, esp_gatt_if
         esp_ble_gatts_create_attr_tab(rcfg_gatt_db, gatts_if, IDX_RCFG_NB, 0);
         break;
 
-    // No write event handler needed use esp_ble_gatts_get_attr_value.
+    // Values are read back with esp_ble_gatts_get_attr_value. The denominator
+    // goes last, so writing it swaps the whole configuration into the running
+    // filter; thresholds are kept until the next calibration.
+    case ESP_GATTS_WRITE_EVT:
+        if (param->write.handle == rcfg_handle_table[IDX_RCFG_CHAR_LAYOUT_VAL])
+        {
+            layout_write(param->write.value, param->write.len);
+        }
+        if (param->write.handle == rcfg_handle_table[IDX_RCFG_CHAR_DENOMINATOR_VAL])
+        {
+            iir_filter_params params = get_remote_config();
+            if (params.sample_rate != 0 && !default_filter_reconfigure(&params))
+            {
+                ESP_LOGI(TAG, "Filter not reconfigured live (unsupported or busy), applying at next calibration.");
+            }
+        }
+        break;
 
     case ESP_GATTS_CREAT_ATTR_TAB_EVT:
         if (param->add_attr_tab.status != ESP_GATT_OK)
@@ -183,14 +244,12 @@ iir_filter_params get_remote_config(void)
 
     ESP_LOGI(TAG, "REMOTE PARAMS %f,%f,%f,%f", freq_normal, freq_held, q_normal, q_held);
 
-    iir_filter_params filter_params = {
-        .sample_rate = 100,
-        .target_frequency = {freq_normal, freq_normal, freq_normal, freq_normal, freq_normal, freq_held, freq_held, freq_held, freq_held, freq_held},
-        .qfactor = {q_normal, q_normal, q_normal, q_normal, q_normal, q_held, q_held, q_held, q_held, q_held},
-        .holdable = {0, 0, 0, 0, 0, 1, 1, 1, 1, 1},
-        .calibration_peak_multiplier = 2.5,
-        .calibration_time_seconds = 2,
-        .debounce_count = 4,
-        .min_threshold = 1};
+    // Only the frequencies and Q factors are remote; the rest is built in.
+    iir_filter_params filter_params = iir_filter_default_params();
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        filter_params.target_frequency[i] = filter_params.holdable[i] ? freq_held : freq_normal;
+        filter_params.qfactor[i] = filter_params.holdable[i] ? q_held : q_normal;
+    }
     return filter_params;
 }
@@ -0,0 +1,163 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "constants.h"
+#include "acquisition.h"
+#include "sampler.h"
+#include "frame_ring.h"
+
+#define SAMPLER_PERIOD_US (1000000 / SENSOR_FRAME_RATE_HZ)
+// Above hid_task and the Bluetooth host, below the controller and esp_timer tasks.
+#define SAMPLER_TASK_PRIORITY 20
+// Several periods without a frame means acquisition has stalled.
+#define SAMPLER_TIMEOUT_MS 100
+
+const static char *TAG = "SAMPLER";
+
+static bool sampler_running = false;
+static TaskHandle_t sampler_task_handle = NULL;
+static TaskHandle_t consumer_task_handle = NULL;
+static sampler_process_fn process_frame = NULL;
+static frame_ring_t ring;
+static sampler_stats_t stats;
+
+static int64_t last_frame_us = 0;
+static uint32_t next_sequence = 0;
+
+#ifndef ADC_CONTINUOUS_MODE
+static esp_timer_handle_t sampler_timer;
+
+static void sampler_timer_callback(void *arg)
+{
+    xTaskNotifyGive(sampler_task_handle);
+}
+#endif
+
+static void record_frame(const sensor_frame_t *frame)
+{
+    int64_t now = esp_timer_get_time();
+    if (stats.frames > 0)
+    {
+        int64_t jitter = now - last_frame_us - SAMPLER_PERIOD_US;
+        jitter = jitter < 0 ? -jitter : jitter;
+        stats.total_jitter_us += jitter;
+        stats.max_jitter_us = jitter > stats.max_jitter_us ? jitter : stats.max_jitter_us;
+    }
+    if (frame->sequence > next_sequence)
+    {
+        stats.deadline_misses += frame->sequence - next_sequence;
+    }
+    next_sequence = frame->sequence + 1;
+    last_frame_us = now;
+    stats.frames++;
+}
+
+// Waits for the next period and acquires its frame.
+static bool sampler_acquire(sensor_frame_t *frame)
+{
+#ifdef ADC_CONTINUOUS_MODE
+    // The DMA delivers frames at the rate it was configured with.
+    if (!acquisition_read_frame(frame, SAMPLER_TIMEOUT_MS))
+    {
+        return false;
+    }
+#else
+    if (sampler_running)
+    {
+        uint32_t periods = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SAMPLER_TIMEOUT_MS));
+        if (!periods)
+        {
+            return false;
+        }
+        stats.deadline_misses += periods - 1;
+    }
+    else
+    {
+        vTaskDelay(pdMS_TO_TICKS(SAMPLER_PERIOD_US / 1000));
+    }
+    acquisition_read_frame(frame, 0);
+#endif
+    record_frame(frame);
+    return true;
+}
+
+static void sampler_task(void *pvParameters)
+{
+    sensor_frame_t frame;
+    while (1)
+    {
+        if (!sampler_acquire(&frame))
+        {
+            ESP_LOGW(TAG, "No frame in %d ms", SAMPLER_TIMEOUT_MS);
+            continue;
+        }
+        if (process_frame)
+        {
+            process_frame(&frame);
+        }
+        // The consumer owns the oldest frames, so a full ring drops the new one.
+        if (!frame_ring_push(&ring, &frame))
+        {
+            stats.ring_overflows++;
+        }
+        xTaskNotifyGive(consumer_task_handle);
+    }
+}
+
+void sampler_init(sampler_process_fn process)
+{
+    process_frame = process;
+    frame_ring_init(&ring);
+}
+
+void sampler_start(TaskHandle_t consumer)
+{
+    consumer_task_handle = consumer;
+    // Set before the task exists: it preempts this one as soon as it is created.
+    sampler_running = true;
+    xTaskCreatePinnedToCore(&sampler_task, "sampler", 4096, NULL, SAMPLER_TASK_PRIORITY, &sampler_task_handle, SAMPLER_CORE);
+
+#ifndef ADC_CONTINUOUS_MODE
+    esp_timer_create_args_t timer_args = {
+        .callback = sampler_timer_callback,
+        .name = "sampler",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &sampler_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(sampler_timer, SAMPLER_PERIOD_US));
+#endif
+    ESP_LOGI(TAG, "Sampling at %d Hz on core %d", SENSOR_FRAME_RATE_HZ, SAMPLER_CORE);
+}
+
+bool sampler_receive(sensor_frame_t *frame, TickType_t ticks_to_wait)
+{
+    if (!sampler_running)
+    {
+        if (!sampler_acquire(frame))
+        {
+            return false;
+        }
+        if (process_frame)
+        {
+            process_frame(frame);
+        }
+        return true;
+    }
+    // A push between a failed pop and the wait leaves a notification pending, so
+    // the wait returns at once and the frame is not missed.
+    while (!frame_ring_pop(&ring, frame))
+    {
+        if (!ulTaskNotifyTake(pdTRUE, ticks_to_wait))
+        {
+            return frame_ring_pop(&ring, frame);
+        }
+    }
+    return true;
+}
+
+sampler_stats_t sampler_get_stats(void)
+{
+    return stats;
+}
@@ -0,0 +1,51 @@
+#ifndef SAMPLER_H__
+#define SAMPLER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "acquisition.h"
+
+// Fixed-rate sampling at SENSOR_FRAME_RATE_HZ, independent of how long the
+// consumer takes per frame. sampler_start runs acquisition and the frame
+// processor (the filter) in their own high-priority task pinned to
+// SAMPLER_CORE: in continuous mode the DMA paces it, otherwise a periodic
+// esp_timer does. Processed frames reach the consumer through a wait-free ring
+// (frame_ring.h), so nothing the consumer does, BLE included, can hold up sampling.
+//
+// Until sampler_start is called, sampler_receive acquires and processes inline on
+// the caller's task instead, paced the same way. Host benchmarks use that under
+// virtual time.
+
+// Core 0 also runs the Bluetooth controller and host, which the consumer talks to.
+#define SAMPLER_CORE 1
+
+typedef void (*sampler_process_fn)(sensor_frame_t *frame);
+
+typedef struct
+{
+    uint32_t frames;
+    // Periods that produced no frame: the sampler woke too late or frames were lost.
+    uint32_t deadline_misses;
+    // Frames dropped because the consumer fell behind and the ring was full.
+    uint32_t ring_overflows;
+    // Deviation of the time between frames from the period, in microseconds.
+    int64_t max_jitter_us;
+    int64_t total_jitter_us;
+} sampler_stats_t;
+
+// Sets the processing every frame goes through before it is handed over.
+void sampler_init(sampler_process_fn process);
+
+// Starts the sampler task. Only `consumer` may call sampler_receive afterwards;
+// it is notified whenever a frame arrives.
+void sampler_start(TaskHandle_t consumer);
+
+// Next frame, oldest first. Returns false if none arrived within ticks_to_wait.
+bool sampler_receive(sensor_frame_t *frame, TickType_t ticks_to_wait);
+
+sampler_stats_t sampler_get_stats(void);
+
+#endif
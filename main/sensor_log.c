@@ -0,0 +1,248 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "sensor_log.h"
+
+#define SENSOR_LOG_BUFFER_MASK (SENSOR_LOG_BUFFER_SIZE - 1)
+// Lowest priority above idle: console output waits for everything else.
+#define SENSOR_LOG_TASK_PRIORITY 1
+#define SENSOR_LOG_TASK_STACK 3072
+// Bytes handed to the console per write.
+#define SENSOR_LOG_CHUNK 512
+// How long the writer sleeps once the buffer is empty; at most a few records accumulate.
+#define SENSOR_LOG_IDLE_MS 20
+
+_Static_assert((SENSOR_LOG_BUFFER_SIZE & SENSOR_LOG_BUFFER_MASK) == 0, "SENSOR_LOG_BUFFER_SIZE must be a power of two");
+_Static_assert(SENSOR_LOG_CHUNK >= SENSOR_LOG_MAX_LINE, "a chunk must hold a whole line");
+_Static_assert(SENSOR_COUNT <= 32, "pressed mask is 32 bits");
+
+const static char *TAG = "SENSOR_LOG";
+
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Single-producer (the sampler task) single-consumer (the writer) byte buffer,
+// in the same style as frame_ring.h. Only whole lines are ever written to it.
+static uint8_t buffer[SENSOR_LOG_BUFFER_SIZE];
+static _Atomic uint32_t head = 0;
+static _Atomic uint32_t tail = 0;
+
+// Encoder state, owned by the sampler task.
+static uint32_t last_sequence;
+static int64_t last_timestamp_us;
+static uint32_t last_raw[SENSOR_COUNT];
+static int32_t last_filtered[SENSOR_COUNT];
+static uint32_t last_state;
+static uint32_t last_pressed;
+static uint32_t records_since_keyframe = SENSOR_LOG_KEYFRAME_INTERVAL;
+
+static int32_t pending_filtered[SENSOR_COUNT];
+static bool pending_has_filtered = false;
+
+static sensor_log_stats_t stats;
+
+static uint8_t crc8(const uint8_t *data, size_t length)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint8_t *put_varint(uint8_t *p, int64_t delta)
+{
+    uint64_t value = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    while (value >= 0x80)
+    {
+        *p++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+static size_t base64_encode(const uint8_t *in, size_t length, char *out)
+{
+    char *p = out;
+    size_t i = 0;
+    for (; i + 3 <= length; i += 3)
+    {
+        uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        *p++ = base64_alphabet[v >> 18];
+        *p++ = base64_alphabet[(v >> 12) & 0x3f];
+        *p++ = base64_alphabet[(v >> 6) & 0x3f];
+        *p++ = base64_alphabet[v & 0x3f];
+    }
+    if (i < length)
+    {
+        uint32_t v = in[i] << 16;
+        if (i + 1 < length)
+        {
+            v |= in[i + 1] << 8;
+        }
+        *p++ = base64_alphabet[v >> 18];
+        *p++ = base64_alphabet[(v >> 12) & 0x3f];
+        if (i + 1 < length)
+        {
+            *p++ = base64_alphabet[(v >> 6) & 0x3f];
+        }
+    }
+    return p - out;
+}
+
+static bool buffer_write(const char *line, size_t length)
+{
+    uint32_t h = atomic_load_explicit(&head, memory_order_relaxed);
+    uint32_t t = atomic_load_explicit(&tail, memory_order_acquire);
+    if (SENSOR_LOG_BUFFER_SIZE - (h - t) < length)
+    {
+        return false;
+    }
+    size_t offset = h & SENSOR_LOG_BUFFER_MASK;
+    size_t first = length < SENSOR_LOG_BUFFER_SIZE - offset ? length : SENSOR_LOG_BUFFER_SIZE - offset;
+    memcpy(&buffer[offset], line, first);
+    memcpy(buffer, line + first, length - first);
+    atomic_store_explicit(&head, h + length, memory_order_release);
+
+    uint32_t buffered = h + length - t;
+    stats.max_buffered = buffered > stats.max_buffered ? buffered : stats.max_buffered;
+    return true;
+}
+
+size_t sensor_log_read(uint8_t *buf, size_t max)
+{
+    uint32_t t = atomic_load_explicit(&tail, memory_order_relaxed);
+    uint32_t h = atomic_load_explicit(&head, memory_order_acquire);
+    size_t length = h - t < max ? h - t : max;
+    size_t offset = t & SENSOR_LOG_BUFFER_MASK;
+    size_t first = length < SENSOR_LOG_BUFFER_SIZE - offset ? length : SENSOR_LOG_BUFFER_SIZE - offset;
+    memcpy(buf, &buffer[offset], first);
+    memcpy(buf + first, buffer, length - first);
+    // Stop after the last complete line, so no other output lands inside one.
+    while (length && buf[length - 1] != '\n')
+    {
+        length--;
+    }
+    atomic_store_explicit(&tail, t + length, memory_order_release);
+    return length;
+}
+
+void sensor_log_filtered(const float *filtered)
+{
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        pending_filtered[i] = (int32_t)lrintf(filtered[i] * SENSOR_LOG_FILTER_SCALE);
+    }
+    pending_has_filtered = true;
+}
+
+void sensor_log_record(const sensor_frame_t *frame, const uint32_t *raw, sensor_mask_t pressed, keyboard_state_t state)
+{
+    bool keyframe = records_since_keyframe >= SENSOR_LOG_KEYFRAME_INTERVAL;
+    if (keyframe)
+    {
+        last_sequence = 0;
+        last_timestamp_us = 0;
+        memset(last_raw, 0, sizeof(last_raw));
+        memset(last_filtered, 0, sizeof(last_filtered));
+        last_state = 0;
+        last_pressed = 0;
+    }
+    if (!pending_has_filtered)
+    {
+        memset(last_filtered, 0, sizeof(last_filtered));
+    }
+
+    uint8_t record[SENSOR_LOG_MAX_RECORD];
+    uint8_t *p = record;
+    *p++ = (keyframe ? SENSOR_LOG_FLAG_KEYFRAME : 0) | (pending_has_filtered ? SENSOR_LOG_FLAG_FILTERED : 0);
+    p = put_varint(p, (int64_t)frame->sequence - last_sequence);
+    p = put_varint(p, frame->timestamp_us - last_timestamp_us);
+    for (int i = 0; i < SENSOR_COUNT; ++i)
+    {
+        p = put_varint(p, (int64_t)raw[i] - last_raw[i]);
+    }
+    if (pending_has_filtered)
+    {
+        for (int i = 0; i < SENSOR_COUNT; ++i)
+        {
+            p = put_varint(p, (int64_t)pending_filtered[i] - last_filtered[i]);
+        }
+    }
+    uint32_t pressed_mask = pressed;
+    p = put_varint(p, (int64_t)(uint32_t)state - last_state);
+    p = put_varint(p, (int64_t)pressed_mask - last_pressed);
+    *p = crc8(record, p - record);
+    p++;
+
+    char line[SENSOR_LOG_MAX_LINE];
+    size_t length = sizeof(SENSOR_LOG_PREFIX) - 1;
+    memcpy(line, SENSOR_LOG_PREFIX, length);
+    length += base64_encode(record, p - record, line + length);
+    line[length++] = '\n';
+
+    if (!buffer_write(line, length))
+    {
+        // The next record has to stand on its own.
+        stats.dropped_records++;
+        records_since_keyframe = SENSOR_LOG_KEYFRAME_INTERVAL;
+        pending_has_filtered = false;
+        return;
+    }
+
+    last_sequence = frame->sequence;
+    last_timestamp_us = frame->timestamp_us;
+    memcpy(last_raw, raw, sizeof(last_raw));
+    if (pending_has_filtered)
+    {
+        memcpy(last_filtered, pending_filtered, sizeof(last_filtered));
+    }
+    last_state = (uint32_t)state;
+    last_pressed = pressed_mask;
+    records_since_keyframe = keyframe ? 1 : records_since_keyframe + 1;
+    pending_has_filtered = false;
+
+    stats.records++;
+    stats.keyframes += keyframe;
+    stats.bytes += length;
+}
+
+static void sensor_log_task(void *arg)
+{
+    static uint8_t chunk[SENSOR_LOG_CHUNK];
+    while (1)
+    {
+        size_t length = sensor_log_read(chunk, sizeof(chunk));
+        if (length)
+        {
+            fwrite(chunk, 1, length, stdout);
+            fflush(stdout);
+        }
+        else
+        {
+            vTaskDelay(pdMS_TO_TICKS(SENSOR_LOG_IDLE_MS));
+        }
+    }
+}
+
+void sensor_log_start(void)
+{
+    xTaskCreate(&sensor_log_task, "sensor_log", SENSOR_LOG_TASK_STACK, NULL, SENSOR_LOG_TASK_PRIORITY, NULL);
+    ESP_LOGI(TAG, "Binary sensor log, %d byte buffer", SENSOR_LOG_BUFFER_SIZE);
+}
+
+sensor_log_stats_t sensor_log_get_stats(void)
+{
+    return stats;
+}
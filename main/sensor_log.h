@@ -0,0 +1,79 @@
+#ifndef SENSOR_LOG_H__
+#define SENSOR_LOG_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "constants.h"
+#include "state.h"
+#include "acquisition.h"
+
+// Compact sensor log, replacing the SENSORLOG and FILTER_LOG text lines. The
+// sampler task encodes one record per frame into a RAM buffer in a few
+// microseconds; a low-priority writer task drains it to the console, so a slow
+// or disconnected console costs dropped records instead of missed frames.
+//
+// The console is captured as text (and sometimes re-encoded as UTF-16), so each
+// record goes out as one line: SENSOR_LOG_PREFIX, the record in base64 without
+// padding, then '\n'. A record is
+//
+//   flags          1 byte, SENSOR_LOG_FLAG_*
+//   sequence       varint
+//   timestamp_us   varint
+//   raw            SENSOR_COUNT varints
+//   filtered       SENSOR_COUNT varints, in 1/SENSOR_LOG_FILTER_SCALE counts,
+//                  only with SENSOR_LOG_FLAG_FILTERED
+//   device_state   varint
+//   pressed        varint, bit i set when sensor i is pressed
+//   crc            1 byte, CRC-8 (polynomial 0x07) of everything before it
+//
+// Every varint is a zigzag-encoded LEB128 difference from the same field in the
+// previous record. A keyframe takes its differences from zero instead, so a
+// decoder can start there; one is sent every SENSOR_LOG_KEYFRAME_INTERVAL
+// records and after any record is dropped. Filtered values also restart from
+// zero after a record without them. host/tools/sensor_log_decode turns a capture
+// back into arrays.
+
+#define SENSOR_LOG_PREFIX "$L"
+
+#define SENSOR_LOG_FLAG_KEYFRAME 0x01
+#define SENSOR_LOG_FLAG_FILTERED 0x02
+
+#define SENSOR_LOG_FILTER_SCALE 16
+#define SENSOR_LOG_KEYFRAME_INTERVAL 100
+
+// Worst case: every varint at its longest.
+#define SENSOR_LOG_MAX_RECORD (1 + 5 + 10 + (SENSOR_COUNT) * 5 * 2 + 5 + 5 + 1)
+#define SENSOR_LOG_MAX_LINE (sizeof(SENSOR_LOG_PREFIX) - 1 + (SENSOR_LOG_MAX_RECORD * 4 + 2) / 3 + 1)
+
+// About a second of records; power of two.
+#define SENSOR_LOG_BUFFER_SIZE 4096
+
+typedef struct
+{
+    uint32_t records;
+    uint32_t keyframes;
+    uint32_t bytes;
+    // Records that did not fit in the buffer because the writer fell behind.
+    uint32_t dropped_records;
+    uint32_t max_buffered;
+} sensor_log_stats_t;
+
+// Starts the writer task. Without it records accumulate until the buffer is
+// full and are then dropped; sensor_log_read drains it instead.
+void sensor_log_start(void);
+
+// Filtered values for the record of the frame being processed. Called by the
+// filter from within default_filter_process.
+void sensor_log_filtered(const float *filtered);
+
+// Encodes and buffers one frame. raw holds SENSOR_COUNT values.
+void sensor_log_record(const sensor_frame_t *frame, const uint32_t *raw, sensor_mask_t pressed, keyboard_state_t state);
+
+// Takes up to max bytes of whole lines from the buffer. Returns the count.
+size_t sensor_log_read(uint8_t *buf, size_t max);
+
+sensor_log_stats_t sensor_log_get_stats(void);
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef SENSOR_MASK_H__
+#define SENSOR_MASK_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "constants.h"
+
+// Pressed state of every sensor in one word: bit i is set while sensor i is
+// pressed. The filters produce it, and the sampler, encoder and haptics pass it
+// on and test it as is. The encoding sensors come first, so the low
+// ENCODING_SENSOR_COUNT bits are the chord.
+typedef uint16_t sensor_mask_t;
+
+_Static_assert((SENSOR_COUNT) <= 16, "sensor_mask_t holds 16 sensors");
+
+#define SENSOR_MASK_BIT(i) ((sensor_mask_t)(1u << (i)))
+#define SENSOR_MASK_ALL ((sensor_mask_t)((1u << (SENSOR_COUNT)) - 1))
+#define SENSOR_MASK_ENCODING ((sensor_mask_t)((1u << ENCODING_SENSOR_COUNT) - 1))
+
+static inline bool sensor_mask_test(sensor_mask_t mask, int i)
+{
+    return (mask >> i) & 1;
+}
+
+static inline int sensor_mask_count(sensor_mask_t mask)
+{
+    return __builtin_popcount(mask);
+}
+
+// Masks are built from the last sensor down, each bit shifted in at the
+// bottom: a constant shift is cheaper than one by i.
+static inline sensor_mask_t sensor_mask_from_bools(const bool *flags)
+{
+    sensor_mask_t mask = 0;
+    for (int i = SENSOR_COUNT - 1; i >= 0; --i)
+    {
+        mask = mask << 1 | flags[i];
+    }
+    return mask;
+}
+
+// Debounce counters of every sensor, bit-sliced: bits[b] holds bit b of each
+// sensor's count, so all of them count together with mask arithmetic.
+#define SENSOR_DEBOUNCE_BITS 8
+// Counts past this are not represented.
+#define SENSOR_DEBOUNCE_MAX ((1 << SENSOR_DEBOUNCE_BITS) - 2)
+
+typedef struct
+{
+    sensor_mask_t bits[SENSOR_DEBOUNCE_BITS];
+    // Sensors whose count is not zero.
+    sensor_mask_t counting;
+} sensor_debounce;
+
+// Counts a frame for the sensors in moving and restarts the others. Returns the
+// sensors whose count went past limit, which restart too.
+static inline sensor_mask_t sensor_debounce_step(sensor_debounce *debounce, sensor_mask_t moving, int limit)
+{
+    if (!(moving | debounce->counting))
+    {
+        // Nothing counting, as on most frames.
+        return 0;
+    }
+    limit = limit < SENSOR_DEBOUNCE_MAX ? limit : SENSOR_DEBOUNCE_MAX;
+    sensor_mask_t carry = moving;
+    for (int b = 0; b < SENSOR_DEBOUNCE_BITS; ++b)
+    {
+        sensor_mask_t bit = debounce->bits[b] & moving;
+        debounce->bits[b] = bit ^ carry;
+        carry &= bit;
+    }
+    // count > limit, from the top bit down.
+    sensor_mask_t greater = 0;
+    sensor_mask_t equal = SENSOR_MASK_ALL;
+    for (int b = SENSOR_DEBOUNCE_BITS - 1; b >= 0; --b)
+    {
+        sensor_mask_t limit_bit = -(sensor_mask_t)((limit >> b) & 1);
+        greater |= equal & debounce->bits[b] & ~limit_bit;
+        equal &= ~(debounce->bits[b] ^ limit_bit);
+    }
+    for (int b = 0; b < SENSOR_DEBOUNCE_BITS; ++b)
+    {
+        debounce->bits[b] &= ~greater;
+    }
+    debounce->counting = moving & ~greater;
+    return greater;
+}
+
+// The press decision of the threshold filters, for every sensor at once. The
+// filter compares each reading with its levels and passes the results as masks:
+// over, bits at or past the press threshold, and releasing, bits past the
+// release point. A sensor not in holdable follows them directly, with
+// hysteresis; a holdable one toggles once it has moved the other way for more
+// than debounce_count frames in a row. Returns the new pressed mask.
+static inline sensor_mask_t sensor_mask_decide(sensor_mask_t pressed, sensor_mask_t over, sensor_mask_t releasing,
+                                               sensor_mask_t holdable, int debounce_count, sensor_debounce *debounce)
+{
+    sensor_mask_t direct = (~pressed & over) | (pressed & ~releasing);
+    sensor_mask_t moving = holdable & ((~pressed & over) | (pressed & releasing));
+    sensor_mask_t toggle = sensor_debounce_step(debounce, moving, debounce_count);
+    return (~holdable & direct) | (holdable & (pressed ^ toggle));
+}
+
+#endif
@@ -6,25 +6,41 @@
 #include <sys/time.h>
 #include "soc/soc_caps.h"
 #include "esp_log.h"
-#include "esp_adc/adc_oneshot.h"
+#include "freertos/FreeRTOS.h"
 #include "driver/gpio.h"
 
 #include "constants.h"
 #include "sensors.h"
 #include "state.h"
 #include "filter.h"
+#include "acquisition.h"
+#include "sampler.h"
+#include "sensor_log.h"
+#include "crosstalk.h"
+#include "filter_store.h"
 
 #define FORCE_ANALOG_LOG false
 
 #define JUMPERS_BIT_MASK ((1ULL << GPIO_CALIBRATION_PIN) | (1ULL << GPIO_LOGGING_PIN))
 
+// A frame is due every period; waiting much longer means sampling stopped.
+#define SENSOR_TIMEOUT_MS 100
+
 const static char *TAG = "SENSOR";
 
-static adc_channel_t adc_channels[] = SENSOR_ADC_CHANNELS;
 static uint8_t digital_sensors[] = DIGITAL_SENSORS;
 
+// Sampler side: the filter's input and its own pressed state, which it reads back.
 static uint32_t adc_raw[SENSOR_COUNT];
-bool pins_pressed[SENSOR_COUNT] = {0};
+static sensor_mask_t filter_pressed = 0;
+// Crosstalk is measured from the readings, and the filter gets them compensated.
+static crosstalk_compensation crosstalk;
+#ifdef CROSSTALK_CALIBRATION
+static crosstalk_estimator crosstalk_estimate;
+#endif
+static uint32_t compensated_raw[SENSOR_COUNT];
+// Consumer side: copied from each frame as it is read.
+sensor_mask_t pins_pressed = 0;
 
 #ifdef JUMPERS_COMMON_POSITIVE
 #define JUMPERS_SIGN_OPERATOR
@@ -38,8 +54,6 @@ bool pins_pressed[SENSOR_COUNT] = {0};
 #define DIGITAL_BUTTON_SIGN_OPERATOR !
 #endif
 
-static adc_oneshot_unit_handle_t adc1_handle;
-
 void jumpers_init(void)
 {
   gpio_config_t io_conf = {};
@@ -67,26 +81,17 @@ void digital_button_init(void)
   gpio_config(&io_conf);
 }
 
+static void pressure_sensor_process_frame(sensor_frame_t *frame);
+
 void pressure_sensor_init(void)
 {
-  adc_oneshot_unit_init_cfg_t init_config1 = {
-      .unit_id = ADC_UNIT_1,
-  };
-  ESP_ERROR_CHECK(adc_oneshot_new_unit(&init_config1, &adc1_handle));
-
-  adc_oneshot_chan_cfg_t config = {
-      .bitwidth = ADC_BITWIDTH_DEFAULT,
-      .atten = ADC_ATTENUATION,
-  };
-
-  for (int i = 0; i < ADC_SENSOR_COUNT; ++i)
-  {
-    ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, adc_channels[i], &config));
-  }
+  acquisition_init();
+  sampler_init(pressure_sensor_process_frame);
 }
 
 void sensor_init(void)
 {
+  crosstalk_compensation_init(&crosstalk);
   jumpers_init();
   pressure_sensor_init();
   digital_button_init();
@@ -107,23 +112,7 @@ int pins_pressed_count(void)
   {
     return 0;
   }
-  char buf = 0;
-
-  for (int i = 0; i < SENSOR_COUNT; ++i)
-  {
-    buf = buf + pins_pressed[i];
-  }
-  return buf;
-}
-
-char pressure_bits_to_num(void)
-{
-  char buf = 0;
-  for (int i = 0; i < ENCODING_SENSOR_COUNT; ++i)
-  {
-    buf = buf + (pins_pressed[i] * (1 << i));
-  }
-  return buf;
+  return sensor_mask_count(pins_pressed);
 }
 
 jumper_states_t read_jumpers(void)
@@ -137,16 +126,6 @@ jumper_states_t read_jumpers(void)
   return ret;
 }
 
-void pressure_sensor_read_raw(void)
-{
-  for (int i = 0; i < ADC_SENSOR_COUNT; ++i)
-  {
-    int tmp;
-    ESP_ERROR_CHECK(adc_oneshot_read(adc1_handle, adc_channels[i], &tmp));
-    adc_raw[i] = tmp;
-  }
-}
-
 void digital_sensor_read_raw(void)
 {
   for (int i = 0; i < DIGITAL_SENSOR_COUNT; ++i)
@@ -168,39 +147,81 @@ void pressure_sensor_calibration_manage()
     if (new_calibration_state)
     {
       default_filter_calibrate_start(adc_raw);
+#ifdef CROSSTALK_CALIBRATION
+      crosstalk_estimator_params params = crosstalk_estimator_default_params();
+      crosstalk_estimator_init(&crosstalk_estimate, &params);
+#endif
     }
     else
     {
       default_filter_calibrate_end(adc_raw);
+#ifdef CROSSTALK_CALIBRATION
+      crosstalk_estimator_finish(&crosstalk_estimate, &crosstalk);
+#endif
     }
     last_calibration_state = new_calibration_state;
   }
 }
 
-char pressure_sensor_read(void)
+// Runs on the sampler task for every frame: completes the raw readings and filters them.
+static void pressure_sensor_process_frame(sensor_frame_t *frame)
 {
-  pressure_sensor_read_raw();
+  memcpy(adc_raw, frame->adc_raw, sizeof(frame->adc_raw));
   digital_sensor_read_raw();
   pressure_sensor_calibration_manage();
-  default_filter_process(adc_raw, pins_pressed);
+#ifdef CROSSTALK_CALIBRATION
+  if (test_state(KEYBOARD_STATE_SENSOR_CALIBRATION))
+  {
+    crosstalk_estimator_add(&crosstalk_estimate, adc_raw);
+  }
+#endif
+  memcpy(compensated_raw, adc_raw, sizeof(adc_raw));
+  crosstalk_compensation_apply(&crosstalk, compensated_raw);
+  default_filter_process(compensated_raw, &filter_pressed);
+  filter_store_frame();
+  frame->pressed = filter_pressed;
 
   if (test_state(KEYBOARD_STATE_SENSOR_LOGGING))
   {
-    ESP_LOGI(TAG, "SENSORLOG | %4ld | %4ld | %4ld | %4ld | %4ld | %4ld | %4ld | %4ld | %4ld | %4ld |", adc_raw[0], adc_raw[1], adc_raw[2], adc_raw[3], adc_raw[4], adc_raw[5], adc_raw[6], adc_raw[7], adc_raw[8], adc_raw[9]);
+    sensor_log_record(frame, adc_raw, filter_pressed, device_state);
   }
 
   switch (device_state & MASK_KEYBOARD_STATE_SENSOR)
   {
   case KEYBOARD_STATE_SENSOR_NORMAL:
-    return pressure_bits_to_num();
+    frame->pins = frame->pressed & SENSOR_MASK_ENCODING;
     break;
   case KEYBOARD_STATE_SENSOR_CALIBRATION:
-    return 0;
+    frame->pins = 0;
     break;
   default:
     // This should be an error?
-    return 0;
+    frame->pins = 0;
     break;
   }
-  return 0;
+}
+
+// Blocks until the sampler has the next frame, which paces the caller at SENSOR_FRAME_RATE_HZ.
+char pressure_sensor_read(void)
+{
+  sensor_frame_t frame;
+  if (!sampler_receive(&frame, pdMS_TO_TICKS(SENSOR_TIMEOUT_MS)))
+  {
+    ESP_LOGW(TAG, "No sensor frame in %d ms", SENSOR_TIMEOUT_MS);
+    return 0;
+  }
+  pins_pressed = frame.pressed;
+  return frame.pins;
+}
+
+void pressure_sensor_set_crosstalk(const crosstalk_compensation *compensation)
+{
+  crosstalk = *compensation;
+}
+
+char pressure_sensor_replay_frame(sensor_frame_t *frame)
+{
+  pressure_sensor_process_frame(frame);
+  pins_pressed = frame->pressed;
+  return frame->pins;
 }
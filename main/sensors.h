@@ -2,15 +2,27 @@
 #define SENSORS_H__
 
 #include "constants.h"
+#include "acquisition.h"
+#include "crosstalk.h"
+#include "sensor_mask.h"
 
-// Still used by feedback controller. Clean up later.
-extern bool pins_pressed[SENSOR_COUNT];
+// Pressed sensors of the last frame read, for the encoder and the feedback controller.
+extern sensor_mask_t pins_pressed;
 
 void sensor_init(void);
 
 // Returns a string of 5 bits as char.
 char pressure_sensor_read(void);
 
+// Runs a frame that did not come from the sampler, such as one replayed from a
+// capture, through the same processing, and publishes it like pressure_sensor_read.
+// adc_raw is taken from the frame; digital sensors and jumpers are still read.
+char pressure_sensor_replay_frame(sensor_frame_t *frame);
+
+// Replaces the crosstalk compensation measured during calibration, e.g. with one
+// fitted on the host. Call while no frames are being processed.
+void pressure_sensor_set_crosstalk(const crosstalk_compensation *compensation);
+
 int pins_pressed_count(void);
 bool all_pins_stable(void);
 
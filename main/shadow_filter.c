@@ -0,0 +1,232 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "shadow_filter.h"
+
+#define SHADOW_FILTER_BUFFER_MASK (SHADOW_FILTER_BUFFER_RECORDS - 1)
+// Lowest priority above idle, as the sensor log writer.
+#define SHADOW_FILTER_TASK_PRIORITY 1
+#define SHADOW_FILTER_TASK_STACK 3072
+// Prefix, 9 bytes in hex, '\n' and the terminator.
+#define SHADOW_FILTER_MAX_LINE (sizeof(SHADOW_FILTER_PREFIX) - 1 + 18 + 2)
+
+_Static_assert((SHADOW_FILTER_BUFFER_RECORDS & SHADOW_FILTER_BUFFER_MASK) == 0, "SHADOW_FILTER_BUFFER_RECORDS must be a power of two");
+
+const static char *TAG = "SHADOW";
+
+enum
+{
+    PRODUCTION,
+    CANDIDATE,
+};
+
+typedef struct
+{
+    filter_handle_t filters[2];
+    sensor_mask_t pressed[2];
+} shadow_filter_data;
+
+// Single-producer (the sampler task) single-consumer (the reporter) ring, in the
+// same style as frame_ring.h.
+static shadow_record ring[SHADOW_FILTER_BUFFER_RECORDS];
+static _Atomic uint32_t head = 0;
+static _Atomic uint32_t tail = 0;
+
+static shadow_filter_stats stats;
+
+static void ring_write(const shadow_record *record)
+{
+    uint32_t h = atomic_load_explicit(&head, memory_order_relaxed);
+    uint32_t t = atomic_load_explicit(&tail, memory_order_acquire);
+    if (h - t == SHADOW_FILTER_BUFFER_RECORDS)
+    {
+        stats.dropped_records++;
+        return;
+    }
+    ring[h & SHADOW_FILTER_BUFFER_MASK] = *record;
+    atomic_store_explicit(&head, h + 1, memory_order_release);
+    stats.records++;
+}
+
+size_t shadow_filter_read(shadow_record *records, size_t max)
+{
+    uint32_t t = atomic_load_explicit(&tail, memory_order_relaxed);
+    uint32_t h = atomic_load_explicit(&head, memory_order_acquire);
+    size_t count = h - t < max ? h - t : max;
+    for (size_t r = 0; r < count; ++r)
+    {
+        records[r] = ring[(t + r) & SHADOW_FILTER_BUFFER_MASK];
+    }
+    atomic_store_explicit(&tail, t + count, memory_order_release);
+    return count;
+}
+
+void shadow_filter_process(filter_handle_t filter_handle, uint32_t *adc_raw, sensor_mask_t *pressed)
+{
+    shadow_filter_data *data = (shadow_filter_data *)filter_handle->filter_data;
+    sensor_mask_t last[2] = {data->pressed[PRODUCTION], data->pressed[CANDIDATE]};
+    // The candidate goes first so the values the sensor log keeps
+    // (sensor_log_filtered) are the production filter's.
+    for (int f = CANDIDATE; f >= PRODUCTION; --f)
+    {
+        filter_handle_t filter = data->filters[f];
+        esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+        filter->process(filter, adc_raw, &data->pressed[f]);
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+        stats.cycles[f] += cycles;
+        stats.max_cycles[f] = cycles > stats.max_cycles[f] ? cycles : stats.max_cycles[f];
+    }
+    *pressed = data->pressed[PRODUCTION];
+
+    sensor_mask_t production = data->pressed[PRODUCTION];
+    sensor_mask_t candidate = data->pressed[CANDIDATE];
+    bool differ = production != candidate;
+    bool differed = last[PRODUCTION] != last[CANDIDATE];
+    stats.frames++;
+    stats.disagreement_frames += differ;
+    stats.disagreements += differ && !differed;
+    if ((differ || differed) && (production != last[PRODUCTION] || candidate != last[CANDIDATE]))
+    {
+        shadow_record record = {
+            .timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000),
+            .production = production,
+            .candidate = candidate,
+        };
+        ring_write(&record);
+    }
+}
+
+void shadow_filter_calibration_start(filter_handle_t filter_handle, uint32_t *adc_raw)
+{
+    shadow_filter_data *data = (shadow_filter_data *)filter_handle->filter_data;
+    for (int f = PRODUCTION; f <= CANDIDATE; ++f)
+    {
+        data->filters[f]->calibrate_start(data->filters[f], adc_raw);
+    }
+}
+
+void shadow_filter_calibration_end(filter_handle_t filter_handle, uint32_t *adc_raw)
+{
+    shadow_filter_data *data = (shadow_filter_data *)filter_handle->filter_data;
+    for (int f = PRODUCTION; f <= CANDIDATE; ++f)
+    {
+        data->filters[f]->calibrate_end(data->filters[f], adc_raw);
+    }
+}
+
+bool shadow_filter_reconfigure(filter_handle_t filter_handle, const void *params)
+{
+    filter_handle_t production = ((shadow_filter_data *)filter_handle->filter_data)->filters[PRODUCTION];
+    return production->reconfigure(production, params);
+}
+
+size_t shadow_filter_save(filter_handle_t filter_handle, void *blob, size_t size)
+{
+    filter_handle_t production = ((shadow_filter_data *)filter_handle->filter_data)->filters[PRODUCTION];
+    return production->save(production, blob, size);
+}
+
+bool shadow_filter_restore(filter_handle_t filter_handle, const void *blob, size_t size)
+{
+    filter_handle_t production = ((shadow_filter_data *)filter_handle->filter_data)->filters[PRODUCTION];
+    return production->restore(production, blob, size);
+}
+
+filter_handle_t init_shadow_filter(filter_handle_t production, filter_handle_t candidate)
+{
+    shadow_filter_data *data = calloc(1, sizeof(shadow_filter_data));
+    data->filters[PRODUCTION] = production;
+    data->filters[CANDIDATE] = candidate;
+
+    filter_handle_t filter_handle = malloc(sizeof(filter));
+    filter_handle->self = filter_handle;
+    filter_handle->process = shadow_filter_process;
+    filter_handle->calibrate_start = shadow_filter_calibration_start;
+    filter_handle->calibrate_end = shadow_filter_calibration_end;
+    // Whatever the production filter supports.
+    filter_handle->reconfigure = production->reconfigure ? shadow_filter_reconfigure : NULL;
+    filter_handle->save = production->save ? shadow_filter_save : NULL;
+    filter_handle->restore = production->restore ? shadow_filter_restore : NULL;
+    filter_handle->filter_data = data;
+    ESP_LOGI(TAG, "Candidate filter in the shadow of the production one");
+    return filter_handle;
+}
+
+void free_shadow_filter(filter_handle_t filter_handle)
+{
+    free(filter_handle->filter_data);
+    free(filter_handle);
+}
+
+static uint8_t crc8(const uint8_t *data, size_t length)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// Little-endian, whatever the host.
+static void print_record(const shadow_record *record)
+{
+    uint8_t bytes[9] = {
+        record->timestamp_ms, record->timestamp_ms >> 8, record->timestamp_ms >> 16, record->timestamp_ms >> 24,
+        record->production, record->production >> 8,
+        record->candidate, record->candidate >> 8};
+    bytes[8] = crc8(bytes, 8);
+    char line[SHADOW_FILTER_MAX_LINE];
+    int length = snprintf(line, sizeof(line), SHADOW_FILTER_PREFIX);
+    for (int b = 0; b < 9; ++b)
+    {
+        length += snprintf(line + length, sizeof(line) - length, "%02x", bytes[b]);
+    }
+    line[length++] = '\n';
+    fwrite(line, 1, length, stdout);
+}
+
+static void shadow_filter_task(void *arg)
+{
+    static shadow_record records[32];
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(SHADOW_FILTER_REPORT_S * 1000));
+        size_t count;
+        while ((count = shadow_filter_read(records, sizeof(records) / sizeof(records[0]))))
+        {
+            for (size_t r = 0; r < count; ++r)
+            {
+                print_record(&records[r]);
+            }
+        }
+        fflush(stdout);
+
+        shadow_filter_stats s = shadow_filter_get_stats();
+        ESP_LOGI(TAG, "%lu frames | %lu differ in %lu runs | %lu records, %lu dropped | production %llu cycles mean, %lu max | candidate %llu cycles mean, %lu max",
+                 s.frames, s.disagreement_frames, s.disagreements, s.records, s.dropped_records,
+                 s.frames ? s.cycles[PRODUCTION] / s.frames : 0, s.max_cycles[PRODUCTION],
+                 s.frames ? s.cycles[CANDIDATE] / s.frames : 0, s.max_cycles[CANDIDATE]);
+    }
+}
+
+void shadow_filter_start(void)
+{
+    xTaskCreate(&shadow_filter_task, "shadow_filter", SHADOW_FILTER_TASK_STACK, NULL, SHADOW_FILTER_TASK_PRIORITY, NULL);
+}
+
+shadow_filter_stats shadow_filter_get_stats(void)
+{
+    return stats;
+}
@@ -0,0 +1,71 @@
+#ifndef SHADOW_FILTER_H__
+#define SHADOW_FILTER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constants.h"
+#include "filter.h"
+#include "sensor_mask.h"
+
+// Runs a candidate filter in the shadow of the production one: both see the
+// same frames and calibrations, but only the production filter's pins are
+// passed on, so the keyboard types as before while the two are compared on real
+// use. The wrapper is itself a filter (filter.h); reconfigure, save and restore
+// go to the production filter only.
+//
+// Every frame on which the pressed sets change while they differ, or stop
+// differing, goes into a RAM ring as an 8-byte shadow_record. The cycles each
+// filter takes are counted in shadow_filter_stats. The candidate calibrates on
+// its own schedule, so its first seconds after boot disagree by design.
+//
+// shadow_filter_start starts a low-priority task that drains the ring to the
+// console every SHADOW_FILTER_REPORT_S, one line per record: SHADOW_FILTER_PREFIX,
+// then the record and a CRC-8 (polynomial 0x07) of it as 18 hex digits, followed
+// by a SHADOW log line with the statistics. host/tools/sensor_log_decode -s turns
+// a capture back into records; log_replay -s runs the same comparison on replayed
+// captures.
+
+#define SHADOW_FILTER_PREFIX "$S"
+// Power of two.
+#define SHADOW_FILTER_BUFFER_RECORDS 512
+#define SHADOW_FILTER_REPORT_S 10
+
+typedef struct
+{
+    // esp_timer time of the frame.
+    uint32_t timestamp_ms;
+    // Pressed from this frame on.
+    sensor_mask_t production;
+    sensor_mask_t candidate;
+} shadow_record;
+
+typedef struct
+{
+    uint32_t frames;
+    // Frames on which the pressed sets differ, and the runs of them.
+    uint32_t disagreement_frames;
+    uint32_t disagreements;
+    uint32_t records;
+    // Records that did not fit in the ring because it was not drained in time.
+    uint32_t dropped_records;
+    // [0] production, [1] candidate.
+    uint64_t cycles[2];
+    uint32_t max_cycles[2];
+} shadow_filter_stats;
+
+// Takes ownership of neither filter; free_shadow_filter frees only the wrapper.
+filter_handle_t init_shadow_filter(filter_handle_t production, filter_handle_t candidate);
+void free_shadow_filter(filter_handle_t filter_handle);
+
+// Starts the console reporter. Without it, shadow_filter_read drains the ring.
+void shadow_filter_start(void);
+
+// Takes up to max records from the ring, oldest first. Returns the count.
+size_t shadow_filter_read(shadow_record *records, size_t max);
+
+// Totals since boot, over every shadow filter.
+shadow_filter_stats shadow_filter_get_stats(void);
+
+#endif
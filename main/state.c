@@ -4,6 +4,9 @@
 #include "state.h"
 #include "sensors.h"
 
+// External definition of the inline in state.h, for builds that do not inline it.
+extern inline bool test_state(keyboard_state_t state);
+
 keyboard_state_t device_state = 0;
 volatile keyboard_state_t bt_state = KEYBOARD_STATE_BT_UNCONNECTED;
 
@@ -2,6 +2,7 @@ import argparse
 import copy
 import fileinput
 import itertools
+import mmap
 import re
 from typing import List
 
@@ -57,21 +58,58 @@ def read(filename, encoding):
 
     return data
 
+COLUMNAR_MAGIC = b'PAWCOL1\n'
+
+def is_columnar(filename):
+    with open(filename, 'rb') as f:
+        return f.read(len(COLUMNAR_MAGIC)) == COLUMNAR_MAGIC
+
+def read_columnar_tables(filename):
+    """Maps a file written by host/tools/log_parse -o (format in host/tools/capture.h).
+    Returns {table: {column: array}}; the arrays are views of the file, nothing is parsed."""
+    with open(filename, 'rb') as f:
+        buf = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    count = int(numpy.frombuffer(buf, dtype='<u4', count=1, offset=8)[0])
+    descriptors = numpy.frombuffer(buf, count=count, offset=16, dtype=numpy.dtype(
+        [('name', 'S40'), ('dtype', 'S8'), ('rows', '<u8'), ('offset', '<u8')]))
+    tables = {}
+    for name, dtype, rows, offset in descriptors:
+        table, column = name.decode().split('.', 1)
+        tables.setdefault(table, {})[column] = numpy.frombuffer(buf, dtype=dtype.decode(), count=int(rows), offset=int(offset))
+    return tables
+
+def read_columnar(filename):
+    tables = read_columnar_tables(filename)
+    data = LogDump(filename=filename)
+
+    def channels(table, prefix, missing):
+        columns = [tables[table][f'{prefix}{i}'] for i in range(len(tables[table])) if f'{prefix}{i}' in tables[table]]
+        return [c for c in columns if len(c) and not missing(c).all()]
+
+    data.analog_timestamps = tables['sensor']['timestamp_ms']
+    data.analog_readings = channels('sensor', 'raw', lambda c: c == -1)
+    data.calibration_timestamps = tables['thresholds']['timestamp_ms']
+    data.calibration_readings = channels('thresholds', 'threshold', numpy.isnan)
+    data.tx_events = [(int(t), 'del' if k == 127 else chr(k))
+                      for t, k in zip(tables['encoding']['timestamp_ms'], tables['encoding']['key'])]
+    return data
+
 def showanalogchannel(data, i, **kwargs):
     plt.plot(data.analog_timestamps, data.analog_readings[i], color = finger_color_map[i], **kwargs)
 
 def showtxevents(data, **kwargs):
     plt.xticks([i[0] for i in data.tx_events],   labels= [i[1] for i in data.tx_events], **kwargs)
 
-finger_color_map = ['blue', 'red', 'green', 'black', 'yellow']
+finger_color_map = ['blue', 'red', 'green', 'black', 'yellow', 'cyan', 'magenta', 'orange', 'purple', 'brown']
 
 def showcalibrationevents(data, i, **kwargs):
     plt.scatter(data.calibration_timestamps, data.calibration_readings[i], color = finger_color_map[i], marker="_", **kwargs)
 
 
 def show(data):
-    for i in range(5): 
+    for i in range(len(data.analog_readings)):
         showanalogchannel(data, i)
+    for i in range(len(data.calibration_readings)):
         showcalibrationevents(data, i)
     showtxevents(data)
     plt.show()
@@ -171,13 +209,16 @@ def dofilter(data, filter_fn):
 
 
 parser = argparse.ArgumentParser()
-parser.add_argument('filepath',)
+parser.add_argument('filepath', help="Console capture, or a columnar file from host/tools/log_parse -o (much faster).")
 parser.add_argument('--encoding', default='utf-8')
 parser.add_argument('--filter', default=None, help="Filter function to run. Does NOT recompute transmission events.")
 
 if __name__ == "__main__":
     args = parser.parse_args()
-    data = read(args.filepath, args.encoding)
+    if is_columnar(args.filepath):
+        data = read_columnar(args.filepath)
+    else:
+        data = read(args.filepath, args.encoding)
     if args.filter:
         data = dofilter(data, filters[args.filter])
     show(data)